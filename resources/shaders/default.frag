@@ -41,17 +41,62 @@ uniform float fogStart;
 uniform float fogEnd;
 uniform float fogDensity;
 
-// texture parameters
-uniform sampler2D diffuseTexture;
-uniform sampler2D normalMap;
+// texture parameters, material textures are layers of texture arrays
+uniform sampler2DArray diffuseTexture;
+uniform sampler2DArray normalMap;
+uniform float diffuseLayer;
+uniform float normalLayer;
+uniform vec2 diffuseRepeat;
+uniform vec2 normalRepeat;
 uniform bool hasDiffuseTexture;
 uniform bool hasNormalMap;
 uniform float time;
 
+// virtual texture (replaces the diffuse texture): tiles live in vtCache, each
+// texel of vtIndirection points one tile at its cache slot. levels are stacked
+// in the indirection texture starting at vtLevelRows[level]
+uniform bool hasVirtualTexture;
+uniform sampler2D vtCache;
+uniform sampler2D vtIndirection;
+uniform vec2 vtSize;
+uniform int vtLevelCount;
+uniform int vtLevelRows[15];
+uniform int vtTileSize;
+uniform int vtBorder;
+uniform float vtCacheSize;
+
 // scrolling parameters
 uniform vec2 scrollDirection;
 uniform float scrollSpeed;
 
+vec3 sampleVirtualTexture(vec2 uv) {
+    // pick the level from the screen footprint, the feedback pass uses the same rule
+    vec2 texel = uv * vtSize;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    int level = clamp(int(floor(lod)), 0, vtLevelCount - 1);
+
+    vec2 wrapped = fract(uv);
+    vec2 levelSize = max(floor(vtSize / exp2(float(level))), vec2(1.0));
+    ivec2 tile = ivec2(wrapped * levelSize) / vtTileSize;
+    vec4 entry = texelFetch(vtIndirection, ivec2(tile.x, vtLevelRows[level] + tile.y), 0);
+    if (entry.a < 0.5) {
+        return vec3(1.0);
+    }
+
+    // the entry may point at a coarser parent when this tile isn't resident yet
+    int resident = int(entry.b * 255.0 + 0.5);
+    vec2 residentSize = max(floor(vtSize / exp2(float(resident))), vec2(1.0));
+    vec2 residentTexel = wrapped * residentSize;
+    vec2 inTile = residentTexel - floor(residentTexel / float(vtTileSize)) * float(vtTileSize);
+
+    // bilinear inside the slot, the border keeps it from bleeding into neighbours
+    vec2 slot = floor(entry.rg * 255.0 + 0.5);
+    vec2 cacheTexel = slot * float(vtTileSize + 2 * vtBorder) + float(vtBorder) + inTile;
+    return texture(vtCache, cacheTexel / vtCacheSize).rgb;
+}
+
 vec3 computeLight(Light light, vec3 normal, vec3 viewDir) {
     vec3 lightDir;
     float attenuation = 1.0;
@@ -103,22 +148,25 @@ void main() {
         vec3 N = normalize(fragNormal);
         mat3 TBN = mat3(T, B, N);
 
-        vec3 normalMapSample = texture(normalMap, fragUV).rgb;
-        vec3 tangentSpaceNormal = normalMapSample * 2.0 - 1.0;
+        // normal maps only store x and y, z is always positive in tangent space
+        vec2 normalXY = texture(normalMap, vec3(fragUV * normalRepeat, normalLayer)).rg * 2.0 - 1.0;
+        vec3 tangentSpaceNormal = vec3(normalXY, sqrt(max(0.0, 1.0 - dot(normalXY, normalXY))));
         normal = normalize(TBN * tangentSpaceNormal);
     }
 
     vec3 viewDir = normalize(cameraPos - fragPosition);
 
-    vec2 uv = fragUV;
-    if (enableScrolling && hasDiffuseTexture) {
+    vec2 uv = fragUV * diffuseRepeat;
+    if (enableScrolling && (hasDiffuseTexture || hasVirtualTexture)) {
         uv += scrollDirection * scrollSpeed * time;
     }
 
     // sample diffuse texture if available
     vec3 texColor = vec3(1.0);
-    if (hasDiffuseTexture) {
-        texColor = texture(diffuseTexture, uv).rgb;
+    if (hasVirtualTexture) {
+        texColor = sampleVirtualTexture(uv);
+    } else if (hasDiffuseTexture) {
+        texColor = texture(diffuseTexture, vec3(uv, diffuseLayer)).rgb;
     }
 
     // ambient (modulated by texture)
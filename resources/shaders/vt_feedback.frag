@@ -0,0 +1,45 @@
+#version 330 core
+
+// virtual texture feedback: writes the tile each pixel would sample so the
+// cpu can stream it in. rendered at a fraction of the viewport size
+
+in vec2 fragUV;
+
+out vec4 fragColor;
+
+uniform int vtIndex;       // -1 for occluders without a virtual texture
+uniform vec2 vtSize;       // level 0 size in texels
+uniform int vtLevelCount;
+uniform int vtTileSize;
+uniform vec2 repeat;
+uniform bool enableScrolling;  // same offset as default.frag
+uniform vec2 scrollDirection;
+uniform float scrollSpeed;
+uniform float time;
+uniform float mipBias;     // makes up for the lower resolution of this pass
+
+void main() {
+    if (vtIndex < 0) {
+        fragColor = vec4(1.0);
+        return;
+    }
+
+    vec2 uv = fragUV * repeat;
+    if (enableScrolling) {
+        uv += scrollDirection * scrollSpeed * time;
+    }
+    vec2 texel = uv * vtSize;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + mipBias;
+    int level = clamp(int(floor(lod)), 0, vtLevelCount - 1);
+
+    vec2 levelSize = max(floor(vtSize / exp2(float(level))), vec2(1.0));
+    ivec2 tile = ivec2(fract(uv) * levelSize) / vtTileSize;
+
+    // r, g = low bits of x and y, b = high bits of both, a = level and texture.
+    // the clear color (all 255) means no tile
+    fragColor = vec4(float(tile.x & 255), float(tile.y & 255),
+                     float((tile.x >> 8) | ((tile.y >> 8) << 4)),
+                     float(level | (vtIndex << 4))) / 255.0;
+}
@@ -0,0 +1,175 @@
+#include "ZoneProfiler.h"
+#include <QSaveFile>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+// a null name marks the end of the innermost open zone. fields are atomic so
+// an export can read a slot while its thread overwrites it; the copy is
+// checked against the write count afterwards and torn slots are dropped
+struct Event {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<int64_t> nanoseconds{0};
+};
+
+struct ThreadEvents {
+    std::unique_ptr<Event[]> events{new Event[ZoneProfiler::EVENTS_PER_THREAD]};
+    std::atomic<uint64_t> written{0};
+    std::atomic<const char*> name{nullptr};
+    int id = 0;
+};
+
+std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// buffers stay registered after their thread exits, so its zones still export
+std::vector<std::shared_ptr<ThreadEvents>>& registry() {
+    static std::vector<std::shared_ptr<ThreadEvents>> threads;
+    return threads;
+}
+
+ThreadEvents& threadEvents() {
+    // registering takes the lock once per thread, never while recording
+    thread_local std::shared_ptr<ThreadEvents> events = []() {
+        auto created = std::make_shared<ThreadEvents>();
+        std::lock_guard<std::mutex> lock(registryMutex());
+        created->id = static_cast<int>(registry().size()) + 1;
+        registry().push_back(created);
+        return created;
+    }();
+    return *events;
+}
+
+int64_t now() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void record(const char* name) {
+    ThreadEvents& thread = threadEvents();
+    uint64_t index = thread.written.load(std::memory_order_relaxed);
+    Event& event = thread.events[index % ZoneProfiler::EVENTS_PER_THREAD];
+    event.name.store(name, std::memory_order_relaxed);
+    event.nanoseconds.store(now(), std::memory_order_relaxed);
+    thread.written.store(index + 1, std::memory_order_release);
+}
+
+void putEscaped(std::ostream& out, const char* text) {
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+}
+
+}
+
+void ZoneProfiler::begin(const char* name) {
+    record(name);
+}
+
+void ZoneProfiler::end() {
+    record(nullptr);
+}
+
+void ZoneProfiler::setThreadName(const char* name) {
+    threadEvents().name.store(name, std::memory_order_relaxed);
+}
+
+bool ZoneProfiler::writeChromeTrace(const std::string& path) {
+    std::vector<std::shared_ptr<ThreadEvents>> threads;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        threads = registry();
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first = true;
+    auto separator = [&]() -> std::ostream& {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        return out;
+    };
+
+    for (const std::shared_ptr<ThreadEvents>& thread : threads) {
+        struct Copy {
+            const char* name;
+            int64_t nanoseconds;
+        };
+
+        // copy the ring, then keep only slots its thread can't have reached since
+        uint64_t written = thread->written.load(std::memory_order_acquire);
+        uint64_t start = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+        std::vector<Copy> events;
+        events.reserve(static_cast<size_t>(written - start));
+        for (uint64_t i = start; i < written; i++) {
+            const Event& event = thread->events[i % EVENTS_PER_THREAD];
+            events.push_back({event.name.load(std::memory_order_relaxed), event.nanoseconds.load(std::memory_order_relaxed)});
+        }
+        uint64_t after = thread->written.load(std::memory_order_acquire);
+        // slot `after` may be half written by now too, so it goes with the overwritten ones
+        size_t torn = after >= start + EVENTS_PER_THREAD ?
+                          static_cast<size_t>(after + 1 - start - EVENTS_PER_THREAD) : 0;
+        torn = std::min(torn, events.size());
+
+        const char* threadName = thread->name.load(std::memory_order_relaxed);
+        separator() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread->id
+                    << ", \"args\": {\"name\": \"";
+        if (threadName != nullptr) {
+            putEscaped(out, threadName);
+        } else {
+            out << "thread " << thread->id;
+        }
+        out << "\"}}";
+
+        // the ring may start inside zones whose beginning was overwritten, and
+        // zones still open get closed at the last event
+        int depth = 0;
+        int64_t last = 0;
+        for (size_t i = torn; i < events.size(); i++) {
+            const Copy& event = events[i];
+            last = event.nanoseconds;
+            if (event.name == nullptr && depth == 0) {
+                continue;
+            }
+            separator() << "{\"ph\": \"" << (event.name != nullptr ? "B" : "E") << "\", \"ts\": "
+                        << event.nanoseconds / 1000.0 << ", \"pid\": 1, \"tid\": " << thread->id;
+            if (event.name != nullptr) {
+                out << ", \"name\": \"";
+                putEscaped(out, event.name);
+                out << "\"";
+                depth++;
+            } else {
+                depth--;
+            }
+            out << "}";
+        }
+        for (; depth > 0; depth--) {
+            separator() << "{\"ph\": \"E\", \"ts\": " << last / 1000.0 << ", \"pid\": 1, \"tid\": " << thread->id << "}";
+        }
+    }
+    out << "\n]}\n";
+
+    std::string text = out.str();
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(text.data(), static_cast<qint64>(text.size())) != static_cast<qint64>(text.size()) ||
+        !file.commit()) {
+        std::cerr << "Failed to save trace to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+// hierarchical cpu profiler for code that runs every frame. PROFILE_ZONE("name")
+// marks the rest of the enclosing block as a zone; zones nest and every thread
+// gets its own track. a zone costs two clock reads and two stores into a ring
+// buffer owned by its thread, with no locks and no allocation. the last
+// EVENTS_PER_THREAD begin/end events of every thread can be written out as a
+// chrome trace (chrome://tracing, perfetto).
+//
+// zones are only compiled in with BREAD_PROFILE_ZONES (cmake -DBREAD_PROFILE_ZONES=ON),
+// otherwise PROFILE_ZONE expands to nothing
+#ifndef BREAD_PROFILE_ZONES
+#define BREAD_PROFILE_ZONES 0
+#endif
+
+class ZoneProfiler {
+public:
+    static constexpr bool ENABLED = BREAD_PROFILE_ZONES != 0;
+    static constexpr int EVENTS_PER_THREAD = 1 << 16;
+
+    // name has to be a string literal, only the pointer is stored
+    static void begin(const char* name);
+    static void end();
+
+    // label the calling thread's track
+    static void setThreadName(const char* name);
+
+    // write every thread's events as chrome trace json. safe while other
+    // threads keep recording. false (after printing why) if it can't be written
+    static bool writeChromeTrace(const std::string& path);
+
+    class Zone {
+    public:
+        explicit Zone(const char* name) { ZoneProfiler::begin(name); }
+        ~Zone() { ZoneProfiler::end(); }
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+    };
+};
+
+#if BREAD_PROFILE_ZONES
+#define BREAD_ZONE_JOIN2(a, b) a##b
+#define BREAD_ZONE_JOIN(a, b) BREAD_ZONE_JOIN2(a, b)
+#define PROFILE_ZONE(name) ZoneProfiler::Zone BREAD_ZONE_JOIN(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) static_cast<void>(0)
+#endif
@@ -55,10 +55,18 @@ void Camera::computeProjectionMatrix() const {
     float n = m_nearPlane;
     float f = m_farPlane;
 
+    // scale the window up to the whole viewport and shift its center to the middle
+    float l = m_projectionWindow.x;
+    float r = m_projectionWindow.y;
+    float b = m_projectionWindow.z;
+    float t = m_projectionWindow.w;
+    sx *= 2.0f / (r - l);
+    sy *= 2.0f / (t - b);
+
     m_projectionMatrix = glm::mat4(
         sx, 0, 0, 0,
         0, sy, 0, 0,
-        0, 0, -(f + n) / (f - n), -1,
+        (r + l) / (r - l), (t + b) / (t - b), -(f + n) / (f - n), -1,
         0, 0, -2.0f * f * n / (f - n), 0
     );
 
@@ -90,6 +98,11 @@ void Camera::updateClippingPlanes(float nearPlane, float farPlane) {
     m_projectionMatrixDirty = true;
 }
 
+void Camera::setProjectionWindow(const glm::vec4& window) {
+    m_projectionWindow = window;
+    m_projectionMatrixDirty = true;
+}
+
 void Camera::updateFromSceneData(const SceneCameraData& cameraData) {
     m_pos = cameraData.pos;
     m_look = glm::normalize(cameraData.look);
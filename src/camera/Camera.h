@@ -14,6 +14,11 @@ public:
     void updateClippingPlanes(float nearPlane, float farPlane);
     void updateFromSceneData(const SceneCameraData& cameraData);
 
+    // narrow the projection to part of the image plane, as an off-axis frustum:
+    // (left, right, bottom, top) in the normalized device coordinates of the
+    // whole view, (-1, 1, -1, 1) being all of it. used to render large images in tiles
+    void setProjectionWindow(const glm::vec4& window);
+
     void translateForward(float distance);
     void translateBackward(float distance);
     void translateLeft(float distance);
@@ -39,6 +44,7 @@ private:
     float m_aspectRatio;
     float m_nearPlane;
     float m_farPlane;
+    glm::vec4 m_projectionWindow = glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f);
 
     mutable glm::mat4 m_viewMatrix;
     mutable glm::mat4 m_projectionMatrix;
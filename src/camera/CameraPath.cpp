@@ -0,0 +1,189 @@
+#include "CameraPath.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+bool toVec3(const QJsonValue& value, glm::vec3& out) {
+    QJsonArray array = value.toArray();
+    if (array.size() != 3) {
+        return false;
+    }
+    out = glm::vec3(array[0].toDouble(), array[1].toDouble(), array[2].toDouble());
+    return true;
+}
+
+QJsonArray fromVec3(const glm::vec3& v) {
+    return QJsonArray{v.x, v.y, v.z};
+}
+
+glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float u) {
+    float u2 = u * u;
+    float u3 = u2 * u;
+    return 0.5f * (2.0f * p1 + (p2 - p0) * u + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * u3);
+}
+
+glm::vec3 normalizeOr(const glm::vec3& v, const glm::vec3& fallback) {
+    float length = glm::length(v);
+    return length > 1e-6f ? v / length : fallback;
+}
+
+glm::vec3 rotateY(const glm::vec3& v, float angle) {
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    return glm::vec3(c * v.x + s * v.z, v.y, -s * v.x + c * v.z);
+}
+
+}
+
+bool CameraPath::load(const std::string& path) {
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "failed to open camera path: " << path << std::endl;
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (document.isNull() || !document.isObject()) {
+        std::cerr << "camera path " << path << " is not a json object: " << error.errorString().toStdString() << std::endl;
+        return false;
+    }
+
+    QJsonObject root = document.object();
+    m_keyframes.clear();
+    m_loop = root["loop"].toBool(false);
+    QJsonArray keyframes = root["keyframes"].toArray();
+    for (int i = 0; i < keyframes.size(); i++) {
+        QJsonObject object = keyframes[i].toObject();
+        Keyframe keyframe;
+        keyframe.time = static_cast<float>(object["time"].toDouble());
+        if (!toVec3(object["position"], keyframe.position) || !toVec3(object["look"], keyframe.look)) {
+            std::cerr << "camera path " << path << ": keyframe " << i << " needs a position and a look direction" << std::endl;
+            return false;
+        }
+        toVec3(object["up"], keyframe.up);
+        if (!m_keyframes.empty() && keyframe.time < m_keyframes.back().time) {
+            std::cerr << "camera path " << path << ": keyframe " << i << " goes back in time" << std::endl;
+            return false;
+        }
+        m_keyframes.push_back(keyframe);
+    }
+
+    if (m_keyframes.empty()) {
+        std::cerr << "camera path " << path << " has no keyframes" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CameraPath::save(const std::string& path) const {
+    QJsonArray keyframes;
+    for (const Keyframe& keyframe : m_keyframes) {
+        QJsonObject object;
+        object["time"] = keyframe.time;
+        object["position"] = fromVec3(keyframe.position);
+        object["look"] = fromVec3(keyframe.look);
+        object["up"] = fromVec3(keyframe.up);
+        keyframes.append(object);
+    }
+    QJsonObject root;
+    root["loop"] = m_loop;
+    root["keyframes"] = keyframes;
+
+    QByteArray text = QJsonDocument(root).toJson();
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly) || file.write(text) != text.size() || !file.commit()) {
+        std::cerr << "Failed to save camera path to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void CameraPath::addKeyframe(const Keyframe& keyframe) {
+    m_keyframes.push_back(keyframe);
+}
+
+float CameraPath::duration() const {
+    return m_keyframes.empty() ? 0.0f : m_keyframes.back().time - m_keyframes.front().time;
+}
+
+SceneCameraData CameraPath::sample(float time, const SceneCameraData& base) const {
+    SceneCameraData camera = base;
+    if (m_keyframes.empty()) {
+        return camera;
+    }
+
+    int count = static_cast<int>(m_keyframes.size());
+    float start = m_keyframes.front().time;
+    float end = m_keyframes.back().time;
+    if (m_loop && end > start) {
+        time = start + std::fmod(time - start, end - start);
+        if (time < start) {
+            time += end - start;
+        }
+    }
+    time = std::clamp(time, start, end);
+
+    // the segment starts at the last keyframe not after time
+    auto next = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), time,
+                                 [](float t, const Keyframe& keyframe) { return t < keyframe.time; });
+    int i1 = std::clamp(static_cast<int>(next - m_keyframes.begin()) - 1, 0, count - 1);
+    int i2 = std::min(i1 + 1, count - 1);
+
+    // a loop's last keyframe is where its first one is, so neighbours wrap
+    // around it; an open path repeats its end points
+    auto key = [&](int i) -> const Keyframe& {
+        if (m_loop && count > 2) {
+            int period = count - 1;
+            return m_keyframes[static_cast<size_t>(((i % period) + period) % period)];
+        }
+        return m_keyframes[static_cast<size_t>(std::clamp(i, 0, count - 1))];
+    };
+
+    const Keyframe& k0 = key(i1 - 1);
+    const Keyframe& k1 = m_keyframes[static_cast<size_t>(i1)];
+    const Keyframe& k2 = m_keyframes[static_cast<size_t>(i2)];
+    const Keyframe& k3 = key(i2 + 1);
+    float span = k2.time - k1.time;
+    float u = span > 0.0f ? (time - k1.time) / span : 0.0f;
+
+    glm::vec3 position = catmullRom(k0.position, k1.position, k2.position, k3.position, u);
+    glm::vec3 look = catmullRom(k0.look, k1.look, k2.look, k3.look, u);
+    glm::vec3 up = catmullRom(k0.up, k1.up, k2.up, k3.up, u);
+
+    camera.pos = glm::vec4(position, 1.0f);
+    camera.look = glm::vec4(normalizeOr(look, glm::normalize(k1.look)), 0.0f);
+    camera.up = glm::vec4(normalizeOr(up, glm::normalize(k1.up)), 0.0f);
+    return camera;
+}
+
+CameraPath CameraPath::orbit(const SceneCameraData& camera, float seconds) {
+    constexpr int KEYFRAMES = 16;
+
+    // the point straight ahead at the distance of the scene origin
+    glm::vec3 position = glm::vec3(camera.pos);
+    glm::vec3 look = normalizeOr(glm::vec3(camera.look), glm::vec3(0.0f, 0.0f, -1.0f));
+    glm::vec3 up = normalizeOr(glm::vec3(camera.up), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec3 focus = position + look * std::max(glm::length(position), 1.0f);
+
+    CameraPath path;
+    path.setLoop(true);
+    for (int i = 0; i <= KEYFRAMES; i++) {
+        float angle = 2.0f * 3.14159265f * i / KEYFRAMES;
+        Keyframe keyframe;
+        keyframe.time = seconds * i / KEYFRAMES;
+        keyframe.position = focus + rotateY(position - focus, angle);
+        keyframe.look = rotateY(look, angle);
+        keyframe.up = rotateY(up, angle);
+        path.addKeyframe(keyframe);
+    }
+    return path;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "utils/scenedata.h"
+
+// a camera moving through keyframes over time, for replaying the same flight
+// through a scene. positions, look and up directions are interpolated along
+// catmull-rom splines through the keyframes, so a few hand placed keys give a
+// smooth flight and a densely recorded path replays as it was flown.
+//
+// stored as json:
+//   {"loop": false, "keyframes": [
+//     {"time": 0.0, "position": [0, 2, 8], "look": [0, -0.2, -1], "up": [0, 1, 0]},
+//     {"time": 4.0, "position": [6, 2, 0], "look": [-1, -0.2, 0], "up": [0, 1, 0]}]}
+// time is in seconds, keyframes in increasing time. a looping path wraps
+// around after its last keyframe, otherwise the camera stays there
+class CameraPath {
+public:
+    struct Keyframe {
+        float time = 0.0f;
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 look = glm::vec3(0.0f, 0.0f, -1.0f);
+        glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+    };
+
+    // false (after printing why) if the file can't be read or has no keyframes
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+
+    // keyframes have to come in increasing time
+    void addKeyframe(const Keyframe& keyframe);
+    void setLoop(bool loop) { m_loop = loop; }
+    void clear() { m_keyframes.clear(); }
+
+    bool isEmpty() const { return m_keyframes.empty(); }
+    const std::vector<Keyframe>& keyframes() const { return m_keyframes; }
+    float duration() const;
+
+    // the camera at time seconds. fields the path doesn't move (height angle,
+    // depth of field) are taken from base
+    SceneCameraData sample(float time, const SceneCameraData& base) const;
+
+    // one loop around the point the camera looks at, at the camera's height,
+    // taking seconds
+    static CameraPath orbit(const SceneCameraData& camera, float seconds);
+
+private:
+    std::vector<Keyframe> m_keyframes;
+    bool m_loop = false;
+};
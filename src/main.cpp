@@ -1,14 +1,136 @@
 #include "mainwindow.h"
 #include "settings.h"
+#include "ZoneProfiler.h"
+#include "rendering/BatchRenderer.h"
+#include "rendering/Benchmark.h"
+#include "rendering/ImageEncoder.h"
+#include "rendering/OffscreenContext.h"
+#include "rendering/RenderCoordinator.h"
+#include "rendering/RenderServer.h"
+#include "rendering/SceneRenderer.h"
+#include "rendering/SequenceRecorder.h"
+#include "rendering/VirtualTextureFile.h"
 
 #include <QApplication>
 #include <QScreen>
 #include <QCommandLineParser>
-#include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <QSettings>
 
+// render the scene once into an offscreen framebuffer and save it, in tiles if
+// it is larger than settings.captureTileSize, or record recordFrames frames of
+// its animation starting at time. no window, no event loop, returns as soon as
+// the output is written
+static int renderHeadless(const std::string& outputPath, int width, int height, float time, int recordFrames, int fps) {
+    OffscreenContext context;
+    if (!context.create()) {
+        return 1;
+    }
+
+    SceneRenderer renderer;
+    bool rendered = false;
+    if (renderer.initialize()) {
+        renderer.resize(std::min(width, settings.captureTileSize), std::min(height, settings.captureTileSize));
+        bool tiled = width > settings.captureTileSize || height > settings.captureTileSize;
+        if (renderer.loadScene()) {
+            if (recordFrames > 0) {
+                SequenceRecorder::Options options;
+                options.frames = recordFrames;
+                options.fps = fps;
+                options.width = width;
+                options.height = height;
+                options.output = outputPath;
+                options.startTime = time;
+                rendered = SequenceRecorder::record(renderer, options) == 0;
+            } else if (tiled) {
+                renderer.setTime(time);
+                rendered = renderer.captureTiled(width, height, settings.captureTileSize, outputPath);
+            } else {
+                renderer.setTime(time);
+                QImage image = renderer.renderImage(width, height);
+                if (image.isNull()) {
+                    std::cerr << "Failed to save image to " << outputPath << std::endl;
+                } else {
+                    rendered = ImageEncoder::save(image.constBits(), image.width(), image.height(), image.bytesPerLine(), outputPath);
+                }
+            }
+        }
+    }
+    renderer.cleanup();
+    return rendered ? 0 : 1;
+}
+
+// fly the benchmark camera path through the scene offscreen and report the timings
+static int runBenchmark(const Benchmark::Options& options) {
+    OffscreenContext context;
+    if (!context.create()) {
+        return 1;
+    }
+
+    SceneRenderer renderer;
+    bool finished = false;
+    if (renderer.initialize()) {
+        renderer.resize(options.width, options.height);
+        finished = renderer.loadScene() && Benchmark::run(renderer, options);
+    }
+    renderer.cleanup();
+    return finished ? 0 : 1;
+}
+
+// the command line for worker processes: the same settings, minus the options
+// that say what to render, which the coordinator hands out itself, and the ones
+// that write a file on exit, which every worker would write over
+static QStringList workerArguments(const QStringList& arguments) {
+    const QStringList withValue = {"o", "output", "size", "time", "record", "fps", "batch", "serve", "workers",
+                                   "gpu-profile", "trace", "benchmark", "camera-path", "seed", "record-camera-path"};
+    const QStringList flags = {"headless", "worker-scaling"};
+    QStringList kept;
+    for (int i = 1; i < arguments.size(); i++) {
+        QString name = arguments[i];
+        while (name.startsWith('-')) {
+            name.remove(0, 1);
+        }
+        bool inlineValue = name.contains('=');
+        name = name.section('=', 0, 0);
+        if (arguments[i].startsWith('-') && withValue.contains(name)) {
+            if (!inlineValue) {
+                i++;
+            }
+            continue;
+        }
+        if (arguments[i].startsWith('-') && flags.contains(name)) {
+            continue;
+        }
+        kept << arguments[i];
+    }
+    return kept;
+}
+
+// writes the zone trace when main returns, whichever mode ran
+struct TraceOnExit {
+    std::string path;
+    ~TraceOnExit() {
+        if (!path.empty() && ZoneProfiler::writeChromeTrace(path)) {
+            std::cout << "trace written to " << path << std::endl;
+        }
+    }
+};
+
 int main(int argc, char *argv[]) {
+    // headless, batch and server renders don't need a display server. the
+    // offscreen platform plugin still provides gl contexts (egl where available)
+    for (int i = 1; i < argc; i++) {
+        bool offscreen = std::strcmp(argv[i], "--headless") == 0 || std::strcmp(argv[i], "--batch") == 0 ||
+                         std::strcmp(argv[i], "--serve") == 0 || std::strcmp(argv[i], "--benchmark") == 0;
+        if (offscreen && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+
     QApplication a(argc, argv);
 
     QCoreApplication::setApplicationName("Bread Final");
@@ -57,12 +179,87 @@ int main(int argc, char *argv[]) {
     parser.addOption(scrollSpeedOption);
     parser.addOption(scrollDirOption);
 
+    // shader hot reload
+    QCommandLineOption shaderDirOption("shader-dir", "Load shaders from a directory and reload them when edited", "dir");
+    parser.addOption(shaderDirOption);
+
+    // texture cache
+    QCommandLineOption textureCacheDirOption("texture-cache-dir", "Directory for preprocessed textures", "dir");
+    QCommandLineOption disableTextureCacheOption("disable-texture-cache", "Always decode textures from source");
+    QCommandLineOption compressTexturesOption("compress-textures", "Store cached textures s3tc compressed");
+    parser.addOption(textureCacheDirOption);
+    parser.addOption(disableTextureCacheOption);
+    parser.addOption(compressTexturesOption);
+    QCommandLineOption uncompressedNormalMapsOption("uncompressed-normal-maps", "Store normal maps as rg8 instead of rgtc2");
+    parser.addOption(uncompressedNormalMapsOption);
+    QCommandLineOption textureBudgetOption("texture-budget", "GPU memory for textures in MB (0 = unlimited)", "mb");
+    parser.addOption(textureBudgetOption);
+
+    // virtual textures
+    QCommandLineOption buildVirtualTextureOption("build-virtual-texture",
+        "Split an image into a .bvt tile file (written next to it, or to -o) and exit", "image");
+    QCommandLineOption virtualTextureCacheOption("vt-cache-tiles", "Virtual texture cache size in tiles per side", "count");
+    parser.addOption(buildVirtualTextureOption);
+    parser.addOption(virtualTextureCacheOption);
+    QCommandLineOption mipFilterOption("mip-filter", "Mip filter for color textures: box or kaiser", "filter");
+    QCommandLineOption alphaCoverageOption("alpha-coverage", "Keep alpha test coverage at this cutoff in every mip level", "cutoff");
+    parser.addOption(mipFilterOption);
+    parser.addOption(alphaCoverageOption);
+
     // headless mode for automated testing
-    QCommandLineOption headlessOption("headless", "Run in headless mode (auto-save and exit)");
+    QCommandLineOption headlessOption("headless", "Render to -o without a window and exit");
     parser.addOption(headlessOption);
+    QCommandLineOption sizeOption("size", "Image size for --headless, default 1024x768", "WxH");
+    QCommandLineOption tileSizeOption("tile-size", "Render captures larger than this in tiles of this size", "pixels");
+    parser.addOption(sizeOption);
+    parser.addOption(tileSizeOption);
+    QCommandLineOption timeOption("time", "Animation time in seconds --headless renders at (default 0.1), or of the first --record frame (default 0)", "seconds");
+    parser.addOption(timeOption);
+    QCommandLineOption recordOption("record", "With --headless, record this many frames to -o (numbered images or .y4m)", "frames");
+    QCommandLineOption fpsOption("fps", "Frame rate of --record, the animation advances 1/fps per frame (default 30)", "fps");
+    parser.addOption(recordOption);
+    parser.addOption(fpsOption);
+    QCommandLineOption batchOption("batch", "Render every job of a json manifest in one process and exit", "manifest");
+    parser.addOption(batchOption);
+    QCommandLineOption gpuProfileOption("gpu-profile", "Time render passes on the gpu and cpu, write min/avg/p99 per pass here on exit (.csv or .json)", "file");
+    parser.addOption(gpuProfileOption);
+    QCommandLineOption traceOption("trace", "Write a chrome trace of the profiled zones here on exit (needs a BREAD_PROFILE_ZONES build)", "file");
+    parser.addOption(traceOption);
+    QCommandLineOption workersOption("workers", "Spread --batch jobs, or the tiles of a --headless image, over this many worker processes", "count");
+    QCommandLineOption workerScalingOption("worker-scaling", "With --workers, time the render on 1, 2, 4, ... workers and report the speedup");
+    parser.addOption(workersOption);
+    parser.addOption(workerScalingOption);
+    QCommandLineOption serveOption("serve", "Keep running and render json requests from a local socket, or stdin for -", "socket");
+    parser.addOption(serveOption);
+    QCommandLineOption benchmarkOption("benchmark", "Fly a camera path through the scene for this many frames offscreen, report frame times (json to -o) and exit", "frames");
+    QCommandLineOption cameraPathOption("camera-path", "Camera path json for --benchmark, default an orbit around the scene camera's focus", "file");
+    QCommandLineOption seedOption("seed", "Instance layout seed for --benchmark (default 1)", "seed");
+    QCommandLineOption recordCameraOption("record-camera-path", "Record the camera flown in the viewport and write it here as a camera path on exit", "file");
+    parser.addOption(benchmarkOption);
+    parser.addOption(cameraPathOption);
+    parser.addOption(seedOption);
+    parser.addOption(recordCameraOption);
 
     parser.process(a);
 
+    TraceOnExit trace;
+    if (parser.isSet(traceOption)) {
+        if (!ZoneProfiler::ENABLED) {
+            std::cerr << "--trace needs a build with -DBREAD_PROFILE_ZONES=ON" << std::endl;
+            return 1;
+        }
+        ZoneProfiler::setThreadName("main");
+        trace.path = parser.value(traceOption).toStdString();
+    }
+
+    // offline tool, no window or gl context needed
+    if (parser.isSet(buildVirtualTextureOption)) {
+        QFileInfo image(parser.value(buildVirtualTextureOption));
+        QString output = parser.isSet(outputOption) ? parser.value(outputOption)
+                                                    : image.dir().filePath(image.completeBaseName() + ".bvt");
+        return VirtualTextureFile::build(image.filePath().toStdString(), output.toStdString()) ? 0 : 1;
+    }
+
     // override settings from command-line arguments
     if (parser.isSet(enableFogOption)) settings.enableFog = true;
     if (parser.isSet(disableFogOption)) settings.enableFog = false;
@@ -96,10 +293,159 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // load scene file if provided
+    if (parser.isSet(shaderDirOption)) {
+        settings.shaderDirectory = parser.value(shaderDirOption).toStdString();
+    }
+
+    if (parser.isSet(textureCacheDirOption)) {
+        settings.textureCacheDirectory = parser.value(textureCacheDirOption).toStdString();
+    }
+    if (parser.isSet(disableTextureCacheOption)) settings.enableTextureCache = false;
+    if (parser.isSet(compressTexturesOption)) settings.compressTextureCache = true;
+    if (parser.isSet(uncompressedNormalMapsOption)) settings.compressNormalMaps = false;
+    if (parser.isSet(textureBudgetOption)) {
+        settings.textureBudgetMB = parser.value(textureBudgetOption).toInt();
+    }
+    if (parser.isSet(virtualTextureCacheOption)) {
+        settings.virtualTextureCacheTiles = parser.value(virtualTextureCacheOption).toInt();
+    }
+    if (parser.isSet(mipFilterOption)) {
+        QString filter = parser.value(mipFilterOption);
+        if (filter != "box" && filter != "kaiser") {
+            std::cerr << "--mip-filter needs box or kaiser" << std::endl;
+            return 1;
+        }
+        settings.kaiserMipFilter = filter == "kaiser";
+    }
+    if (parser.isSet(alphaCoverageOption)) {
+        settings.mipAlphaCutoff = parser.value(alphaCoverageOption).toFloat();
+    }
+    if (parser.isSet(gpuProfileOption)) {
+        settings.gpuProfilePath = parser.value(gpuProfileOption).toStdString();
+    }
+    if (parser.isSet(tileSizeOption)) {
+        settings.captureTileSize = std::max(2, parser.value(tileSizeOption).toInt());
+    }
+    if (parser.isSet(recordCameraOption)) {
+        settings.cameraRecordPath = parser.value(recordCameraOption).toStdString();
+    }
+
+    // load scene file if provided, the feature showcase otherwise
     QStringList positionalArgs = parser.positionalArguments();
     if (!positionalArgs.isEmpty()) {
         settings.sceneFilePath = positionalArgs.first().toStdString();
+    } else {
+        settings.sceneFilePath = "scenefiles/test_all_features.json";
+    }
+
+    int workers = parser.isSet(workersOption) ? parser.value(workersOption).toInt() : 0;
+    if (parser.isSet(workersOption) && workers <= 0) {
+        std::cerr << "--workers needs a number of processes" << std::endl;
+        return 1;
+    }
+    QStringList forwarded = workerArguments(QCoreApplication::arguments());
+
+    if (parser.isSet(batchOption)) {
+        BatchRenderer batch;
+        if (!batch.load(parser.value(batchOption).toStdString())) {
+            return 1;
+        }
+        if (workers == 0) {
+            return batch.run() > 0 ? 1 : 0;
+        }
+        auto renderJobs = [&batch](RenderCoordinator& coordinator) { return coordinator.renderJobs(batch.jobs()) == 0; };
+        if (parser.isSet(workerScalingOption)) {
+            return RenderCoordinator::benchmarkScaling(workers, forwarded, renderJobs) ? 0 : 1;
+        }
+        RenderCoordinator coordinator(workers, forwarded);
+        return coordinator.start() && renderJobs(coordinator) ? 0 : 1;
+    }
+
+    if (parser.isSet(benchmarkOption)) {
+        Benchmark::Options options;
+        options.frames = parser.value(benchmarkOption).toInt();
+        if (options.frames <= 0) {
+            std::cerr << "--benchmark needs a number of frames" << std::endl;
+            return 1;
+        }
+        if (parser.isSet(sizeOption)) {
+            QStringList size = parser.value(sizeOption).split('x');
+            if (size.size() != 2 || size[0].toInt() <= 0 || size[1].toInt() <= 0) {
+                std::cerr << "--size needs WxH, for example 1920x1080" << std::endl;
+                return 1;
+            }
+            options.width = size[0].toInt();
+            options.height = size[1].toInt();
+        }
+        if (parser.isSet(fpsOption)) {
+            options.fps = std::max(1, parser.value(fpsOption).toInt());
+        }
+        if (parser.isSet(seedOption)) {
+            options.seed = parser.value(seedOption).toUInt();
+        }
+        options.cameraPath = parser.value(cameraPathOption).toStdString();
+        options.reportPath = parser.value(outputOption).toStdString();
+        return runBenchmark(options);
+    }
+
+    if (parser.isSet(serveOption)) {
+        RenderServer server;
+        if (!server.start(parser.value(serveOption).toStdString())) {
+            return 1;
+        }
+        return a.exec();
+    }
+
+    if (parser.isSet(headlessOption)) {
+        if (!parser.isSet(outputOption)) {
+            std::cerr << "--headless needs an output path (-o)" << std::endl;
+            return 1;
+        }
+        int width = 1024;
+        int height = 768;
+        if (parser.isSet(sizeOption)) {
+            QStringList size = parser.value(sizeOption).split('x');
+            if (size.size() != 2 || size[0].toInt() <= 0 || size[1].toInt() <= 0) {
+                std::cerr << "--size needs WxH, for example 16384x9216" << std::endl;
+                return 1;
+            }
+            width = size[0].toInt();
+            height = size[1].toInt();
+        }
+        int recordFrames = parser.isSet(recordOption) ? parser.value(recordOption).toInt() : 0;
+        int fps = parser.isSet(fpsOption) ? std::max(1, parser.value(fpsOption).toInt()) : 30;
+        if (parser.isSet(recordOption) && recordFrames <= 0) {
+            std::cerr << "--record needs a number of frames" << std::endl;
+            return 1;
+        }
+        // stills default to about where the windowed screenshot used to be taken,
+        // 100 ms after the window showed, so scrolling textures have moved
+        float time = recordFrames > 0 ? 0.0f : 0.1f;
+        if (parser.isSet(timeOption)) {
+            bool valid = false;
+            time = parser.value(timeOption).toFloat(&valid);
+            if (!valid || time < 0.0f) {
+                std::cerr << "--time needs a number of seconds" << std::endl;
+                return 1;
+            }
+        }
+        if (workers > 0 && recordFrames == 0) {
+            BatchRenderer::Job job;
+            job.scene = settings.sceneFilePath;
+            job.output = parser.value(outputOption).toStdString();
+            job.width = width;
+            job.height = height;
+            job.time = time;
+            auto renderTiled = [&job](RenderCoordinator& coordinator) {
+                return coordinator.renderTiled(job, settings.captureTileSize);
+            };
+            if (parser.isSet(workerScalingOption)) {
+                return RenderCoordinator::benchmarkScaling(workers, forwarded, renderTiled) ? 0 : 1;
+            }
+            RenderCoordinator coordinator(workers, forwarded);
+            return coordinator.start() && renderTiled(coordinator) ? 0 : 1;
+        }
+        return renderHeadless(parser.value(outputOption).toStdString(), width, height, time, recordFrames, fps);
     }
 
     QSurfaceFormat fmt;
@@ -110,19 +456,7 @@ int main(int argc, char *argv[]) {
     MainWindow w;
     w.initialize();
     w.resize(1280, 960);
-
-    // headless mode: show, render, save, quit
-    bool headless = parser.isSet(headlessOption);
-    if (headless && parser.isSet(outputOption)) {
-        w.show();
-        // give it a moment to render
-        QTimer::singleShot(100, &w, [&w, &parser, &a]() {
-            w.saveScreenshot(parser.value("output").toStdString());
-            QTimer::singleShot(100, &a, &QApplication::quit);
-        });
-    } else {
-        w.show();
-    }
+    w.show();
 
     int return_val = a.exec();
     w.finish();
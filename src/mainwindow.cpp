@@ -197,8 +197,6 @@ void MainWindow::initialize() {
     // Set default values for near and far planes
     onValChangeNearBox(0.1f);
     onValChangeFarBox(30.f);
-
-    settings.sceneFilePath = "/Users/fluffy/projects/cs1230/bread-final/scenefiles/test_all_features.json";
 }
 
 void MainWindow::finish() {
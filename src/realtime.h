@@ -7,18 +7,14 @@
 #include <glm/glm.hpp>
 
 #include <unordered_map>
-#include <memory>
 #include <QElapsedTimer>
 #include <QOpenGLWidget>
 #include <QTime>
 #include <QTimer>
 
-#include "camera/Camera.h"
-#include "shapes/ShapeManager.h"
-#include "rendering/ShaderManager.h"
-#include "rendering/TextureManager.h"
-#include "rendering/InstanceManager.h"
-#include "utils/sceneparser.h"
+#include "camera/CameraPath.h"
+#include "rendering/PerfHud.h"
+#include "rendering/SceneRenderer.h"
 
 class Realtime : public QOpenGLWidget
 {
@@ -45,9 +41,6 @@ private:
     void mouseMoveEvent(QMouseEvent *event) override;
     void timerEvent(QTimerEvent *event) override;
 
-    void setGlobalUniforms();
-    void renderShape(const RenderShapeData& shape);
-
     int m_timer;
     QElapsedTimer m_elapsedTimer;
 
@@ -57,19 +50,14 @@ private:
 
     double m_devicePixelRatio;
 
-    RenderData m_renderData;
-    bool m_sceneLoaded = false;
-    bool m_initialized = false;
-
-    std::unique_ptr<Camera> m_camera;
-    ShapeManager m_shapeManager;
-    ShaderManager m_shaderManager;
-    TextureManager m_textureManager;
-    InstanceManager m_instanceManager;
+    SceneRenderer m_renderer;
 
-    GLuint m_testNormalMapId = 0;  // test normal map texture
-    GLuint m_defaultWhiteTexture = 0;  // default 1x1 white texture
-    GLuint m_breadTextureId = 0;  // bread diffuse texture
+    // F3 toggles the performance overlay
+    PerfHud m_hud;
+    bool m_showHud = false;
+    QElapsedTimer m_frameTimer;
 
-    float m_elapsedTime = 0.0f;  // total elapsed time for animations
+    // the camera every tick, while settings.cameraRecordPath is set
+    CameraPath m_cameraRecording;
+    float m_cameraRecordTime = 0.0f;
 };
@@ -0,0 +1,231 @@
+#include "BatchRenderer.h"
+#include "FrameCapture.h"
+#include "OffscreenContext.h"
+#include "SceneRenderer.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include "settings.h"
+
+namespace {
+
+glm::vec3 toVec3(const QJsonValue& value, const glm::vec3& fallback) {
+    QJsonArray array = value.toArray();
+    if (array.size() != 3) {
+        return fallback;
+    }
+    return glm::vec3(array[0].toDouble(), array[1].toDouble(), array[2].toDouble());
+}
+
+}
+
+bool BatchRenderer::load(const std::string& manifestPath) {
+    QFile file(QString::fromStdString(manifestPath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "failed to open batch manifest: " << manifestPath << std::endl;
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (document.isNull() || !document.isObject()) {
+        std::cerr << "failed to parse batch manifest " << manifestPath << ": "
+                  << error.errorString().toStdString() << std::endl;
+        return false;
+    }
+
+    QJsonObject root = document.object();
+    QJsonObject defaults = root["defaults"].toObject();
+    QJsonArray jobs = root["jobs"].toArray();
+
+    m_jobs.clear();
+    for (int i = 0; i < jobs.size(); i++) {
+        // job keys replace the defaults, settings are merged one by one
+        QJsonObject object = defaults;
+        QJsonObject jobObject = jobs[i].toObject();
+        for (auto it = jobObject.begin(); it != jobObject.end(); ++it) {
+            object[it.key()] = it.value();
+        }
+        QJsonObject merged = defaults["settings"].toObject();
+        QJsonObject jobSettings = jobObject["settings"].toObject();
+        for (auto it = jobSettings.begin(); it != jobSettings.end(); ++it) {
+            merged[it.key()] = it.value();
+        }
+        object["settings"] = merged;
+
+        Job job = parseJob(object);
+        if (job.scene.empty() || job.output.empty()) {
+            std::cerr << "batch job " << i + 1 << " needs a scene and an output" << std::endl;
+            return false;
+        }
+        m_jobs.push_back(job);
+    }
+
+    if (m_jobs.empty()) {
+        std::cerr << "batch manifest has no jobs: " << manifestPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+BatchRenderer::Job BatchRenderer::parseJob(const QJsonObject& object) {
+    Job job;
+    job.scene = object["scene"].toString().toStdString();
+    job.output = object["output"].toString().toStdString();
+    job.width = std::max(1, object["width"].toInt(job.width));
+    job.height = std::max(1, object["height"].toInt(job.height));
+    job.time = static_cast<float>(object["time"].toDouble(job.time));
+    job.instanceSeed = static_cast<unsigned>(object["instance-seed"].toInt(0));
+    job.settings = object["settings"].toObject();
+    job.camera = object["camera"].toObject();
+    return job;
+}
+
+QJsonObject BatchRenderer::toJson(const Job& job) {
+    QJsonObject object;
+    object["scene"] = QString::fromStdString(job.scene);
+    object["output"] = QString::fromStdString(job.output);
+    object["width"] = job.width;
+    object["height"] = job.height;
+    object["time"] = static_cast<double>(job.time);
+    object["instance-seed"] = static_cast<int>(job.instanceSeed);
+    object["settings"] = job.settings;
+    object["camera"] = job.camera;
+    return object;
+}
+
+void BatchRenderer::applySettings(const QJsonObject& overrides, Settings& target) {
+    target.enableFog = overrides["fog"].toBool(target.enableFog);
+    target.fogStart = static_cast<float>(overrides["fog-start"].toDouble(target.fogStart));
+    target.fogEnd = static_cast<float>(overrides["fog-end"].toDouble(target.fogEnd));
+    target.fogColor = toVec3(overrides["fog-color"], target.fogColor);
+
+    target.enableNormalMapping = overrides["normal-mapping"].toBool(target.enableNormalMapping);
+
+    target.enableScrolling = overrides["scrolling"].toBool(target.enableScrolling);
+    target.scrollSpeed = static_cast<float>(overrides["scroll-speed"].toDouble(target.scrollSpeed));
+    QJsonArray direction = overrides["scroll-direction"].toArray();
+    if (direction.size() == 2) {
+        target.scrollDirection = glm::vec2(direction[0].toDouble(), direction[1].toDouble());
+    }
+
+    target.enableInstancing = overrides["instancing"].toBool(target.enableInstancing);
+
+    target.nearPlane = static_cast<float>(overrides["near"].toDouble(target.nearPlane));
+    target.farPlane = static_cast<float>(overrides["far"].toDouble(target.farPlane));
+    QJsonArray tessellation = overrides["tessellation"].toArray();
+    if (tessellation.size() == 2) {
+        target.shapeParameter1 = tessellation[0].toInt(target.shapeParameter1);
+        target.shapeParameter2 = tessellation[1].toInt(target.shapeParameter2);
+    }
+    target.captureTileSize = std::max(2, overrides["tile-size"].toInt(target.captureTileSize));
+}
+
+bool BatchRenderer::prepare(SceneRenderer& renderer, const Job& job, const Settings& base, std::string& loadedScene) {
+    settings = base;
+    applySettings(job.settings, settings);
+    settings.sceneFilePath = job.scene;
+    renderer.resize(std::min(job.width, settings.captureTileSize), std::min(job.height, settings.captureTileSize));
+    if (job.instanceSeed != 0) {
+        renderer.setInstanceSeed(job.instanceSeed);
+    }
+    renderer.settingsChanged();
+
+    // the same scene keeps its parsed shapes and texture arrays
+    if (job.scene != loadedScene) {
+        loadedScene.clear();
+        if (!renderer.loadScene()) {
+            std::cerr << "failed to load " << job.scene << std::endl;
+            return false;
+        }
+        loadedScene = job.scene;
+    }
+
+    // every job starts from the scene's own camera
+    SceneCameraData camera = renderer.sceneCamera();
+    camera.pos = glm::vec4(toVec3(job.camera["position"], glm::vec3(camera.pos)), 1.0f);
+    camera.look = glm::vec4(toVec3(job.camera["look"], glm::vec3(camera.look)), 0.0f);
+    camera.up = glm::vec4(toVec3(job.camera["up"], glm::vec3(camera.up)), 0.0f);
+    if (job.camera.contains("heightAngle")) {
+        camera.heightAngle = static_cast<float>(job.camera["heightAngle"].toDouble() * M_PI / 180.0);
+    }
+    renderer.setCamera(camera);
+    renderer.setTime(job.time);
+    return true;
+}
+
+int BatchRenderer::run() {
+    QElapsedTimer total;
+    total.start();
+
+    OffscreenContext context;
+    if (!context.create()) {
+        return static_cast<int>(m_jobs.size());
+    }
+
+    // the command line settings are the base every job starts from
+    const Settings base = settings;
+
+    SceneRenderer renderer;
+    FrameCapture capture;
+    if (!renderer.initialize()) {
+        renderer.cleanup();
+        return static_cast<int>(m_jobs.size());
+    }
+    double setupMs = total.nsecsElapsed() / 1e6;
+
+    int failed = 0;
+    int tiledSaved = 0;
+    std::string loadedScene;
+    for (size_t i = 0; i < m_jobs.size(); i++) {
+        const Job& job = m_jobs[i];
+        QElapsedTimer timer;
+        timer.start();
+
+        bool reused = job.scene == loadedScene;
+        if (!prepare(renderer, job, base, loadedScene)) {
+            std::cerr << "[" << i + 1 << "/" << m_jobs.size() << "] skipped " << job.output << std::endl;
+            failed++;
+            continue;
+        }
+        double sceneMs = timer.nsecsElapsed() / 1e6;
+
+        // includes waiting for textures the scene is still decoding. the readback
+        // and the save finish in the background while the next jobs render.
+        // images past the tile size are drawn in tiles and written before moving on
+        bool tiled = job.width > settings.captureTileSize || job.height > settings.captureTileSize;
+        bool queued = tiled ? renderer.captureTiled(job.width, job.height, settings.captureTileSize, job.output)
+                            : renderer.captureImage(job.width, job.height, capture, job.output);
+        capture.poll();
+        double renderMs = timer.nsecsElapsed() / 1e6 - sceneMs;
+        if (!queued) {
+            failed++;
+        } else if (tiled) {
+            tiledSaved++;
+        }
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "[" << i + 1 << "/" << m_jobs.size() << "] " << job.output
+                  << ": scene " << sceneMs << " ms" << (reused ? " (reused)" : "")
+                  << ", render " << renderMs << " ms" << std::endl;
+    }
+
+    capture.finish();
+    FrameCapture::Stats captureStats = capture.getStats();
+    failed += captureStats.failed;
+    capture.cleanup();
+    renderer.cleanup();
+    settings = base;
+
+    double totalMs = total.nsecsElapsed() / 1e6;
+    double fps = captureStats.seconds > 0.0 ? captureStats.saved / captureStats.seconds : 0.0;
+    std::cout << std::fixed << std::setprecision(1)
+              << "batch: " << captureStats.saved + tiledSaved << "/" << m_jobs.size() << " images in " << totalMs
+              << " ms (setup " << setupMs << " ms, " << fps << " images/s captured)" << std::endl;
+    return failed;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QJsonObject>
+#include <string>
+#include <vector>
+
+class SceneRenderer;
+struct Settings;
+
+// renders every job of a manifest in one process with one offscreen context.
+// shaders, shapes, the capture framebuffers and the texture manager stay alive
+// across jobs; a scene is only parsed again when its path changes.
+//
+// manifest (json, paths relative to the working directory like the command line):
+//   { "defaults": { ...job keys... },
+//     "jobs": [ { "scene": "scenefiles/test_fog.json", "output": "fog.png",
+//                 "width": 1024, "height": 768, "time": 0.0, "instance-seed": 1,
+//                 "settings": { "fog": true, "fog-start": 8.0, "fog-color": [1, 0.9, 0.7], ... },
+//                 "camera": { "position": [0, 2, 8], "look": [0, 0, -1], "up": [0, 1, 0], "heightAngle": 55 } } ] }
+// "settings" keys match the command line options (fog, fog-start, fog-end,
+// fog-color, normal-mapping, scrolling, scroll-speed, scroll-direction,
+// instancing, near, far, tessellation [p1, p2], tile-size). a job's keys
+// override "defaults", its settings are merged key by key. jobs larger than
+// the tile size are rendered in tiles and streamed to their output
+class BatchRenderer {
+public:
+    // returns false (and prints why) if the manifest can't be read
+    bool load(const std::string& manifestPath);
+
+    // render every job, returns the number of jobs that failed
+    int run();
+
+    struct Job {
+        std::string scene;
+        std::string output;
+        int width = 1024;
+        int height = 768;
+        float time = 0.0f;
+        unsigned instanceSeed = 0;  // 0 keeps the current layout
+        QJsonObject settings;
+        QJsonObject camera;
+    };
+
+    const std::vector<Job>& jobs() const { return m_jobs; }
+
+    // a job object with the keys above, defaults already merged in, and back
+    static Job parseJob(const QJsonObject& object);
+    static QJsonObject toJson(const Job& job);
+
+    // get the renderer ready to draw job: base settings plus the job's, its
+    // scene (parsed again only if it isn't loadedScene, which is updated),
+    // camera and time. false (after printing why) if the scene didn't load
+    static bool prepare(SceneRenderer& renderer, const Job& job, const Settings& base, std::string& loadedScene);
+
+private:
+    static void applySettings(const QJsonObject& overrides, Settings& target);
+
+    std::vector<Job> m_jobs;
+};
@@ -0,0 +1,194 @@
+#include "Benchmark.h"
+#include "RenderStats.h"
+#include "RenderTargetPool.h"
+#include "SceneRenderer.h"
+#include "camera/CameraPath.h"
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "settings.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// highest resident set size of the process so far, 0 where it can't be asked
+long long peakResidentBytes() {
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return static_cast<long long>(usage.ru_maxrss);  // bytes
+#else
+        return static_cast<long long>(usage.ru_maxrss) * 1024;  // kilobytes
+#endif
+    }
+#endif
+    return 0;
+}
+
+// "draw calls" -> "draw-calls"
+QString jsonKey(const char* name) {
+    return QString(name).replace(' ', '-');
+}
+
+QJsonObject percentiles(const FrameTimes& times) {
+    QJsonObject object;
+    object["min"] = times.min();
+    object["mean"] = times.mean();
+    object["p50"] = times.percentile(50.0f);
+    object["p95"] = times.percentile(95.0f);
+    object["p99"] = times.percentile(99.0f);
+    object["max"] = times.max();
+    return object;
+}
+
+}
+
+bool Benchmark::run(SceneRenderer& renderer, const Options& options) {
+    int frames = std::max(1, options.frames);
+    int fps = std::max(1, options.fps);
+
+    CameraPath path;
+    if (!options.cameraPath.empty()) {
+        if (!path.load(options.cameraPath)) {
+            return false;
+        }
+    } else {
+        path = CameraPath::orbit(renderer.sceneCamera(), static_cast<float>(frames) / fps);
+    }
+    renderer.setInstanceSeed(options.seed);
+
+    // waits for the shaders and every texture, so the timed frames don't load anything
+    renderer.renderImage(options.width, options.height);
+
+    RenderTargetPool targets;
+    const RenderTarget* target = targets.acquire(options.width, options.height);
+    if (target == nullptr) {
+        std::cerr << "benchmark: no framebuffer of " << options.width << "x" << options.height << std::endl;
+        return false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    renderer.resize(options.width, options.height);
+
+    GpuProfiler& profiler = renderer.gpuProfiler();
+    bool wasProfiling = profiler.isEnabled();
+    profiler.setEnabled(true);
+
+    const SceneCameraData base = renderer.sceneCamera();
+    auto renderFrame = [&](int frame) {
+        float time = static_cast<float>(static_cast<double>(frame) / fps);
+        renderer.setTime(time);
+        renderer.setCamera(path.sample(time, base));
+        renderer.render();
+    };
+
+    // the same frames the run starts with, so the tiles and mips it needs are in
+    for (int i = 0; i < options.warmupFrames; i++) {
+        renderFrame(i % frames);
+    }
+    glFinish();
+    profiler.reset();
+
+    FrameTimes cpuTimes(frames);
+    int64_t sums[RenderStats::COUNTER_COUNT] = {};
+    int64_t maxima[RenderStats::COUNTER_COUNT] = {};
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < frames; i++) {
+        qint64 begin = timer.nsecsElapsed();
+        renderFrame(i);
+        cpuTimes.add(static_cast<float>((timer.nsecsElapsed() - begin) / 1e6));
+
+        for (int c = 0; c < RenderStats::COUNTER_COUNT; c++) {
+            int64_t value = RenderStats::lastFrame(static_cast<RenderStats::Counter>(c));
+            sums[c] += value;
+            maxima[c] = std::max(maxima[c], value);
+        }
+    }
+    glFinish();
+    double seconds = timer.nsecsElapsed() / 1e9;
+
+    profiler.collect(true);
+    GpuProfiler::ScopeStats gpuFrame;
+    for (const GpuProfiler::ScopeStats& scope : profiler.stats()) {
+        if (scope.name == "frame") {
+            gpuFrame = scope;
+        }
+    }
+    if (!wasProfiling) {
+        profiler.setEnabled(false);
+    }
+    renderer.setCamera(base);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    QJsonObject report;
+    report["scene"] = QString::fromStdString(settings.sceneFilePath);
+    report["frames"] = frames;
+    report["warmup-frames"] = options.warmupFrames;
+    report["width"] = options.width;
+    report["height"] = options.height;
+    report["fps"] = fps;
+    report["seed"] = static_cast<qint64>(options.seed);
+    report["camera-path"] = options.cameraPath.empty() ? QString("orbit") : QString::fromStdString(options.cameraPath);
+    report["seconds"] = seconds;
+    report["frames-per-second"] = frames / seconds;
+    report["cpu-ms"] = percentiles(cpuTimes);
+    if (gpuFrame.gpuSamples > 0) {
+        QJsonObject gpu;
+        gpu["samples"] = gpuFrame.gpuSamples;
+        gpu["min"] = gpuFrame.gpu.minMs;
+        gpu["mean"] = gpuFrame.gpu.avgMs;
+        gpu["p50"] = gpuFrame.gpu.p50Ms;
+        gpu["p95"] = gpuFrame.gpu.p95Ms;
+        gpu["p99"] = gpuFrame.gpu.p99Ms;
+        report["gpu-ms"] = gpu;
+    }
+
+    QJsonObject perFrame;
+    for (int c = 0; c < RenderStats::COUNTER_COUNT; c++) {
+        QJsonObject counter;
+        counter["mean"] = static_cast<double>(sums[c]) / frames;
+        counter["max"] = static_cast<qint64>(maxima[c]);
+        perFrame[jsonKey(RenderStats::name(static_cast<RenderStats::Counter>(c)))] = counter;
+    }
+    report["per-frame"] = perFrame;
+
+    QJsonObject memory;
+    memory["texture-bytes"] = static_cast<qint64>(RenderStats::get(RenderStats::TextureBytes));
+    memory["texture-budget-bytes"] = static_cast<qint64>(RenderStats::get(RenderStats::TextureBudgetBytes));
+    memory["textures"] = static_cast<qint64>(RenderStats::get(RenderStats::Textures));
+    memory["peak-rss-bytes"] = static_cast<qint64>(peakResidentBytes());
+    report["memory"] = memory;
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "benchmark: " << frames << " frames of " << options.width << "x" << options.height << " in "
+              << seconds << " s (" << frames / seconds << " fps)" << std::endl
+              << "  cpu ms  p50 " << cpuTimes.percentile(50.0f) << "  p95 " << cpuTimes.percentile(95.0f)
+              << "  p99 " << cpuTimes.percentile(99.0f) << std::endl;
+    if (gpuFrame.gpuSamples > 0) {
+        std::cout << "  gpu ms  p50 " << gpuFrame.gpu.p50Ms << "  p95 " << gpuFrame.gpu.p95Ms
+                  << "  p99 " << gpuFrame.gpu.p99Ms << std::endl;
+    }
+    std::cout << "  draw calls " << sums[RenderStats::DrawCalls] / frames << "  triangles "
+              << sums[RenderStats::Triangles] / frames << " per frame" << std::endl;
+
+    if (options.reportPath.empty()) {
+        return true;
+    }
+    QByteArray text = QJsonDocument(report).toJson();
+    QSaveFile file(QString::fromStdString(options.reportPath));
+    if (!file.open(QIODevice::WriteOnly) || file.write(text) != text.size() || !file.commit()) {
+        std::cerr << "Failed to save benchmark report to " << options.reportPath << std::endl;
+        return false;
+    }
+    std::cout << "benchmark report written to " << options.reportPath << std::endl;
+    return true;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+class SceneRenderer;
+
+// flies a camera path through the loaded scene as fast as the gpu allows and
+// reports frame time percentiles, what each frame issued and memory, so two
+// builds can be compared on the same work. the animation clock advances
+// exactly 1/fps per frame and the instanced cubes are laid out from a fixed
+// seed, so every run renders the same frames whatever the frame times are.
+// warmup frames (shaders, texture uploads, virtual texture tiles) aren't timed.
+//
+// the report is json:
+//   {"scene": ..., "frames": 600, "seconds": 2.4, "frames-per-second": 250,
+//    "cpu-ms": {"min", "mean", "p50", "p95", "p99", "max"},
+//    "gpu-ms": {"samples", "min", "mean", "p50", "p95", "p99"},
+//    "per-frame": {"draw-calls": {"mean", "max"}, "triangles": ..., ...},
+//    "memory": {"texture-bytes", "texture-budget-bytes", "textures", "peak-rss-bytes"}}
+// cpu-ms is the wall time of each frame on the cpu, including any wait the
+// driver makes it do. gpu-ms comes from timer queries over the last 1024
+// frames and is missing without timer query support
+class Benchmark {
+public:
+    struct Options {
+        int frames = 600;
+        int warmupFrames = 30;
+        int fps = 30;
+        int width = 1280;
+        int height = 720;
+        unsigned seed = 1;
+        std::string cameraPath;  // camera path json, empty = orbit the scene camera's focus
+        std::string reportPath;  // empty = print the summary only
+    };
+
+    // needs the renderer's context current and a scene loaded. false (after
+    // printing why) if the camera path can't be read, no framebuffer of the
+    // size can be made or the report can't be written
+    static bool run(SceneRenderer& renderer, const Options& options);
+};
@@ -0,0 +1,158 @@
+#include "FrameCapture.h"
+#include "ImageEncoder.h"
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+FrameCapture::FrameCapture() {
+    m_maxEncoding = std::max(2, QThread::idealThreadCount() * 2);
+}
+
+FrameCapture::~FrameCapture() {
+    m_encodePool.waitForDone();
+}
+
+FrameCapture::Output FrameCapture::imageFile(const std::string& path) {
+    // the format follows the extension, ImageEncoder prints why a save failed
+    return [path](const std::vector<unsigned char>& pixels, int width, int height) {
+        return !pixels.empty() && ImageEncoder::save(pixels.data(), width, height, width * 4, path);
+    };
+}
+
+void FrameCapture::capture(int width, int height, const std::string& path) {
+    capture(width, height, imageFile(path));
+}
+
+void FrameCapture::capture(int width, int height, Output output) {
+    if (!m_timer.isValid()) {
+        m_timer.start();
+    }
+
+    // slots are used in order, so a busy slot holds the oldest pending frame
+    int index = m_nextBuffer;
+    PixelBuffer& buffer = m_buffers[index];
+    if (buffer.fence != nullptr) {
+        collect(buffer, true);
+        m_pending.pop_front();
+    }
+
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(width) * height * 4;
+    if (buffer.pbo == 0) {
+        glGenBuffers(1, &buffer.pbo);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    if (bytes > buffer.size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        buffer.size = bytes;
+    }
+
+    // rgba is the format drivers copy out of a framebuffer without converting
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer.width = width;
+    buffer.height = height;
+    buffer.output = std::move(output);
+
+    // poll() peeks at fences without flushing, make sure this one gets submitted
+    glFlush();
+
+    m_pending.push_back(index);
+    m_nextBuffer = (index + 1) % PIXEL_BUFFER_COUNT;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.captured++;
+}
+
+void FrameCapture::poll() {
+    while (!m_pending.empty() && collect(m_buffers[m_pending.front()], false)) {
+        m_pending.pop_front();
+    }
+}
+
+bool FrameCapture::collect(PixelBuffer& buffer, bool blocking) {
+    GLbitfield flags = blocking ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+    GLuint64 timeout = blocking ? GL_TIMEOUT_IGNORED : 0;
+    if (glClientWaitSync(buffer.fence, flags, timeout) == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+
+    // gl rows start at the bottom, copy them out in reverse
+    size_t rowBytes = static_cast<size_t>(buffer.width) * 4;
+    std::vector<unsigned char> pixels(rowBytes * buffer.height);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    const unsigned char* mapped = static_cast<const unsigned char*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(pixels.size()), GL_MAP_READ_BIT));
+    if (mapped != nullptr) {
+        for (int y = 0; y < buffer.height; y++) {
+            std::memcpy(pixels.data() + (buffer.height - 1 - y) * rowBytes, mapped + y * rowBytes, rowBytes);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (mapped == nullptr) {
+        std::cerr << "Failed to read back a captured frame" << std::endl;
+        pixels.clear();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_encodeDone.wait(lock, [this]() { return m_encoding < m_maxEncoding; });
+    m_encoding++;
+    lock.unlock();
+
+    int width = buffer.width;
+    int height = buffer.height;
+    m_encodePool.start([this, pixels = std::move(pixels), width, height, output = std::move(buffer.output)]() {
+        encode(pixels, width, height, output);
+    });
+    buffer.output = nullptr;
+    return true;
+}
+
+void FrameCapture::encode(const std::vector<unsigned char>& pixels, int width, int height, const Output& output) {
+    bool saved = output(pixels, width, height);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (saved) {
+        m_stats.saved++;
+    } else {
+        m_stats.failed++;
+    }
+    m_encoding--;
+    m_encodeDone.notify_all();
+}
+
+void FrameCapture::finish() {
+    while (!m_pending.empty()) {
+        collect(m_buffers[m_pending.front()], true);
+        m_pending.pop_front();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_encodeDone.wait(lock, [this]() { return m_encoding == 0; });
+    if (m_timer.isValid()) {
+        m_stats.seconds = m_timer.nsecsElapsed() / 1e9;
+    }
+}
+
+FrameCapture::Stats FrameCapture::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void FrameCapture::cleanup() {
+    finish();
+    for (PixelBuffer& buffer : m_buffers) {
+        if (buffer.pbo != 0) {
+            glDeleteBuffers(1, &buffer.pbo);
+        }
+        buffer = PixelBuffer();
+    }
+    m_nextBuffer = 0;
+}
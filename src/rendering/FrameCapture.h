@@ -0,0 +1,89 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// asynchronous readback of rendered frames. capture() starts a glReadPixels
+// into the next pixel buffer of a ring and returns; the pixels are mapped once
+// the gpu has written them (a few frames later, or in finish()), copied out
+// bottom row first so the image comes out upright, and encoded and saved on
+// worker threads while the gpu renders the next frames
+class FrameCapture {
+public:
+    struct Stats {
+        int captured = 0;
+        int saved = 0;
+        int failed = 0;
+        double seconds = 0.0;  // first capture() to the end of finish()
+    };
+
+    // receives a frame's upright rgba8 pixels on an encode thread, returns false
+    // (after printing why) if it couldn't be saved. called with no pixels if the
+    // readback failed, so outputs that count frames still hear about it
+    using Output = std::function<bool(const std::vector<unsigned char>& pixels, int width, int height)>;
+
+    // saves the frame as an image file, in the format of its extension
+    static Output imageFile(const std::string& path);
+
+    FrameCapture();
+    ~FrameCapture();
+
+    // queue a readback of the currently bound read framebuffer (width x height
+    // from the origin) to be saved as path. needs a current context
+    void capture(int width, int height, const std::string& path);
+
+    // the same, handing the pixels to output instead. blocks while the encode
+    // threads are full, so a slow output holds the renderer back
+    void capture(int width, int height, Output output);
+
+    // map readbacks the gpu has finished, without waiting for the others
+    void poll();
+
+    // true while readbacks are waiting for the gpu, poll() or finish() hands them on
+    bool hasPendingReadbacks() const { return !m_pending.empty(); }
+
+    // wait for every queued frame to be written
+    void finish();
+
+    Stats getStats() const;
+
+    // free the pixel buffers, needs the context current. finishes first
+    void cleanup();
+
+private:
+    static constexpr int PIXEL_BUFFER_COUNT = 3;
+
+    // one slot of the readback ring
+    struct PixelBuffer {
+        GLuint pbo = 0;
+        GLsizeiptr size = 0;
+        GLsync fence = nullptr;
+        int width = 0;
+        int height = 0;
+        Output output;
+    };
+
+    bool collect(PixelBuffer& buffer, bool blocking);
+    void encode(const std::vector<unsigned char>& pixels, int width, int height, const Output& output);
+
+    PixelBuffer m_buffers[PIXEL_BUFFER_COUNT];
+    std::deque<int> m_pending;  // ring slots in capture order
+    int m_nextBuffer = 0;
+
+    // bounded so a slow disk can't pile up frames in memory
+    QThreadPool m_encodePool;
+    int m_maxEncoding = 0;
+    int m_encoding = 0;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_encodeDone;
+
+    Stats m_stats;
+    QElapsedTimer m_timer;
+};
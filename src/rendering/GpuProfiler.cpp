@@ -0,0 +1,196 @@
+#include "GpuProfiler.h"
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+void GpuProfiler::setEnabled(bool enabled) {
+    if (enabled && !m_timerQueries) {
+        // core since 3.3
+        m_timerQueries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+        if (m_timerQueries) {
+            glGenQueries(RING_SIZE * 2, m_queries);
+        } else {
+            std::cerr << "no timer queries, profiling cpu time only" << std::endl;
+        }
+    }
+    m_enabled = enabled;
+}
+
+int GpuProfiler::scopeIndex(const char* name) {
+    // names are literals, the pointer usually matches on the first compare
+    for (size_t i = 0; i < m_scopes.size(); i++) {
+        if (m_scopes[i].name == name || std::strcmp(m_scopes[i].name, name) == 0) {
+            return static_cast<int>(i);
+        }
+    }
+    ScopeSamples scope;
+    scope.name = name;
+    m_scopes.push_back(scope);
+    return static_cast<int>(m_scopes.size() - 1);
+}
+
+int GpuProfiler::begin(const char* name) {
+    if (!m_enabled) {
+        return -1;
+    }
+    if (m_head - m_tail == RING_SIZE) {
+        collect();
+        if (m_head - m_tail == RING_SIZE) {
+            m_dropped++;
+            return -1;
+        }
+    }
+
+    int slot = static_cast<int>(m_head % RING_SIZE);
+    m_head++;
+    Record& record = m_records[slot];
+    record.scope = scopeIndex(name);
+    record.open = true;
+    if (m_timerQueries) {
+        glQueryCounter(m_queries[slot * 2], GL_TIMESTAMP);
+    }
+    record.cpuStart = std::chrono::steady_clock::now();
+    return slot;
+}
+
+void GpuProfiler::end(int slot) {
+    if (slot < 0) {
+        return;
+    }
+    Record& record = m_records[slot];
+    record.cpuMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - record.cpuStart).count();
+    if (m_timerQueries) {
+        glQueryCounter(m_queries[slot * 2 + 1], GL_TIMESTAMP);
+    }
+    record.open = false;
+}
+
+void GpuProfiler::collect(bool wait) {
+    // in order, so the first record the gpu hasn't reached ends the pass
+    while (m_tail < m_head) {
+        int slot = static_cast<int>(m_tail % RING_SIZE);
+        Record& record = m_records[slot];
+        if (record.open) {
+            break;
+        }
+
+        ScopeSamples& scope = m_scopes[static_cast<size_t>(record.scope)];
+        if (m_timerQueries) {
+            GLint available = 0;
+            if (!wait) {
+                glGetQueryObjectiv(m_queries[slot * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) {
+                    break;
+                }
+            }
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(m_queries[slot * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(m_queries[slot * 2 + 1], GL_QUERY_RESULT, &end);
+            addSample(scope.gpu, scope.gpuNext, static_cast<float>((end - begin) / 1e6));
+        }
+        addSample(scope.cpu, scope.cpuNext, record.cpuMs);
+        m_tail++;
+    }
+}
+
+void GpuProfiler::addSample(std::vector<float>& samples, int& next, float value) {
+    if (static_cast<int>(samples.size()) < SAMPLE_WINDOW) {
+        samples.push_back(value);
+        return;
+    }
+    samples[static_cast<size_t>(next)] = value;
+    next = (next + 1) % SAMPLE_WINDOW;
+}
+
+GpuProfiler::Timing GpuProfiler::summarize(const std::vector<float>& samples) {
+    Timing timing;
+    if (samples.empty()) {
+        return timing;
+    }
+    std::vector<float> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (float sample : sorted) {
+        sum += sample;
+    }
+    // nearest rank
+    auto percentile = [&sorted](size_t p) {
+        size_t rank = (sorted.size() * p + 99) / 100;
+        return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    };
+    timing.minMs = sorted.front();
+    timing.avgMs = sum / sorted.size();
+    timing.p50Ms = percentile(50);
+    timing.p95Ms = percentile(95);
+    timing.p99Ms = percentile(99);
+    return timing;
+}
+
+std::vector<GpuProfiler::ScopeStats> GpuProfiler::stats() const {
+    std::vector<ScopeStats> result;
+    for (const ScopeSamples& scope : m_scopes) {
+        ScopeStats stats;
+        stats.name = scope.name;
+        stats.gpuSamples = static_cast<int>(scope.gpu.size());
+        stats.cpuSamples = static_cast<int>(scope.cpu.size());
+        stats.gpu = summarize(scope.gpu);
+        stats.cpu = summarize(scope.cpu);
+        result.push_back(stats);
+    }
+    return result;
+}
+
+void GpuProfiler::reset() {
+    collect(true);
+    m_scopes.clear();
+    m_dropped = 0;
+}
+
+bool GpuProfiler::write(const std::string& path) const {
+    std::vector<ScopeStats> all = stats();
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+
+    std::ostringstream out;
+    if (json) {
+        out << "{\n  \"dropped\": " << m_dropped << ",\n  \"scopes\": [";
+        for (size_t i = 0; i < all.size(); i++) {
+            const ScopeStats& s = all[i];
+            out << (i == 0 ? "\n" : ",\n")
+                << "    {\"name\": \"" << s.name << "\", \"gpu-samples\": " << s.gpuSamples
+                << ", \"gpu-min-ms\": " << s.gpu.minMs << ", \"gpu-avg-ms\": " << s.gpu.avgMs
+                << ", \"gpu-p99-ms\": " << s.gpu.p99Ms << ", \"cpu-samples\": " << s.cpuSamples
+                << ", \"cpu-min-ms\": " << s.cpu.minMs << ", \"cpu-avg-ms\": " << s.cpu.avgMs
+                << ", \"cpu-p99-ms\": " << s.cpu.p99Ms << "}";
+        }
+        out << "\n  ]\n}\n";
+    } else {
+        out << "scope,gpu_samples,gpu_min_ms,gpu_avg_ms,gpu_p99_ms,cpu_samples,cpu_min_ms,cpu_avg_ms,cpu_p99_ms\n";
+        for (const ScopeStats& s : all) {
+            out << s.name << "," << s.gpuSamples << "," << s.gpu.minMs << "," << s.gpu.avgMs << "," << s.gpu.p99Ms
+                << "," << s.cpuSamples << "," << s.cpu.minMs << "," << s.cpu.avgMs << "," << s.cpu.p99Ms << "\n";
+        }
+    }
+
+    std::string text = out.str();
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(text.data(), static_cast<qint64>(text.size())) != static_cast<qint64>(text.size()) ||
+        !file.commit()) {
+        std::cerr << "Failed to save profile to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void GpuProfiler::cleanup() {
+    if (m_timerQueries) {
+        glDeleteQueries(RING_SIZE * 2, m_queries);
+        m_timerQueries = false;
+    }
+    m_enabled = false;
+    m_head = 0;
+    m_tail = 0;
+}
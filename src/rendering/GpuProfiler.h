@@ -0,0 +1,105 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// gpu time of named render passes from timer queries, next to the cpu time
+// spent issuing them. every scope writes a gl timestamp where it begins and
+// ends into a ring of queries spanning several frames; collect() reads the
+// ones the gpu has reached without waiting for the rest, so profiling never
+// stalls the pipeline. scopes may nest. when the ring is full (the gpu is far
+// behind) new scopes are dropped, not waited for
+class GpuProfiler {
+public:
+    struct Timing {
+        double minMs = 0.0;
+        double avgMs = 0.0;
+        double p50Ms = 0.0;
+        double p95Ms = 0.0;
+        double p99Ms = 0.0;
+    };
+
+    // over the last SAMPLE_WINDOW samples of a scope
+    struct ScopeStats {
+        std::string name;
+        int gpuSamples = 0;  // 0 where timer queries aren't supported
+        int cpuSamples = 0;
+        Timing gpu;
+        Timing cpu;
+    };
+
+    // RAII helper: GpuProfiler::Scope scope(profiler, "opaque");
+    class Scope {
+    public:
+        Scope(GpuProfiler& profiler, const char* name) : m_profiler(profiler), m_slot(profiler.begin(name)) {}
+        ~Scope() { m_profiler.end(m_slot); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        GpuProfiler& m_profiler;
+        int m_slot;
+    };
+
+    // off until enabled, then scopes cost two timestamp queries each. needs a
+    // current context; without timer queries only cpu times are recorded
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+
+    // name must be a string literal (it is kept, not copied). returns the
+    // slot to hand to end(), -1 if nothing is recorded
+    int begin(const char* name);
+    void end(int slot);
+
+    // read every finished scope, or wait for all of them
+    void collect(bool wait = false);
+
+    std::vector<ScopeStats> stats() const;
+
+    // wait for the scopes in flight and forget every sample, e.g. after a
+    // warmup. call it between frames, with no scope open
+    void reset();
+
+    // write stats() as .json, or as csv for any other extension. false (after
+    // printing why) if the file can't be written
+    bool write(const std::string& path) const;
+
+    // free the queries, needs the context current
+    void cleanup();
+
+private:
+    static constexpr int RING_SIZE = 512;
+    static constexpr int SAMPLE_WINDOW = 1024;
+
+    struct Record {
+        int scope = -1;
+        bool open = false;
+        std::chrono::steady_clock::time_point cpuStart;
+        float cpuMs = 0.0f;
+    };
+
+    // samples kept as a ring for percentiles
+    struct ScopeSamples {
+        const char* name = nullptr;
+        std::vector<float> gpu;
+        std::vector<float> cpu;
+        int gpuNext = 0;
+        int cpuNext = 0;
+    };
+
+    int scopeIndex(const char* name);
+    static void addSample(std::vector<float>& samples, int& next, float value);
+    static Timing summarize(const std::vector<float>& samples);
+
+    bool m_enabled = false;
+    bool m_timerQueries = false;
+    GLuint m_queries[RING_SIZE * 2] = {};
+    Record m_records[RING_SIZE];
+    long long m_head = 0;  // next record to hand out
+    long long m_tail = 0;  // oldest record not yet collected
+    int m_dropped = 0;
+
+    std::vector<ScopeSamples> m_scopes;
+};
@@ -0,0 +1,541 @@
+#include "ImageEncoder.h"
+#include "ParallelFor.h"
+#include <QImage>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <zlib.h>
+
+namespace {
+
+// zlib level for png. past this, rendered frames get little smaller for a lot more time
+constexpr int PNG_COMPRESSION_LEVEL = 3;
+
+// filtered bytes per deflate job. each job after the first is primed with the
+// 32k before it, so splitting costs almost nothing in size
+constexpr size_t DEFLATE_CHUNK_BYTES = 256 * 1024;
+constexpr size_t DEFLATE_WINDOW_BYTES = 32 * 1024;
+
+constexpr int64_t MIN_PIXELS_PER_BAND = 64 * 1024;
+
+QThreadPool& encodePool() {
+    static QThreadPool pool;
+    return pool;
+}
+
+// run work(firstRow, lastRow) over bands of rows on the encode pool
+void forEachBand(int width, int height, const std::function<void(int, int)>& work) {
+    int64_t pixels = static_cast<int64_t>(width) * height;
+    int maxBands = std::min(height, QThread::idealThreadCount() * 4);
+    int bands = static_cast<int>(std::clamp<int64_t>(pixels / MIN_PIXELS_PER_BAND, 1, std::max(1, maxBands)));
+    parallelFor(encodePool(), bands, [&](int band) {
+        work(static_cast<int>(static_cast<int64_t>(band) * height / bands),
+             static_cast<int>(static_cast<int64_t>(band + 1) * height / bands));
+    });
+}
+
+void toRgb(const unsigned char* rgba, int width, unsigned char* rgb) {
+    for (int x = 0; x < width; x++) {
+        rgb[x * 3] = rgba[x * 4];
+        rgb[x * 3 + 1] = rgba[x * 4 + 1];
+        rgb[x * 3 + 2] = rgba[x * 4 + 2];
+    }
+}
+
+void putBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+    out.push_back(static_cast<unsigned char>(value >> 24));
+    out.push_back(static_cast<unsigned char>(value >> 16));
+    out.push_back(static_cast<unsigned char>(value >> 8));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+void putPngChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size) {
+    putBigEndian(out, static_cast<uint32_t>(size));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    putBigEndian(out, static_cast<uint32_t>(crc32(0, out.data() + start, static_cast<uInt>(size + 4))));
+}
+
+inline int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+// filter one rgb8 row (prev is the unfiltered row above, zeros for the first).
+// picks the filter whose output has the smallest sum of |signed byte|, libpng's
+// heuristic, and writes its type byte followed by the filtered row
+void filterRow(const unsigned char* row, const unsigned char* prev, int bytes, unsigned char* out) {
+    constexpr int BPP = 3;
+    auto predict = [&](int filter, int i) -> int {
+        int left = i >= BPP ? row[i - BPP] : 0;
+        int up = prev[i];
+        int upLeft = i >= BPP ? prev[i - BPP] : 0;
+        switch (filter) {
+        case 1: return left;
+        case 2: return up;
+        case 3: return (left + up) >> 1;
+        case 4: return paeth(left, up, upLeft);
+        default: return 0;
+        }
+    };
+
+    uint64_t costs[5] = {0, 0, 0, 0, 0};
+    for (int i = 0; i < bytes; i++) {
+        for (int filter = 0; filter < 5; filter++) {
+            unsigned char residual = static_cast<unsigned char>(row[i] - predict(filter, i));
+            costs[filter] += residual < 128 ? residual : 256 - residual;
+        }
+    }
+    int best = static_cast<int>(std::min_element(costs, costs + 5) - costs);
+
+    out[0] = static_cast<unsigned char>(best);
+    for (int i = 0; i < bytes; i++) {
+        out[i + 1] = static_cast<unsigned char>(row[i] - predict(best, i));
+    }
+}
+
+// one piece of the zlib stream: raw deflate ending on a byte boundary
+struct DeflateChunk {
+    std::vector<unsigned char> data;
+    uLong adler = 1;
+    size_t size = 0;
+    bool ok = false;
+};
+
+void deflateChunk(const unsigned char* input, size_t begin, size_t end, bool last, DeflateChunk& chunk) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, PNG_COMPRESSION_LEVEL, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+    if (begin > 0) {
+        size_t dictionary = std::min(begin, DEFLATE_WINDOW_BYTES);
+        deflateSetDictionary(&stream, input + begin - dictionary, static_cast<uInt>(dictionary));
+    }
+
+    size_t size = end - begin;
+    // a sync flush adds an empty stored block on top of the bound
+    chunk.data.resize(deflateBound(&stream, static_cast<uLong>(size)) + 16);
+    stream.next_in = const_cast<Bytef*>(input + begin);
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = chunk.data.data();
+    stream.avail_out = static_cast<uInt>(chunk.data.size());
+    int result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+    chunk.ok = result == (last ? Z_STREAM_END : Z_OK) && stream.avail_in == 0;
+    chunk.data.resize(chunk.data.size() - stream.avail_out);
+    deflateEnd(&stream);
+
+    chunk.adler = adler32(1, input + begin, static_cast<uInt>(size));
+    chunk.size = size;
+}
+
+void putPngHeader(std::vector<unsigned char>& out, int width, int height) {
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out.insert(out.end(), signature, signature + 8);
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, static_cast<uint32_t>(width));
+    putBigEndian(header, static_cast<uint32_t>(height));
+    header.push_back(8);  // bits per channel
+    header.push_back(2);  // truecolor rgb
+    header.push_back(0);  // deflate
+    header.push_back(0);  // adaptive filtering
+    header.push_back(0);  // not interlaced
+    putPngChunk(out, "IHDR", header.data(), header.size());
+}
+
+// what a png needs to carry from one band of rows to the next
+struct PngStream {
+    std::vector<unsigned char> previousRow;  // unfiltered rgb, zeros before the first row
+    std::vector<unsigned char> window;       // the last filtered bytes, the next band's dictionary
+    uLong adler = 1;
+    bool started = false;
+};
+
+// filter and deflate a band of rows into one IDAT chunk. the first band
+// starts the zlib stream, the last one ends it with the adler-32
+bool putPngRows(PngStream& png, const unsigned char* pixels, int width, int rows, int rowBytes, bool last,
+                std::vector<unsigned char>& out) {
+    size_t rgbRow = static_cast<size_t>(width) * 3;
+    size_t filteredRow = rgbRow + 1;
+    if (png.previousRow.size() != rgbRow) {
+        png.previousRow.assign(rgbRow, 0);
+    }
+
+    // filter bands of rows in parallel. a row's filter only looks at the
+    // unfiltered row above, so bands don't depend on each other. the filtered
+    // rows go after the previous band's tail so chunks can be primed with it
+    size_t windowSize = png.window.size();
+    std::vector<unsigned char> filtered(windowSize + filteredRow * rows);
+    std::memcpy(filtered.data(), png.window.data(), windowSize);
+    unsigned char* body = filtered.data() + windowSize;
+    forEachBand(width, rows, [&](int firstRow, int lastRow) {
+        std::vector<unsigned char> prev(png.previousRow);
+        std::vector<unsigned char> row(rgbRow);
+        if (firstRow > 0) {
+            toRgb(pixels + static_cast<size_t>(firstRow - 1) * rowBytes, width, prev.data());
+        }
+        for (int y = firstRow; y < lastRow; y++) {
+            toRgb(pixels + static_cast<size_t>(y) * rowBytes, width, row.data());
+            filterRow(row.data(), prev.data(), static_cast<int>(rgbRow), body + y * filteredRow);
+            std::swap(row, prev);
+        }
+    });
+    toRgb(pixels + static_cast<size_t>(rows - 1) * rowBytes, width, png.previousRow.data());
+
+    // deflate fixed-size chunks in parallel and join them into one zlib stream,
+    // the way pigz does: every chunk but the last ends with a sync flush so they
+    // concatenate, and the adler-32s of the chunks are combined
+    size_t bodySize = filtered.size() - windowSize;
+    int chunkCount = static_cast<int>((bodySize + DEFLATE_CHUNK_BYTES - 1) / DEFLATE_CHUNK_BYTES);
+    std::vector<DeflateChunk> chunks(chunkCount);
+    parallelFor(encodePool(), chunkCount, [&](int i) {
+        size_t begin = windowSize + static_cast<size_t>(i) * DEFLATE_CHUNK_BYTES;
+        size_t end = std::min(filtered.size(), begin + DEFLATE_CHUNK_BYTES);
+        deflateChunk(filtered.data(), begin, end, last && i == chunkCount - 1, chunks[i]);
+    });
+
+    std::vector<unsigned char> stream;
+    size_t compressed = 0;
+    for (const DeflateChunk& chunk : chunks) {
+        if (!chunk.ok) {
+            return false;
+        }
+        compressed += chunk.data.size();
+    }
+    stream.reserve(compressed + 6);
+
+    if (!png.started) {
+        // zlib header: deflate with a 32k window, level hint as zlib would set it
+        int levelHint = PNG_COMPRESSION_LEVEL < 2 ? 0 : PNG_COMPRESSION_LEVEL < 6 ? 1 : PNG_COMPRESSION_LEVEL == 6 ? 2 : 3;
+        unsigned char cmf = 0x78;
+        unsigned char flg = static_cast<unsigned char>(levelHint << 6);
+        flg = static_cast<unsigned char>(flg + 31 - (cmf * 256 + flg) % 31);
+        stream.push_back(cmf);
+        stream.push_back(flg);
+        png.started = true;
+    }
+
+    for (const DeflateChunk& chunk : chunks) {
+        stream.insert(stream.end(), chunk.data.begin(), chunk.data.end());
+        png.adler = adler32_combine(png.adler, chunk.adler, static_cast<z_off_t>(chunk.size));
+    }
+    if (last) {
+        putBigEndian(stream, static_cast<uint32_t>(png.adler));
+    }
+    putPngChunk(out, "IDAT", stream.data(), stream.size());
+
+    size_t keep = std::min(filtered.size(), DEFLATE_WINDOW_BYTES);
+    png.window.assign(filtered.end() - keep, filtered.end());
+    return true;
+}
+
+// qoi's ops depend on every pixel before them, so it is encoded in one pass.
+// it is quick enough that the frame-level parallelism of bulk capture is what counts
+struct QoiStream {
+    struct Pixel {
+        unsigned char r = 0, g = 0, b = 0, a = 255;
+        bool operator==(const Pixel& other) const {
+            return r == other.r && g == other.g && b == other.b && a == other.a;
+        }
+    };
+
+    Pixel index[64];
+    Pixel previous;
+    int run = 0;
+    int64_t remaining = 0;
+
+    void begin(std::vector<unsigned char>& out, int width, int height) {
+        out.insert(out.end(), {'q', 'o', 'i', 'f'});
+        putBigEndian(out, static_cast<uint32_t>(width));
+        putBigEndian(out, static_cast<uint32_t>(height));
+        out.push_back(3);  // rgb
+        out.push_back(0);  // srgb
+        for (Pixel& entry : index) {
+            entry = Pixel();
+            entry.a = 0;
+        }
+        previous = Pixel();
+        run = 0;
+        remaining = static_cast<int64_t>(width) * height;
+    }
+
+    void rows(std::vector<unsigned char>& out, const unsigned char* pixels, int width, int rows, int rowBytes) {
+        for (int y = 0; y < rows; y++) {
+            const unsigned char* row = pixels + static_cast<size_t>(y) * rowBytes;
+            for (int x = 0; x < width; x++) {
+                Pixel pixel;
+                pixel.r = row[x * 4];
+                pixel.g = row[x * 4 + 1];
+                pixel.b = row[x * 4 + 2];
+                remaining--;
+
+                if (pixel == previous) {
+                    run++;
+                    if (run == 62 || remaining == 0) {
+                        out.push_back(static_cast<unsigned char>(0xc0 | (run - 1)));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0) {
+                    out.push_back(static_cast<unsigned char>(0xc0 | (run - 1)));
+                    run = 0;
+                }
+
+                int hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+                if (index[hash] == pixel) {
+                    out.push_back(static_cast<unsigned char>(hash));
+                } else {
+                    index[hash] = pixel;
+                    int dr = static_cast<signed char>(pixel.r - previous.r);
+                    int dg = static_cast<signed char>(pixel.g - previous.g);
+                    int db = static_cast<signed char>(pixel.b - previous.b);
+                    int drg = dr - dg;
+                    int dbg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        out.push_back(static_cast<unsigned char>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        out.push_back(static_cast<unsigned char>(0x80 | (dg + 32)));
+                        out.push_back(static_cast<unsigned char>((drg + 8) << 4 | (dbg + 8)));
+                    } else {
+                        out.insert(out.end(), {0xfe, pixel.r, pixel.g, pixel.b});
+                    }
+                }
+                previous = pixel;
+            }
+        }
+    }
+
+    void end(std::vector<unsigned char>& out) {
+        out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+    }
+};
+
+void putRgbRows(std::vector<unsigned char>& out, const unsigned char* pixels, int width, int rows, int rowBytes) {
+    size_t rgbRow = static_cast<size_t>(width) * 3;
+    size_t start = out.size();
+    out.resize(start + rgbRow * rows);
+    unsigned char* body = out.data() + start;
+    forEachBand(width, rows, [&](int firstRow, int lastRow) {
+        for (int y = firstRow; y < lastRow; y++) {
+            toRgb(pixels + static_cast<size_t>(y) * rowBytes, width, body + y * rgbRow);
+        }
+    });
+}
+
+std::string ppmHeader(int width, int height) {
+    return "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+}
+
+}
+
+ImageFormat ImageEncoder::formatForPath(const std::string& path) {
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return ImageFormat::Other;
+    }
+
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (extension == "png") {
+        return ImageFormat::Png;
+    }
+    if (extension == "ppm") {
+        return ImageFormat::Ppm;
+    }
+    if (extension == "qoi") {
+        return ImageFormat::Qoi;
+    }
+    if (extension == "raw") {
+        return ImageFormat::Raw;
+    }
+    return ImageFormat::Other;
+}
+
+bool ImageEncoder::encode(const unsigned char* pixels, int width, int height, int rowBytes, ImageFormat format,
+                          std::vector<unsigned char>& out) {
+    out.clear();
+    if (pixels == nullptr || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    switch (format) {
+    case ImageFormat::Png: {
+        out.reserve(static_cast<size_t>(width) * height + 64);
+        putPngHeader(out, width, height);
+        PngStream png;
+        if (!putPngRows(png, pixels, width, height, rowBytes, true, out)) {
+            out.clear();
+            return false;
+        }
+        putPngChunk(out, "IEND", nullptr, 0);
+        return true;
+    }
+    case ImageFormat::Qoi: {
+        out.reserve(14 + static_cast<size_t>(width) * height + 8);
+        QoiStream qoi;
+        qoi.begin(out, width, height);
+        qoi.rows(out, pixels, width, height, rowBytes);
+        qoi.end(out);
+        return true;
+    }
+    case ImageFormat::Ppm:
+    case ImageFormat::Raw:
+        if (format == ImageFormat::Ppm) {
+            std::string header = ppmHeader(width, height);
+            out.insert(out.end(), header.begin(), header.end());
+        }
+        putRgbRows(out, pixels, width, height, rowBytes);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ImageEncoder::save(const unsigned char* pixels, int width, int height, int rowBytes, const std::string& path) {
+    ImageFormat format = formatForPath(path);
+    if (format == ImageFormat::Other) {
+        QImage image(pixels, width, height, rowBytes, QImage::Format_RGBX8888);
+        if (!image.save(QString::fromStdString(path))) {
+            std::cerr << "Failed to save image to " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    std::vector<unsigned char> data;
+    if (!encode(pixels, width, height, rowBytes, format, data)) {
+        std::cerr << "Failed to encode image for " << path << std::endl;
+        return false;
+    }
+
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<qint64>(data.size())) != static_cast<qint64>(data.size()) ||
+        !file.commit()) {
+        std::cerr << "Failed to save image to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+struct ImageStreamWriter::State {
+    QSaveFile file;
+    std::string path;
+    ImageFormat format = ImageFormat::Other;
+    int width = 0;
+    int height = 0;
+    int rowsWritten = 0;
+    bool failed = false;
+    PngStream png;
+    QoiStream qoi;
+    std::vector<unsigned char> buffer;
+
+    bool flush() {
+        if (!buffer.empty() &&
+            file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<qint64>(buffer.size())) != static_cast<qint64>(buffer.size())) {
+            failed = true;
+        }
+        buffer.clear();
+        return !failed;
+    }
+};
+
+ImageStreamWriter::ImageStreamWriter() = default;
+
+ImageStreamWriter::~ImageStreamWriter() = default;
+
+bool ImageStreamWriter::open(const std::string& path, int width, int height) {
+    m_state.reset();
+    ImageFormat format = ImageEncoder::formatForPath(path);
+    if (format == ImageFormat::Other) {
+        std::cerr << "Can't stream " << path << ", use .png, .qoi, .ppm or .raw" << std::endl;
+        return false;
+    }
+
+    auto state = std::make_unique<State>();
+    state->file.setFileName(QString::fromStdString(path));
+    if (width <= 0 || height <= 0 || !state->file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Failed to save image to " << path << std::endl;
+        return false;
+    }
+    state->path = path;
+    state->format = format;
+    state->width = width;
+    state->height = height;
+
+    if (format == ImageFormat::Png) {
+        putPngHeader(state->buffer, width, height);
+    } else if (format == ImageFormat::Qoi) {
+        state->qoi.begin(state->buffer, width, height);
+    } else if (format == ImageFormat::Ppm) {
+        std::string header = ppmHeader(width, height);
+        state->buffer.insert(state->buffer.end(), header.begin(), header.end());
+    }
+    if (!state->flush()) {
+        std::cerr << "Failed to save image to " << path << std::endl;
+        return false;
+    }
+    m_state = std::move(state);
+    return true;
+}
+
+bool ImageStreamWriter::writeRows(const unsigned char* pixels, int rows, int rowBytes) {
+    if (!m_state || m_state->failed) {
+        return false;
+    }
+    State& state = *m_state;
+    rows = std::min(rows, state.height - state.rowsWritten);
+    if (rows <= 0) {
+        return true;
+    }
+    state.rowsWritten += rows;
+
+    if (state.format == ImageFormat::Png) {
+        bool last = state.rowsWritten == state.height;
+        state.failed = !putPngRows(state.png, pixels, state.width, rows, rowBytes, last, state.buffer);
+    } else if (state.format == ImageFormat::Qoi) {
+        state.qoi.rows(state.buffer, pixels, state.width, rows, rowBytes);
+    } else {
+        putRgbRows(state.buffer, pixels, state.width, rows, rowBytes);
+    }
+    return !state.failed && state.flush();
+}
+
+bool ImageStreamWriter::close() {
+    if (!m_state) {
+        return false;
+    }
+    std::unique_ptr<State> state = std::move(m_state);
+    if (state->rowsWritten != state->height) {
+        std::cerr << "Image " << state->path << " is missing rows, not saved" << std::endl;
+        return false;
+    }
+
+    if (state->format == ImageFormat::Png) {
+        putPngChunk(state->buffer, "IEND", nullptr, 0);
+    } else if (state->format == ImageFormat::Qoi) {
+        state->qoi.end(state->buffer);
+    }
+    if (!state->flush() || !state->file.commit()) {
+        std::cerr << "Failed to save image to " << state->path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// output formats, picked by file extension
+enum class ImageFormat {
+    Png,    // .png: rgb8, rows filtered and deflated in parallel chunks
+    Ppm,    // .ppm: binary P6, no compression, the fastest to write
+    Qoi,    // .qoi: lossless, a single fast pass, larger than png
+    Raw,    // .raw: rgb8 rows top first, no header
+    Other,  // anything else QImage can write (jpg, bmp, ...)
+};
+
+// encodes rendered frames for bulk capture. input is rgba8 rows top first;
+// alpha is dropped since the framebuffer's is not meaningful
+class ImageEncoder {
+public:
+    static ImageFormat formatForPath(const std::string& path);
+
+    // encode into out (replacing its contents). Other is not handled here and returns false
+    static bool encode(const unsigned char* pixels, int width, int height, int rowBytes, ImageFormat format,
+                       std::vector<unsigned char>& out);
+
+    // encode in the format path's extension asks for and write it, replacing the
+    // file only once it is complete. prints why and returns false on failure
+    static bool save(const unsigned char* pixels, int width, int height, int rowBytes, const std::string& path);
+};
+
+// writes an image a band of rows at a time, for images too large to hold in
+// memory. the same formats as ImageEncoder::encode, a png's deflate stream and
+// a qoi's state carry over from one band to the next
+class ImageStreamWriter {
+public:
+    ImageStreamWriter();
+    ~ImageStreamWriter();
+
+    // start the file. prints why and returns false for extensions that can't be streamed
+    bool open(const std::string& path, int width, int height);
+
+    // rgba8 rows top first, continuing where the last call stopped
+    bool writeRows(const unsigned char* pixels, int rows, int rowBytes);
+
+    // finish the file and move it into place. false (and nothing written) if
+    // rows are missing or a write failed
+    bool close();
+
+private:
+    struct State;
+    std::unique_ptr<State> m_state;
+};
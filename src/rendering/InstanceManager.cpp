@@ -1,4 +1,5 @@
 #include "InstanceManager.h"
+#include "RenderStats.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <random>
 #include <iostream>
@@ -10,36 +11,41 @@ InstanceManager::~InstanceManager() {
     cleanup();
 }
 
-void InstanceManager::generateInstances(int count, float spreadRadius) {
+void InstanceManager::generateInstances(int count, float spreadRadius, unsigned seed) {
     m_instanceMatrices.clear();
     m_instanceCount = count;
 
     // random number generator
     std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> posDist(-spreadRadius, spreadRadius);
-    std::uniform_real_distribution<float> scaleDist(0.5f, 1.5f);
-    std::uniform_real_distribution<float> rotDist(0.0f, 360.0f);
+    std::mt19937 gen(seed != 0 ? seed : rd());
+    // mt19937's output is the same everywhere but std::uniform_real_distribution's
+    // isn't, so a seed only places the same instances on every toolchain when the
+    // engine output is scaled by hand, as SceneGenerator does
+    auto uniform = [&gen](float low, float high) {
+        double unit = (gen() >> 8) * (1.0 / 16777216.0);
+        return static_cast<float>(low + (high - low) * unit);
+    };
 
     for (int i = 0; i < count; i++) {
         glm::mat4 model(1.0f);
 
         // random position
-        float x = posDist(gen);
-        float y = posDist(gen) * 0.3f;  // less vertical spread
-        float z = posDist(gen);
+        float x = uniform(-spreadRadius, spreadRadius);
+        float y = uniform(-spreadRadius, spreadRadius) * 0.3f;  // less vertical spread
+        float z = uniform(-spreadRadius, spreadRadius);
         model = glm::translate(model, glm::vec3(x, y, z));
 
-        float rotationY = rotDist(gen);
+        float rotationY = uniform(0.0f, 360.0f);
         model = glm::rotate(model, glm::radians(rotationY), glm::vec3(0, 1, 0));
 
-        float scale = scaleDist(gen);
+        float scale = uniform(0.5f, 1.5f);
         model = glm::scale(model, glm::vec3(scale));
 
         m_instanceMatrices.push_back(model);
     }
 
     std::cout << "generated " << count << " instances" << std::endl;
+    RenderStats::set(RenderStats::InstanceCount, count);
 }
 
 void InstanceManager::uploadToGPU() {
@@ -72,4 +78,5 @@ void InstanceManager::cleanup() {
     }
     m_instanceMatrices.clear();
     m_instanceCount = 0;
+    RenderStats::set(RenderStats::InstanceCount, 0);
 }
@@ -9,8 +9,9 @@ public:
     InstanceManager();
     ~InstanceManager();
 
-    // generate random instance transformations
-    void generateInstances(int count, float spreadRadius);
+    // generate random instance transformations. a nonzero seed gives the same
+    // layout every time, 0 a new one
+    void generateInstances(int count, float spreadRadius, unsigned seed = 0);
 
     // upload instance data to GPU
     void uploadToGPU();
@@ -0,0 +1,535 @@
+#include "MipGenerator.h"
+#include "ParallelFor.h"
+#include <QThread>
+#include <QThreadPool>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define MIP_SSE2 1
+#if defined(__GNUC__)
+#define MIP_AVX2 1
+#endif
+#endif
+
+namespace {
+
+// srgb <-> linear conversion tables, filtering in linear space keeps
+// bright/dark detail from getting muddy in the smaller levels. linear values
+// are 16 bit so levels can be chained without rounding to srgb in between
+struct SrgbTables {
+    uint16_t toLinear[256];
+    unsigned char toSrgb[65536];
+
+    SrgbTables() {
+        for (int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            float l = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            toLinear[i] = static_cast<uint16_t>(l * 65535.0f + 0.5f);
+        }
+        for (int i = 0; i < 65536; i++) {
+            float l = i / 65535.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = static_cast<unsigned char>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+const SrgbTables& srgbTables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+void srgbRowToLinear(const unsigned char* src, int width, uint16_t* out) {
+    const SrgbTables& tables = srgbTables();
+    for (int i = 0; i < width * 4; i += 4) {
+        out[i] = tables.toLinear[src[i]];
+        out[i + 1] = tables.toLinear[src[i + 1]];
+        out[i + 2] = tables.toLinear[src[i + 2]];
+        out[i + 3] = static_cast<uint16_t>(src[i + 3] * 257);
+    }
+}
+
+void linearRowToSrgb(const uint16_t* src, int width, unsigned char* out) {
+    const SrgbTables& tables = srgbTables();
+    for (int i = 0; i < width * 4; i += 4) {
+        out[i] = tables.toSrgb[src[i]];
+        out[i + 1] = tables.toSrgb[src[i + 1]];
+        out[i + 2] = tables.toSrgb[src[i + 2]];
+        out[i + 3] = static_cast<unsigned char>((src[i + 3] + 128) / 257);
+    }
+}
+
+// the level being read, either the srgb source image or the linear copy of the
+// previous level
+struct SourceLevel {
+    const unsigned char* srgb = nullptr;
+    int rowBytes = 0;
+    const uint16_t* linear = nullptr;
+    int width = 0;
+    int height = 0;
+
+    // row y in linear, converted into scratch when reading the source image
+    const uint16_t* row(int y, uint16_t* scratch) const {
+        if (linear != nullptr) {
+            return linear + static_cast<size_t>(y) * width * 4;
+        }
+        srgbRowToLinear(srgb + static_cast<size_t>(y) * rowBytes, width, scratch);
+        return scratch;
+    }
+};
+
+// 2x2 average of two rows, the even-size case every power of two level takes
+void boxRowScalar(const uint16_t* row0, const uint16_t* row1, int outWidth, uint16_t* out) {
+    for (int x = 0; x < outWidth; x++) {
+        const uint16_t* a = row0 + x * 8;
+        const uint16_t* b = row1 + x * 8;
+        for (int c = 0; c < 4; c++) {
+            out[x * 4 + c] = static_cast<uint16_t>((a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2);
+        }
+    }
+}
+
+#ifdef MIP_SSE2
+// two output texels per iteration. sums are widened to 32 bits; sse2 has no
+// unsigned 32 -> 16 pack, so values are shifted into the signed range and back
+void boxRowSSE2(const uint16_t* row0, const uint16_t* row1, int outWidth, uint16_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(2);
+    const __m128i bias32 = _mm_set1_epi32(32768);
+    const __m128i bias16 = _mm_set1_epi16(static_cast<short>(0x8000));
+
+    int x = 0;
+    for (; x + 2 <= outWidth; x += 2) {
+        __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+        __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8 + 8));
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8 + 8));
+
+        __m128i s0 = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a0, zero), _mm_unpackhi_epi16(a0, zero)),
+                                   _mm_add_epi32(_mm_unpacklo_epi16(b0, zero), _mm_unpackhi_epi16(b0, zero)));
+        __m128i s1 = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(a1, zero), _mm_unpackhi_epi16(a1, zero)),
+                                   _mm_add_epi32(_mm_unpacklo_epi16(b1, zero), _mm_unpackhi_epi16(b1, zero)));
+        s0 = _mm_srli_epi32(_mm_add_epi32(s0, round), 2);
+        s1 = _mm_srli_epi32(_mm_add_epi32(s1, round), 2);
+
+        __m128i packed = _mm_packs_epi32(_mm_sub_epi32(s0, bias32), _mm_sub_epi32(s1, bias32));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_xor_si128(packed, bias16));
+    }
+    boxRowScalar(row0 + x * 8, row1 + x * 8, outWidth - x, out + x * 4);
+}
+#endif
+
+#ifdef MIP_AVX2
+// four output texels per iteration. unpack and pack work per 128-bit lane, so
+// the packed texels come out as 0 2 1 3 and get put back in order
+__attribute__((target("avx2")))
+void boxRowAVX2(const uint16_t* row0, const uint16_t* row1, int outWidth, uint16_t* out) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(2);
+
+    int x = 0;
+    for (; x + 4 <= outWidth; x += 4) {
+        __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + x * 8));
+        __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + x * 8 + 16));
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + x * 8));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + x * 8 + 16));
+
+        __m256i s0 = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(a0, zero), _mm256_unpackhi_epi16(a0, zero)),
+                                      _mm256_add_epi32(_mm256_unpacklo_epi16(b0, zero), _mm256_unpackhi_epi16(b0, zero)));
+        __m256i s1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(a1, zero), _mm256_unpackhi_epi16(a1, zero)),
+                                      _mm256_add_epi32(_mm256_unpacklo_epi16(b1, zero), _mm256_unpackhi_epi16(b1, zero)));
+        s0 = _mm256_srli_epi32(_mm256_add_epi32(s0, round), 2);
+        s1 = _mm256_srli_epi32(_mm256_add_epi32(s1, round), 2);
+
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(s0, s1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4), packed);
+    }
+    boxRowSSE2(row0 + x * 8, row1 + x * 8, outWidth - x, out + x * 4);
+}
+#endif
+
+using BoxRowFunction = void (*)(const uint16_t*, const uint16_t*, int, uint16_t*);
+
+// widest kernel the cpu runs, picked once
+BoxRowFunction boxRowFunction() {
+    static const BoxRowFunction function = []() -> BoxRowFunction {
+#ifdef MIP_AVX2
+        if (__builtin_cpu_supports("avx2")) {
+            return &boxRowAVX2;
+        }
+#endif
+#ifdef MIP_SSE2
+        return &boxRowSSE2;
+#else
+        return &boxRowScalar;
+#endif
+    }();
+    return function;
+}
+
+// box filter over the source texels covered by each destination texel.
+// odd sizes cover three texels on that axis so nothing is dropped
+void boxRowFootprint(const SourceLevel& src, int y, int dstWidth, int dstHeight, uint16_t* scratch, uint16_t* out) {
+    int y0 = y * src.height / dstHeight;
+    int y1 = std::max(y0 + 1, ((y + 1) * src.height + dstHeight - 1) / dstHeight);
+
+    const uint16_t* rows[3];
+    int rowCount = y1 - y0;
+    for (int i = 0; i < rowCount; i++) {
+        rows[i] = src.row(y0 + i, scratch + static_cast<size_t>(i) * src.width * 4);
+    }
+
+    for (int x = 0; x < dstWidth; x++) {
+        int x0 = x * src.width / dstWidth;
+        int x1 = std::max(x0 + 1, ((x + 1) * src.width + dstWidth - 1) / dstWidth);
+
+        uint32_t sum[4] = {0, 0, 0, 0};
+        for (int i = 0; i < rowCount; i++) {
+            for (int sx = x0; sx < x1; sx++) {
+                const uint16_t* p = rows[i] + sx * 4;
+                sum[0] += p[0];
+                sum[1] += p[1];
+                sum[2] += p[2];
+                sum[3] += p[3];
+            }
+        }
+
+        uint32_t count = static_cast<uint32_t>((x1 - x0) * rowCount);
+        for (int c = 0; c < 4; c++) {
+            out[x * 4 + c] = static_cast<uint16_t>((sum[c] + count / 2) / count);
+        }
+    }
+}
+
+struct FilterTap {
+    int index = 0;
+    float weight = 0.0f;
+};
+
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// kaiser-windowed sinc taps for every destination coordinate (width 3, alpha 4,
+// in destination texels). source indices wrap around like GL_REPEAT
+std::vector<std::vector<FilterTap>> kaiserTaps(int srcSize, int dstSize) {
+    const double width = 3.0;
+    const double alpha = 4.0;
+    const double pi = 3.14159265358979323846;
+
+    double scale = static_cast<double>(srcSize) / dstSize;
+    std::vector<std::vector<FilterTap>> taps(dstSize);
+    for (int i = 0; i < dstSize; i++) {
+        double center = (i + 0.5) * scale;
+        int first = static_cast<int>(std::floor(center - width * scale));
+        int last = static_cast<int>(std::ceil(center + width * scale));
+
+        double total = 0.0;
+        for (int s = first; s <= last; s++) {
+            double t = (s + 0.5 - center) / scale;
+            if (std::abs(t) >= width) {
+                continue;
+            }
+            double sinc = t == 0.0 ? 1.0 : std::sin(pi * t) / (pi * t);
+            double window = besselI0(alpha * std::sqrt(1.0 - (t / width) * (t / width))) / besselI0(alpha);
+            double weight = sinc * window;
+
+            FilterTap tap;
+            tap.index = ((s % srcSize) + srcSize) % srcSize;
+            tap.weight = static_cast<float>(weight);
+            taps[i].push_back(tap);
+            total += weight;
+        }
+        for (FilterTap& tap : taps[i]) {
+            tap.weight = static_cast<float>(tap.weight / total);
+        }
+    }
+    return taps;
+}
+
+constexpr int MIN_TEXELS_PER_BAND = 64 * 1024;
+
+QThreadPool& mipPool() {
+    static QThreadPool pool;
+    return pool;
+}
+
+// run work(firstRow, lastRow) over bands of rows on the mip pool
+void parallelRows(int rows, int rowTexels, bool parallel, const std::function<void(int, int)>& work) {
+    int64_t texels = static_cast<int64_t>(rows) * rowTexels;
+    int maxBands = std::min(rows, QThread::idealThreadCount() * 4);
+    int bands = parallel ? static_cast<int>(std::clamp<int64_t>(texels / MIN_TEXELS_PER_BAND, 1, std::max(1, maxBands))) : 1;
+    if (bands <= 1) {
+        work(0, rows);
+        return;
+    }
+
+    parallelFor(mipPool(), bands, [&](int band) {
+        work(static_cast<int>(static_cast<int64_t>(band) * rows / bands),
+             static_cast<int>(static_cast<int64_t>(band + 1) * rows / bands));
+    });
+}
+
+void boxLevel(const SourceLevel& src, bool parallel, MipLevel& dst, uint16_t* dstLinear) {
+    bool halves = src.width == dst.width * 2 && src.height == dst.height * 2;
+    BoxRowFunction boxRow = boxRowFunction();
+
+    parallelRows(dst.height, dst.width, parallel, [&](int firstRow, int lastRow) {
+        std::vector<uint16_t> scratch(static_cast<size_t>(src.width) * 4 * 3);
+        std::vector<uint16_t> outRow(dstLinear == nullptr ? static_cast<size_t>(dst.width) * 4 : 0);
+
+        for (int y = firstRow; y < lastRow; y++) {
+            uint16_t* out = dstLinear != nullptr ? dstLinear + static_cast<size_t>(y) * dst.width * 4 : outRow.data();
+            if (halves) {
+                const uint16_t* row0 = src.row(2 * y, scratch.data());
+                const uint16_t* row1 = src.row(2 * y + 1, scratch.data() + static_cast<size_t>(src.width) * 4);
+                boxRow(row0, row1, dst.width, out);
+            } else {
+                boxRowFootprint(src, y, dst.width, dst.height, scratch.data(), out);
+            }
+            linearRowToSrgb(out, dst.width, dst.pixels.data() + static_cast<size_t>(y) * dst.width * 4);
+        }
+    });
+}
+
+void kaiserLevel(const SourceLevel& src, bool parallel, MipLevel& dst, uint16_t* dstLinear) {
+    std::vector<std::vector<FilterTap>> columnTaps = kaiserTaps(src.width, dst.width);
+    std::vector<std::vector<FilterTap>> rowTaps = kaiserTaps(src.height, dst.height);
+
+    size_t ringSize = 1;
+    for (const std::vector<FilterTap>& taps : rowTaps) {
+        ringSize = std::max(ringSize, taps.size());
+    }
+
+    parallelRows(dst.height, dst.width * static_cast<int>(ringSize), parallel, [&](int firstRow, int lastRow) {
+        // horizontally filtered source rows, shared by neighbouring output rows
+        size_t rowFloats = static_cast<size_t>(dst.width) * 4;
+        std::vector<float> ring(ringSize * rowFloats);
+        std::vector<int> ringRow(ringSize, -1);
+        std::vector<uint16_t> scratch(static_cast<size_t>(src.width) * 4);
+        std::vector<float> sum(rowFloats);
+        std::vector<uint16_t> outRow(dstLinear == nullptr ? rowFloats : 0);
+
+        for (int y = firstRow; y < lastRow; y++) {
+            std::fill(sum.begin(), sum.end(), 0.0f);
+
+            for (const FilterTap& rowTap : rowTaps[y]) {
+                size_t slot = static_cast<size_t>(rowTap.index) % ringSize;
+                float* filtered = ring.data() + slot * rowFloats;
+                if (ringRow[slot] != rowTap.index) {
+                    const uint16_t* row = src.row(rowTap.index, scratch.data());
+                    for (int x = 0; x < dst.width; x++) {
+                        float texel[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                        for (const FilterTap& tap : columnTaps[x]) {
+                            const uint16_t* p = row + tap.index * 4;
+                            for (int c = 0; c < 4; c++) {
+                                texel[c] += p[c] * tap.weight;
+                            }
+                        }
+                        std::copy(texel, texel + 4, filtered + x * 4);
+                    }
+                    ringRow[slot] = rowTap.index;
+                }
+
+                for (size_t i = 0; i < rowFloats; i++) {
+                    sum[i] += filtered[i] * rowTap.weight;
+                }
+            }
+
+            // the negative lobes can overshoot
+            uint16_t* out = dstLinear != nullptr ? dstLinear + static_cast<size_t>(y) * rowFloats : outRow.data();
+            for (size_t i = 0; i < rowFloats; i++) {
+                out[i] = static_cast<uint16_t>(std::clamp(sum[i] + 0.5f, 0.0f, 65535.0f));
+            }
+            linearRowToSrgb(out, dst.width, dst.pixels.data() + static_cast<size_t>(y) * rowFloats);
+        }
+    });
+}
+
+// scale alpha so the share of texels at or above the cutoff matches target.
+// coverage only depends on the alpha histogram, so the search never rescans the level
+void preserveCoverage(MipLevel& level, float cutoff, float target) {
+    uint32_t histogram[256] = {};
+    size_t texels = static_cast<size_t>(level.width) * level.height;
+    for (size_t i = 0; i < texels; i++) {
+        histogram[level.pixels[i * 4 + 3]]++;
+    }
+
+    auto coverage = [&](float scale) {
+        uint32_t passing = 0;
+        for (int a = 0; a < 256; a++) {
+            if (a * scale >= cutoff * 255.0f) {
+                passing += histogram[a];
+            }
+        }
+        return static_cast<float>(passing) / texels;
+    };
+
+    float low = 0.0f;
+    float high = 4.0f;
+    for (int i = 0; i < 16; i++) {
+        float middle = (low + high) * 0.5f;
+        if (coverage(middle) < target) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    // alpha only takes a few values in small levels, take the closer side
+    float scale = std::abs(coverage(low) - target) < std::abs(coverage(high) - target) ? low : high;
+    for (size_t i = 0; i < texels; i++) {
+        unsigned char& alpha = level.pixels[i * 4 + 3];
+        alpha = static_cast<unsigned char>(std::min(255.0f, alpha * scale + 0.5f));
+    }
+}
+
+// same footprint as boxRowFootprint(), but on unit vectors: unpack, sum, renormalize
+void downsampleNormals(const unsigned char* src, int srcWidth, int srcHeight, MipLevel& dst, int firstRow, int lastRow) {
+    unsigned char* out = dst.pixels.data();
+
+    for (int y = firstRow; y < lastRow; y++) {
+        int y0 = y * srcHeight / dst.height;
+        int y1 = std::max(y0 + 1, ((y + 1) * srcHeight + dst.height - 1) / dst.height);
+
+        for (int x = 0; x < dst.width; x++) {
+            int x0 = x * srcWidth / dst.width;
+            int x1 = std::max(x0 + 1, ((x + 1) * srcWidth + dst.width - 1) / dst.width);
+
+            float sum[3] = {0.0f, 0.0f, 0.0f};
+            for (int sy = y0; sy < y1; sy++) {
+                const unsigned char* row = src + sy * srcWidth * 2;
+                for (int sx = x0; sx < x1; sx++) {
+                    float nx = row[sx * 2] / 127.5f - 1.0f;
+                    float ny = row[sx * 2 + 1] / 127.5f - 1.0f;
+                    sum[0] += nx;
+                    sum[1] += ny;
+                    sum[2] += std::sqrt(std::max(0.0f, 1.0f - nx * nx - ny * ny));
+                }
+            }
+
+            float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+            float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            unsigned char* o = out + (y * dst.width + x) * 2;
+            o[0] = static_cast<unsigned char>(std::clamp((sum[0] * scale * 0.5f + 0.5f) * 255.0f + 0.5f, 0.0f, 255.0f));
+            o[1] = static_cast<unsigned char>(std::clamp((sum[1] * scale * 0.5f + 0.5f) * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+}
+
+}
+
+int MipGenerator::levelCount(int width, int height) {
+    int levels = 1;
+    int size = std::max(width, height);
+    while (size > 1) {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+float MipGenerator::alphaCoverage(const unsigned char* pixels, int width, int height, int rowBytes, float cutoff) {
+    size_t passing = 0;
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = pixels + static_cast<size_t>(y) * rowBytes;
+        for (int x = 0; x < width; x++) {
+            if (row[x * 4 + 3] >= cutoff * 255.0f) {
+                passing++;
+            }
+        }
+    }
+    return static_cast<float>(passing) / (static_cast<size_t>(width) * height);
+}
+
+std::vector<MipLevel> MipGenerator::generateRGBA8(const unsigned char* pixels, int width, int height, int rowBytes,
+                                                  const MipOptions& options) {
+    std::vector<MipLevel> levels;
+    int count = levelCount(width, height);
+    levels.reserve(count - 1);
+
+    float targetCoverage = 0.0f;
+    if (options.alphaCutoff > 0.0f) {
+        targetCoverage = alphaCoverage(pixels, width, height, rowBytes, options.alphaCutoff);
+    }
+
+    // level 1 reads the source directly, later levels the linear copy of the
+    // previous one. the two buffers swap roles every level
+    SourceLevel src;
+    src.srgb = pixels;
+    src.rowBytes = rowBytes;
+    src.width = width;
+    src.height = height;
+    std::vector<uint16_t> srcLinear;
+    std::vector<uint16_t> dstLinear;
+
+    for (int level = 1; level < count; level++) {
+        MipLevel dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+        // the last level isn't read again, skip its linear copy
+        bool last = level == count - 1;
+        dstLinear.resize(last ? 0 : static_cast<size_t>(dst.width) * dst.height * 4);
+        uint16_t* linear = last ? nullptr : dstLinear.data();
+
+        if (options.filter == MipFilter::Kaiser) {
+            kaiserLevel(src, options.parallel, dst, linear);
+        } else {
+            boxLevel(src, options.parallel, dst, linear);
+        }
+
+        if (options.alphaCutoff > 0.0f) {
+            preserveCoverage(dst, options.alphaCutoff, targetCoverage);
+        }
+
+        std::swap(srcLinear, dstLinear);
+        src = SourceLevel();
+        src.linear = srcLinear.data();
+        src.width = dst.width;
+        src.height = dst.height;
+        levels.push_back(std::move(dst));
+    }
+
+    return levels;
+}
+
+std::vector<MipLevel> MipGenerator::generateNormalRG8(const unsigned char* pixels, int width, int height) {
+    std::vector<MipLevel> levels;
+    int count = levelCount(width, height);
+    levels.reserve(count - 1);
+
+    const unsigned char* src = pixels;
+    int srcWidth = width;
+    int srcHeight = height;
+
+    for (int level = 1; level < count; level++) {
+        MipLevel dst;
+        dst.width = std::max(1, srcWidth / 2);
+        dst.height = std::max(1, srcHeight / 2);
+        dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 2);
+
+        parallelRows(dst.height, dst.width, true, [&](int firstRow, int lastRow) {
+            downsampleNormals(src, srcWidth, srcHeight, dst, firstRow, lastRow);
+        });
+        levels.push_back(std::move(dst));
+
+        const MipLevel& last = levels.back();
+        src = last.pixels.data();
+        srcWidth = last.width;
+        srcHeight = last.height;
+    }
+
+    return levels;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+// one level of a mip chain, tightly packed rows
+struct MipLevel {
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+enum class MipFilter {
+    Box,     // average of the source texels each texel covers
+    Kaiser,  // kaiser-windowed sinc, sharper small levels. wraps at the edges like GL_REPEAT
+};
+
+struct MipOptions {
+    MipFilter filter = MipFilter::Box;
+
+    // above 0, alpha is scaled per level so the share of texels passing an alpha
+    // test at this cutoff stays what it is in level 0 (cutout foliage, crumbs)
+    float alphaCutoff = 0.0f;
+
+    // split every level across the mip thread pool by rows
+    bool parallel = true;
+};
+
+// builds full mip chains on the cpu so uploads don't depend on glGenerateMipmap
+class MipGenerator {
+public:
+    // number of levels down to 1x1 for the given size
+    static int levelCount(int width, int height);
+
+    // downsample an rgba8 image (srgb color, linear alpha) into levels 1..n.
+    // level 0 is not copied; the returned vector starts at level 1. filtering
+    // happens in 16-bit linear light, each level is built from the linear
+    // version of the one above rather than its rounded srgb texels
+    static std::vector<MipLevel> generateRGBA8(const unsigned char* pixels, int width, int height, int rowBytes,
+                                               const MipOptions& options = MipOptions());
+
+    // downsample a two-channel normal map (x, y in rg, z implied) into levels 1..n.
+    // vectors are averaged and renormalized rather than filtered per channel
+    static std::vector<MipLevel> generateNormalRG8(const unsigned char* pixels, int width, int height);
+
+    // share of texels whose alpha is at least cutoff (0..1)
+    static float alphaCoverage(const unsigned char* pixels, int width, int height, int rowBytes, float cutoff);
+};
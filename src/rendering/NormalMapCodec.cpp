@@ -0,0 +1,83 @@
+#include "NormalMapCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// one bc4 block: two endpoints and a 3-bit index per texel. red0 > red1 selects
+// the mode with six interpolated values between the endpoints
+void encodeBC4(const unsigned char values[16], unsigned char* out) {
+    unsigned char high = *std::max_element(values, values + 16);
+    unsigned char low = *std::min_element(values, values + 16);
+
+    uint64_t indices = 0;
+    if (high > low) {
+        float scale = 7.0f / (high - low);
+        for (int i = 0; i < 16; i++) {
+            // step 0 is red0, step 7 is red1, the steps between are indices 2..7
+            int step = static_cast<int>((high - values[i]) * scale + 0.5f);
+            uint64_t index = step == 0 ? 0 : step == 7 ? 1 : step + 1;
+            indices |= index << (3 * i);
+        }
+    }
+
+    out[0] = high;
+    out[1] = low;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = static_cast<unsigned char>(indices >> (8 * i));
+    }
+}
+
+}
+
+std::vector<unsigned char> NormalMapCodec::toRG8(const unsigned char* pixels, int width, int height, int rowBytes) {
+    std::vector<unsigned char> rg(static_cast<size_t>(width) * height * 2);
+
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = pixels + y * rowBytes;
+        unsigned char* out = rg.data() + static_cast<size_t>(y) * width * 2;
+        for (int x = 0; x < width; x++) {
+            float nx = row[x * 4] / 127.5f - 1.0f;
+            float ny = row[x * 4 + 1] / 127.5f - 1.0f;
+            float nz = std::max(0.0f, row[x * 4 + 2] / 127.5f - 1.0f);
+
+            // renormalize so the shader's reconstructed z matches the source direction
+            float length = std::sqrt(nx * nx + ny * ny + nz * nz);
+            float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            out[x * 2] = static_cast<unsigned char>(std::clamp((nx * scale * 0.5f + 0.5f) * 255.0f + 0.5f, 0.0f, 255.0f));
+            out[x * 2 + 1] = static_cast<unsigned char>(std::clamp((ny * scale * 0.5f + 0.5f) * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+
+    return rg;
+}
+
+std::vector<unsigned char> NormalMapCodec::compressRGTC2(const unsigned char* pixels, int width, int height) {
+    std::vector<unsigned char> blocks(rgtc2Size(width, height));
+    unsigned char* out = blocks.data();
+
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            // texels past the edge repeat the last row/column
+            unsigned char red[16];
+            unsigned char green[16];
+            for (int i = 0; i < 16; i++) {
+                int x = std::min(bx + i % 4, width - 1);
+                int y = std::min(by + i / 4, height - 1);
+                const unsigned char* texel = pixels + (static_cast<size_t>(y) * width + x) * 2;
+                red[i] = texel[0];
+                green[i] = texel[1];
+            }
+            encodeBC4(red, out);
+            encodeBC4(green, out + 8);
+            out += 16;
+        }
+    }
+
+    return blocks;
+}
+
+size_t NormalMapCodec::rgtc2Size(int width, int height) {
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * 16;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// tangent-space normal maps stored as two channels. x and y go in red/green and
+// the shader rebuilds z = sqrt(1 - x^2 - y^2), which is always positive in
+// tangent space. rg8 halves the memory of rgba8, rgtc2 (bc5) quarters it
+class NormalMapCodec {
+public:
+    // rgba8 normal map (xyz in rgb) -> tightly packed rg8 of the normalized vectors
+    static std::vector<unsigned char> toRG8(const unsigned char* pixels, int width, int height, int rowBytes);
+
+    // rg8 -> GL_COMPRESSED_RG_RGTC2 blocks, one bc4 block per channel per 4x4 texels
+    static std::vector<unsigned char> compressRGTC2(const unsigned char* pixels, int width, int height);
+
+    // size of a compressed level in bytes
+    static size_t rgtc2Size(int width, int height);
+};
@@ -0,0 +1,37 @@
+#include "OffscreenContext.h"
+#include <iostream>
+
+OffscreenContext::~OffscreenContext() {
+    doneCurrent();
+}
+
+bool OffscreenContext::create() {
+    QSurfaceFormat format;
+    format.setVersion(4, 1);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+
+    m_context.setFormat(format);
+    if (!m_context.create()) {
+        std::cerr << "failed to create an offscreen opengl context" << std::endl;
+        return false;
+    }
+
+    // the platform may back this with a pbuffer or nothing at all (surfaceless egl)
+    m_surface.setFormat(m_context.format());
+    m_surface.create();
+    if (!m_surface.isValid() || !m_context.makeCurrent(&m_surface)) {
+        std::cerr << "failed to make the offscreen opengl context current" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void OffscreenContext::makeCurrent() {
+    m_context.makeCurrent(&m_surface);
+}
+
+void OffscreenContext::doneCurrent() {
+    if (QOpenGLContext::currentContext() == &m_context) {
+        m_context.doneCurrent();
+    }
+}
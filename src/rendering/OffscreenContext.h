@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+
+// a gl context without a window, for rendering with no display server. frames
+// go into framebuffer objects, the surface itself is never drawn to
+class OffscreenContext {
+public:
+    ~OffscreenContext();
+
+    // 4.1 core, like the window. returns false if no context could be made current
+    bool create();
+
+    void makeCurrent();
+    void doneCurrent();
+
+private:
+    QOpenGLContext m_context;
+    QOffscreenSurface m_surface;
+};
@@ -0,0 +1,46 @@
+#include "ParallelFor.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+void parallelFor(QThreadPool& pool, int count, const std::function<void(int)>& work) {
+    if (count <= 1) {
+        if (count == 1) {
+            work(0);
+        }
+        return;
+    }
+
+    struct Items {
+        std::atomic<int> next{0};
+        int count = 0;
+        int finished = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<Items>();
+    state->count = count;
+
+    auto run = [state, &work]() {
+        int item;
+        while ((item = state->next++) < state->count) {
+            work(item);
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (++state->finished == state->count) {
+                state->done.notify_all();
+            }
+        }
+    };
+
+    int helpers = std::min(count - 1, pool.maxThreadCount());
+    for (int i = 0; i < helpers; i++) {
+        pool.start(run);
+    }
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->done.wait(lock, [&]() { return state->finished == state->count; });
+}
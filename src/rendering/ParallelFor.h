@@ -0,0 +1,9 @@
+#pragma once
+
+#include <QThreadPool>
+#include <functional>
+
+// run work(i) for every i in [0, count) on pool and return when all are done.
+// the calling thread takes items too, so this can't deadlock when it is itself
+// a worker of another pool, and late helpers simply find nothing left to do
+void parallelFor(QThreadPool& pool, int count, const std::function<void(int)>& work);
@@ -0,0 +1,275 @@
+#include "PerfHud.h"
+#include "utils/shaderloader.h"
+#include <QFontDatabase>
+#include <QPainter>
+#include <QStringList>
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// positions come in pixels from the top left corner of the viewport
+const char* HUD_VERT = R"(#version 330 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 uv;
+
+uniform vec2 viewport;
+
+out vec2 texCoord;
+
+void main() {
+    texCoord = uv;
+    gl_Position = vec4(position.x / viewport.x * 2.0 - 1.0, 1.0 - position.y / viewport.y * 2.0, 0.0, 1.0);
+}
+)";
+
+// premultiplied alpha, the text texture already is
+const char* HUD_FRAG = R"(#version 330 core
+in vec2 texCoord;
+
+uniform vec4 color;
+uniform bool textured;
+uniform sampler2D text;
+
+out vec4 fragColor;
+
+void main() {
+    fragColor = textured ? texture(text, texCoord) : vec4(color.rgb * color.a, color.a);
+}
+)";
+
+// panel, two reference lines, the graph and the text quad
+constexpr int PANEL_FIRST = 0;
+constexpr int LINES_FIRST = 6;
+constexpr int GRAPH_FIRST = 10;
+constexpr int MAX_VERTICES = GRAPH_FIRST + FrameTimes::DEFAULT_CAPACITY + 6;
+
+double megabytes(int64_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+}
+
+PerfHud::~PerfHud() {
+    cleanup();
+}
+
+bool PerfHud::initialize() {
+    try {
+        GLuint program = ShaderLoader::beginShaderProgramFromSource(HUD_VERT, HUD_FRAG);
+        ShaderLoader::finishShaderProgram(program);
+        m_program = program;
+    } catch (const std::exception& e) {
+        std::cerr << "Hud shader failed: " << e.what() << std::endl;
+        return false;
+    }
+
+    m_viewportLocation = glGetUniformLocation(m_program, "viewport");
+    m_colorLocation = glGetUniformLocation(m_program, "color");
+    m_texturedLocation = glGetUniformLocation(m_program, "textured");
+    glUseProgram(m_program);
+    glUniform1i(glGetUniformLocation(m_program, "text"), 0);
+    glUseProgram(0);
+
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, MAX_VERTICES * sizeof(Vertex), nullptr, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(0));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(2 * sizeof(float)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glGenTextures(1, &m_textTexture);
+    glBindTexture(GL_TEXTURE_2D, m_textTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_vertices.reserve(MAX_VERTICES);
+    return true;
+}
+
+void PerfHud::addFrame(float frameMs, float cpuMs) {
+    m_frameTimes.add(frameMs);
+    m_cpuTimes.add(cpuMs);
+}
+
+void PerfHud::updateText(float scale) {
+    int width = static_cast<int>(PANEL_WIDTH * scale);
+    int height = static_cast<int>(TEXT_HEIGHT * scale);
+    bool resized = m_text.width() != width || m_text.height() != height;
+    if (resized) {
+        m_text = QImage(width, height, QImage::Format_RGBA8888_Premultiplied);
+    }
+    m_textScale = scale;
+
+    float p50 = m_frameTimes.percentile(50.0f);
+    QStringList lines;
+    lines << QString::asprintf("frame %6.2f ms   %4.0f fps", m_frameTimes.latest(), p50 > 0.0f ? 1000.0f / p50 : 0.0f);
+    lines << QString::asprintf("p50 %.2f  p95 %.2f  p99 %.2f", p50, m_frameTimes.percentile(95.0f),
+                               m_frameTimes.percentile(99.0f));
+    lines << QString::asprintf("cpu %6.2f ms   p99 %.2f", m_cpuTimes.percentile(50.0f), m_cpuTimes.percentile(99.0f));
+    lines << QString::asprintf("draws %lld   tris %lld",
+                               static_cast<long long>(RenderStats::lastFrame(RenderStats::DrawCalls)),
+                               static_cast<long long>(RenderStats::lastFrame(RenderStats::Triangles)));
+    lines << QString::asprintf("instances %lld of %lld",
+                               static_cast<long long>(RenderStats::lastFrame(RenderStats::Instances)),
+                               static_cast<long long>(RenderStats::get(RenderStats::InstanceCount)));
+    lines << QString::asprintf("state changes %lld   uniforms %lld",
+                               static_cast<long long>(RenderStats::lastFrame(RenderStats::StateChanges)),
+                               static_cast<long long>(RenderStats::lastFrame(RenderStats::UniformUploads)));
+
+    QString textures = QString::asprintf("textures %lld   %.1f MB",
+                                         static_cast<long long>(RenderStats::get(RenderStats::Textures)),
+                                         megabytes(RenderStats::get(RenderStats::TextureBytes)));
+    if (RenderStats::get(RenderStats::TextureBudgetBytes) > 0) {
+        textures += QString::asprintf(" / %.0f MB", megabytes(RenderStats::get(RenderStats::TextureBudgetBytes)));
+    }
+    if (RenderStats::get(RenderStats::TexturesReduced) > 0) {
+        textures += QString::asprintf(" (%lld reduced)",
+                                      static_cast<long long>(RenderStats::get(RenderStats::TexturesReduced)));
+    }
+    lines << textures;
+    lines << QString::asprintf("shapes %lld drawn   %lld skipped",
+                               static_cast<long long>(RenderStats::lastFrame(RenderStats::ShapesDrawn)),
+                               static_cast<long long>(RenderStats::lastFrame(RenderStats::ShapesSkipped)));
+    lines << QString::asprintf("lights %lld", static_cast<long long>(RenderStats::get(RenderStats::Lights)));
+
+    m_text.fill(Qt::transparent);
+    QPainter painter(&m_text);
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    font.setPixelSize(std::max(1, static_cast<int>(11.0f * scale)));
+    painter.setFont(font);
+    painter.setPen(QColor(235, 235, 235));
+    float lineHeight = 15.0f * scale;
+    for (int i = 0; i < lines.size(); i++) {
+        painter.drawText(QPointF(6.0f * scale, (6.0f + 11.0f) * scale + i * lineHeight), lines[i]);
+    }
+    painter.end();
+
+    // rows are width * 4 bytes, already aligned
+    glBindTexture(GL_TEXTURE_2D, m_textTexture);
+    if (resized) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, m_text.constBits());
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, m_text.constBits());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void PerfHud::draw(int width, int height, float scale) {
+    if (m_program == 0 || width <= 0 || height <= 0) {
+        return;
+    }
+
+    // the counters only move a few times a second as far as anyone can read them
+    if (!m_textTimer.isValid() || m_textTimer.elapsed() >= TEXT_REFRESH_MS || scale != m_textScale) {
+        updateText(scale);
+        m_textTimer.restart();
+    }
+
+    float left = MARGIN * scale;
+    float right = left + PANEL_WIDTH * scale;
+    float top = MARGIN * scale;
+    float graphTop = top + TEXT_HEIGHT * scale;
+    float graphBottom = graphTop + GRAPH_HEIGHT * scale;
+
+    m_vertices.clear();
+    auto quad = [&](float x0, float y0, float x1, float y1) {
+        m_vertices.push_back({x0, y0, 0.0f, 0.0f});
+        m_vertices.push_back({x1, y0, 1.0f, 0.0f});
+        m_vertices.push_back({x1, y1, 1.0f, 1.0f});
+        m_vertices.push_back({x0, y0, 0.0f, 0.0f});
+        m_vertices.push_back({x1, y1, 1.0f, 1.0f});
+        m_vertices.push_back({x0, y1, 0.0f, 1.0f});
+    };
+
+    quad(left, top, right, graphBottom);
+
+    // 60 and 30 fps, the graph grows past 30 fps to fit spikes
+    float graphMs = std::max(1000.0f / 30.0f, m_frameTimes.max());
+    auto graphY = [&](float ms) {
+        return graphBottom - std::min(ms / graphMs, 1.0f) * (graphBottom - graphTop);
+    };
+    for (float ms : {1000.0f / 60.0f, 1000.0f / 30.0f}) {
+        m_vertices.push_back({left, graphY(ms), 0.0f, 0.0f});
+        m_vertices.push_back({right, graphY(ms), 0.0f, 0.0f});
+    }
+
+    // newest sample on the right edge
+    int samples = m_frameTimes.size();
+    int capacity = m_frameTimes.capacity();
+    float step = (right - left) / (capacity - 1);
+    for (int i = 0; i < samples; i++) {
+        float x = left + (capacity - samples + i) * step;
+        m_vertices.push_back({x, graphY(m_frameTimes.at(i)), 0.0f, 0.0f});
+    }
+
+    int textFirst = static_cast<int>(m_vertices.size());
+    quad(left, top, right, graphTop);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_vertices.size() * sizeof(Vertex), m_vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glViewport(0, 0, width, height);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    glUseProgram(m_program);
+    glUniform2f(m_viewportLocation, static_cast<float>(width), static_cast<float>(height));
+    glUniform1i(m_texturedLocation, 0);
+    glBindVertexArray(m_vao);
+
+    glUniform4f(m_colorLocation, 0.0f, 0.0f, 0.0f, 0.6f);
+    glDrawArrays(GL_TRIANGLES, PANEL_FIRST, 6);
+
+    glUniform4f(m_colorLocation, 1.0f, 1.0f, 1.0f, 0.25f);
+    glDrawArrays(GL_LINES, LINES_FIRST, 4);
+
+    if (samples > 1) {
+        glUniform4f(m_colorLocation, 0.35f, 1.0f, 0.45f, 1.0f);
+        glDrawArrays(GL_LINE_STRIP, GRAPH_FIRST, samples);
+    }
+
+    glUniform1i(m_texturedLocation, 1);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_textTexture);
+    glDrawArrays(GL_TRIANGLES, textFirst, 6);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDisable(GL_BLEND);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void PerfHud::cleanup() {
+    if (m_textTexture != 0) {
+        glDeleteTextures(1, &m_textTexture);
+        m_textTexture = 0;
+    }
+    if (m_vbo != 0) {
+        glDeleteBuffers(1, &m_vbo);
+        m_vbo = 0;
+    }
+    if (m_vao != 0) {
+        glDeleteVertexArrays(1, &m_vao);
+        m_vao = 0;
+    }
+    if (m_program != 0) {
+        glDeleteProgram(m_program);
+        m_program = 0;
+    }
+    m_text = QImage();
+    m_textScale = 0.0f;
+}
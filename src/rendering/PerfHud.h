@@ -0,0 +1,63 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <QElapsedTimer>
+#include <QImage>
+#include <vector>
+
+#include "rendering/RenderStats.h"
+
+// frame-time graph and the renderer's counters drawn over the viewport. the
+// text is painted into a texture a few times a second; every other frame
+// only the graph's few kilobytes of vertices are updated and the panel is a
+// handful of small draws, so the overlay stays far below a tenth of a
+// millisecond. draws with its own program and buffers, none of the managers
+class PerfHud {
+public:
+    ~PerfHud();
+
+    // needs a current context. false (after printing why) if the shader doesn't build
+    bool initialize();
+    bool isInitialized() const { return m_program != 0; }
+
+    // time since the previous frame, and how long issuing this one took on the cpu
+    void addFrame(float frameMs, float cpuMs);
+
+    // over whatever the bound framebuffer holds, width x height pixels. scale
+    // is the device pixel ratio. restores the state the renderer expects
+    void draw(int width, int height, float scale);
+
+    const FrameTimes& frameTimes() const { return m_frameTimes; }
+
+    void cleanup();
+
+private:
+    static constexpr int PANEL_WIDTH = 260;  // in device independent pixels
+    static constexpr int TEXT_HEIGHT = 148;
+    static constexpr int GRAPH_HEIGHT = 64;
+    static constexpr int MARGIN = 8;
+    static constexpr int TEXT_REFRESH_MS = 250;
+
+    struct Vertex {
+        float x, y;  // pixels from the top left
+        float u, v;
+    };
+
+    void updateText(float scale);
+
+    GLuint m_program = 0;
+    GLint m_viewportLocation = -1;
+    GLint m_colorLocation = -1;
+    GLint m_texturedLocation = -1;
+    GLuint m_vao = 0;
+    GLuint m_vbo = 0;
+    GLuint m_textTexture = 0;
+
+    QImage m_text;
+    QElapsedTimer m_textTimer;
+    float m_textScale = 0.0f;
+    std::vector<Vertex> m_vertices;
+
+    FrameTimes m_frameTimes;
+    FrameTimes m_cpuTimes;
+};
@@ -0,0 +1,342 @@
+#include "RenderCoordinator.h"
+#include "ImageEncoder.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+namespace {
+
+// how long a worker gets to create its context and compile its shaders
+constexpr int WORKER_START_TIMEOUT_MS = 120000;
+
+// below this, tiles cost more in per-request overhead than they win in balance
+constexpr int MIN_TILE_SIZE = 64;
+
+void send(QProcess* process, const QJsonObject& request) {
+    process->write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+}
+
+}
+
+RenderCoordinator::RenderCoordinator(int workerCount, const QStringList& arguments)
+    : m_workers(static_cast<size_t>(std::max(1, workerCount))), m_arguments(arguments) {}
+
+RenderCoordinator::~RenderCoordinator() {
+    stop();
+}
+
+bool RenderCoordinator::start() {
+    QStringList arguments = m_arguments;
+    arguments << "--serve" << "-";
+    for (Worker& worker : m_workers) {
+        // the workers' logs go straight to ours
+        worker.process = new QProcess();
+        worker.process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        worker.process->start(QCoreApplication::applicationFilePath(), arguments);
+    }
+
+    // a ping comes back once the worker's context and shaders are ready
+    bool started = true;
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        Worker& worker = m_workers[i];
+        if (!worker.process->waitForStarted(WORKER_START_TIMEOUT_MS)) {
+            std::cerr << "failed to start render worker " << i + 1 << ": "
+                      << worker.process->errorString().toStdString() << std::endl;
+            started = false;
+            continue;
+        }
+        QJsonObject ping;
+        ping["command"] = "ping";
+        send(worker.process, ping);
+    }
+    for (size_t i = 0; started && i < m_workers.size(); i++) {
+        Worker& worker = m_workers[i];
+        while (!worker.buffer.contains('\n') && worker.process->waitForReadyRead(WORKER_START_TIMEOUT_MS)) {
+            worker.buffer.append(worker.process->readAllStandardOutput());
+        }
+        qsizetype end = worker.buffer.indexOf('\n');
+        if (end < 0 || !QJsonDocument::fromJson(worker.buffer.left(end)).object()["ok"].toBool()) {
+            std::cerr << "render worker " << i + 1 << " didn't come up" << std::endl;
+            started = false;
+            continue;
+        }
+        worker.buffer.remove(0, end + 1);
+        worker.alive = true;
+    }
+
+    if (!started) {
+        stop();
+    }
+    return started;
+}
+
+void RenderCoordinator::stop() {
+    for (Worker& worker : m_workers) {
+        if (worker.process == nullptr) {
+            continue;
+        }
+        if (worker.process->state() != QProcess::NotRunning) {
+            QJsonObject shutdown;
+            shutdown["command"] = "shutdown";
+            send(worker.process, shutdown);
+            worker.process->closeWriteChannel();
+            if (!worker.process->waitForFinished(WORKER_START_TIMEOUT_MS)) {
+                worker.process->kill();
+                worker.process->waitForFinished();
+            }
+        }
+        delete worker.process;
+        worker.process = nullptr;
+        worker.alive = false;
+        worker.inFlight.clear();
+        worker.buffer.clear();
+    }
+}
+
+void RenderCoordinator::run(std::vector<Task>& tasks) {
+    QEventLoop loop;
+    size_t next = 0;
+    size_t answered = 0;
+
+    auto finishTask = [&](int id, const QJsonObject& reply) {
+        tasks[static_cast<size_t>(id)].done(reply);
+        answered++;
+    };
+
+    // a request id is the task's index
+    auto dispatch = [&]() {
+        bool anyAlive = false;
+        for (Worker& worker : m_workers) {
+            anyAlive = anyAlive || worker.alive;
+            while (worker.alive && next < tasks.size() && static_cast<int>(worker.inFlight.size()) < REQUESTS_PER_WORKER) {
+                QJsonObject request = tasks[next].request;
+                request["id"] = static_cast<int>(next);
+                send(worker.process, request);
+                worker.inFlight.insert(static_cast<int>(next));
+                next++;
+            }
+        }
+        if (!anyAlive) {
+            // nobody left to draw the rest
+            QJsonObject failed;
+            failed["ok"] = false;
+            failed["error"] = "no render workers left";
+            while (next < tasks.size()) {
+                finishTask(static_cast<int>(next++), failed);
+            }
+        }
+        if (answered == tasks.size()) {
+            loop.quit();
+        }
+    };
+
+    std::vector<QMetaObject::Connection> connections;
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        Worker& worker = m_workers[i];
+        connections.push_back(QObject::connect(worker.process, &QProcess::readyReadStandardOutput, [&, i]() {
+            Worker& source = m_workers[i];
+            source.buffer.append(source.process->readAllStandardOutput());
+            qsizetype end = source.buffer.indexOf('\n');
+            while (end >= 0) {
+                QJsonObject reply = QJsonDocument::fromJson(source.buffer.left(end)).object();
+                source.buffer.remove(0, end + 1);
+                end = source.buffer.indexOf('\n');
+
+                int id = reply["id"].toInt(-1);
+                if (source.inFlight.erase(id) > 0) {
+                    finishTask(id, reply);
+                }
+            }
+            dispatch();
+        }));
+        connections.push_back(QObject::connect(worker.process, &QProcess::finished, [&, i]() {
+            Worker& source = m_workers[i];
+            std::cerr << "render worker " << i + 1 << " exited" << std::endl;
+            source.alive = false;
+            QJsonObject failed;
+            failed["ok"] = false;
+            failed["error"] = "render worker exited";
+            for (int id : source.inFlight) {
+                finishTask(id, failed);
+            }
+            source.inFlight.clear();
+            dispatch();
+        }));
+    }
+
+    dispatch();
+    if (answered < tasks.size()) {
+        loop.exec();
+    }
+    for (const QMetaObject::Connection& connection : connections) {
+        QObject::disconnect(connection);
+    }
+}
+
+int RenderCoordinator::renderJobs(const std::vector<BatchRenderer::Job>& jobs) {
+    QElapsedTimer timer;
+    timer.start();
+
+    int failed = 0;
+    std::vector<Task> tasks;
+    for (const BatchRenderer::Job& job : jobs) {
+        Task task;
+        task.request = BatchRenderer::toJson(job);
+        task.done = [&failed, &job](const QJsonObject& reply) {
+            if (!reply["ok"].toBool()) {
+                std::cerr << job.output << ": " << reply["error"].toString().toStdString() << std::endl;
+                failed++;
+            }
+        };
+        tasks.push_back(task);
+    }
+    run(tasks);
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    int rendered = static_cast<int>(jobs.size()) - failed;
+    std::cout << std::fixed << std::setprecision(1)
+              << "distributed: " << rendered << "/" << jobs.size() << " images on " << workerCount()
+              << " workers in " << seconds * 1000.0 << " ms (" << (seconds > 0.0 ? rendered / seconds : 0.0)
+              << " images/s)" << std::endl;
+    return failed;
+}
+
+bool RenderCoordinator::renderTiled(const BatchRenderer::Job& job, int tileSize) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // a few tiles per worker so a slow corner of the image doesn't hold one up.
+    // even sizes keep derivative quads lined up across tile edges
+    double share = std::sqrt(static_cast<double>(job.width) * job.height / (workerCount() * 4));
+    int tile = std::min(tileSize, std::max(MIN_TILE_SIZE, static_cast<int>(std::ceil(share))));
+    tile = std::max(2, (tile + 1) & ~1);
+    int columns = (job.width + tile - 1) / tile;
+    int rows = (job.height + tile - 1) / tile;
+
+    // tiles come back as raw rgb files in a scratch directory, usually in the
+    // page cache, and a strip is assembled once its whole row is in
+    QTemporaryDir scratch;
+    ImageStreamWriter writer;
+    if (!scratch.isValid() || !writer.open(job.output, job.width, job.height)) {
+        return false;
+    }
+
+    std::vector<int> tilesDone(static_cast<size_t>(rows), 0);
+    std::vector<unsigned char> strip;
+    int rowsWritten = 0;
+    bool failed = false;
+
+    auto tilePath = [&](int column, int row) {
+        return scratch.filePath(QString("tile_%1_%2.raw").arg(row).arg(column));
+    };
+    auto writeRows = [&]() {
+        while (!failed && rowsWritten < rows && tilesDone[static_cast<size_t>(rowsWritten)] == columns) {
+            int row = rowsWritten;
+            int height = std::min(tile, job.height - row * tile);
+            strip.assign(static_cast<size_t>(job.width) * height * 4, 255);
+            for (int column = 0; column < columns && !failed; column++) {
+                int width = std::min(tile, job.width - column * tile);
+                QFile file(tilePath(column, row));
+                QByteArray rgb = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+                if (rgb.size() != static_cast<qsizetype>(width) * height * 3) {
+                    std::cerr << "render worker left a bad tile " << column << ", " << row << std::endl;
+                    failed = true;
+                    break;
+                }
+                for (int y = 0; y < height; y++) {
+                    const unsigned char* source = reinterpret_cast<const unsigned char*>(rgb.constData()) +
+                                                  static_cast<size_t>(y) * width * 3;
+                    unsigned char* destination =
+                        strip.data() + (static_cast<size_t>(y) * job.width + static_cast<size_t>(column) * tile) * 4;
+                    for (int x = 0; x < width; x++) {
+                        std::copy_n(source + x * 3, 3, destination + x * 4);
+                    }
+                }
+                file.remove();
+            }
+            failed = failed || !writer.writeRows(strip.data(), height, job.width * 4);
+            rowsWritten++;
+        }
+    };
+
+    // row by row, so the strips at the top are complete first
+    std::vector<Task> tasks;
+    QJsonObject request = BatchRenderer::toJson(job);
+    if (job.instanceSeed == 0) {
+        // every worker has to lay the instances out the same way
+        request["instance-seed"] = static_cast<int>(std::random_device()() & 0x7fffffff) | 1;
+    }
+    for (int row = 0; row < rows; row++) {
+        for (int column = 0; column < columns; column++) {
+            Task task;
+            task.request = request;
+            task.request["output"] = tilePath(column, row);
+            task.request["region"] = QJsonArray{column * tile, row * tile, std::min(tile, job.width - column * tile),
+                                                std::min(tile, job.height - row * tile)};
+            task.done = [&, row](const QJsonObject& reply) {
+                if (!reply["ok"].toBool()) {
+                    std::cerr << "tile of row " << row << ": " << reply["error"].toString().toStdString() << std::endl;
+                    failed = true;
+                    return;
+                }
+                tilesDone[static_cast<size_t>(row)]++;
+                writeRows();
+            };
+            tasks.push_back(task);
+        }
+    }
+    run(tasks);
+
+    // a failed image is never closed, so nothing is left at the output path
+    bool written = !failed && rowsWritten == rows && writer.close();
+    double seconds = timer.nsecsElapsed() / 1e9;
+    std::cout << std::fixed << std::setprecision(1)
+              << "distributed: " << job.output << ", " << job.width << "x" << job.height << " in "
+              << columns * rows << " tiles of " << tile << " on " << workerCount() << " workers in "
+              << seconds * 1000.0 << " ms" << (written ? "" : " (failed)") << std::endl;
+    return written;
+}
+
+bool RenderCoordinator::benchmarkScaling(int maxWorkers, const QStringList& arguments,
+                                         const std::function<bool(RenderCoordinator&)>& work) {
+    std::vector<int> counts;
+    for (int count = 1; count < maxWorkers; count *= 2) {
+        counts.push_back(count);
+    }
+    counts.push_back(std::max(1, maxWorkers));
+
+    std::vector<double> times;
+    for (int count : counts) {
+        RenderCoordinator coordinator(count, arguments);
+        if (!coordinator.start()) {
+            return false;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        bool succeeded = work(coordinator);
+        times.push_back(timer.nsecsElapsed() / 1e6);
+        coordinator.stop();
+        if (!succeeded) {
+            return false;
+        }
+    }
+
+    std::cout << "workers        ms   speedup   efficiency" << std::endl;
+    for (size_t i = 0; i < counts.size(); i++) {
+        double speedup = times[i] > 0.0 ? times[0] / times[i] : 0.0;
+        std::cout << std::fixed << std::setprecision(1) << std::setw(7) << counts[i] << std::setw(10) << times[i]
+                  << std::setprecision(2) << std::setw(10) << speedup << std::setw(12) << speedup / counts[i]
+                  << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QStringList>
+#include <functional>
+#include <set>
+#include <vector>
+
+#include "rendering/BatchRenderer.h"
+
+class QProcess;
+
+// spreads rendering over worker processes. every worker is this executable
+// running as a render server on its stdin and stdout (--serve -), with its own
+// offscreen context, so under a software gl driver, where one context keeps
+// about one core busy, N workers keep N cores busy. jobs go to whichever
+// worker is free, and a large still is cut into tiles that are drawn as
+// regions of the full frame and put back together strip by strip
+class RenderCoordinator {
+public:
+    // arguments go to every worker in front of --serve -, so workers render
+    // with the coordinator's command line settings
+    RenderCoordinator(int workerCount, const QStringList& arguments);
+    ~RenderCoordinator();
+
+    // start the workers and wait until each one has its context and shaders.
+    // false (after printing why) if any of them doesn't come up
+    bool start();
+
+    // render every job, returns the number that failed
+    int renderJobs(const std::vector<BatchRenderer::Job>& jobs);
+
+    // render job as tiles of at most tileSize (smaller if that gives the workers
+    // too few to share) and stream them into job.output, which has to be png,
+    // qoi, ppm or raw. false if the image couldn't be written
+    bool renderTiled(const BatchRenderer::Job& job, int tileSize);
+
+    // ask the workers to finish and wait for them to exit
+    void stop();
+
+    int workerCount() const { return static_cast<int>(m_workers.size()); }
+
+    // time work (renderJobs or renderTiled) on 1, 2, 4, ... up to maxWorkers
+    // workers and print how it scales. startup isn't counted. returns false if
+    // a run failed
+    static bool benchmarkScaling(int maxWorkers, const QStringList& arguments,
+                                 const std::function<bool(RenderCoordinator&)>& work);
+
+private:
+    // requests each worker has at once, so it never waits for the next one
+    static constexpr int REQUESTS_PER_WORKER = 2;
+
+    struct Worker {
+        QProcess* process = nullptr;
+        QByteArray buffer;       // stdout up to the next complete line
+        std::set<int> inFlight;  // request ids sent and not answered
+        bool alive = false;
+    };
+
+    struct Task {
+        QJsonObject request;
+        std::function<void(const QJsonObject& reply)> done;
+    };
+
+    // send the tasks to free workers and hand every reply to its task, in an
+    // event loop until all are answered. a worker that exits fails what it had
+    void run(std::vector<Task>& tasks);
+
+    std::vector<Worker> m_workers;
+    QStringList m_arguments;
+};
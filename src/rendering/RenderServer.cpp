@@ -0,0 +1,362 @@
+#include "RenderServer.h"
+#include "BatchRenderer.h"
+#include "ImageEncoder.h"
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QSocketNotifier>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+RenderServer::RenderServer() {
+    m_pollTimer.setInterval(1);
+    connect(&m_pollTimer, &QTimer::timeout, this, [this]() {
+        m_capture.poll();
+        if (!m_capture.hasPendingReadbacks()) {
+            m_pollTimer.stop();
+        }
+    });
+}
+
+RenderServer::~RenderServer() {
+    if (m_started) {
+        m_capture.cleanup();
+        m_renderer.cleanup();
+    }
+    if (m_coutBuffer != nullptr) {
+        std::cout.rdbuf(m_coutBuffer);
+    }
+}
+
+bool RenderServer::start(const std::string& address) {
+    bool useStdin = address == "-";
+#ifndef Q_OS_UNIX
+    if (useStdin) {
+        std::cerr << "serving on stdin needs a unix platform, use a socket name" << std::endl;
+        return false;
+    }
+#endif
+    if (useStdin) {
+        // stdout carries the replies, everything the renderer prints goes to stderr
+        m_coutBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    }
+
+    if (!m_context.create()) {
+        return false;
+    }
+    m_base = settings;
+    m_started = true;
+    if (!m_renderer.initialize()) {
+        return false;
+    }
+
+    if (useStdin) {
+#ifdef Q_OS_UNIX
+        m_stdinNotifier = new QSocketNotifier(STDIN_FILENO, QSocketNotifier::Read, this);
+        connect(m_stdinNotifier, &QSocketNotifier::activated, this, [this]() { readStdin(); });
+#endif
+        std::cerr << "render server reading requests from stdin" << std::endl;
+        return true;
+    }
+
+    // a socket file left behind by a server that crashed would block the name
+    m_server = new QLocalServer(this);
+    QString name = QString::fromStdString(address);
+    QLocalServer::removeServer(name);
+    if (!m_server->listen(name)) {
+        std::cerr << "failed to listen on " << address << ": " << m_server->errorString().toStdString() << std::endl;
+        return false;
+    }
+    connect(m_server, &QLocalServer::newConnection, this, [this]() { acceptConnection(); });
+    std::cout << "render server listening on " << m_server->fullServerName().toStdString() << std::endl;
+    return true;
+}
+
+void RenderServer::acceptConnection() {
+    while (QLocalSocket* socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+
+        // replies can come back after the client went away, they are dropped then
+        QPointer<QLocalSocket> client(socket);
+        Reply reply = [client](const QJsonObject& object) {
+            if (client) {
+                client->write(QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n');
+                client->flush();
+            }
+        };
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket, reply]() {
+            while (socket->canReadLine()) {
+                receive(socket->readLine(), reply);
+            }
+        });
+    }
+}
+
+void RenderServer::readStdin() {
+#ifdef Q_OS_UNIX
+    char chunk[65536];
+    ssize_t count = ::read(STDIN_FILENO, chunk, sizeof(chunk));
+    Reply reply = [](const QJsonObject& object) {
+        QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+        std::fwrite(line.constData(), 1, static_cast<size_t>(line.size()), stdout);
+        std::fflush(stdout);
+    };
+    if (count <= 0) {
+        // the other end closed the pipe, finish what it asked for and stop
+        m_stdinNotifier->setEnabled(false);
+        if (!m_stopping) {
+            receive(QByteArray("{\"command\": \"shutdown\"}"), [](const QJsonObject&) {});
+        }
+        return;
+    }
+
+    m_stdinBuffer.append(chunk, static_cast<int>(count));
+    qsizetype end = m_stdinBuffer.indexOf('\n');
+    while (end >= 0) {
+        receive(m_stdinBuffer.left(end), reply);
+        m_stdinBuffer.remove(0, end + 1);
+        end = m_stdinBuffer.indexOf('\n');
+    }
+#endif
+}
+
+void RenderServer::receive(const QByteArray& line, const Reply& reply) {
+    if (line.trimmed().isEmpty()) {
+        return;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(line, &error);
+    if (document.isNull() || !document.isObject()) {
+        QJsonObject object;
+        object["ok"] = false;
+        object["error"] = "failed to parse request: " + error.errorString();
+        reply(object);
+        return;
+    }
+    if (m_stopping) {
+        QJsonObject object;
+        object["id"] = document.object()["id"];
+        object["ok"] = false;
+        object["error"] = "the server is shutting down";
+        reply(object);
+        return;
+    }
+
+    Request request;
+    request.object = document.object();
+    request.reply = reply;
+    request.received.start();
+    if (request.object["command"].toString() == "shutdown") {
+        m_stopping = true;
+    }
+    m_queue.push_back(request);
+
+    // one request per turn of the event loop, so new clients and input are
+    // still picked up while a long queue renders
+    if (!m_processScheduled) {
+        m_processScheduled = true;
+        QTimer::singleShot(0, this, [this]() { processNext(); });
+    }
+}
+
+void RenderServer::processNext() {
+    m_processScheduled = false;
+    if (m_queue.empty()) {
+        return;
+    }
+    Request request = m_queue.front();
+    m_queue.pop_front();
+
+    if (request.object.contains("command")) {
+        QString command = request.object["command"].toString();
+        if (command == "shutdown") {
+            shutdown(request);
+            return;
+        }
+        // ping answers once everything before it has been drawn
+        QJsonObject object;
+        object["id"] = request.object["id"];
+        object["ok"] = command == "ping";
+        if (command != "ping") {
+            object["error"] = "unknown command " + command;
+        }
+        request.reply(object);
+    } else {
+        render(request);
+    }
+
+    m_capture.poll();
+    if (!m_queue.empty()) {
+        m_processScheduled = true;
+        QTimer::singleShot(0, this, [this]() { processNext(); });
+    } else if (m_capture.hasPendingReadbacks()) {
+        m_pollTimer.start();
+    }
+}
+
+void RenderServer::render(const Request& request) {
+    QJsonObject base;
+    base["id"] = request.object["id"];
+    auto fail = [&](const QString& message) {
+        QJsonObject object = base;
+        object["ok"] = false;
+        object["error"] = message;
+        request.reply(object);
+    };
+
+    BatchRenderer::Job job = BatchRenderer::parseJob(request.object);
+    if (job.scene.empty()) {
+        job.scene = m_base.sceneFilePath;
+    }
+
+    // "region": [x, y, width, height] draws just that part of the frame
+    QJsonArray region = request.object["region"].toArray();
+    bool partial = request.object.contains("region");
+    if (partial && region.size() != 4) {
+        fail("region needs [x, y, width, height]");
+        return;
+    }
+    int regionX = partial ? region[0].toInt() : 0;
+    int regionY = partial ? region[1].toInt() : 0;
+    int regionWidth = partial ? region[2].toInt() : job.width;
+    int regionHeight = partial ? region[3].toInt() : job.height;
+
+    // without an output path the image travels back in the reply
+    ImageFormat format = ImageFormat::Png;
+    if (job.output.empty()) {
+        QString name = request.object["format"].toString("png");
+        format = ImageEncoder::formatForPath("image." + name.toStdString());
+        if (format == ImageFormat::Other) {
+            fail("unsupported format " + name + ", use png, qoi, ppm or raw");
+            return;
+        }
+    }
+
+    double queuedMs = request.received.nsecsElapsed() / 1e6;
+    QElapsedTimer timer;
+    timer.start();
+    bool reused = job.scene == m_loadedScene;
+    if (!BatchRenderer::prepare(m_renderer, job, m_base, m_loadedScene)) {
+        settings = m_base;
+        fail("failed to load " + QString::fromStdString(job.scene));
+        return;
+    }
+    double sceneMs = timer.nsecsElapsed() / 1e6;
+
+    // the request's settings may change the tile size. a region is drawn in one piece
+    bool tiled = !partial && (job.width > settings.captureTileSize || job.height > settings.captureTileSize);
+    if (tiled && job.output.empty()) {
+        settings = m_base;
+        fail("images larger than the tile size need an output path");
+        return;
+    }
+
+    base["ok"] = true;
+    base["width"] = regionWidth;
+    base["height"] = regionHeight;
+    if (partial) {
+        base["region"] = region;
+    }
+    base["scene-reused"] = reused;
+    if (job.output.empty()) {
+        base["format"] = request.object["format"].toString("png");
+    } else {
+        base["output"] = QString::fromStdString(job.output);
+    }
+    QJsonObject timing;
+    timing["queued-ms"] = queuedMs;
+    timing["scene-ms"] = sceneMs;
+
+    if (tiled) {
+        // drawn and written before this returns, there is nothing left to wait for
+        bool saved = m_renderer.captureTiled(job.width, job.height, settings.captureTileSize, job.output);
+        settings = m_base;
+        if (!saved) {
+            fail("failed to save " + QString::fromStdString(job.output));
+            return;
+        }
+        timing["render-ms"] = timer.nsecsElapsed() / 1e6 - sceneMs;
+        timing["encode-ms"] = 0.0;
+        timing["total-ms"] = request.received.nsecsElapsed() / 1e6;
+        base["timing"] = timing;
+        request.reply(base);
+        return;
+    }
+
+    // the reply is finished on an encode thread once the image is saved. the
+    // render time is filled in before the readback can complete
+    auto renderMs = std::make_shared<double>(0.0);
+    QElapsedTimer received = request.received;
+    Reply reply = request.reply;
+    std::string output = job.output;
+    FrameCapture::Output done = [this, base, timing, received, reply, output, format, renderMs](
+                                    const std::vector<unsigned char>& pixels, int width, int height) mutable {
+        QElapsedTimer encodeTimer;
+        encodeTimer.start();
+        bool saved = false;
+        if (!pixels.empty() && output.empty()) {
+            std::vector<unsigned char> bytes;
+            saved = ImageEncoder::encode(pixels.data(), width, height, width * 4, format, bytes);
+            QByteArray encoded(reinterpret_cast<const char*>(bytes.data()), static_cast<int>(bytes.size()));
+            base["image"] = QString::fromLatin1(encoded.toBase64());
+        } else if (!pixels.empty()) {
+            saved = ImageEncoder::save(pixels.data(), width, height, width * 4, output);
+        }
+        if (!saved) {
+            QJsonObject object;
+            object["id"] = base["id"];
+            object["ok"] = false;
+            object["error"] = output.empty() ? QString("failed to encode the image")
+                                             : "failed to save " + QString::fromStdString(output);
+            post(reply, object);
+            return false;
+        }
+        timing["render-ms"] = *renderMs;
+        timing["encode-ms"] = encodeTimer.nsecsElapsed() / 1e6;
+        timing["total-ms"] = received.nsecsElapsed() / 1e6;
+        base["timing"] = timing;
+        post(reply, base);
+        return true;
+    };
+
+    bool queued = partial ? m_renderer.captureRegion(job.width, job.height, regionX, regionY, regionWidth, regionHeight,
+                                                     m_capture, std::move(done))
+                          : m_renderer.captureImage(job.width, job.height, m_capture, std::move(done));
+    *renderMs = timer.nsecsElapsed() / 1e6 - sceneMs;
+    settings = m_base;
+    if (!queued) {
+        fail("failed to render");
+    }
+}
+
+void RenderServer::shutdown(const Request& request) {
+    // once the captures are finished every earlier reply has been posted, so
+    // they go out ahead of this one and of the quit
+    m_pollTimer.stop();
+    m_capture.cleanup();
+    m_renderer.cleanup();
+    m_started = false;
+    if (m_server != nullptr) {
+        m_server->close();
+    }
+
+    QJsonObject object;
+    object["id"] = request.object["id"];
+    object["ok"] = true;
+    post(request.reply, object);
+    QMetaObject::invokeMethod(QCoreApplication::instance(), []() { QCoreApplication::quit(); }, Qt::QueuedConnection);
+}
+
+void RenderServer::post(const Reply& reply, const QJsonObject& object) {
+    QMetaObject::invokeMethod(this, [reply, object]() { reply(object); }, Qt::QueuedConnection);
+}
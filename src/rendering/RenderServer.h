@@ -0,0 +1,90 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QObject>
+#include <QTimer>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+#include "rendering/FrameCapture.h"
+#include "rendering/OffscreenContext.h"
+#include "rendering/SceneRenderer.h"
+#include "settings.h"
+
+class QLocalServer;
+class QSocketNotifier;
+
+// a long running renderer that takes jobs as json, one object per line, from
+// clients of a local socket (a unix domain socket, a named pipe on windows) or
+// from stdin. the context, shaders, shapes, capture buffers and texture manager
+// live as long as the server and the last scene stays loaded, so a request for
+// the scene that is already loaded only pays for drawing it.
+//
+// request: a batch job (see BatchRenderer, the scene defaults to the one given
+//   on the command line) plus an "id" that is echoed in the reply. with
+//   "output" the image is saved there, without it the image comes back in the
+//   reply as base64, in "format" (png, qoi, ppm or raw, default png).
+//   "region": [x, y, w, h] draws only that part of the width x height frame,
+//   for splitting one image across servers (see RenderCoordinator).
+//   {"command": "ping"} is answered once the requests before it are drawn,
+//   {"command": "shutdown"} finishes the work queued before it and stops the server.
+// reply: { "id": 7, "ok": true, "output": "fog.png" (or "image": "<base64>", "format": "png"),
+//          "width": 1024, "height": 768, "scene-reused": true,
+//          "timing": { "queued-ms", "scene-ms", "render-ms", "encode-ms", "total-ms" } }
+//   or { "id": 7, "ok": false, "error": "..." }
+//
+// there is one gl context, so requests are drawn one at a time in the order
+// they arrive. readback, encoding and saving run on FrameCapture's threads
+// while the next requests render, so replies go out as their images finish
+// and a quick one can overtake a slow one
+class RenderServer : public QObject {
+public:
+    RenderServer();
+    ~RenderServer();
+
+    // create the context and renderer, then listen on a local socket (a name or
+    // a path), or read requests from stdin and reply on stdout for "-" (unix
+    // only; the log moves to stderr). false (after printing why) if any of it fails.
+    // the server runs in the application's event loop, which it quits on shutdown
+    bool start(const std::string& address);
+
+private:
+    using Reply = std::function<void(const QJsonObject&)>;
+
+    struct Request {
+        QJsonObject object;
+        Reply reply;
+        QElapsedTimer received;
+    };
+
+    void acceptConnection();
+    void readStdin();
+    void receive(const QByteArray& line, const Reply& reply);
+    void processNext();
+    void render(const Request& request);
+    void shutdown(const Request& request);
+
+    // hand reply to the event loop thread, from any thread
+    void post(const Reply& reply, const QJsonObject& object);
+
+    OffscreenContext m_context;
+    SceneRenderer m_renderer;
+    FrameCapture m_capture;
+    Settings m_base;  // the command line settings every request starts from
+    std::string m_loadedScene;
+    bool m_started = false;
+    bool m_stopping = false;
+
+    std::deque<Request> m_queue;
+    bool m_processScheduled = false;
+    QTimer m_pollTimer;  // hands finished readbacks on while no request is rendering
+
+    QLocalServer* m_server = nullptr;
+    QSocketNotifier* m_stdinNotifier = nullptr;
+    QByteArray m_stdinBuffer;
+    std::streambuf* m_coutBuffer = nullptr;  // std::cout's own buffer while it points at stderr
+};
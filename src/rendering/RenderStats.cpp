@@ -0,0 +1,106 @@
+#include "RenderStats.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+void RenderStats::addDraw(int vertexCount, int instanceCount) {
+    s_frame[DrawCalls]++;
+    int64_t triangles = vertexCount / 3;
+    if (instanceCount > 0) {
+        s_frame[Instances] += instanceCount;
+        triangles *= instanceCount;
+    }
+    s_frame[Triangles] += triangles;
+}
+
+void RenderStats::endFrame() {
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        s_last[i] = s_frame[i];
+        s_frame[i] = 0;
+    }
+}
+
+const char* RenderStats::name(Counter counter) {
+    switch (counter) {
+        case DrawCalls: return "draw calls";
+        case Triangles: return "triangles";
+        case Instances: return "instances";
+        case StateChanges: return "state changes";
+        case UniformUploads: return "uniform uploads";
+        case ShapesDrawn: return "shapes drawn";
+        case ShapesSkipped: return "shapes skipped";
+        default: return "";
+    }
+}
+
+const char* RenderStats::name(Gauge gauge) {
+    switch (gauge) {
+        case TextureBytes: return "texture memory";
+        case TextureBudgetBytes: return "texture budget";
+        case Textures: return "textures";
+        case TexturesReduced: return "textures reduced";
+        case Lights: return "lights";
+        case InstanceCount: return "instance count";
+        default: return "";
+    }
+}
+
+void RenderStats::reset() {
+    std::fill(std::begin(s_frame), std::end(s_frame), 0);
+    std::fill(std::begin(s_last), std::end(s_last), 0);
+    std::fill(std::begin(s_gauges), std::end(s_gauges), 0);
+}
+
+void FrameTimes::add(float ms) {
+    if (static_cast<int>(m_samples.size()) < m_capacity) {
+        m_samples.push_back(ms);
+        return;
+    }
+    m_samples[static_cast<size_t>(m_next)] = ms;
+    m_next = (m_next + 1) % m_capacity;
+}
+
+void FrameTimes::clear() {
+    m_samples.clear();
+    m_next = 0;
+}
+
+float FrameTimes::at(int i) const {
+    // once full, m_next is the oldest slot
+    return m_samples[static_cast<size_t>((m_next + i) % size())];
+}
+
+float FrameTimes::latest() const {
+    return m_samples.empty() ? 0.0f : at(size() - 1);
+}
+
+float FrameTimes::min() const {
+    return m_samples.empty() ? 0.0f : *std::min_element(m_samples.begin(), m_samples.end());
+}
+
+float FrameTimes::max() const {
+    return m_samples.empty() ? 0.0f : *std::max_element(m_samples.begin(), m_samples.end());
+}
+
+float FrameTimes::mean() const {
+    if (m_samples.empty()) {
+        return 0.0f;
+    }
+    double sum = 0.0;
+    for (float sample : m_samples) {
+        sum += sample;
+    }
+    return static_cast<float>(sum / m_samples.size());
+}
+
+float FrameTimes::percentile(float p) const {
+    if (m_samples.empty()) {
+        return 0.0f;
+    }
+    std::vector<float> sorted = m_samples;
+    // nearest rank
+    double rank = std::clamp(std::ceil(p / 100.0 * sorted.size()), 1.0, double(sorted.size()));
+    auto nth = sorted.begin() + (static_cast<size_t>(rank) - 1);
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// what the renderer issued in the last frame, counted by the managers that
+// issue it. counters add up while a frame is drawn and endFrame() publishes
+// them; gauges hold a current value (texture memory, lights, instances). only
+// touched from the thread that owns the gl context, so counting is a plain add
+class RenderStats {
+public:
+    enum Counter {
+        DrawCalls,
+        Triangles,
+        Instances,       // drawn by instanced draws
+        StateChanges,    // program, vertex array and texture binds
+        UniformUploads,
+        ShapesDrawn,
+        ShapesSkipped,   // scene shapes that issued no draw this frame
+        COUNTER_COUNT
+    };
+
+    enum Gauge {
+        TextureBytes,         // resident texture memory
+        TextureBudgetBytes,   // 0 = unlimited
+        Textures,
+        TexturesReduced,      // held below the detail they asked for
+        Lights,
+        InstanceCount,        // laid out by the instance manager
+        GAUGE_COUNT
+    };
+
+    static void add(Counter counter, int64_t amount = 1) { s_frame[counter] += amount; }
+    static void set(Gauge gauge, int64_t value) { s_gauges[gauge] = value; }
+
+    // a draw of vertexCount triangle vertices, instanceCount times when instanced
+    static void addDraw(int vertexCount, int instanceCount = 0);
+
+    // publish the counters of the frame just drawn and start the next one
+    static void endFrame();
+
+    static int64_t lastFrame(Counter counter) { return s_last[counter]; }
+    static int64_t get(Gauge gauge) { return s_gauges[gauge]; }
+
+    static const char* name(Counter counter);
+    static const char* name(Gauge gauge);
+
+    // zero everything, e.g. when a new scene is loaded
+    static void reset();
+
+private:
+    static inline int64_t s_frame[COUNTER_COUNT] = {};
+    static inline int64_t s_last[COUNTER_COUNT] = {};
+    static inline int64_t s_gauges[GAUGE_COUNT] = {};
+};
+
+// the last capacity frame times, oldest first, with percentiles over them
+class FrameTimes {
+public:
+    static constexpr int DEFAULT_CAPACITY = 240;
+
+    explicit FrameTimes(int capacity = DEFAULT_CAPACITY) : m_capacity(capacity) {}
+
+    void add(float ms);
+    void clear();
+
+    int capacity() const { return m_capacity; }
+    int size() const { return static_cast<int>(m_samples.size()); }
+    // i = 0 is the oldest sample kept
+    float at(int i) const;
+    float latest() const;
+    float min() const;
+    float max() const;
+    float mean() const;
+
+    // nearest rank percentile, 0 without samples
+    float percentile(float p) const;
+
+private:
+    int m_capacity;
+    std::vector<float> m_samples;
+    int m_next = 0;  // slot the next sample overwrites once full
+};
@@ -0,0 +1,86 @@
+#include "RenderTargetPool.h"
+#include <algorithm>
+#include <iostream>
+
+RenderTargetPool::~RenderTargetPool() {
+    cleanup();
+}
+
+const RenderTarget* RenderTargetPool::acquire(int width, int height) {
+    m_frame++;
+    for (RenderTarget& target : m_targets) {
+        if (target.width == width && target.height == height) {
+            target.lastUsed = m_frame;
+            return &target;
+        }
+    }
+
+    if (static_cast<int>(m_targets.size()) >= MAX_TARGETS) {
+        auto oldest = std::min_element(m_targets.begin(), m_targets.end(), [](const RenderTarget& a, const RenderTarget& b) {
+            return a.lastUsed < b.lastUsed;
+        });
+        destroy(*oldest);
+        m_targets.erase(oldest);
+    }
+
+    RenderTarget target;
+    if (!create(target, width, height)) {
+        destroy(target);
+        return nullptr;
+    }
+    target.lastUsed = m_frame;
+    m_targets.push_back(target);
+    return &m_targets.back();
+}
+
+bool RenderTargetPool::create(RenderTarget& target, int width, int height) {
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+    target.width = width;
+    target.height = height;
+
+    glGenTextures(1, &target.color);
+    glBindTexture(GL_TEXTURE_2D, target.color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &target.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &target.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+    if (!complete) {
+        std::cerr << "Error: Framebuffer is not complete! (" << width << "x" << height << ")" << std::endl;
+    }
+    return complete;
+}
+
+void RenderTargetPool::destroy(RenderTarget& target) {
+    if (target.framebuffer != 0) {
+        glDeleteFramebuffers(1, &target.framebuffer);
+    }
+    if (target.color != 0) {
+        glDeleteTextures(1, &target.color);
+    }
+    if (target.depth != 0) {
+        glDeleteRenderbuffers(1, &target.depth);
+    }
+    target = RenderTarget();
+}
+
+void RenderTargetPool::cleanup() {
+    for (RenderTarget& target : m_targets) {
+        destroy(target);
+    }
+    m_targets.clear();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+
+// an offscreen framebuffer: rgba8 color texture and 24-bit depth renderbuffer
+struct RenderTarget {
+    GLuint framebuffer = 0;
+    GLuint color = 0;
+    GLuint depth = 0;
+    int width = 0;
+    int height = 0;
+    int lastUsed = 0;
+};
+
+// framebuffers kept across captures so rendering many images doesn't allocate
+// (and the driver doesn't clear) new storage every frame. one target per size,
+// the least recently used size is dropped past MAX_TARGETS
+class RenderTargetPool {
+public:
+    ~RenderTargetPool();
+
+    // a complete target of this size, or nullptr if the driver rejects it.
+    // the pointer stays valid until the next acquire() of another size
+    const RenderTarget* acquire(int width, int height);
+
+    void cleanup();
+
+private:
+    static constexpr int MAX_TARGETS = 4;
+
+    static bool create(RenderTarget& target, int width, int height);
+    static void destroy(RenderTarget& target);
+
+    std::vector<RenderTarget> m_targets;
+    int m_frame = 0;
+};
@@ -0,0 +1,674 @@
+#include "SceneRenderer.h"
+#include "TiledCapture.h"
+#include "RenderStats.h"
+
+#include <QStandardPaths>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include "settings.h"
+#include "ZoneProfiler.h"
+
+bool SceneRenderer::initialize() {
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // surfaceless egl contexts have no glx display, the gl entry points still load
+    if (err == GLEW_ERROR_NO_GLX_DISPLAY) {
+        err = GLEW_OK;
+    }
+#endif
+    if (err != GLEW_OK) {
+        std::cerr << "Error while initializing GL: " << glewGetErrorString(err) << std::endl;
+    }
+    std::cout << "Initialized GL: Version " << glewGetString(GLEW_VERSION) << std::endl;
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    glViewport(0, 0, m_width, m_height);
+
+    m_gpuProfiler.setEnabled(!settings.gpuProfilePath.empty());
+
+    std::string shaderDir = settings.shaderDirectory.empty() ? ":/resources/shaders" : settings.shaderDirectory;
+    bool shadersLoaded = m_shaderManager.loadShaders(
+        shaderDir + "/default.vert",
+        shaderDir + "/default.frag"
+    );
+
+    if (!shadersLoaded) {
+        std::cerr << "Failed to load shaders!" << std::endl;
+        return false;
+    }
+
+    // embedded resources can't change, only watch shaders loaded from disk
+    if (!settings.shaderDirectory.empty()) {
+        m_shaderManager.watchSources(true);
+    }
+
+    if (settings.enableTextureCache) {
+        std::string cacheDir = settings.textureCacheDirectory;
+        if (cacheDir.empty()) {
+            cacheDir = (QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/textures").toStdString();
+        }
+        m_textureManager.setCacheDirectory(cacheDir);
+        m_textureManager.setCompression(settings.compressTextureCache);
+    }
+    m_textureManager.setNormalMapCompression(settings.compressNormalMaps);
+
+    MipOptions mipOptions;
+    mipOptions.filter = settings.kaiserMipFilter ? MipFilter::Kaiser : MipFilter::Box;
+    mipOptions.alphaCutoff = settings.mipAlphaCutoff;
+    m_textureManager.setMipOptions(mipOptions);
+
+    m_textureManager.setMemoryBudget(static_cast<size_t>(settings.textureBudgetMB) * 1024 * 1024);
+
+    m_virtualTextures.initialize(shaderDir, settings.virtualTextureCacheTiles);
+
+    m_shaderManager.use();
+    m_shaderManager.setUniformInt("diffuseTexture", 0);
+    m_shaderManager.setUniformInt("normalMap", 1);
+    m_shaderManager.setUniformInt("vtCache", 2);
+    m_shaderManager.setUniformInt("vtIndirection", 3);
+    glUseProgram(0);
+
+    m_shapeManager.initialize(settings.shapeParameter1, settings.shapeParameter2);
+
+    m_initialized = true;
+    return true;
+}
+
+bool SceneRenderer::loadScene() {
+    m_sceneLoaded = SceneParser::parse(settings.sceneFilePath, m_renderData);
+
+    if (!m_sceneLoaded) {
+        std::cerr << "Failed to load scene: " << settings.sceneFilePath << std::endl;
+        return false;
+    }
+
+    float aspectRatio = static_cast<float>(m_width) / m_height;
+
+    m_camera = std::make_unique<Camera>(
+        m_renderData.cameraData,
+        aspectRatio,
+        settings.nearPlane,
+        settings.farPlane
+    );
+
+    loadMaterialTextures();
+    setupInstances();
+    return true;
+}
+
+void SceneRenderer::setupInstances() {
+    // generated once, later scenes reuse the layout
+    if (!settings.enableInstancing || m_instanceManager.getInstanceCount() > 0) {
+        return;
+    }
+    m_instanceManager.generateInstances(100, 15.0f, m_instanceSeed);
+    m_instanceManager.uploadToGPU();
+    m_shapeManager.setupInstanceAttributes(PrimitiveType::PRIMITIVE_CUBE,
+                                            m_instanceManager.getInstanceVBO());
+    std::cout << "generated " << m_instanceManager.getInstanceCount()
+              << " instances for cube" << std::endl;
+}
+
+void SceneRenderer::setInstanceSeed(unsigned seed) {
+    if (seed == m_instanceSeed && seed != 0) {
+        return;
+    }
+    m_instanceSeed = seed;
+    m_instanceManager.cleanup();
+    setupInstances();
+}
+
+void SceneRenderer::setCamera(const SceneCameraData& cameraData) {
+    if (m_camera) {
+        m_camera->updateFromSceneData(cameraData);
+    }
+}
+
+void SceneRenderer::settingsChanged() {
+    if (!m_initialized) {
+        return;
+    }
+
+    if (m_camera) {
+        m_camera->updateClippingPlanes(settings.nearPlane, settings.farPlane);
+    }
+
+    // new tessellation replaces the cube's vertex array and its instance attributes
+    if (m_shapeManager.updateTessellation(settings.shapeParameter1, settings.shapeParameter2) &&
+        m_instanceManager.getInstanceCount() > 0) {
+        m_shapeManager.setupInstanceAttributes(PrimitiveType::PRIMITIVE_CUBE,
+                                                m_instanceManager.getInstanceVBO());
+    }
+    setupInstances();
+}
+
+void SceneRenderer::resize(int width, int height) {
+    m_width = std::max(width, 1);
+    m_height = std::max(height, 1);
+    m_imageHeight = m_height;
+    glViewport(0, 0, m_width, m_height);
+
+    if (m_camera) {
+        m_camera->updateAspectRatio(static_cast<float>(m_width) / m_height);
+    }
+}
+
+void SceneRenderer::advanceTime(float seconds) {
+    m_elapsedTime += seconds;
+}
+
+void SceneRenderer::setTime(float seconds) {
+    m_elapsedTime = seconds;
+}
+
+void SceneRenderer::setGlobalUniforms() {
+    m_shaderManager.setUniformMat4("viewMatrix", m_camera->getViewMatrix());
+    m_shaderManager.setUniformMat4("projectionMatrix", m_camera->getProjectionMatrix());
+    m_shaderManager.setUniformVec3("cameraPos", m_camera->getPosition());
+
+    int numLights = std::min(static_cast<int>(m_renderData.lights.size()), 8);
+    m_shaderManager.setUniformInt("numLights", numLights);
+    RenderStats::set(RenderStats::Lights, numLights);
+
+    for (int i = 0; i < numLights; i++) {
+        m_shaderManager.setLight(i, m_renderData.lights[i]);
+    }
+}
+
+float SceneRenderer::projectedSize(const glm::mat4& ctm) const {
+    // bounding sphere of the unit primitive, scaled by the largest axis
+    glm::vec3 center = glm::vec3(ctm[3]);
+    float scale = std::max({glm::length(glm::vec3(ctm[0])), glm::length(glm::vec3(ctm[1])), glm::length(glm::vec3(ctm[2]))});
+    float radius = 0.866f * scale;
+
+    float distance = std::max(glm::length(center - m_camera->getPosition()) - radius, settings.nearPlane);
+    return radius / (distance * std::tan(m_camera->getHeightAngle() / 2.0f)) * m_imageHeight;
+}
+
+void SceneRenderer::bindMaterialTextures(const MaterialTextures& textures, const SceneMaterial& material, float screenSize) {
+    // tell the residency manager how much detail each texture needs on screen
+    if (textures.diffuse.isValid()) {
+        float repeat = std::max({material.textureMap.repeatU, material.textureMap.repeatV, 1.0f});
+        m_textureManager.requestDetail(textures.diffuse, screenSize / repeat);
+    }
+    if (textures.normal.isValid()) {
+        float repeat = std::max({material.bumpMap.repeatU, material.bumpMap.repeatV, 1.0f});
+        m_textureManager.requestDetail(textures.normal, screenSize / repeat);
+    }
+
+    // virtual textures pick their tiles from the feedback pass instead
+    bool hasVirtualTexture = textures.virtualTexture >= 0 &&
+        m_virtualTextures.bind(textures.virtualTexture, m_shaderManager, GL_TEXTURE2, GL_TEXTURE3);
+    m_shaderManager.setUniformBool("hasVirtualTexture", hasVirtualTexture);
+
+    // layers that are still loading render untextured
+    bool hasDiffuseTexture = !hasVirtualTexture && m_textureManager.isLayerReady(textures.diffuse);
+    m_shaderManager.setUniformBool("hasDiffuseTexture", hasDiffuseTexture);
+
+    if (hasVirtualTexture) {
+        m_shaderManager.setUniformVec2("diffuseRepeat", glm::vec2(material.textureMap.repeatU, material.textureMap.repeatV));
+    } else if (hasDiffuseTexture) {
+        // shapes are drawn sorted by array, so this rarely rebinds
+        if (textures.diffuse.array != m_boundDiffuseArray) {
+            m_textureManager.bindArray(textures.diffuse.array, GL_TEXTURE0);
+            m_boundDiffuseArray = textures.diffuse.array;
+        }
+        m_shaderManager.setUniformFloat("diffuseLayer", static_cast<float>(textures.diffuse.layer));
+        m_shaderManager.setUniformVec2("diffuseRepeat", glm::vec2(material.textureMap.repeatU, material.textureMap.repeatV));
+    }
+
+    bool hasNormalMap = settings.enableNormalMapping && m_textureManager.isLayerReady(textures.normal);
+    m_shaderManager.setUniformBool("hasNormalMap", hasNormalMap);
+
+    if (hasNormalMap) {
+        if (textures.normal.array != m_boundNormalArray) {
+            m_textureManager.bindArray(textures.normal.array, GL_TEXTURE1);
+            m_boundNormalArray = textures.normal.array;
+        }
+        m_shaderManager.setUniformFloat("normalLayer", static_cast<float>(textures.normal.layer));
+        m_shaderManager.setUniformVec2("normalRepeat", glm::vec2(material.bumpMap.repeatU, material.bumpMap.repeatV));
+    }
+}
+
+void SceneRenderer::renderShape(const RenderShapeData& shape, const MaterialTextures& textures) {
+    // cubes are drawn with the instanced ones
+    if (settings.enableInstancing && shape.primitive.type == PrimitiveType::PRIMITIVE_CUBE) {
+        RenderStats::add(RenderStats::ShapesSkipped);
+        return;
+    }
+
+    m_shaderManager.setUniformBool("useInstancing", false);
+    m_shaderManager.setUniformMat4("modelMatrix", shape.ctm);
+
+    const SceneMaterial& mat = shape.primitive.material;
+    const SceneGlobalData& global = m_renderData.globalData;
+
+    glm::vec4 ambient = mat.cAmbient * global.ka;
+    glm::vec4 diffuse = mat.cDiffuse * global.kd;
+    glm::vec4 specular = mat.cSpecular * global.ks;
+
+    m_shaderManager.setUniformVec4("ambientColor", ambient);
+    m_shaderManager.setUniformVec4("diffuseColor", diffuse);
+    m_shaderManager.setUniformVec4("specularColor", specular);
+    m_shaderManager.setUniformFloat("shininess", mat.shininess);
+
+    bindMaterialTextures(textures, mat, projectedSize(shape.ctm));
+
+    bool drawn = m_shapeManager.draw(shape.primitive.type);
+    RenderStats::add(drawn ? RenderStats::ShapesDrawn : RenderStats::ShapesSkipped);
+}
+
+void SceneRenderer::renderVirtualTextureFeedback() {
+    if (!m_virtualTextures.beginFeedback(m_camera->getViewMatrix(), m_camera->getProjectionMatrix())) {
+        return;
+    }
+
+    // every shape is drawn so hidden surfaces don't ask for tiles
+    for (size_t index : m_drawOrder) {
+        const RenderShapeData& shape = m_renderData.shapes[index];
+        if (settings.enableInstancing && shape.primitive.type == PrimitiveType::PRIMITIVE_CUBE) {
+            continue;
+        }
+        const SceneMaterial& mat = shape.primitive.material;
+        m_virtualTextures.drawFeedback(m_shapeTextures[index].virtualTexture, shape.ctm,
+                                       glm::vec2(mat.textureMap.repeatU, mat.textureMap.repeatV),
+                                       settings.enableScrolling, settings.scrollDirection,
+                                       settings.scrollSpeed, m_elapsedTime,
+                                       m_shapeManager.getVAO(shape.primitive.type),
+                                       m_shapeManager.getVertexCount(shape.primitive.type));
+    }
+
+    if (settings.enableInstancing && m_instanceManager.getInstanceCount() > 0) {
+        int vt = -1;
+        glm::vec2 repeat(1.0f);
+        if (m_instanceMaterialShape >= 0) {
+            const SceneMaterial& mat = m_renderData.shapes[m_instanceMaterialShape].primitive.material;
+            vt = m_shapeTextures[m_instanceMaterialShape].virtualTexture;
+            repeat = glm::vec2(mat.textureMap.repeatU, mat.textureMap.repeatV);
+        }
+        m_virtualTextures.drawFeedback(vt, glm::mat4(1.0f), repeat,
+                                       settings.enableScrolling, settings.scrollDirection,
+                                       settings.scrollSpeed, m_elapsedTime,
+                                       m_shapeManager.getVAO(PrimitiveType::PRIMITIVE_CUBE),
+                                       m_shapeManager.getVertexCount(PrimitiveType::PRIMITIVE_CUBE),
+                                       m_instanceManager.getInstanceCount());
+    }
+
+    m_virtualTextures.endFeedback();
+}
+
+void SceneRenderer::render() {
+    if (!m_sceneLoaded || !m_camera) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return;
+    }
+
+    // set background color to match fog color if fog is enabled
+    if (settings.enableFog) {
+        glClearColor(settings.fogColor.r, settings.fogColor.g, settings.fogColor.b, 1.0f);
+    } else {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    PROFILE_ZONE("SceneRenderer::render");
+
+    // timings of earlier frames the gpu has finished
+    m_gpuProfiler.collect();
+    GpuProfiler::Scope frameScope(m_gpuProfiler, "frame");
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // picks up programs that finished compiling (initial load or hot reload)
+    m_shaderManager.poll();
+
+    // textures decode in the background, a few are uploaded each frame
+    m_textureManager.processUploads();
+
+    // virtual textures: record the tiles this frame needs, stream in the ones
+    // earlier frames asked for
+    {
+        GpuProfiler::Scope scope(m_gpuProfiler, "vt feedback");
+        renderVirtualTextureFeedback();
+        m_virtualTextures.update();
+    }
+
+    // arrays get bound by the first shape that needs them
+    m_boundDiffuseArray = -1;
+    m_boundNormalArray = -1;
+
+    m_shaderManager.use();
+
+    setGlobalUniforms();
+
+
+    m_shaderManager.setUniformInt("enableFog", settings.enableFog ? 1 : 0);
+    m_shaderManager.setUniformInt("enableNormalMapping", settings.enableNormalMapping ? 1 : 0);
+    m_shaderManager.setUniformInt("enableScrolling", settings.enableScrolling ? 1 : 0);
+    m_shaderManager.setUniformInt("hasDiffuseTexture", 0);
+    m_shaderManager.setUniformInt("hasNormalMap", 0);
+    m_shaderManager.setUniformInt("hasVirtualTexture", 0);
+
+    m_shaderManager.setUniformInt("diffuseTexture", 0);
+    m_shaderManager.setUniformInt("normalMap", 1);
+    m_shaderManager.setUniformInt("vtCache", 2);
+    m_shaderManager.setUniformInt("vtIndirection", 3);
+
+    m_shaderManager.setUniformVec3("fogColor", settings.fogColor);
+    m_shaderManager.setUniformFloat("fogStart", settings.fogStart);
+    m_shaderManager.setUniformFloat("fogEnd", settings.fogEnd);
+    m_shaderManager.setUniformFloat("fogDensity", settings.fogDensity);
+    m_shaderManager.setUniformFloat("time", m_elapsedTime);
+
+    m_shaderManager.setUniformVec2("scrollDirection", settings.scrollDirection);
+    m_shaderManager.setUniformFloat("scrollSpeed", settings.scrollSpeed); 
+
+
+
+    {
+        GpuProfiler::Scope scope(m_gpuProfiler, "shapes");
+        for (size_t index : m_drawOrder) {
+            renderShape(m_renderData.shapes[index], m_shapeTextures[index]);
+        }
+    }
+
+    if (settings.enableInstancing && m_instanceManager.getInstanceCount() > 0) {
+        GpuProfiler::Scope scope(m_gpuProfiler, "instanced");
+        m_shaderManager.setUniformBool("useInstancing", true);
+
+        glm::vec4 ambient = glm::vec4(0.9f, 0.9f, 0.9f, 1.0f) * m_renderData.globalData.ka;
+        glm::vec4 diffuse = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f) * m_renderData.globalData.kd;
+        glm::vec4 specular = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f) * m_renderData.globalData.ks;
+
+        m_shaderManager.setUniformVec4("ambientColor", ambient);
+        m_shaderManager.setUniformVec4("diffuseColor", diffuse);
+        m_shaderManager.setUniformVec4("specularColor", specular);
+        m_shaderManager.setUniformFloat("shininess", 25.0f);
+
+        if (m_instanceMaterialShape >= 0) {
+            // instances are spread around the camera, keep full detail
+            float screenSize = static_cast<float>(m_imageHeight);
+            bindMaterialTextures(m_shapeTextures[m_instanceMaterialShape],
+                                 m_renderData.shapes[m_instanceMaterialShape].primitive.material, screenSize);
+        } else {
+            bindMaterialTextures(MaterialTextures(), SceneMaterial(), 0.0f);
+        }
+
+        m_shapeManager.draw(PrimitiveType::PRIMITIVE_CUBE, m_instanceManager.getInstanceCount());
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    RenderStats::endFrame();
+}
+
+void SceneRenderer::loadMaterialTextures() {
+    m_textureManager.clearArrays();
+    m_virtualTextures.clear();
+    m_shapeTextures.clear();
+    m_instanceMaterialShape = -1;
+
+    for (const RenderShapeData& shape : m_renderData.shapes) {
+        const SceneMaterial& mat = shape.primitive.material;
+        MaterialTextures textures;
+        if (mat.textureMap.isUsed) {
+            const std::string& filename = mat.textureMap.filename;
+            if (filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".bvt") == 0) {
+                textures.virtualTexture = m_virtualTextures.load(filename);
+            } else {
+                textures.diffuse = m_textureManager.loadArrayTexture(filename);
+            }
+        }
+        if (mat.bumpMap.isUsed) {
+            textures.normal = m_textureManager.loadArrayTexture(mat.bumpMap.filename, TextureUsage::NormalMap);
+        }
+        m_shapeTextures.push_back(textures);
+    }
+
+    // the instanced cubes share the material of the first textured cube
+    for (size_t i = 0; i < m_renderData.shapes.size(); i++) {
+        const MaterialTextures& textures = m_shapeTextures[i];
+        if (m_renderData.shapes[i].primitive.type == PrimitiveType::PRIMITIVE_CUBE &&
+            (textures.diffuse.isValid() || textures.virtualTexture >= 0)) {
+            m_instanceMaterialShape = static_cast<int>(i);
+            break;
+        }
+    }
+
+    // every layer is known now, allocate the arrays and start loading
+    m_textureManager.allocateArrays();
+
+    // draw shapes sharing an array back to back
+    m_drawOrder.resize(m_renderData.shapes.size());
+    for (size_t i = 0; i < m_drawOrder.size(); i++) {
+        m_drawOrder[i] = i;
+    }
+    std::stable_sort(m_drawOrder.begin(), m_drawOrder.end(), [this](size_t a, size_t b) {
+        const MaterialTextures& ta = m_shapeTextures[a];
+        const MaterialTextures& tb = m_shapeTextures[b];
+        if (ta.diffuse.array != tb.diffuse.array) {
+            return ta.diffuse.array < tb.diffuse.array;
+        }
+        return ta.normal.array < tb.normal.array;
+    });
+}
+
+const RenderTarget* SceneRenderer::renderCaptureFrame(int width, int height) {
+    // don't capture the fallback shader or placeholder textures
+    m_shaderManager.waitUntilReady();
+    m_textureManager.finishPendingLoads();
+
+    const RenderTarget* target = m_renderTargets.acquire(width, height);
+    if (target == nullptr) {
+        return nullptr;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+
+    // frame at the image's size, the camera aspect is put back below
+    int savedWidth = m_width;
+    int savedHeight = m_height;
+    resize(width, height);
+
+    // one frame to find the visible virtual texture tiles, then load all of them
+    if (m_virtualTextures.hasTextures()) {
+        render();
+        m_virtualTextures.finishPendingTiles();
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    render();
+
+    resize(savedWidth, savedHeight);
+    return target;
+}
+
+QImage SceneRenderer::renderImage(int width, int height) {
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    QImage image;
+    if (renderCaptureFrame(width, height) != nullptr) {
+        // read pixels from framebuffer as rgba, the layout ImageEncoder takes
+        std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+        {
+            GpuProfiler::Scope scope(m_gpuProfiler, "readback");
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        }
+
+        // gl rows start at the bottom
+        image = QImage(width, height, QImage::Format_RGBX8888);
+        size_t rowBytes = static_cast<size_t>(width) * 4;
+        for (int y = 0; y < height; y++) {
+            std::memcpy(image.scanLine(height - 1 - y), pixels.data() + y * rowBytes, rowBytes);
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    return image;
+}
+
+bool SceneRenderer::captureImage(int width, int height, FrameCapture& capture, const std::string& path) {
+    return captureImage(width, height, capture, FrameCapture::imageFile(path));
+}
+
+bool SceneRenderer::captureImage(int width, int height, FrameCapture& capture, FrameCapture::Output output) {
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    bool rendered = renderCaptureFrame(width, height) != nullptr;
+    if (rendered) {
+        GpuProfiler::Scope scope(m_gpuProfiler, "readback");
+        capture.capture(width, height, std::move(output));
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    return rendered;
+}
+
+bool SceneRenderer::captureRegion(int imageWidth, int imageHeight, int x, int y, int width, int height,
+                                  FrameCapture& capture, FrameCapture::Output output) {
+    if (!m_camera || width <= 0 || height <= 0 || x < 0 || y < 0 || x + width > imageWidth || y + height > imageHeight) {
+        return false;
+    }
+
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    m_shaderManager.waitUntilReady();
+    m_textureManager.finishPendingLoads();
+
+    const RenderTarget* target = m_renderTargets.acquire(width, height);
+    bool rendered = target != nullptr;
+    if (rendered) {
+        glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+
+        // the same off-axis window a tile of captureTiled gets
+        int savedWidth = m_width;
+        int savedHeight = m_height;
+        resize(width, height);
+        m_imageHeight = imageHeight;
+        m_camera->updateAspectRatio(static_cast<float>(imageWidth) / imageHeight);
+        double x0 = static_cast<double>(x) / imageWidth;
+        double x1 = static_cast<double>(x + width) / imageWidth;
+        double y0 = static_cast<double>(y) / imageHeight;
+        double y1 = static_cast<double>(y + height) / imageHeight;
+        m_camera->setProjectionWindow(glm::vec4(-1.0 + 2.0 * x0, -1.0 + 2.0 * x1, 1.0 - 2.0 * y1, 1.0 - 2.0 * y0));
+
+        render();
+        m_textureManager.finishPendingLoads();
+        m_virtualTextures.finishPendingTiles();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        render();
+        GpuProfiler::Scope scope(m_gpuProfiler, "readback");
+        capture.capture(width, height, std::move(output));
+
+        m_camera->setProjectionWindow(glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f));
+        resize(savedWidth, savedHeight);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    return rendered;
+}
+
+bool SceneRenderer::captureTiled(int width, int height, int tileSize, const std::string& path) {
+    // no bigger than the driver can draw into in one piece
+    GLint maxRenderbuffer = 0;
+    GLint maxViewport[2] = {0, 0};
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &maxRenderbuffer);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, maxViewport);
+    tileSize = std::min({tileSize, static_cast<int>(maxRenderbuffer), static_cast<int>(maxViewport[0]), static_cast<int>(maxViewport[1])});
+
+    TiledCapture capture;
+    if (!m_camera || !capture.begin(width, height, tileSize, path)) {
+        return false;
+    }
+
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    m_shaderManager.waitUntilReady();
+    m_textureManager.finishPendingLoads();
+
+    int tile = capture.tileSize();
+    const RenderTarget* target = m_renderTargets.acquire(tile, tile);
+    bool rendered = target != nullptr;
+    if (rendered) {
+        glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+
+        // every tile is a window onto the same full-size frustum, so fog, lighting
+        // and texture filtering come out as if the image had been drawn in one go.
+        // level of detail follows the whole image's height, not the tile's
+        int savedWidth = m_width;
+        int savedHeight = m_height;
+        resize(tile, tile);
+        m_imageHeight = height;
+        m_camera->updateAspectRatio(static_cast<float>(width) / height);
+
+        for (int row = 0; row < capture.rows(); row++) {
+            for (int column = 0; column < capture.columns(); column++) {
+                m_camera->setProjectionWindow(capture.tileWindow(column, row));
+
+                // the first tile settles which texture mips are resident, after that
+                // only the virtual texture tiles each window sees have to be loaded
+                bool first = row == 0 && column == 0;
+                if (first || m_virtualTextures.hasTextures()) {
+                    render();
+                    m_textureManager.finishPendingLoads();
+                    m_virtualTextures.finishPendingTiles();
+                }
+
+                render();
+                GpuProfiler::Scope scope(m_gpuProfiler, "readback");
+                capture.readTile(column, row);
+            }
+        }
+
+        m_camera->setProjectionWindow(glm::vec4(-1.0f, 1.0f, -1.0f, 1.0f));
+        resize(savedWidth, savedHeight);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+    rendered = capture.finish() && rendered;
+    capture.cleanup();
+    return rendered;
+}
+
+void SceneRenderer::cleanup() {
+    if (m_gpuProfiler.isEnabled()) {
+        // the last frames' queries are still in flight
+        m_gpuProfiler.collect(true);
+        if (m_gpuProfiler.write(settings.gpuProfilePath)) {
+            std::cout << "gpu profile written to " << settings.gpuProfilePath << std::endl;
+        }
+    }
+    m_gpuProfiler.cleanup();
+    m_shapeManager.cleanup();
+    m_shaderManager.cleanup();
+    m_textureManager.cleanup();
+    m_virtualTextures.cleanup();
+    m_instanceManager.cleanup();
+
+    m_renderTargets.cleanup();
+    m_initialized = false;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <QImage>
+#include <glm/glm.hpp>
+#include <memory>
+#include <vector>
+
+#include "camera/Camera.h"
+#include "shapes/ShapeManager.h"
+#include "rendering/ShaderManager.h"
+#include "rendering/TextureManager.h"
+#include "rendering/VirtualTextureManager.h"
+#include "rendering/InstanceManager.h"
+#include "rendering/FrameCapture.h"
+#include "rendering/GpuProfiler.h"
+#include "rendering/RenderTargetPool.h"
+#include "utils/sceneparser.h"
+
+// draws the current scene into whatever framebuffer is bound, independent of
+// where the gl context came from. Realtime drives it from its widget, headless
+// renders from an offscreen context. every call needs the context current
+class SceneRenderer {
+public:
+    // loads glew, shaders and the shapes. returns false if the shaders can't be loaded
+    bool initialize();
+    bool isInitialized() const { return m_initialized; }
+
+    // parse settings.sceneFilePath and start loading its textures
+    bool loadScene();
+    bool hasScene() const { return m_sceneLoaded && m_camera; }
+
+    // apply changed near/far planes and tessellation
+    void settingsChanged();
+
+    // size of the framebuffer frames are drawn into, in pixels
+    void resize(int width, int height);
+
+    // draw one frame
+    void render();
+
+    // advance the scrolling animation, or set its clock
+    void advanceTime(float seconds);
+    void setTime(float seconds);
+
+    // lay the instanced cubes out again from this seed (0 = random). the same
+    // seed keeps the current layout
+    void setInstanceSeed(unsigned seed);
+
+    // move the camera of the loaded scene. sceneCamera() is where the scene file put it
+    void setCamera(const SceneCameraData& cameraData);
+    const SceneCameraData& sceneCamera() const { return m_renderData.cameraData; }
+
+    // nullptr until a scene is loaded
+    Camera* camera() { return m_camera.get(); }
+
+    // wait for shaders, textures and the visible virtual texture tiles, render one
+    // frame into an offscreen framebuffer of the given size and read it back.
+    // the bound framebuffer and viewport are restored afterwards
+    QImage renderImage(int width, int height);
+
+    // the same frame, read back through capture's pixel buffer ring and saved to
+    // path in the background. returns false if no framebuffer of that size could be made
+    bool captureImage(int width, int height, FrameCapture& capture, const std::string& path);
+    bool captureImage(int width, int height, FrameCapture& capture, FrameCapture::Output output);
+
+    // the width x height part of an imageWidth x imageHeight frame whose top
+    // left corner is at x, y, drawn exactly as that part of the whole frame
+    // would be and read back through capture. for splitting one image across
+    // processes; false if the region is empty, outside the image or too large
+    bool captureRegion(int imageWidth, int imageHeight, int x, int y, int width, int height,
+                       FrameCapture& capture, FrameCapture::Output output);
+
+    // render a width x height image of any size in tiles of at most tileSize and
+    // stream it into path (.png, .qoi, .ppm or .raw) strip by strip. blocks until
+    // the file is written, returns false if it couldn't be
+    bool captureTiled(int width, int height, int tileSize, const std::string& path);
+
+    // per-pass timings, on while settings.gpuProfilePath is set
+    GpuProfiler& gpuProfiler() { return m_gpuProfiler; }
+
+    // writes the profile to settings.gpuProfilePath if profiling was on
+    void cleanup();
+
+private:
+    // texture array slots of a shape's material
+    struct MaterialTextures {
+        TextureSlot diffuse;
+        TextureSlot normal;
+        int virtualTexture = -1;  // .bvt diffuse textures stream tiles instead
+    };
+
+    void setGlobalUniforms();
+    void loadMaterialTextures();
+    void bindMaterialTextures(const MaterialTextures& textures, const SceneMaterial& material, float screenSize);
+    float projectedSize(const glm::mat4& ctm) const;
+    void renderShape(const RenderShapeData& shape, const MaterialTextures& textures);
+    void renderVirtualTextureFeedback();
+    void setupInstances();
+    const RenderTarget* renderCaptureFrame(int width, int height);
+
+    int m_width = 1;
+    int m_height = 1;
+    int m_imageHeight = 1;  // of the whole image when drawing one tile of it, for level of detail
+
+    RenderData m_renderData;
+    bool m_sceneLoaded = false;
+    bool m_initialized = false;
+
+    std::unique_ptr<Camera> m_camera;
+    ShapeManager m_shapeManager;
+    ShaderManager m_shaderManager;
+    TextureManager m_textureManager;
+    VirtualTextureManager m_virtualTextures;
+    InstanceManager m_instanceManager;
+
+    std::vector<MaterialTextures> m_shapeTextures;  // parallel to m_renderData.shapes
+    std::vector<size_t> m_drawOrder;  // shapes sorted by texture array
+    int m_instanceMaterialShape = -1;  // shape whose material the instanced cubes use
+    int m_boundDiffuseArray = -1;
+    int m_boundNormalArray = -1;
+    unsigned m_instanceSeed = 0;
+
+    // framebuffers captures draw into, kept across frames
+    RenderTargetPool m_renderTargets;
+
+    GpuProfiler m_gpuProfiler;
+
+    float m_elapsedTime = 0.0f;  // total elapsed time for animations
+};
@@ -0,0 +1,116 @@
+#include "SequenceRecorder.h"
+#include "FrameCapture.h"
+#include "SceneRenderer.h"
+#include "Y4mWriter.h"
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cctype>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+bool isVideoPath(const std::string& path) {
+    if (path.size() < 4) {
+        return false;
+    }
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".y4m";
+}
+
+}
+
+std::string SequenceRecorder::framePath(const std::string& pattern, int index) {
+    // %d or %0Nd, parsed here rather than handed to printf
+    size_t percent = pattern.find('%');
+    while (percent != std::string::npos) {
+        size_t end = percent + 1;
+        int width = 0;
+        while (end < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[end]))) {
+            width = width * 10 + (pattern[end] - '0');
+            end++;
+        }
+        if (end < pattern.size() && pattern[end] == 'd') {
+            std::ostringstream number;
+            number << std::setw(std::min(width, 16)) << std::setfill('0') << index;
+            return pattern.substr(0, percent) + number.str() + pattern.substr(end + 1);
+        }
+        percent = pattern.find('%', percent + 1);
+    }
+
+    size_t dot = pattern.find_last_of('.');
+    size_t slash = pattern.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        dot = pattern.size();
+    }
+    std::ostringstream number;
+    number << "_" << std::setw(5) << std::setfill('0') << index;
+    return pattern.substr(0, dot) + number.str() + pattern.substr(dot);
+}
+
+int SequenceRecorder::record(SceneRenderer& renderer, const Options& options) {
+    bool video = isVideoPath(options.output);
+    Y4mWriter stream;
+    if (video && !stream.open(options.output, options.width, options.height, options.fps)) {
+        return options.frames;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    FrameCapture capture;
+    int failed = 0;
+    int recorded = 0;
+    for (int i = 0; i < options.frames; i++) {
+        // the clock advances by exactly one frame, however long the frame took
+        renderer.setTime(options.startTime + static_cast<float>(static_cast<double>(i) / std::max(1, options.fps)));
+
+        FrameCapture::Output output;
+        if (video) {
+            output = [&stream, i](const std::vector<unsigned char>& pixels, int width, int) {
+                if (pixels.empty()) {
+                    stream.skipFrame(i);
+                    return false;
+                }
+                return stream.writeFrame(i, pixels.data(), width * 4);
+            };
+        } else {
+            output = FrameCapture::imageFile(framePath(options.output, i));
+        }
+
+        if (!renderer.captureImage(options.width, options.height, capture, std::move(output))) {
+            // a video can't have a gap, and a framebuffer that failed once won't come back
+            failed = options.frames - i;
+            if (video) {
+                capture.finish();
+                stream.skipFrame(i);
+            }
+            break;
+        }
+        recorded++;
+        capture.poll();
+
+        if ((i + 1) % std::max(1, options.fps) == 0) {
+            std::cout << "recorded " << i + 1 << "/" << options.frames << " frames" << std::endl;
+        }
+    }
+
+    capture.finish();
+    FrameCapture::Stats stats = capture.getStats();
+    capture.cleanup();
+    failed += stats.failed;
+    if (video && !stream.close()) {
+        failed = options.frames;
+    }
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    std::cout << std::fixed << std::setprecision(1)
+              << "recording: " << recorded - stats.failed << "/" << options.frames << " frames of "
+              << options.width << "x" << options.height << " in " << seconds << " s ("
+              << (seconds > 0.0 ? (recorded - stats.failed) / seconds : 0.0) << " frames/s, "
+              << static_cast<double>(options.frames) / std::max(1, options.fps) << " s of animation)" << std::endl;
+    return failed;
+}
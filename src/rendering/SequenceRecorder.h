@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+class SceneRenderer;
+
+// records an animation frame by frame at a fixed timestep, as fast as the gpu
+// and the encoders allow instead of in real time, so long runs come out the
+// same every time. frames go through FrameCapture's readback ring: rendering,
+// readback and encoding overlap, and when the encoders fall behind the
+// renderer waits for them instead of frames piling up in memory
+class SequenceRecorder {
+public:
+    struct Options {
+        int frames = 60;
+        int fps = 30;
+        float startTime = 0.0f;  // animation clock of the first frame, in seconds
+        int width = 1024;
+        int height = 768;
+
+        // a .y4m path records one uncompressed video stream. anything else is a
+        // numbered image sequence: "shots/frame_%04d.png" (%d or %0Nd), or
+        // "_%05d" is put in front of the extension if there is no placeholder
+        std::string output;
+    };
+
+    // needs the renderer's context current and a scene loaded. returns the
+    // number of frames that didn't make it to disk
+    static int record(SceneRenderer& renderer, const Options& options);
+
+    // where frame index of an image sequence goes
+    static std::string framePath(const std::string& pattern, int index);
+};
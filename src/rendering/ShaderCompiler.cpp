@@ -0,0 +1,204 @@
+#include "ShaderCompiler.h"
+#include "utils/shaderloader.h"
+#include <QFileSystemWatcher>
+#include <QFileInfo>
+#include <iostream>
+
+ShaderCompiler::ShaderCompiler() {}
+
+ShaderCompiler::~ShaderCompiler() {
+    cleanup();
+}
+
+void ShaderCompiler::initialize() {
+#ifdef GL_KHR_parallel_shader_compile
+    if (GLEW_KHR_parallel_shader_compile) {
+        // let the driver pick how many compiler threads to use
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        m_parallelCompile = true;
+    }
+#endif
+#ifdef GL_ARB_parallel_shader_compile
+    if (!m_parallelCompile && GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        m_parallelCompile = true;
+    }
+#endif
+    std::cout << "parallel shader compile: " << (m_parallelCompile ? "available" : "unavailable") << std::endl;
+}
+
+int ShaderCompiler::submit(const std::string& vertPath, const std::string& fragPath) {
+    ProgramEntry entry;
+    entry.vertPath = vertPath;
+    entry.fragPath = fragPath;
+
+    if (!start(entry)) {
+        return -1;
+    }
+
+    m_programs.push_back(entry);
+    int handle = static_cast<int>(m_programs.size()) - 1;
+
+    if (m_watcher) {
+        m_watcher->addPath(QString::fromStdString(vertPath));
+        m_watcher->addPath(QString::fromStdString(fragPath));
+    }
+
+    return handle;
+}
+
+bool ShaderCompiler::start(ProgramEntry& entry) {
+    // a failed start waits for the next edit instead of retrying every frame
+    entry.dirty = false;
+    try {
+        entry.pending = ShaderLoader::beginShaderProgram(entry.vertPath.c_str(), entry.fragPath.c_str());
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Shader compile failed to start: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool ShaderCompiler::isComplete(GLuint program) const {
+#ifdef GL_KHR_parallel_shader_compile
+    if (m_parallelCompile) {
+        GLint complete = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+        return complete == GL_TRUE;
+    }
+#endif
+    // without the extension we can't ask, so finish on the poll after submission.
+    // drivers that compile on their own threads have still had a frame to work
+    return true;
+}
+
+bool ShaderCompiler::finish(ProgramEntry& entry) {
+    GLuint program = entry.pending;
+    entry.pending = 0;
+
+    try {
+        ShaderLoader::finishShaderProgram(program);
+    } catch (const std::exception& e) {
+        // keep drawing with the previous program so a typo doesn't blank the viewport
+        std::cerr << "Shader compile failed (" << entry.vertPath << ", " << entry.fragPath << "): "
+                  << e.what() << std::endl;
+        return false;
+    }
+
+    if (entry.program != 0) {
+        glDeleteProgram(entry.program);
+        std::cout << "reloaded shader program: " << entry.fragPath << std::endl;
+    }
+    entry.program = program;
+    return true;
+}
+
+bool ShaderCompiler::poll() {
+    bool changed = false;
+
+    // programs started here are left for the next poll, so the driver gets a
+    // frame with them even when isComplete() can't tell
+    std::vector<bool> started(m_programs.size(), false);
+    for (size_t i = 0; i < m_programs.size(); i++) {
+        ProgramEntry& entry = m_programs[i];
+        if (entry.dirty && entry.pending == 0) {
+            started[i] = start(entry);
+        }
+    }
+
+    for (size_t i = 0; i < m_programs.size(); i++) {
+        ProgramEntry& entry = m_programs[i];
+        if (entry.pending == 0 || started[i] || !isComplete(entry.pending)) {
+            continue;
+        }
+        changed |= finish(entry);
+
+        // without completion queries, finishing blocks; spread that over frames
+        if (!m_parallelCompile) {
+            break;
+        }
+    }
+
+    return changed;
+}
+
+void ShaderCompiler::finishAll() {
+    for (ProgramEntry& entry : m_programs) {
+        if (entry.dirty && entry.pending == 0) {
+            start(entry);
+        }
+        if (entry.pending != 0) {
+            finish(entry);
+        }
+    }
+}
+
+GLuint ShaderCompiler::getProgram(int handle) const {
+    if (handle < 0 || handle >= static_cast<int>(m_programs.size())) {
+        return 0;
+    }
+    return m_programs[handle].program;
+}
+
+bool ShaderCompiler::isPending(int handle) const {
+    if (handle < 0 || handle >= static_cast<int>(m_programs.size())) {
+        return false;
+    }
+    return m_programs[handle].pending != 0 || m_programs[handle].dirty;
+}
+
+bool ShaderCompiler::hasPending() const {
+    for (size_t i = 0; i < m_programs.size(); i++) {
+        if (isPending(static_cast<int>(i))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ShaderCompiler::watchSources(bool enabled) {
+    if (!enabled) {
+        m_watcher.reset();
+        return;
+    }
+    if (m_watcher) {
+        return;
+    }
+
+    m_watcher = std::make_unique<QFileSystemWatcher>();
+    QObject::connect(m_watcher.get(), &QFileSystemWatcher::fileChanged,
+                     [this](const QString& path) { onSourceChanged(path.toStdString()); });
+
+    for (const ProgramEntry& entry : m_programs) {
+        m_watcher->addPath(QString::fromStdString(entry.vertPath));
+        m_watcher->addPath(QString::fromStdString(entry.fragPath));
+    }
+}
+
+void ShaderCompiler::onSourceChanged(const std::string& path) {
+    // editors that save by replacing the file drop it from the watch list
+    QString qPath = QString::fromStdString(path);
+    if (QFileInfo::exists(qPath) && !m_watcher->files().contains(qPath)) {
+        m_watcher->addPath(qPath);
+    }
+
+    // the actual recompile happens in poll(), where the context is current
+    for (ProgramEntry& entry : m_programs) {
+        if (entry.vertPath == path || entry.fragPath == path) {
+            entry.dirty = true;
+        }
+    }
+}
+
+void ShaderCompiler::cleanup() {
+    m_watcher.reset();
+    for (ProgramEntry& entry : m_programs) {
+        if (entry.pending != 0) {
+            glDeleteProgram(entry.pending);
+        }
+        if (entry.program != 0) {
+            glDeleteProgram(entry.program);
+        }
+    }
+    m_programs.clear();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class QFileSystemWatcher;
+
+// compiles shader programs without stalling the frame.
+// programs are submitted up front and polled once per frame; until a program
+// has linked, getProgram() returns 0 and the caller draws with a fallback.
+class ShaderCompiler {
+public:
+    ShaderCompiler();
+    ~ShaderCompiler();
+
+    // query parallel compile support (requires a current context)
+    void initialize();
+
+    // queue a program for compilation, returns a handle or -1 if the sources can't be read
+    int submit(const std::string& vertPath, const std::string& fragPath);
+
+    // finish programs the driver is done with, never blocks on an unfinished compile.
+    // returns true if any program was swapped in
+    bool poll();
+
+    // block until every pending program has finished
+    void finishAll();
+
+    // last successfully linked program for a handle, 0 if none yet
+    GLuint getProgram(int handle) const;
+    bool isPending(int handle) const;
+    bool hasPending() const;
+
+    // recompile programs in the background when their source files are edited
+    void watchSources(bool enabled);
+
+    void cleanup();
+
+private:
+    struct ProgramEntry {
+        std::string vertPath;
+        std::string fragPath;
+        GLuint program = 0;   // last program that linked successfully
+        GLuint pending = 0;   // program the driver is still compiling
+        bool dirty = false;   // source changed on disk, needs a resubmit
+    };
+
+    std::vector<ProgramEntry> m_programs;
+    bool m_parallelCompile = false;
+    std::unique_ptr<QFileSystemWatcher> m_watcher;
+
+    bool start(ProgramEntry& entry);
+    bool isComplete(GLuint program) const;
+    bool finish(ProgramEntry& entry);
+    void onSourceChanged(const std::string& path);
+};
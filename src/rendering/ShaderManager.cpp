@@ -1,7 +1,39 @@
 #include "ShaderManager.h"
+#include "RenderStats.h"
 #include "utils/shaderloader.h"
 #include <iostream>
 
+namespace {
+
+// flat shaded stand-in with the same inputs and uniforms as default.vert/frag
+const char* FALLBACK_VERT = R"(#version 330 core
+layout(location = 0) in vec3 position;
+layout(location = 5) in mat4 instanceMatrix;
+
+uniform mat4 modelMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 projectionMatrix;
+uniform bool useInstancing;
+
+void main() {
+    mat4 model = useInstancing ? instanceMatrix : modelMatrix;
+    gl_Position = projectionMatrix * viewMatrix * model * vec4(position, 1.0);
+}
+)";
+
+const char* FALLBACK_FRAG = R"(#version 330 core
+uniform vec4 ambientColor;
+uniform vec4 diffuseColor;
+
+out vec4 fragColor;
+
+void main() {
+    fragColor = vec4(ambientColor.rgb + 0.5 * diffuseColor.rgb, 1.0);
+}
+)";
+
+}
+
 ShaderManager::ShaderManager() {}
 
 ShaderManager::~ShaderManager() {
@@ -9,34 +41,69 @@ ShaderManager::~ShaderManager() {
 }
 
 bool ShaderManager::loadShaders(const std::string& vertPath, const std::string& fragPath) {
-    try {
-        m_program = ShaderLoader::createShaderProgram(vertPath.c_str(), fragPath.c_str());
-        return true;
-    } catch (const std::exception& e) {
-        std::cerr << "Shader loading failed: " << e.what() << std::endl;
+    if (m_fallbackProgram == 0) {
+        m_compiler.initialize();
+        try {
+            GLuint program = ShaderLoader::beginShaderProgramFromSource(FALLBACK_VERT, FALLBACK_FRAG);
+            ShaderLoader::finishShaderProgram(program);
+            m_fallbackProgram = program;
+        } catch (const std::exception& e) {
+            std::cerr << "Fallback shader failed: " << e.what() << std::endl;
+        }
+    }
+
+    m_programHandle = m_compiler.submit(vertPath, fragPath);
+    if (m_programHandle < 0) {
+        std::cerr << "Shader loading failed: " << vertPath << ", " << fragPath << std::endl;
         return false;
     }
+    return true;
+}
+
+void ShaderManager::poll() {
+    m_compiler.poll();
+}
+
+void ShaderManager::waitUntilReady() {
+    m_compiler.finishAll();
+}
+
+void ShaderManager::watchSources(bool enabled) {
+    m_compiler.watchSources(enabled);
+}
+
+GLuint ShaderManager::getProgram() const {
+    GLuint program = m_compiler.getProgram(m_programHandle);
+    return program != 0 ? program : m_fallbackProgram;
+}
+
+bool ShaderManager::isReady() const {
+    return m_compiler.getProgram(m_programHandle) != 0;
 }
 
 void ShaderManager::use() const {
-    glUseProgram(m_program);
+    glUseProgram(getProgram());
+    RenderStats::add(RenderStats::StateChanges);
 }
 
 void ShaderManager::cleanup() {
-    if (m_program != 0) {
-        glDeleteProgram(m_program);
-        m_program = 0;
+    m_compiler.cleanup();
+    m_programHandle = -1;
+    if (m_fallbackProgram != 0) {
+        glDeleteProgram(m_fallbackProgram);
+        m_fallbackProgram = 0;
     }
 }
 
 GLint ShaderManager::getUniformLocation(const std::string& name) const {
-    return glGetUniformLocation(m_program, name.c_str());
+    return glGetUniformLocation(getProgram(), name.c_str());
 }
 
 void ShaderManager::setUniformMat4(const std::string& name, const glm::mat4& mat) const {
     GLint loc = getUniformLocation(name);
     if (loc != -1) {
         glUniformMatrix4fv(loc, 1, GL_FALSE, &mat[0][0]);
+        RenderStats::add(RenderStats::UniformUploads);
     }
 }
 
@@ -44,6 +111,7 @@ void ShaderManager::setUniformVec2(const std::string& name, const glm::vec2& vec
     GLint loc = getUniformLocation(name);
     if (loc != -1) {
         glUniform2fv(loc, 1, &vec[0]);
+        RenderStats::add(RenderStats::UniformUploads);
     }
 }
 
@@ -51,6 +119,7 @@ void ShaderManager::setUniformVec3(const std::string& name, const glm::vec3& vec
     GLint loc = getUniformLocation(name);
     if (loc != -1) {
         glUniform3fv(loc, 1, &vec[0]);
+        RenderStats::add(RenderStats::UniformUploads);
     }
 }
 
@@ -58,6 +127,7 @@ void ShaderManager::setUniformVec4(const std::string& name, const glm::vec4& vec
     GLint loc = getUniformLocation(name);
     if (loc != -1) {
         glUniform4fv(loc, 1, &vec[0]);
+        RenderStats::add(RenderStats::UniformUploads);
     }
 }
 
@@ -65,6 +135,7 @@ void ShaderManager::setUniformFloat(const std::string& name, float value) const
     GLint loc = getUniformLocation(name);
     if (loc != -1) {
         glUniform1f(loc, value);
+        RenderStats::add(RenderStats::UniformUploads);
     }
 }
 
@@ -72,6 +143,7 @@ void ShaderManager::setUniformInt(const std::string& name, int value) const {
     GLint loc = getUniformLocation(name);
     if (loc != -1) {
         glUniform1i(loc, value);
+        RenderStats::add(RenderStats::UniformUploads);
     }
 }
 
@@ -92,5 +164,6 @@ void ShaderManager::setUniformBool(const std::string& name, bool value) const {
     GLint loc = getUniformLocation(name);
     if (loc != -1) {
         glUniform1i(loc, value ? 1 : 0);
+        RenderStats::add(RenderStats::UniformUploads);
     }
 }
\ No newline at end of file
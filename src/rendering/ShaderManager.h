@@ -4,16 +4,28 @@
 #include <string>
 #include <glm/glm.hpp>
 #include "utils/scenedata.h"
+#include "ShaderCompiler.h"
 
 class ShaderManager {
 public:
     ShaderManager();
     ~ShaderManager();
 
+    // compiles a flat-shaded fallback right away and the real program in the background
     bool loadShaders(const std::string& vertPath, const std::string& fragPath);
 
+    // swap in programs that finished compiling, call once per frame
+    void poll();
+
+    // block until the real program is ready (e.g. before saving an image)
+    void waitUntilReady();
+
+    // recompile when the shader files are edited on disk
+    void watchSources(bool enabled);
+
     void use() const;
-    GLuint getProgram() const { return m_program; }
+    GLuint getProgram() const;
+    bool isReady() const;
 
     void setUniformMat4(const std::string& name, const glm::mat4& mat) const;
     void setUniformVec2(const std::string& name, const glm::vec2& vec) const;
@@ -28,7 +40,9 @@ public:
     void cleanup();
 
 private:
-    GLuint m_program = 0;
+    ShaderCompiler m_compiler;
+    int m_programHandle = -1;
+    GLuint m_fallbackProgram = 0;  // used until m_programHandle has linked
 
     GLint getUniformLocation(const std::string& name) const;
 };
@@ -0,0 +1,312 @@
+#include "TextureCache.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'B', 'R', 'E', 'A', 'D', 'T', 'X', '\0'};
+// 2: color mip chains are filtered in 16-bit linear and odd sizes take a
+// three texel footprint, so chains written by version 1 are rebuilt
+const uint32_t CACHE_VERSION = 2;
+const uint64_t LEVEL_ALIGNMENT = 16;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t internalFormat;
+    uint32_t format;         // 0 when the levels are compressed
+    uint32_t type;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t reserved;
+    int64_t sourceModified;  // ms since epoch
+    int64_t sourceSize;
+    uint64_t sourceHash;
+};
+static_assert(sizeof(FileHeader) == 64, "cache header layout changed");
+
+struct FileLevel {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+static_assert(sizeof(FileLevel) == 24, "cache level layout changed");
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// bytes a level of the given size takes in the header's format, 0 for
+// formats this cache never writes
+uint64_t expectedLevelSize(const FileHeader& header, uint64_t width, uint64_t height) {
+    if (header.format == 0) {
+        switch (header.internalFormat) {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RED_RGTC1:
+                return (width + 3) / 4 * ((height + 3) / 4) * 8;
+            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_RG_RGTC2:
+                return (width + 3) / 4 * ((height + 3) / 4) * 16;
+            default:
+                return 0;
+        }
+    }
+
+    uint64_t components = 0;
+    switch (header.format) {
+        case GL_RED: components = 1; break;
+        case GL_RG: components = 2; break;
+        case GL_RGB: components = 3; break;
+        case GL_RGBA:
+        case GL_BGRA: components = 4; break;
+        default: return 0;
+    }
+    uint64_t componentBytes = 0;
+    switch (header.type) {
+        case GL_UNSIGNED_BYTE: componentBytes = 1; break;
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT: componentBytes = 2; break;
+        case GL_FLOAT: componentBytes = 4; break;
+        default: return 0;
+    }
+    return width * height * components * componentBytes;
+}
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+std::string TextureCache::cachePathFor(const std::string& cacheDir, const std::string& sourcePath,
+                                       const std::string& variant) {
+    QString absolute = QFileInfo(QString::fromStdString(sourcePath)).absoluteFilePath();
+    QByteArray key = absolute.toUtf8();
+    if (!variant.empty()) {
+        key += '#' + QByteArray::fromStdString(variant);
+    }
+    uint64_t hash = hashBytes(key.constData(), key.size());
+
+    QString name = QString::number(hash, 16).rightJustified(16, '0') + ".btex";
+    return QDir(QString::fromStdString(cacheDir)).filePath(name).toStdString();
+}
+
+std::unique_ptr<TextureCache::MappedFile> TextureCache::open(const std::string& cachePath, const std::string& sourcePath) {
+    QFileInfo sourceInfo(QString::fromStdString(sourcePath));
+    if (!sourceInfo.exists()) {
+        return nullptr;
+    }
+
+    auto mapped = std::make_unique<MappedFile>();
+    mapped->m_file.setFileName(QString::fromStdString(cachePath));
+    if (!mapped->m_file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    qint64 fileSize = mapped->m_file.size();
+    if (fileSize < static_cast<qint64>(sizeof(FileHeader))) {
+        return nullptr;
+    }
+
+    const uchar* data = mapped->m_file.map(0, fileSize);
+    if (data == nullptr) {
+        return nullptr;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION) {
+        return nullptr;
+    }
+
+    // source changed since the cache was written?
+    if (header.sourceSize != sourceInfo.size()) {
+        return nullptr;
+    }
+    if (header.sourceModified != sourceInfo.lastModified().toMSecsSinceEpoch()) {
+        // touched but maybe not edited (e.g. a fresh checkout), compare contents
+        if (header.sourceHash != hashFile(sourcePath)) {
+            return nullptr;
+        }
+    }
+
+    // each level halves the one before it, down to 1x1 at most
+    uint32_t largest = std::max(header.width, header.height);
+    uint32_t maxLevels = 1;
+    while (largest >> maxLevels) {
+        maxLevels++;
+    }
+    uint64_t tableEnd = sizeof(FileHeader) + uint64_t(header.levelCount) * sizeof(FileLevel);
+    if (header.levelCount == 0 || header.width == 0 || header.height == 0 || header.levelCount > maxLevels ||
+        tableEnd > uint64_t(fileSize)) {
+        std::cerr << "corrupt texture cache file: " << cachePath << std::endl;
+        return nullptr;
+    }
+
+    mapped->internalFormat = header.internalFormat;
+    mapped->format = header.format;
+    mapped->type = header.type;
+
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        FileLevel fileLevel;
+        std::memcpy(&fileLevel, data + sizeof(FileHeader) + i * sizeof(FileLevel), sizeof(fileLevel));
+        // a truncated file or a bad table would have the upload read past the mapping
+        uint32_t width = std::max(1u, header.width >> i);
+        uint32_t height = std::max(1u, header.height >> i);
+        if (fileLevel.width != width || fileLevel.height != height || fileLevel.offset < tableEnd ||
+            fileLevel.offset > uint64_t(fileSize) || fileLevel.size > uint64_t(fileSize) - fileLevel.offset ||
+            fileLevel.size != expectedLevelSize(header, width, height)) {
+            std::cerr << "corrupt texture cache file: " << cachePath << std::endl;
+            return nullptr;
+        }
+
+        Level level;
+        level.width = fileLevel.width;
+        level.height = fileLevel.height;
+        level.data = data + fileLevel.offset;
+        level.size = fileLevel.size;
+        mapped->levels.push_back(level);
+    }
+
+    return mapped;
+}
+
+bool TextureCache::write(const std::string& cachePath, const std::string& sourcePath,
+                         GLenum internalFormat, GLenum format, GLenum type,
+                         const std::vector<Level>& levels) {
+    if (levels.empty()) {
+        return false;
+    }
+
+    QFileInfo sourceInfo(QString::fromStdString(sourcePath));
+    QDir().mkpath(QFileInfo(QString::fromStdString(cachePath)).absolutePath());
+
+    FileHeader header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.internalFormat = internalFormat;
+    header.format = format;
+    header.type = type;
+    header.width = levels[0].width;
+    header.height = levels[0].height;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.sourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+    header.sourceSize = sourceInfo.size();
+    header.sourceHash = hashFile(sourcePath);
+
+    std::vector<FileLevel> table(levels.size());
+    uint64_t offset = alignUp(sizeof(FileHeader) + levels.size() * sizeof(FileLevel), LEVEL_ALIGNMENT);
+    for (size_t i = 0; i < levels.size(); i++) {
+        table[i].offset = offset;
+        table[i].size = levels[i].size;
+        table[i].width = levels[i].width;
+        table[i].height = levels[i].height;
+        offset = alignUp(offset + levels[i].size, LEVEL_ALIGNMENT);
+    }
+
+    QSaveFile file(QString::fromStdString(cachePath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "could not write texture cache: " << cachePath << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(FileLevel));
+
+    const char padding[LEVEL_ALIGNMENT] = {};
+    for (size_t i = 0; i < levels.size(); i++) {
+        qint64 position = file.pos();
+        file.write(padding, table[i].offset - position);
+        file.write(reinterpret_cast<const char*>(levels[i].data), levels[i].size);
+    }
+
+    if (!file.commit()) {
+        std::cerr << "could not write texture cache: " << cachePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool TextureCache::readSourceHash(const std::string& cachePath, const std::string& sourcePath, uint64_t& hash) {
+    QFileInfo sourceInfo(QString::fromStdString(sourcePath));
+    QFile file(QString::fromStdString(cachePath));
+    if (!sourceInfo.exists() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    FileHeader header;
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != static_cast<qint64>(sizeof(header)) ||
+        std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION) {
+        return false;
+    }
+
+    // a touched source has to be hashed again anyway
+    if (header.sourceSize != sourceInfo.size() ||
+        header.sourceModified != sourceInfo.lastModified().toMSecsSinceEpoch()) {
+        return false;
+    }
+
+    hash = header.sourceHash;
+    return true;
+}
+
+uint64_t TextureCache::hashBytes(const void* data, size_t size, uint64_t seed) {
+    const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+    const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (size * prime1);
+
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t w;
+        std::memcpy(&w, bytes + i * 8, 8);
+        w *= prime2;
+        w = rotl(w, 31);
+        w *= prime1;
+        h ^= w;
+        h = rotl(h, 27) * prime1 + prime2;
+    }
+
+    for (size_t i = words * 8; i < size; i++) {
+        h ^= bytes[i] * prime1;
+        h = rotl(h, 11) * prime2;
+    }
+
+    return mix(h);
+}
+
+uint64_t TextureCache::hashFile(const std::string& path) {
+    QFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    if (file.size() == 0) {
+        return hashBytes(nullptr, 0);
+    }
+
+    const uchar* data = file.map(0, file.size());
+    if (data == nullptr) {
+        QByteArray contents = file.readAll();
+        return hashBytes(contents.constData(), contents.size());
+    }
+    return hashBytes(data, file.size());
+}
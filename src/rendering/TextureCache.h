@@ -0,0 +1,60 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <QFile>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// preprocessed texture files: every mip level stored ready for upload behind a
+// small ktx-like header. files are memory-mapped on load so the upload reads
+// straight from the page cache with no decode step
+class TextureCache {
+public:
+    // one mip level, data is either owned elsewhere or points into a mapping
+    struct Level {
+        int width = 0;
+        int height = 0;
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+    };
+
+    // a cache file mapped into memory, valid for as long as this object lives
+    class MappedFile {
+    public:
+        GLenum internalFormat = 0;
+        GLenum format = 0;  // 0 when the levels are compressed
+        GLenum type = 0;
+        std::vector<Level> levels;
+
+        bool isCompressed() const { return format == 0; }
+
+    private:
+        friend class TextureCache;
+        QFile m_file;
+    };
+
+    // cache file location for a source image inside cacheDir. variant separates
+    // differently processed versions of the same image (e.g. as a normal map)
+    static std::string cachePathFor(const std::string& cacheDir, const std::string& sourcePath,
+                                    const std::string& variant = "");
+
+    // map a cache file, returns nullptr if it is missing, corrupt or stale.
+    // a cache is stale when the source size changed, or its mtime changed and
+    // the content hash no longer matches
+    static std::unique_ptr<MappedFile> open(const std::string& cachePath, const std::string& sourcePath);
+
+    // content hash of the source stored in a cache file, only trusted while the
+    // source size and mtime still match. false if there is no such cache file
+    static bool readSourceHash(const std::string& cachePath, const std::string& sourcePath, uint64_t& hash);
+
+    // write all levels to a cache file (atomically, via a temporary file)
+    static bool write(const std::string& cachePath, const std::string& sourcePath,
+                      GLenum internalFormat, GLenum format, GLenum type,
+                      const std::vector<Level>& levels);
+
+    // fast 64-bit content hash
+    static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+    static uint64_t hashFile(const std::string& path);
+};
@@ -1,69 +1,1155 @@
 #include "TextureManager.h"
-#include <QImage>
+#include "NormalMapCodec.h"
+#include "RenderStats.h"
+#include <QDateTime>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include "ZoneProfiler.h"
+
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool isCompressedFormat(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_RG_RGTC2:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// bytes per 4x4 block
+GLsizei compressedBlockBytes(GLenum internalFormat) {
+    switch (internalFormat) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+            return 8;
+        default:
+            return 16;
+    }
+}
+
+size_t levelBytes(GLenum internalFormat, int width, int height) {
+    if (isCompressedFormat(internalFormat)) {
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * compressedBlockBytes(internalFormat);
+    }
+    size_t texelBytes = internalFormat == GL_RG8 ? 2 : internalFormat == GL_R8 ? 1 : 4;
+    return static_cast<size_t>(width) * height * texelBytes;
+}
+
+// gpu size of every level of a full chain
+std::vector<size_t> chainBytes(GLenum internalFormat, int width, int height, int levelCount, int layers) {
+    std::vector<size_t> bytes;
+    for (int level = 0; level < levelCount; level++) {
+        bytes.push_back(levelBytes(internalFormat, std::max(1, width >> level), std::max(1, height >> level)) * layers);
+    }
+    return bytes;
+}
+
+// finest level worth keeping for a texture drawn at screenSize pixels per repeat
+int levelForScreenSize(int width, int height, float screenSize) {
+    float texels = static_cast<float>(std::max(width, height));
+    if (screenSize >= texels) {
+        return 0;
+    }
+    if (screenSize < 1.0f) {
+        return MipGenerator::levelCount(width, height) - 1;
+    }
+    return static_cast<int>(std::floor(std::log2(texels / screenSize)));
+}
+
+}
 
 TextureManager::TextureManager() {
+    m_decodePool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
 }
 
 TextureManager::~TextureManager() {
     cleanup();
 }
 
-GLuint TextureManager::loadTexture(const std::string& filepath) {
-    // check if texture is already loaded
-    auto it = m_textureCache.find(filepath);
-    if (it != m_textureCache.end()) {
-        return it->second;
+void TextureManager::setCacheDirectory(const std::string& directory) {
+    m_cacheDirectory = directory;
+}
+
+void TextureManager::setCompression(bool enabled) {
+    m_compression = enabled;
+}
+
+void TextureManager::setNormalMapCompression(bool enabled) {
+    m_normalMapCompression = enabled;
+}
+
+void TextureManager::setMipOptions(const MipOptions& options) {
+    m_mipOptions = options;
+}
+
+size_t TextureManager::DecodedImage::totalBytes() const {
+    size_t bytes = 0;
+    for (size_t i = firstLevel; i < levels.size(); i++) {
+        bytes += alignUp(levels[i].size, 4);
     }
+    return bytes;
+}
 
-    // load image using qt
-    QImage image(QString::fromStdString(filepath));
-    if (image.isNull()) {
+void TextureManager::setMemoryBudget(size_t bytes) {
+    m_residency.setBudget(bytes);
+}
+
+GLuint TextureManager::loadTexture(const std::string& filepath, TextureUsage usage) {
+    PROFILE_ZONE("TextureManager::loadTexture");
+    // only the cheap existence check happens here, decoding errors are reported later
+    if (!QFileInfo::exists(QString::fromStdString(filepath))) {
         std::cerr << "failed to load texture: " << filepath << std::endl;
         return 0;
     }
 
-    // convert to opengl format (rgba, flipped vertically)
-    image = image.convertToFormat(QImage::Format_RGBA8888);
-    image = image.flipped(Qt::Vertical);  // flip vertically for opengl
+    // check if the same content is already loaded, under this path or another
+    LoadRequest request = makeRequest(0, filepath, usage);
+    bool needsHash = false;
+    ContentKey key = {contentId(filepath, request.cachePath, needsHash), usage};
+    auto it = m_textureCache.find(key);
+    if (it != m_textureCache.end()) {
+        TextureInfo& info = m_textureInfo[it->second];
+        info.refs++;
+        info.paths.insert(filepath);
+        return it->second;
+    }
 
-    // generate and bind texture
+    // generate the texture with a white placeholder so it can be bound right away
     GLuint textureId;
     glGenTextures(1, &textureId);
     glBindTexture(GL_TEXTURE_2D, textureId);
 
-    // upload texture data
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width(), image.height(),
-                 0, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
-
-    // set texture parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    unsigned char whitePixel[4] = {255, 255, 255, 255};
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, whitePixel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
-    // generate mipmaps
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // unbind
     glBindTexture(GL_TEXTURE_2D, 0);
 
     // cache the texture
-    m_textureCache[filepath] = textureId;
+    m_textureCache[key] = textureId;
+    TextureInfo& info = m_textureInfo[textureId];
+    info.filepath = filepath;
+    info.usage = usage;
+    info.contentId = key.first;
+    info.refs = 1;
+    info.generation = ++m_textureGeneration;
+    info.paths.insert(filepath);
+
+    request.textureId = textureId;
+    request.generation = info.generation;
+    request.contentId = needsHash ? key.first : 0;
+    startLoad(request);
+
+    return textureId;
+}
+
+GLuint TextureManager::resolveTexture(GLuint textureId) const {
+    auto alias = m_textureAliases.find(textureId);
+    return alias != m_textureAliases.end() ? alias->second.texture : textureId;
+}
+
+void TextureManager::releaseTexture(GLuint textureId) {
+    // a duplicate's handle holds one of the shared texture's references
+    auto alias = m_textureAliases.find(textureId);
+    if (alias != m_textureAliases.end()) {
+        GLuint texture = alias->second.texture;
+        if (--alias->second.refs == 0) {
+            glDeleteTextures(1, &textureId);
+            m_textureAliases.erase(alias);
+        }
+        textureId = texture;
+    }
+
+    auto it = m_textureInfo.find(textureId);
+    if (it == m_textureInfo.end() || --it->second.refs > 0) {
+        return;
+    }
+
+    // a load still decoding is dropped when it reaches the upload
+    m_textureCache.erase({it->second.contentId, it->second.usage});
+    m_residency.remove(static_cast<int>(textureId));
+    m_textureInfo.erase(it);
+    glDeleteTextures(1, &textureId);
+}
+
+uint64_t TextureManager::contentId(const std::string& filepath, const std::string& cachePath, bool& needsHash) {
+    QFileInfo file(QString::fromStdString(filepath));
+    std::string canonical = file.canonicalFilePath().toStdString();
+    int64_t size = file.size();
+    int64_t modified = file.lastModified().toMSecsSinceEpoch();
+
+    auto it = m_contentIndex.find(canonical);
+    if (it != m_contentIndex.end()) {
+        if (it->second.size == size && it->second.modified == modified) {
+            return it->second.id;
+        }
+        // changed on disk, its old id stays with the texture loaded from it
+        auto unhashed = m_unhashedFiles.find(it->second.size);
+        if (unhashed != m_unhashedFiles.end() && unhashed->second == canonical) {
+            m_unhashedFiles.erase(unhashed);
+        }
+    }
+
+    // nothing is read here, a file that needs comparing is hashed on the decode pool
+    FileIdentity identity = {size, modified, m_nextContentId++, cachePath};
+    auto unhashed = m_unhashedFiles.find(size);
+    if (unhashed == m_unhashedFiles.end() && m_hashedSizes.count(size) == 0) {
+        m_unhashedFiles[size] = canonical;
+    } else {
+        if (unhashed != m_unhashedFiles.end()) {
+            // the file that had this size to itself has to be hashed too
+            const FileIdentity& first = m_contentIndex[unhashed->second];
+            startHash(first.id, unhashed->second, first.cachePath);
+            m_unhashedFiles.erase(unhashed);
+            m_hashedSizes.insert(size);
+        }
+        needsHash = true;
+    }
+    m_contentIndex[canonical] = identity;
+    return identity.id;
+}
+
+void TextureManager::startHash(uint64_t contentId, const std::string& filepath, const std::string& cachePath) {
+    m_pendingHashes++;
+    m_decodePool.start([this, contentId, filepath, cachePath]() {
+        PROFILE_ZONE("hash texture");
+        ContentHash hashed;
+        hashed.contentId = contentId;
+        hashed.hash = hashContent(filepath, cachePath, hashed.hashedFile);
+
+        std::lock_guard<std::mutex> lock(m_decodedMutex);
+        m_hashes.push_back(hashed);
+    });
+}
+
+uint64_t TextureManager::hashContent(const std::string& filepath, const std::string& cachePath, bool& hashedFile) {
+    // a cache file written for the untouched source already knows the hash,
+    // otherwise the file is hashed once (mapped, no decode)
+    uint64_t hash = 0;
+    hashedFile = cachePath.empty() || !TextureCache::readSourceHash(cachePath, filepath, hash);
+    if (hashedFile) {
+        hash = TextureCache::hashFile(filepath);
+    }
+    return hash;
+}
+
+void TextureManager::resolveContent(uint64_t contentId, uint64_t hash, bool hashedFile) {
+    if (hashedFile) {
+        m_hashedFiles++;
+    }
+    for (auto& pair : m_contentIndex) {
+        if (pair.second.id == contentId) {
+            pair.second.id = hash;
+        }
+    }
+    rekeyContent(contentId, hash);
+}
 
-    std::cout << "loaded texture: " << filepath << " (id: " << textureId << ")" << std::endl;
+void TextureManager::rekeyContent(uint64_t from, uint64_t to) {
+    for (TextureUsage usage : {TextureUsage::Color, TextureUsage::NormalMap}) {
+        auto texture = m_textureCache.find({from, usage});
+        if (texture != m_textureCache.end()) {
+            auto existing = m_textureCache.find({to, usage});
+            if (existing == m_textureCache.end()) {
+                m_textureInfo[texture->second].contentId = to;
+                m_textureCache.emplace(ContentKey(to, usage), texture->second);
+            } else {
+                mergeTexture(texture->second, existing->second);
+            }
+            m_textureCache.erase(texture);
+        }
+
+        // a layer already handed out keeps its storage, later loads share the first one
+        auto slot = m_arraySlots.find({from, usage});
+        if (slot != m_arraySlots.end()) {
+            m_arraySlots.emplace(ContentKey(to, usage), slot->second);
+            m_arraySlots.erase(slot);
+        }
+    }
+}
+
+void TextureManager::mergeTexture(GLuint duplicate, GLuint texture) {
+    // the duplicate's references and paths move to the texture, its handle
+    // becomes an alias, and a load still decoding into it is dropped
+    TextureInfo& shared = m_textureInfo[texture];
+    const TextureInfo& info = m_textureInfo[duplicate];
+    shared.refs += info.refs;
+    shared.paths.insert(info.paths.begin(), info.paths.end());
+    m_textureAliases[duplicate] = {texture, info.refs};
+
+    // back to the placeholder, so the duplicate's levels don't take memory
+    int levelCount = info.width > 0 ? MipGenerator::levelCount(info.width, info.height) : 1;
+    glBindTexture(GL_TEXTURE_2D, duplicate);
+    unsigned char whitePixel[4] = {255, 255, 255, 255};
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, whitePixel);
+    for (int i = 1; i < levelCount; i++) {
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_residency.remove(static_cast<int>(duplicate));
+    m_textureInfo.erase(duplicate);
+    std::cout << "texture " << duplicate << " has the same content as " << texture << ", sharing it" << std::endl;
+}
+
+TextureManager::LoadRequest TextureManager::makeRequest(GLuint textureId, const std::string& filepath,
+                                                        TextureUsage usage) const {
+    LoadRequest request;
+    request.textureId = textureId;
+    request.filepath = filepath;
+
+    // normal maps are converted and compressed on the cpu, and cached separately
+    std::string variant;
+    if (usage == TextureUsage::NormalMap) {
+        request.normalFormat = m_normalMapCompression ? GL_COMPRESSED_RG_RGTC2 : GL_RG8;
+        variant = m_normalMapCompression ? "normal-rgtc2" : "normal-rg8";
+    } else {
+        request.mipOptions = m_mipOptions;
+        if (m_mipOptions.filter == MipFilter::Kaiser) {
+            variant = "kaiser";
+        }
+        if (m_mipOptions.alphaCutoff > 0.0f) {
+            char cutoff[16];
+            std::snprintf(cutoff, sizeof(cutoff), "a%.2f", m_mipOptions.alphaCutoff);
+            variant += variant.empty() ? cutoff : std::string("-") + cutoff;
+        }
+    }
+
+    if (!m_cacheDirectory.empty()) {
+        request.cachePath = TextureCache::cachePathFor(m_cacheDirectory, filepath, variant);
+    }
+    if (usage == TextureUsage::Color && m_compression && !request.cachePath.empty() &&
+        GLEW_EXT_texture_compression_s3tc) {
+        request.compressTo = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    }
+    return request;
+}
+
+void TextureManager::startLoad(const LoadRequest& request) {
+    if (m_pendingLoads == 0) {
+        m_loadTimer.start();
+        m_batchLoads = 0;
+        m_batchCacheHits = 0;
+        m_batchDecodeMs = 0.0;
+        m_batchCacheMs = 0.0;
+    }
+    m_pendingLoads++;
+    m_batchLoads++;
+
+    // decode on the pool, the result is picked up by processUploads()
+    m_decodePool.start([this, request]() {
+        PROFILE_ZONE("decode texture");
+        DecodedImage decoded;
+        decoded.textureId = request.textureId;
+        decoded.filepath = request.filepath;
+        decoded.cachePath = request.cachePath;
+        decoded.compressTo = request.compressTo;
+        decoded.array = request.array;
+        decoded.layer = request.layer;
+        decoded.generation = request.generation;
+        decoded.firstLevel = request.firstLevel;
+        decoded.normalFormat = request.normalFormat;
+        decoded.mipOptions = request.mipOptions;
+        if (request.contentId != 0) {
+            decoded.contentId = request.contentId;
+            decoded.contentHash = hashContent(request.filepath, request.cachePath, decoded.hashedFile);
+        }
+        prepareImage(decoded);
+
+        std::lock_guard<std::mutex> lock(m_decodedMutex);
+        m_decoded.push_back(std::move(decoded));
+    });
+}
+
+TextureSlot TextureManager::loadArrayTexture(const std::string& filepath, TextureUsage usage) {
+    auto it = m_arrayPaths.find({filepath, usage});
+    if (it != m_arrayPaths.end()) {
+        return it->second;
+    }
+
+    if (!QFileInfo::exists(QString::fromStdString(filepath))) {
+        std::cerr << "failed to load texture: " << filepath << std::endl;
+        return TextureSlot();
+    }
+
+    // another path to the same image shares its layer
+    LoadRequest request = makeRequest(0, filepath, usage);
+    bool needsHash = false;
+    ContentKey key = {contentId(filepath, request.cachePath, needsHash), usage};
+    if (needsHash) {
+        // layers only decode after allocateArrays(), hash the file now
+        startHash(key.first, filepath, request.cachePath);
+    }
+    auto shared = m_arraySlots.find(key);
+    if (shared != m_arraySlots.end()) {
+        m_arrayPaths[{filepath, usage}] = shared->second;
+        return shared->second;
+    }
+
+    if (m_maxArrayLayers == 0) {
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &m_maxArrayLayers);
+    }
+
+    // grouping needs the size up front; read it from the cache header or the
+    // image header, neither decodes any pixels
+    int width = 0;
+    int height = 0;
+    GLenum internalFormat = request.normalFormat != 0 ? request.normalFormat : GL_RGBA8;
+
+    std::unique_ptr<TextureCache::MappedFile> cached;
+    if (!request.cachePath.empty()) {
+        cached = TextureCache::open(request.cachePath, filepath);
+    }
+    if (cached) {
+        width = cached->levels[0].width;
+        height = cached->levels[0].height;
+        if (cached->isCompressed()) {
+            internalFormat = cached->internalFormat;
+        }
+    } else {
+        QSize size = QImageReader(QString::fromStdString(filepath)).size();
+        width = size.width();
+        height = size.height();
+    }
+
+    if (width <= 0 || height <= 0) {
+        std::cerr << "failed to load texture: " << filepath << std::endl;
+        return TextureSlot();
+    }
+
+    // join an array that hasn't been allocated yet, or start a new one
+    int arrayIndex = -1;
+    for (int i = 0; i < static_cast<int>(m_arrays.size()); i++) {
+        const TextureArray& array = m_arrays[i];
+        if (array.textureId == 0 && array.width == width && array.height == height &&
+            array.internalFormat == internalFormat && array.usage == usage &&
+            static_cast<GLint>(array.layers.size()) < m_maxArrayLayers) {
+            arrayIndex = i;
+            break;
+        }
+    }
+    if (arrayIndex < 0) {
+        TextureArray array;
+        array.width = width;
+        array.height = height;
+        array.internalFormat = internalFormat;
+        array.usage = usage;
+        array.levelCount = MipGenerator::levelCount(width, height);
+        m_arrays.push_back(array);
+        arrayIndex = static_cast<int>(m_arrays.size()) - 1;
+    }
+
+    TextureArray& array = m_arrays[arrayIndex];
+    TextureSlot slot;
+    slot.array = arrayIndex;
+    slot.layer = static_cast<int>(array.layers.size());
+    array.layers.push_back(filepath);
+    array.layerReady.push_back(false);
+
+    m_arraySlots[key] = slot;
+    m_arrayPaths[{filepath, usage}] = slot;
+    return slot;
+}
+
+void TextureManager::allocateArrays() {
+    for (int i = 0; i < static_cast<int>(m_arrays.size()); i++) {
+        const TextureArray& array = m_arrays[i];
+        if (array.textureId != 0 || m_residency.contains(arrayKey(i))) {
+            continue;
+        }
+
+        // nothing resident yet, the residency update picks the first level to load
+        std::vector<size_t> bytes = chainBytes(array.internalFormat, array.width, array.height,
+                                               array.levelCount, static_cast<int>(array.layers.size()));
+        m_residency.add(arrayKey(i), bytes, array.levelCount);
+    }
+
+    updateResidency();
+}
+
+void TextureManager::updateResidency() {
+    for (const TextureResidency::Change& change : m_residency.update()) {
+        if (change.key < 0) {
+            streamArray(-1 - change.key, change.firstLevel);
+        } else {
+            streamTexture(static_cast<GLuint>(change.key), change.firstLevel);
+        }
+    }
+}
+
+void TextureManager::streamTexture(GLuint textureId, int firstLevel) {
+    // the full chain is prepared again (a cheap mapping when cached) and only
+    // the levels from firstLevel down replace the current storage
+    const TextureInfo& info = m_textureInfo[textureId];
+    LoadRequest request = makeRequest(textureId, info.filepath, info.usage);
+    request.generation = info.generation;
+    request.firstLevel = firstLevel;
+    startLoad(request);
+}
+
+void TextureManager::streamArray(int index, int firstLevel) {
+    TextureArray& array = m_arrays[index];
+    GLuint target = allocateArrayStorage(array, firstLevel);
+
+    // the first load fills the array in place, later ones replace it when done
+    if (array.textureId == 0) {
+        array.textureId = target;
+        std::cout << "allocated texture array " << index << ": " << array.width << "x" << array.height
+                  << ", " << array.layers.size() << " layers" << std::endl;
+    } else {
+        array.pendingTextureId = target;
+    }
+    array.streamLevel = firstLevel;
+    array.layersLeft = static_cast<int>(array.layers.size());
+
+    for (int layer = 0; layer < static_cast<int>(array.layers.size()); layer++) {
+        LoadRequest request = makeRequest(target, array.layers[layer], array.usage);
+        request.compressTo = 0;
+        request.array = index;
+        request.layer = layer;
+        request.generation = m_arrayGeneration;
+        request.firstLevel = firstLevel;
+        startLoad(request);
+    }
+}
+
+GLuint TextureManager::allocateArrayStorage(const TextureArray& array, int firstLevel) {
+    GLuint textureId;
+    glGenTextures(1, &textureId);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureId);
+
+    GLsizei layers = static_cast<GLsizei>(array.layers.size());
+    for (int level = firstLevel; level < array.levelCount; level++) {
+        GLsizei width = std::max(1, array.width >> level);
+        GLsizei height = std::max(1, array.height >> level);
+        if (isCompressedFormat(array.internalFormat)) {
+            GLsizei size = static_cast<GLsizei>(levelBytes(array.internalFormat, width, height)) * layers;
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level - firstLevel, array.internalFormat,
+                                   width, height, layers, 0, size, nullptr);
+        } else {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level - firstLevel, array.internalFormat, width, height, layers,
+                         0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, array.levelCount - firstLevel - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
     return textureId;
 }
 
+void TextureManager::requestDetail(GLuint textureId, float screenSize) {
+    textureId = resolveTexture(textureId);
+    auto it = m_textureInfo.find(textureId);
+    if (it == m_textureInfo.end() || it->second.width == 0) {
+        return;
+    }
+    const TextureInfo& info = it->second;
+    m_residency.request(static_cast<int>(textureId), levelForScreenSize(info.width, info.height, screenSize));
+}
+
+void TextureManager::requestDetail(TextureSlot slot, float screenSize) {
+    if (slot.array < 0 || slot.array >= static_cast<int>(m_arrays.size())) {
+        return;
+    }
+    const TextureArray& array = m_arrays[slot.array];
+    m_residency.request(arrayKey(slot.array), levelForScreenSize(array.width, array.height, screenSize));
+}
+
+void TextureManager::finishStream(const DecodedImage& decoded, bool uploaded) {
+    if (decoded.array >= 0) {
+        TextureArray& array = m_arrays[decoded.array];
+        if (uploaded && decoded.textureId == array.textureId) {
+            array.layerReady[decoded.layer] = true;
+        }
+        if (--array.layersLeft > 0) {
+            return;
+        }
+
+        if (array.pendingTextureId != 0) {
+            glDeleteTextures(1, &array.textureId);
+            array.textureId = array.pendingTextureId;
+            array.pendingTextureId = 0;
+        }
+        m_residency.setResident(arrayKey(decoded.array), array.streamLevel);
+        logResidency();
+        return;
+    }
+
+    int key = static_cast<int>(decoded.textureId);
+    if (!uploaded) {
+        m_residency.cancelStream(key);
+        return;
+    }
+
+    if (m_residency.contains(key)) {
+        m_residency.setResident(key, decoded.firstLevel);
+        logResidency();
+        return;
+    }
+
+    // first upload, now the size is known
+    TextureInfo& info = m_textureInfo[decoded.textureId];
+    info.width = decoded.levels[0].width;
+    info.height = decoded.levels[0].height;
+    info.internalFormat = decoded.format == 0 ? decoded.internalFormat :
+                          decoded.compressTo != 0 ? decoded.compressTo : decoded.internalFormat;
+    std::vector<size_t> bytes = chainBytes(info.internalFormat, info.width, info.height,
+                                           static_cast<int>(decoded.levels.size()), 1);
+    m_residency.add(key, bytes, decoded.firstLevel);
+}
+
+void TextureManager::logResidency() const {
+    TextureResidency::Stats stats = m_residency.getStats();
+    std::cout << "texture residency: " << stats.residentBytes / (1024.0 * 1024.0) << " MB";
+    if (stats.budgetBytes > 0) {
+        std::cout << " of " << stats.budgetBytes / (1024.0 * 1024.0) << " MB budget";
+    }
+    std::cout << ", " << stats.textures << " textures (" << stats.reduced << " reduced, "
+              << stats.streaming << " streaming)" << std::endl;
+}
+
+TextureManager::DedupStats TextureManager::getDedupStats() const {
+    // every path past the first would have been a texture (or layer) of its own
+    DedupStats stats;
+    for (const auto& pair : m_textureInfo) {
+        const TextureInfo& info = pair.second;
+        stats.paths += static_cast<int>(info.paths.size());
+        stats.textures++;
+        if (info.width > 0) {
+            std::vector<size_t> bytes = chainBytes(info.internalFormat, info.width, info.height,
+                                                   MipGenerator::levelCount(info.width, info.height), 1);
+            for (size_t level : bytes) {
+                stats.dedupedBytes += level * (info.paths.size() - 1);
+            }
+        }
+    }
+
+    stats.hashedFiles = m_hashedFiles;
+
+    // a copy hashed after it got a layer of its own counts as a texture
+    std::set<std::pair<int, int>> layers;
+    for (const auto& pair : m_arrayPaths) {
+        layers.insert({pair.second.array, pair.second.layer});
+    }
+    stats.paths += static_cast<int>(m_arrayPaths.size());
+    stats.textures += static_cast<int>(layers.size());
+    for (const auto& pair : m_arrayPaths) {
+        const TextureArray& array = m_arrays[pair.second.array];
+        if (array.layers[pair.second.layer] == pair.first.first) {
+            continue;
+        }
+        for (size_t level : chainBytes(array.internalFormat, array.width, array.height, array.levelCount, 1)) {
+            stats.dedupedBytes += level;
+        }
+    }
+    return stats;
+}
+
+bool TextureManager::isLayerReady(TextureSlot slot) const {
+    if (slot.array < 0 || slot.array >= static_cast<int>(m_arrays.size())) {
+        return false;
+    }
+    const TextureArray& array = m_arrays[slot.array];
+    return slot.layer < static_cast<int>(array.layerReady.size()) && array.layerReady[slot.layer];
+}
+
+void TextureManager::bindArray(int array, GLenum textureUnit) {
+    glActiveTexture(textureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, getArrayTexture(array));
+    RenderStats::add(RenderStats::StateChanges);
+}
+
+GLuint TextureManager::getArrayTexture(int array) const {
+    if (array < 0 || array >= static_cast<int>(m_arrays.size())) {
+        return 0;
+    }
+    return m_arrays[array].textureId;
+}
+
+void TextureManager::clearArrays() {
+    for (int i = 0; i < static_cast<int>(m_arrays.size()); i++) {
+        TextureArray& array = m_arrays[i];
+        if (array.textureId != 0) {
+            glDeleteTextures(1, &array.textureId);
+        }
+        if (array.pendingTextureId != 0) {
+            glDeleteTextures(1, &array.pendingTextureId);
+        }
+        m_residency.remove(arrayKey(i));
+    }
+    m_arrays.clear();
+    m_arraySlots.clear();
+    m_arrayPaths.clear();
+
+    // layers still decoding are dropped when they reach the upload
+    m_arrayGeneration++;
+}
+
+void TextureManager::prepareImage(DecodedImage& decoded) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // a valid cache file skips decoding and mip generation entirely
+    if (!decoded.cachePath.empty()) {
+        decoded.mapped = TextureCache::open(decoded.cachePath, decoded.filepath);
+        if (decoded.mapped) {
+            decoded.internalFormat = decoded.mapped->internalFormat;
+            decoded.format = decoded.mapped->format;
+            decoded.type = decoded.mapped->type;
+            decoded.levels = decoded.mapped->levels;
+            decoded.fromCache = true;
+            decoded.compressTo = 0;
+            decoded.prepareMs = timer.nsecsElapsed() / 1e6;
+            return;
+        }
+    }
+
+    decodeImage(decoded);
+    if (decoded.image.isNull()) {
+        return;
+    }
+
+    if (decoded.normalFormat != 0) {
+        convertNormalMap(decoded);
+    } else {
+        const QImage& image = decoded.image;
+        decoded.mips = MipGenerator::generateRGBA8(image.constBits(), image.width(), image.height(), image.bytesPerLine(),
+                                                    decoded.mipOptions);
+
+        TextureCache::Level base;
+        base.width = image.width();
+        base.height = image.height();
+        base.data = image.constBits();
+        base.size = static_cast<size_t>(image.sizeInBytes());
+        decoded.levels.push_back(base);
+    }
+
+    for (const MipLevel& mip : decoded.mips) {
+        TextureCache::Level level;
+        level.width = mip.width;
+        level.height = mip.height;
+        level.data = mip.pixels.data();
+        level.size = mip.pixels.size();
+        decoded.levels.push_back(level);
+    }
+
+    // compressed caches are written after the driver has compressed the upload
+    if (!decoded.cachePath.empty() && decoded.compressTo == 0) {
+        TextureCache::write(decoded.cachePath, decoded.filepath,
+                            decoded.internalFormat, decoded.format, decoded.type, decoded.levels);
+    }
+
+    decoded.prepareMs = timer.nsecsElapsed() / 1e6;
+}
+
+void TextureManager::decodeImage(DecodedImage& decoded) {
+    // load image using qt
+    QImageReader reader(QString::fromStdString(decoded.filepath));
+    QImage image = reader.read();
+    if (image.isNull()) {
+        return;
+    }
+
+    // convert to opengl format in place (no copy if the decoder already produced rgba)
+    image.convertTo(QImage::Format_RGBA8888);
+
+    // flip vertically for opengl by swapping rows in place instead of copying the image
+    int height = image.height();
+    qsizetype rowBytes = image.bytesPerLine();
+    for (int y = 0; y < height / 2; y++) {
+        uchar* top = image.scanLine(y);
+        uchar* bottom = image.scanLine(height - 1 - y);
+        std::swap_ranges(top, top + rowBytes, bottom);
+    }
+
+    decoded.image = std::move(image);
+}
+
+void TextureManager::convertNormalMap(DecodedImage& decoded) {
+    // every level, including the base, ends up in decoded.mips
+    MipLevel base;
+    base.width = decoded.image.width();
+    base.height = decoded.image.height();
+    base.pixels = NormalMapCodec::toRG8(decoded.image.constBits(), base.width, base.height,
+                                        decoded.image.bytesPerLine());
+    decoded.image = QImage();
+
+    std::vector<MipLevel> levels = MipGenerator::generateNormalRG8(base.pixels.data(), base.width, base.height);
+    levels.insert(levels.begin(), std::move(base));
+
+    if (decoded.normalFormat == GL_COMPRESSED_RG_RGTC2) {
+        for (MipLevel& level : levels) {
+            level.pixels = NormalMapCodec::compressRGTC2(level.pixels.data(), level.width, level.height);
+        }
+        decoded.internalFormat = GL_COMPRESSED_RG_RGTC2;
+        decoded.format = 0;
+    } else {
+        decoded.internalFormat = GL_RG8;
+        decoded.format = GL_RG;
+    }
+    decoded.type = GL_UNSIGNED_BYTE;
+    decoded.mips = std::move(levels);
+}
+
+void TextureManager::processUploads() {
+    uploadImages(false);
+
+    // act on the detail requested while drawing the previous frame
+    updateResidency();
+
+    TextureResidency::Stats stats = m_residency.getStats();
+    RenderStats::set(RenderStats::TextureBytes, static_cast<int64_t>(stats.residentBytes));
+    RenderStats::set(RenderStats::TextureBudgetBytes, static_cast<int64_t>(stats.budgetBytes));
+    RenderStats::set(RenderStats::Textures, stats.textures);
+    RenderStats::set(RenderStats::TexturesReduced, stats.reduced);
+}
+
+void TextureManager::finishPendingLoads() {
+    while (m_pendingLoads > 0 || m_pendingHashes > 0) {
+        m_decodePool.waitForDone();
+        uploadImages(true);
+    }
+}
+
+void TextureManager::uploadImages(bool blocking) {
+    // content hashes first, so a duplicate still decoding is dropped below
+    std::deque<ContentHash> hashes;
+    {
+        std::lock_guard<std::mutex> lock(m_decodedMutex);
+        hashes.swap(m_hashes);
+    }
+    for (const ContentHash& hashed : hashes) {
+        resolveContent(hashed.contentId, hashed.hash, hashed.hashedFile);
+        m_pendingHashes--;
+    }
+
+    size_t uploadedBytes = 0;
+
+    while (true) {
+        DecodedImage decoded;
+        {
+            std::lock_guard<std::mutex> lock(m_decodedMutex);
+            if (m_decoded.empty()) {
+                break;
+            }
+
+            // spread large batches over several frames, but always make progress
+            size_t bytes = m_decoded.front().totalBytes();
+            if (!blocking && uploadedBytes > 0 && uploadedBytes + bytes > UPLOAD_BYTES_PER_FRAME) {
+                break;
+            }
+
+            decoded = std::move(m_decoded.front());
+            m_decoded.pop_front();
+        }
+
+        // a texture that turns out to duplicate another one is merged into it
+        if (decoded.contentId != 0) {
+            resolveContent(decoded.contentId, decoded.contentHash, decoded.hashedFile);
+            decoded.contentId = 0;
+        }
+
+        if (!isCurrentLoad(decoded)) {
+            // its texture was released (or its array deleted) while decoding
+            finishLoad(decoded);
+            continue;
+        }
+
+        if (decoded.levels.empty() || (decoded.array >= 0 && !canUploadToArray(decoded))) {
+            // the texture keeps its white placeholder (or the layer stays not ready)
+            std::cerr << "failed to load texture: " << decoded.filepath << std::endl;
+            finishStream(decoded, false);
+            finishLoad(decoded);
+            continue;
+        }
+
+        if (!uploadImage(decoded, blocking)) {
+            // the next pixel buffer is still in flight, try again next frame
+            std::lock_guard<std::mutex> lock(m_decodedMutex);
+            m_decoded.push_front(std::move(decoded));
+            break;
+        }
+
+        if (decoded.compressTo != 0 && decoded.firstLevel == 0) {
+            writeCompressedCache(decoded);
+        }
+
+        uploadedBytes += decoded.totalBytes();
+        finishStream(decoded, true);
+        finishLoad(decoded);
+    }
+}
+
+bool TextureManager::uploadImage(const DecodedImage& decoded, bool blocking) {
+    PixelBuffer& buffer = m_pixelBuffers[m_nextPixelBuffer];
+
+    if (buffer.fence != nullptr) {
+        // non-blocking uploads only peek at the fence
+        GLbitfield flags = blocking ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+        GLuint64 timeout = blocking ? GL_TIMEOUT_IGNORED : 0;
+        GLenum result = glClientWaitSync(buffer.fence, flags, timeout);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            return false;
+        }
+        glDeleteSync(buffer.fence);
+        buffer.fence = nullptr;
+    }
+
+    GLsizeiptr bytes = decoded.totalBytes();
+
+    if (buffer.pbo == 0) {
+        glGenBuffers(1, &buffer.pbo);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo);
+    if (buffer.size < bytes) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        buffer.size = bytes;
+    }
+
+    // the fence above guarantees the gpu is done with this buffer
+    unsigned char* mapped = static_cast<unsigned char*>(
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    if (mapped == nullptr) {
+        std::cerr << "failed to map pixel buffer for: " << decoded.filepath << std::endl;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return true;
+    }
+
+    // every resident level goes into the buffer back to back, straight from the
+    // decoded image or the cache mapping. offsets[0] is decoded.firstLevel
+    std::vector<size_t> offsets;
+    size_t offset = 0;
+    for (size_t i = decoded.firstLevel; i < decoded.levels.size(); i++) {
+        const TextureCache::Level& level = decoded.levels[i];
+        std::memcpy(mapped + offset, level.data, level.size);
+        offsets.push_back(offset);
+        offset += alignUp(level.size, 4);
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // rg8 rows are not 4-byte aligned at odd widths, every level is tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    int levelCount = static_cast<int>(decoded.levels.size());
+
+    if (decoded.array >= 0) {
+        // layers go into storage allocated by streamArray()
+        glBindTexture(GL_TEXTURE_2D_ARRAY, decoded.textureId);
+        for (int i = decoded.firstLevel; i < levelCount; i++) {
+            const TextureCache::Level& level = decoded.levels[i];
+            const void* data = reinterpret_cast<const void*>(offsets[i - decoded.firstLevel]);
+            GLint target = i - decoded.firstLevel;
+            if (decoded.format == 0) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, decoded.layer, level.width, level.height, 1,
+                                          decoded.internalFormat, static_cast<GLsizei>(level.size), data);
+            } else {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, decoded.layer, level.width, level.height, 1,
+                                decoded.format, decoded.type, data);
+            }
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    } else {
+        uploadTextureLevels(decoded, offsets);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    m_nextPixelBuffer = (m_nextPixelBuffer + 1) % PIXEL_BUFFER_COUNT;
+
+    std::cout << "loaded texture: " << decoded.filepath << " (id: " << decoded.textureId
+              << (decoded.array >= 0 ? ", layer " + std::to_string(decoded.layer) : "")
+              << (decoded.firstLevel > 0 ? ", from level " + std::to_string(decoded.firstLevel) : "")
+              << (decoded.fromCache ? ", cached" : "") << ")" << std::endl;
+
+    return true;
+}
+
+bool TextureManager::isCurrentLoad(const DecodedImage& decoded) const {
+    if (decoded.array < 0) {
+        auto it = m_textureInfo.find(decoded.textureId);
+        return it != m_textureInfo.end() && it->second.generation == decoded.generation;
+    }
+    if (decoded.generation != m_arrayGeneration || decoded.array >= static_cast<int>(m_arrays.size())) {
+        return false;
+    }
+    const TextureArray& array = m_arrays[decoded.array];
+    return decoded.textureId == array.textureId || decoded.textureId == array.pendingTextureId;
+}
+
+bool TextureManager::canUploadToArray(const DecodedImage& decoded) const {
+    const TextureArray& array = m_arrays[decoded.array];
+    return decoded.internalFormat == array.internalFormat &&
+           decoded.levels[0].width == array.width &&
+           decoded.levels[0].height == array.height &&
+           static_cast<int>(decoded.levels.size()) == array.levelCount;
+}
+
+void TextureManager::uploadTextureLevels(const DecodedImage& decoded, const std::vector<size_t>& offsets) {
+    // upload texture data from the pixel buffer, the copy to the texture happens asynchronously.
+    // levels above firstLevel are skipped, so level firstLevel becomes level 0
+    glBindTexture(GL_TEXTURE_2D, decoded.textureId);
+    int levelCount = static_cast<int>(decoded.levels.size());
+    int residentCount = levelCount - decoded.firstLevel;
+    for (int i = decoded.firstLevel; i < levelCount; i++) {
+        const TextureCache::Level& level = decoded.levels[i];
+        const void* data = reinterpret_cast<const void*>(offsets[i - decoded.firstLevel]);
+        GLint target = i - decoded.firstLevel;
+        if (decoded.format == 0) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, target, decoded.internalFormat, level.width, level.height,
+                                   0, static_cast<GLsizei>(level.size), data);
+        } else {
+            GLenum internalFormat = decoded.compressTo != 0 ? decoded.compressTo : decoded.internalFormat;
+            glTexImage2D(GL_TEXTURE_2D, target, internalFormat, level.width, level.height,
+                         0, decoded.format, decoded.type, data);
+        }
+    }
+
+    // release the small levels left over from a finer residency
+    for (int i = residentCount; i < levelCount; i++) {
+        glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    // set texture parameters, all levels come precomputed so no glGenerateMipmap
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, residentCount - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // unbind
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureManager::writeCompressedCache(const DecodedImage& decoded) {
+    // read back what the driver compressed. this waits for the upload, but only
+    // happens the first time a texture is seen
+    glBindTexture(GL_TEXTURE_2D, decoded.textureId);
+
+    GLint compressed = GL_FALSE;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    if (compressed != GL_TRUE) {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    auto storage = std::make_shared<std::vector<std::vector<unsigned char>>>();
+    std::vector<TextureCache::Level> levels;
+    for (int i = 0; i < static_cast<int>(decoded.levels.size()); i++) {
+        GLint size = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        storage->emplace_back(size);
+        glGetCompressedTexImage(GL_TEXTURE_2D, i, storage->back().data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (size_t i = 0; i < storage->size(); i++) {
+        TextureCache::Level level;
+        level.width = decoded.levels[i].width;
+        level.height = decoded.levels[i].height;
+        level.data = (*storage)[i].data();
+        level.size = (*storage)[i].size();
+        levels.push_back(level);
+    }
+
+    std::string cachePath = decoded.cachePath;
+    std::string filepath = decoded.filepath;
+    GLenum internalFormat = decoded.compressTo;
+    m_decodePool.start([storage, levels, cachePath, filepath, internalFormat]() {
+        TextureCache::write(cachePath, filepath, internalFormat, 0, 0, levels);
+    });
+}
+
+void TextureManager::finishLoad(const DecodedImage& decoded) {
+    if (decoded.fromCache) {
+        m_batchCacheHits++;
+        m_batchCacheMs += decoded.prepareMs;
+    } else {
+        m_batchDecodeMs += decoded.prepareMs;
+    }
+
+    m_pendingLoads--;
+    if (m_pendingLoads == 0) {
+        std::cout << "loaded " << m_batchLoads << " textures in " << m_loadTimer.elapsed() << " ms ("
+                  << m_batchCacheHits << " from cache, "
+                  << m_batchCacheMs << " ms mapping, " << m_batchDecodeMs << " ms decoding)" << std::endl;
+
+        DedupStats dedup = getDedupStats();
+        if (dedup.paths > dedup.textures) {
+            std::cout << "shared " << dedup.paths - dedup.textures << " duplicate texture paths ("
+                      << dedup.dedupedBytes / (1024.0 * 1024.0) << " MB)" << std::endl;
+        }
+    }
+}
+
 void TextureManager::bindTexture(GLuint textureId, GLenum textureUnit) {
     glActiveTexture(textureUnit);
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    glBindTexture(GL_TEXTURE_2D, resolveTexture(textureId));
+    RenderStats::add(RenderStats::StateChanges);
 }
 
 void TextureManager::cleanup() {
+    // decode jobs hold a pointer to this manager
+    m_decodePool.clear();
+    m_decodePool.waitForDone();
+    {
+        std::lock_guard<std::mutex> lock(m_decodedMutex);
+        m_decoded.clear();
+        m_hashes.clear();
+    }
+    m_pendingLoads = 0;
+    m_pendingHashes = 0;
+
+    for (PixelBuffer& buffer : m_pixelBuffers) {
+        if (buffer.fence != nullptr) {
+            glDeleteSync(buffer.fence);
+            buffer.fence = nullptr;
+        }
+        if (buffer.pbo != 0) {
+            glDeleteBuffers(1, &buffer.pbo);
+            buffer.pbo = 0;
+            buffer.size = 0;
+        }
+    }
+
     for (auto& pair : m_textureCache) {
         glDeleteTextures(1, &pair.second);
     }
     m_textureCache.clear();
+    m_textureInfo.clear();
+    for (auto& pair : m_textureAliases) {
+        glDeleteTextures(1, &pair.first);
+    }
+    m_textureAliases.clear();
+
+    clearArrays();
+    m_residency.clear();
 }
@@ -1,24 +1,307 @@
 #pragma once
 
 #include <GL/glew.h>
-#include <string>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QThreadPool>
+#include <atomic>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "MipGenerator.h"
+#include "TextureCache.h"
+#include "TextureResidency.h"
+
+// how a texture's texels are interpreted, which decides how it is stored
+enum class TextureUsage {
+    Color,      // srgb color, rgba8 (or dxt5 with compression)
+    NormalMap,  // tangent-space normals, two channels (rg8 or rgtc2), z rebuilt in the shader
+};
+
+// where a material texture lives inside the texture arrays
+struct TextureSlot {
+    int array = -1;  // -1 when there is no texture
+    int layer = 0;
+
+    bool isValid() const { return array >= 0; }
+};
 
 class TextureManager {
 public:
     TextureManager();
     ~TextureManager();
 
-    // load texture from file path (cached)
-    GLuint loadTexture(const std::string& filepath);
+    // preprocessed mip chains are written to and mapped from this directory.
+    // empty (the default) disables the cache
+    void setCacheDirectory(const std::string& directory);
+
+    // store newly cached textures s3tc compressed when the driver supports it
+    void setCompression(bool enabled);
+
+    // store normal maps as rgtc2 (default) instead of rg8
+    void setNormalMapCompression(bool enabled);
+
+    // filter and alpha coverage for color mip chains built on the cpu. non-default
+    // options are cached separately so switching them doesn't reuse stale chains
+    void setMipOptions(const MipOptions& options);
+
+    // request a texture by file path. returns a handle immediately; it samples as
+    // opaque white until the image is decoded and uploaded. textures are keyed by
+    // content, so the same image reached through another path, a symlink or a
+    // copied folder shares one texture. every call adds a reference.
+    // returns 0 if the file does not exist
+    GLuint loadTexture(const std::string& filepath, TextureUsage usage = TextureUsage::Color);
+
+    // a copy is only recognized once its decode job has hashed it, so it can get
+    // a handle of its own first. that handle then stands for the shared texture:
+    // this returns the texture it samples, bindTexture() and requestDetail()
+    // follow it and releaseTexture() drops a reference of the shared one
+    GLuint resolveTexture(GLuint textureId) const;
+
+    // drop a reference from loadTexture(), the texture is deleted with the last one
+    void releaseTexture(GLuint textureId);
+
+    // upload decoded images through the pixel buffer ring, call once per frame
+    void processUploads();
+
+    // block until every requested texture is uploaded (e.g. before saving an image)
+    void finishPendingLoads();
+
+    bool hasPendingLoads() const { return m_pendingLoads > 0; }
 
     // bind a texture to a specific texture unit
     void bindTexture(GLuint textureId, GLenum textureUnit);
 
+    // material textures are packed into GL_TEXTURE_2D_ARRAY layers grouped by
+    // size and format, so draws with different textures only change a layer index.
+    // add every texture of a scene, then allocateArrays() creates the arrays and
+    // starts loading the layers. files with the same content and usage share a
+    // slot, a copy given a layer before its hash came in keeps that layer
+    TextureSlot loadArrayTexture(const std::string& filepath, TextureUsage usage = TextureUsage::Color);
+    void allocateArrays();
+
+    // a layer is ready once its pixels have been uploaded
+    bool isLayerReady(TextureSlot slot) const;
+
+    void bindArray(int array, GLenum textureUnit);
+    GLuint getArrayTexture(int array) const;
+
+    // delete all arrays (e.g. when the scene changes)
+    void clearArrays();
+
+    // gpu memory for textures in bytes, 0 = unlimited. over budget, least recently
+    // used textures lose their top mips until the rest fits
+    void setMemoryBudget(size_t bytes);
+
+    // report that a texture was drawn covering about this many pixels per repeat
+    // on screen. streams finer mips in (or lets them go) to match
+    void requestDetail(GLuint textureId, float screenSize);
+    void requestDetail(TextureSlot slot, float screenSize);
+
+    TextureResidency::Stats getResidencyStats() const { return m_residency.getStats(); }
+
+    // how much sharing textures by content saved
+    struct DedupStats {
+        int paths = 0;            // distinct paths requested
+        int textures = 0;         // distinct images loaded for them
+        size_t dedupedBytes = 0;  // gpu memory the duplicates would have taken
+        int hashedFiles = 0;      // files read whole to compare them with another of their size
+    };
+    DedupStats getDedupStats() const;
+
     // clean up all loaded textures
     void cleanup();
 
 private:
-    // cache: filepath -> texture id
-    std::map<std::string, GLuint> m_textureCache;
+    // everything a decode job needs, copied into the worker
+    struct LoadRequest {
+        GLuint textureId = 0;
+        std::string filepath;
+        std::string cachePath;
+        GLenum compressTo = 0;
+        GLenum normalFormat = 0;  // GL_RG8 or GL_COMPRESSED_RG_RGTC2 for normal maps, 0 for color
+        int array = -1;       // upload into this array layer instead of a 2d texture
+        int layer = 0;
+        int generation = 0;   // a released texture or cleared arrays make the request stale
+        int firstLevel = 0;   // mips above this level are not uploaded
+        MipOptions mipOptions;
+        uint64_t contentId = 0;  // id the job's hash of the file replaces, 0 if already known
+    };
+
+    // a full mip chain waiting for upload, either mapped from the cache or
+    // decoded from the source image (rgba8888, already flipped for opengl)
+    struct DecodedImage {
+        GLuint textureId = 0;
+        std::string filepath;
+        std::string cachePath;
+        int array = -1;
+        int layer = 0;
+        int generation = 0;
+        int firstLevel = 0;
+        GLenum normalFormat = 0;
+        MipOptions mipOptions;
+
+        GLenum internalFormat = GL_RGBA8;
+        GLenum format = GL_RGBA;  // 0 when the levels are compressed
+        GLenum type = GL_UNSIGNED_BYTE;
+        std::vector<TextureCache::Level> levels;
+
+        QImage image;                                      // level 0 of a decoded source
+        std::vector<MipLevel> mips;                        // levels 1..n of a decoded source (0..n for normal maps)
+        std::unique_ptr<TextureCache::MappedFile> mapped;  // level storage on a cache hit
+
+        bool fromCache = false;
+        GLenum compressTo = 0;  // let the driver compress on upload, then cache the result
+        double prepareMs = 0.0;
+
+        uint64_t contentId = 0;  // from the request, with the hash the job took
+        uint64_t contentHash = 0;
+        bool hashedFile = false;  // the hash came from reading the file, not a cache header
+
+        size_t totalBytes() const;
+    };
+
+    // one texture array, every layer has the same size, format and level count.
+    // changing its resident levels loads every layer into a new array that
+    // replaces the old one once complete
+    struct TextureArray {
+        GLuint textureId = 0;  // 0 until the first load starts
+        int width = 0;
+        int height = 0;
+        GLenum internalFormat = GL_RGBA8;
+        TextureUsage usage = TextureUsage::Color;
+        int levelCount = 1;    // full chain, independent of what is resident
+        std::vector<std::string> layers;  // source file per layer
+        std::vector<bool> layerReady;
+
+        GLuint pendingTextureId = 0;
+        int streamLevel = 0;
+        int layersLeft = 0;
+    };
+
+    // one slot of the upload ring; the fence guards reuse while the gpu still reads it
+    struct PixelBuffer {
+        GLuint pbo = 0;
+        GLsizeiptr size = 0;
+        GLsync fence = nullptr;
+    };
+
+    static constexpr int PIXEL_BUFFER_COUNT = 3;
+    static constexpr size_t UPLOAD_BYTES_PER_FRAME = 32 * 1024 * 1024;
+
+    // textures are identified by (content id, usage)
+    using ContentKey = std::pair<uint64_t, TextureUsage>;
+
+    // cache: content -> texture id
+    std::map<ContentKey, GLuint> m_textureCache;
+
+    // source and full size of a standalone texture (size is 0 until its first upload)
+    struct TextureInfo {
+        std::string filepath;          // first path it was loaded from
+        TextureUsage usage = TextureUsage::Color;
+        uint64_t contentId = 0;
+        int refs = 0;
+        int generation = 0;            // tells loads of a reused texture name apart
+        std::set<std::string> paths;   // every path that resolved to this texture
+        int width = 0;
+        int height = 0;
+        GLenum internalFormat = 0;
+    };
+    std::map<GLuint, TextureInfo> m_textureInfo;
+    int m_textureGeneration = 0;
+
+    // handles of textures that turned out to duplicate another one. the name is
+    // kept (holding the placeholder) until its own references are released
+    struct TextureAlias {
+        GLuint texture = 0;
+        int refs = 0;
+    };
+    std::map<GLuint, TextureAlias> m_textureAliases;
+
+    // path -> content id, valid while the file keeps its size and mtime. keyed
+    // by the canonical path so relative paths and symlinks find the same entry.
+    // files can only share content with files of the same size, so every file
+    // starts with a serial id and is only hashed once another file of that size
+    // turns up. the hash is taken on the decode pool, and the id becomes the hash
+    // when processUploads() picks it up
+    struct FileIdentity {
+        int64_t size = 0;
+        int64_t modified = 0;
+        uint64_t id = 0;
+        std::string cachePath;  // may already know the hash
+    };
+    std::map<std::string, FileIdentity> m_contentIndex;
+    std::map<int64_t, std::string> m_unhashedFiles;  // size -> the only file of that size
+    std::set<int64_t> m_hashedSizes;                 // sizes shared by several files
+    uint64_t m_nextContentId = 1;
+    int m_hashedFiles = 0;
+
+    // hashes of files that have no decode job starting (the file that had its
+    // size to itself, array layers) are taken by jobs of their own
+    struct ContentHash {
+        uint64_t contentId = 0;
+        uint64_t hash = 0;
+        bool hashedFile = false;
+    };
+    std::deque<ContentHash> m_hashes;  // guarded by m_decodedMutex
+    std::atomic<int> m_pendingHashes = 0;
+
+    // standalone textures use their id as residency key, arrays negative keys
+    TextureResidency m_residency;
+    static int arrayKey(int array) { return -1 - array; }
+
+    std::vector<TextureArray> m_arrays;
+    std::map<ContentKey, TextureSlot> m_arraySlots;
+    std::map<std::pair<std::string, TextureUsage>, TextureSlot> m_arrayPaths;
+    int m_arrayGeneration = 0;
+    GLint m_maxArrayLayers = 0;
+
+    std::string m_cacheDirectory;
+    bool m_compression = false;
+    bool m_normalMapCompression = true;
+    MipOptions m_mipOptions;
+
+    QThreadPool m_decodePool;
+    std::mutex m_decodedMutex;
+    std::deque<DecodedImage> m_decoded;
+    std::atomic<int> m_pendingLoads = 0;
+
+    PixelBuffer m_pixelBuffers[PIXEL_BUFFER_COUNT];
+    int m_nextPixelBuffer = 0;
+
+    // load time of the current batch, split by source so the cache speedup is visible
+    QElapsedTimer m_loadTimer;
+    int m_batchLoads = 0;
+    int m_batchCacheHits = 0;
+    double m_batchDecodeMs = 0.0;
+    double m_batchCacheMs = 0.0;
+
+    void startLoad(const LoadRequest& request);
+    uint64_t contentId(const std::string& filepath, const std::string& cachePath, bool& needsHash);
+    void startHash(uint64_t contentId, const std::string& filepath, const std::string& cachePath);
+    static uint64_t hashContent(const std::string& filepath, const std::string& cachePath, bool& hashedFile);
+    void resolveContent(uint64_t contentId, uint64_t hash, bool hashedFile);
+    void rekeyContent(uint64_t from, uint64_t to);
+    void mergeTexture(GLuint duplicate, GLuint texture);
+    LoadRequest makeRequest(GLuint textureId, const std::string& filepath, TextureUsage usage) const;
+    void updateResidency();
+    void streamTexture(GLuint textureId, int firstLevel);
+    void streamArray(int array, int firstLevel);
+    GLuint allocateArrayStorage(const TextureArray& array, int firstLevel);
+    void finishStream(const DecodedImage& decoded, bool uploaded);
+    bool isCurrentLoad(const DecodedImage& decoded) const;
+    void logResidency() const;
+    static void prepareImage(DecodedImage& decoded);
+    static void decodeImage(DecodedImage& decoded);
+    static void convertNormalMap(DecodedImage& decoded);
+    void uploadImages(bool blocking);
+    bool uploadImage(const DecodedImage& decoded, bool blocking);
+    bool canUploadToArray(const DecodedImage& decoded) const;
+    void uploadTextureLevels(const DecodedImage& decoded, const std::vector<size_t>& offsets);
+    void writeCompressedCache(const DecodedImage& decoded);
+    void finishLoad(const DecodedImage& decoded);
 };
@@ -0,0 +1,156 @@
+#include "TextureResidency.h"
+#include <algorithm>
+
+size_t TextureResidency::Entry::bytesFrom(int firstLevel) const {
+    size_t bytes = 0;
+    for (int i = firstLevel; i < levelCount(); i++) {
+        bytes += levelBytes[i];
+    }
+    return bytes;
+}
+
+void TextureResidency::setBudget(size_t bytes) {
+    m_budget = bytes;
+}
+
+void TextureResidency::add(int key, const std::vector<size_t>& levelBytes, int residentLevel) {
+    Entry entry;
+    entry.levelBytes = levelBytes;
+    entry.residentLevel = residentLevel;
+    entry.targetLevel = residentLevel;
+    entry.wantedFrame = m_frame;
+    entry.lastUsedFrame = m_frame;
+    m_entries[key] = entry;
+}
+
+void TextureResidency::remove(int key) {
+    m_entries.erase(key);
+}
+
+void TextureResidency::clear() {
+    m_entries.clear();
+}
+
+void TextureResidency::request(int key, int level) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return;
+    }
+    Entry& entry = it->second;
+    level = std::clamp(level, 0, entry.levelCount() - 1);
+    if (entry.frameLevel < 0 || level < entry.frameLevel) {
+        entry.frameLevel = level;
+    }
+}
+
+std::vector<TextureResidency::Change> TextureResidency::update() {
+    m_frame++;
+
+    size_t total = 0;
+    for (auto& pair : m_entries) {
+        Entry& entry = pair.second;
+        if (entry.frameLevel >= 0) {
+            entry.lastUsedFrame = m_frame;
+            if (entry.frameLevel <= entry.wantedLevel) {
+                entry.wantedLevel = entry.frameLevel;
+                entry.wantedFrame = m_frame;
+            } else if (m_frame - entry.wantedFrame > KEEP_FRAMES) {
+                entry.wantedLevel = entry.frameLevel;
+                entry.wantedFrame = m_frame;
+            }
+            entry.frameLevel = -1;
+        }
+        entry.targetLevel = std::min(entry.wantedLevel, entry.levelCount() - 1);
+        total += entry.bytesFrom(entry.targetLevel);
+    }
+
+    if (m_budget > 0 && total > m_budget) {
+        // least recently used first, the biggest of equally old ones first
+        std::vector<Entry*> order;
+        for (auto& pair : m_entries) {
+            order.push_back(&pair.second);
+        }
+        std::stable_sort(order.begin(), order.end(), [](const Entry* a, const Entry* b) {
+            if (a->lastUsedFrame != b->lastUsedFrame) {
+                return a->lastUsedFrame < b->lastUsedFrame;
+            }
+            return a->bytesFrom(a->targetLevel) > b->bytesFrom(b->targetLevel);
+        });
+
+        for (Entry* entry : order) {
+            while (total > m_budget && entry->targetLevel < entry->levelCount() - 1) {
+                total -= entry->levelBytes[entry->targetLevel];
+                entry->targetLevel++;
+            }
+            if (total <= m_budget) {
+                break;
+            }
+        }
+    }
+
+    // free memory before streaming finer levels in. first loads are never held back
+    std::vector<Change> drops;
+    std::vector<Change> loads;
+    int started = 0;
+    for (auto& pair : m_entries) {
+        Entry& entry = pair.second;
+        if (entry.streaming || entry.targetLevel == entry.residentLevel) {
+            continue;
+        }
+        if (entry.targetLevel > entry.residentLevel) {
+            drops.push_back({pair.first, entry.targetLevel});
+        } else {
+            loads.push_back({pair.first, entry.targetLevel});
+        }
+    }
+
+    std::vector<Change> changes;
+    for (const std::vector<Change>* list : {&drops, &loads}) {
+        for (const Change& change : *list) {
+            Entry& entry = m_entries[change.key];
+            bool firstLoad = entry.residentLevel >= entry.levelCount();
+            if (!firstLoad && started >= MAX_STREAMS_PER_UPDATE) {
+                continue;
+            }
+            if (!firstLoad) {
+                started++;
+            }
+            entry.streaming = true;
+            changes.push_back(change);
+        }
+    }
+    return changes;
+}
+
+void TextureResidency::setResident(int key, int firstLevel) {
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        return;
+    }
+    it->second.residentLevel = firstLevel;
+    it->second.streaming = false;
+}
+
+void TextureResidency::cancelStream(int key) {
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        it->second.streaming = false;
+    }
+}
+
+TextureResidency::Stats TextureResidency::getStats() const {
+    Stats stats;
+    stats.budgetBytes = m_budget;
+    for (const auto& pair : m_entries) {
+        const Entry& entry = pair.second;
+        stats.textures++;
+        stats.residentBytes += entry.bytesFrom(entry.residentLevel);
+        if (entry.targetLevel > std::min(entry.wantedLevel, entry.levelCount() - 1)) {
+            stats.reduced++;
+        }
+        if (entry.streaming) {
+            stats.streaming++;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// decides which mip levels of each texture stay on the gpu. textures report the
+// finest level they need while drawing; when the total goes over the budget the
+// least recently used textures lose their top mips first. no gl calls, the
+// texture manager applies the changes
+class TextureResidency {
+public:
+    struct Stats {
+        size_t residentBytes = 0;
+        size_t budgetBytes = 0;  // 0 = unlimited
+        int textures = 0;
+        int reduced = 0;         // textures held below the level they asked for
+        int streaming = 0;
+    };
+
+    // a texture that should move to a new first level
+    struct Change {
+        int key = 0;
+        int firstLevel = 0;
+    };
+
+    void setBudget(size_t bytes);
+    size_t getBudget() const { return m_budget; }
+
+    // levelBytes[i] is the size of mip level i (all layers). residentLevel is the
+    // first level already on the gpu, levelBytes.size() when nothing is
+    void add(int key, const std::vector<size_t>& levelBytes, int residentLevel);
+    void remove(int key);
+    bool contains(int key) const { return m_entries.count(key) > 0; }
+    void clear();
+
+    // the texture was drawn and needs at least this level (0 = full resolution)
+    void request(int key, int level);
+
+    // once per frame: picks the level every texture should have and returns the
+    // ones to stream in or out. they count as streaming until setResident()
+    std::vector<Change> update();
+
+    // a stream finished, or failed and kept the old levels
+    void setResident(int key, int firstLevel);
+    void cancelStream(int key);
+
+    Stats getStats() const;
+
+private:
+    // a texture asking for finer levels gets them right away, but only drops
+    // them after asking for coarser ones this many frames in a row
+    static constexpr int KEEP_FRAMES = 60;
+    static constexpr int MAX_STREAMS_PER_UPDATE = 4;
+
+    struct Entry {
+        std::vector<size_t> levelBytes;
+        int residentLevel = 0;
+        int wantedLevel = 0;
+        int wantedFrame = 0;
+        int frameLevel = -1;  // finest level requested this frame, -1 = not drawn
+        int lastUsedFrame = 0;
+        int targetLevel = 0;
+        bool streaming = false;
+
+        int levelCount() const { return static_cast<int>(levelBytes.size()); }
+        size_t bytesFrom(int firstLevel) const;
+    };
+
+    std::map<int, Entry> m_entries;
+    size_t m_budget = 0;
+    int m_frame = 0;
+};
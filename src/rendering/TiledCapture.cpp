@@ -0,0 +1,170 @@
+#include "TiledCapture.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+TiledCapture::TiledCapture() {
+    m_writePool.setMaxThreadCount(1);
+}
+
+TiledCapture::~TiledCapture() {
+    m_writePool.waitForDone();
+}
+
+bool TiledCapture::begin(int width, int height, int tileSize, const std::string& path) {
+    if (m_active || width <= 0 || height <= 0) {
+        return false;
+    }
+
+    // even sizes keep the 2x2 pixel quads texture derivatives come from in the
+    // same place in every tile, so mip selection can't jump at a tile edge
+    m_tileSize = std::max(2, (tileSize + 1) & ~1);
+    m_width = width;
+    m_height = height;
+    m_columns = (width + m_tileSize - 1) / m_tileSize;
+    m_rows = (height + m_tileSize - 1) / m_tileSize;
+
+    if (!m_writer.open(path, width, height)) {
+        return false;
+    }
+
+    for (int i = 0; i < STRIP_COUNT; i++) {
+        m_strips[i].assign(static_cast<size_t>(width) * std::min(m_tileSize, height) * 4, 0);
+        m_tilesInStrip[i] = 0;
+    }
+    m_nextBuffer = 0;
+    m_stripsWritten = 0;
+    m_failed = false;
+    m_active = true;
+    return true;
+}
+
+glm::vec4 TiledCapture::tileWindow(int column, int row) const {
+    // one pixel is 2 / size wide in normalized device coordinates
+    double x0 = static_cast<double>(column) * m_tileSize / m_width;
+    double x1 = static_cast<double>(column + 1) * m_tileSize / m_width;
+    double y0 = static_cast<double>(row) * m_tileSize / m_height;
+    double y1 = static_cast<double>(row + 1) * m_tileSize / m_height;
+    return glm::vec4(-1.0 + 2.0 * x0, -1.0 + 2.0 * x1, 1.0 - 2.0 * y1, 1.0 - 2.0 * y0);
+}
+
+int TiledCapture::tileWidth(int column) const {
+    return std::min(m_tileSize, m_width - column * m_tileSize);
+}
+
+int TiledCapture::tileHeight(int row) const {
+    return std::min(m_tileSize, m_height - row * m_tileSize);
+}
+
+void TiledCapture::readTile(int column, int row) {
+    // slots are used in order, so a busy slot holds the oldest pending tile
+    PixelBuffer& buffer = m_buffers[m_nextBuffer];
+    if (buffer.fence != nullptr) {
+        collect(buffer);
+    }
+
+    if (buffer.pbo == 0) {
+        glGenBuffers(1, &buffer.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(m_tileSize) * m_tileSize * 4, nullptr, GL_STREAM_READ);
+    } else {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    }
+
+    // the image's part of an edge tile is its top left corner
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, m_tileSize - tileHeight(row), tileWidth(column), tileHeight(row), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer.column = column;
+    buffer.row = row;
+    glFlush();
+
+    m_nextBuffer = (m_nextBuffer + 1) % PIXEL_BUFFER_COUNT;
+}
+
+void TiledCapture::collect(PixelBuffer& buffer) {
+    glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+
+    int strip = buffer.row % STRIP_COUNT;
+    if (m_tilesInStrip[strip] == 0) {
+        // the strip that used this memory before has to be on disk first
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_stripWritten.wait(lock, [&]() { return m_stripsWritten >= buffer.row - STRIP_COUNT + 1; });
+    }
+
+    int width = tileWidth(buffer.column);
+    int height = tileHeight(buffer.row);
+    size_t tileRowBytes = static_cast<size_t>(width) * 4;
+    size_t stripRowBytes = static_cast<size_t>(m_width) * 4;
+    unsigned char* destination = m_strips[strip].data() + static_cast<size_t>(buffer.column) * m_tileSize * 4;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    const unsigned char* mapped = static_cast<const unsigned char*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(tileRowBytes * height), GL_MAP_READ_BIT));
+    if (mapped != nullptr) {
+        // gl rows start at the bottom
+        for (int y = 0; y < height; y++) {
+            std::memcpy(destination + (height - 1 - y) * stripRowBytes, mapped + y * tileRowBytes, tileRowBytes);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        std::cerr << "Failed to read back tile " << buffer.column << ", " << buffer.row << std::endl;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed = true;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (++m_tilesInStrip[strip] == m_columns) {
+        m_tilesInStrip[strip] = 0;
+        writeStrip(buffer.row);
+    }
+}
+
+void TiledCapture::writeStrip(int row) {
+    m_writePool.start([this, row]() {
+        const std::vector<unsigned char>& strip = m_strips[row % STRIP_COUNT];
+        bool written = m_writer.writeRows(strip.data(), tileHeight(row), m_width * 4);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_failed = m_failed || !written;
+        m_stripsWritten++;
+        m_stripWritten.notify_all();
+    });
+}
+
+bool TiledCapture::finish() {
+    if (!m_active) {
+        return false;
+    }
+    for (int i = 0; i < PIXEL_BUFFER_COUNT; i++) {
+        PixelBuffer& buffer = m_buffers[(m_nextBuffer + i) % PIXEL_BUFFER_COUNT];
+        if (buffer.fence != nullptr) {
+            collect(buffer);
+        }
+    }
+    m_writePool.waitForDone();
+    m_active = false;
+
+    for (std::vector<unsigned char>& strip : m_strips) {
+        std::vector<unsigned char>().swap(strip);
+    }
+
+    // a failed image is never closed, its temporary file goes with the writer
+    return !m_failed && m_writer.close();
+}
+
+void TiledCapture::cleanup() {
+    if (m_active) {
+        finish();
+    }
+    for (PixelBuffer& buffer : m_buffers) {
+        if (buffer.pbo != 0) {
+            glDeleteBuffers(1, &buffer.pbo);
+        }
+        buffer = PixelBuffer();
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <QThreadPool>
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "rendering/ImageEncoder.h"
+
+// readback side of an image rendered in tiles, for sizes past what one
+// framebuffer (or gpu memory) can hold. tiles are read into a ring of pixel
+// buffers while the next ones render, copied upright into a strip one tile row
+// tall, and each finished strip is encoded and appended to the output on a
+// writer thread. only two strips are ever in memory, never the whole image
+class TiledCapture {
+public:
+    TiledCapture();
+    ~TiledCapture();
+
+    // start a width x height image at path (.png, .qoi, .ppm or .raw) cut into
+    // square tiles of about tileSize. returns false if the file can't be started
+    bool begin(int width, int height, int tileSize, const std::string& path);
+
+    int tileSize() const { return m_tileSize; }
+    int columns() const { return m_columns; }
+    int rows() const { return m_rows; }
+
+    // the part of the image plane tile (column, row) covers, for
+    // Camera::setProjectionWindow. row 0 is the top. tiles on the right and
+    // bottom edge reach past the image so every tile has the same pixel scale
+    glm::vec4 tileWindow(int column, int row) const;
+
+    // queue the readback of tile (column, row) from the bound framebuffer.
+    // tiles have to come row by row from the top left
+    void readTile(int column, int row);
+
+    // wait for the remaining tiles and finish the file. false if anything failed
+    bool finish();
+
+    // free the pixel buffers, needs the context current. finishes first
+    void cleanup();
+
+private:
+    static constexpr int PIXEL_BUFFER_COUNT = 3;
+    static constexpr int STRIP_COUNT = 2;
+
+    struct PixelBuffer {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        int column = 0;
+        int row = 0;
+    };
+
+    int tileWidth(int column) const;
+    int tileHeight(int row) const;
+    void collect(PixelBuffer& buffer);
+    void writeStrip(int row);
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_tileSize = 0;
+    int m_columns = 0;
+    int m_rows = 0;
+    bool m_active = false;
+
+    PixelBuffer m_buffers[PIXEL_BUFFER_COUNT];
+    int m_nextBuffer = 0;
+
+    std::vector<unsigned char> m_strips[STRIP_COUNT];
+    int m_tilesInStrip[STRIP_COUNT] = {};
+
+    // strips are appended in order by a single writer thread
+    ImageStreamWriter m_writer;
+    QThreadPool m_writePool;
+    std::mutex m_mutex;
+    std::condition_variable m_stripWritten;
+    int m_stripsWritten = 0;
+    bool m_failed = false;
+};
@@ -0,0 +1,169 @@
+#include "VirtualTextureFile.h"
+#include "MipGenerator.h"
+#include <QImage>
+#include <QImageReader>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+const char FILE_MAGIC[8] = {'B', 'R', 'E', 'A', 'D', 'V', 'T', '\0'};
+const uint32_t FILE_VERSION = 1;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t border;
+    uint32_t levelCount;
+    uint64_t dataOffset;
+    uint64_t tileCount;
+    uint64_t reserved;
+};
+static_assert(sizeof(FileHeader) == 56, "virtual texture header layout changed");
+
+// copy one padded tile out of a level, texels past the edge clamp to it
+void cutTile(const unsigned char* pixels, int width, int height, int tileX, int tileY,
+             int tileSize, int border, unsigned char* out) {
+    int padded = tileSize + 2 * border;
+    for (int y = 0; y < padded; y++) {
+        int sy = std::clamp(tileY * tileSize + y - border, 0, height - 1);
+        const unsigned char* row = pixels + static_cast<size_t>(sy) * width * 4;
+        for (int x = 0; x < padded; x++) {
+            int sx = std::clamp(tileX * tileSize + x - border, 0, width - 1);
+            std::memcpy(out + (static_cast<size_t>(y) * padded + x) * 4, row + sx * 4, 4);
+        }
+    }
+}
+
+}
+
+std::vector<VirtualTextureFile::Level> VirtualTextureFile::layoutLevels(int width, int height, int tileSize) {
+    std::vector<Level> levels;
+    size_t firstTile = 0;
+    for (int index = 0; ; index++) {
+        Level level;
+        level.width = std::max(1, width >> index);
+        level.height = std::max(1, height >> index);
+        level.tilesX = (level.width + tileSize - 1) / tileSize;
+        level.tilesY = (level.height + tileSize - 1) / tileSize;
+        level.firstTile = firstTile;
+        firstTile += static_cast<size_t>(level.tilesX) * level.tilesY;
+        levels.push_back(level);
+
+        if (level.tilesX == 1 && level.tilesY == 1) {
+            break;
+        }
+    }
+    return levels;
+}
+
+bool VirtualTextureFile::build(const std::string& imagePath, const std::string& outputPath,
+                               int tileSize, int border) {
+    // surface textures are far past qt's default 256 MB decode limit
+    QImageReader::setAllocationLimit(0);
+    QImageReader reader(QString::fromStdString(imagePath));
+    QImage image = reader.read();
+    if (image.isNull()) {
+        std::cerr << "could not read image: " << imagePath << " (" << reader.errorString().toStdString() << ")" << std::endl;
+        return false;
+    }
+    image.convertTo(QImage::Format_RGBA8888);
+    image.mirror();
+
+    int width = image.width();
+    int height = image.height();
+    std::vector<Level> levels = layoutLevels(width, height, tileSize);
+    std::vector<MipLevel> mips = MipGenerator::generateRGBA8(image.constBits(), width, height, image.bytesPerLine());
+
+    FileHeader header = {};
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.tileSize = tileSize;
+    header.border = border;
+    header.levelCount = static_cast<uint32_t>(levels.size());
+    header.dataOffset = sizeof(FileHeader);
+    header.tileCount = levels.back().firstTile + 1;
+
+    QSaveFile file(QString::fromStdString(outputPath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "could not write virtual texture: " << outputPath << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    int padded = tileSize + 2 * border;
+    std::vector<unsigned char> tile(static_cast<size_t>(padded) * padded * 4);
+
+    // rgba8888 rows are already 4-byte aligned, so level 0 is tightly packed
+    for (int index = 0; index < static_cast<int>(levels.size()); index++) {
+        const Level& level = levels[index];
+        const unsigned char* pixels = index == 0 ? image.constBits() : mips[index - 1].pixels.data();
+        for (int y = 0; y < level.tilesY; y++) {
+            for (int x = 0; x < level.tilesX; x++) {
+                cutTile(pixels, level.width, level.height, x, y, tileSize, border, tile.data());
+                file.write(reinterpret_cast<const char*>(tile.data()), tile.size());
+            }
+        }
+    }
+
+    if (!file.commit()) {
+        std::cerr << "could not write virtual texture: " << outputPath << std::endl;
+        return false;
+    }
+
+    std::cout << "built virtual texture " << outputPath << ": " << width << "x" << height << ", "
+              << levels.size() << " levels, " << header.tileCount << " tiles" << std::endl;
+    return true;
+}
+
+std::unique_ptr<VirtualTextureFile> VirtualTextureFile::open(const std::string& path) {
+    std::unique_ptr<VirtualTextureFile> file(new VirtualTextureFile());
+    file->m_file.setFileName(QString::fromStdString(path));
+    if (!file->m_file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+
+    qint64 fileSize = file->m_file.size();
+    if (fileSize < static_cast<qint64>(sizeof(FileHeader))) {
+        return nullptr;
+    }
+
+    const uchar* data = file->m_file.map(0, fileSize);
+    if (data == nullptr) {
+        return nullptr;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION ||
+        header.width == 0 || header.height == 0 || header.tileSize == 0) {
+        return nullptr;
+    }
+
+    file->m_tileSize = static_cast<int>(header.tileSize);
+    file->m_border = static_cast<int>(header.border);
+    file->m_levels = layoutLevels(header.width, header.height, file->m_tileSize);
+
+    uint64_t tileCount = file->m_levels.back().firstTile + 1;
+    if (file->levelCount() != static_cast<int>(header.levelCount) || tileCount != header.tileCount ||
+        header.dataOffset + tileCount * file->tileBytes() > uint64_t(fileSize)) {
+        std::cerr << "corrupt virtual texture: " << path << std::endl;
+        return nullptr;
+    }
+
+    file->m_tiles = data + header.dataOffset;
+    return file;
+}
+
+const unsigned char* VirtualTextureFile::tile(int level, int x, int y) const {
+    const Level& l = m_levels[level];
+    size_t index = l.firstTile + static_cast<size_t>(y) * l.tilesX + x;
+    return m_tiles + index * tileBytes();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QFile>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// tiled, mip-chained images for virtual texturing. every level is cut into
+// square tiles with a border copied from the neighbouring texels, so bilinear
+// filtering inside the tile cache never reads another tile. tiles are rgba8,
+// flipped for opengl, stored level by level in row-major order
+class VirtualTextureFile {
+public:
+    static constexpr int DEFAULT_TILE_SIZE = 128;
+    static constexpr int DEFAULT_BORDER = 4;
+
+    struct Level {
+        int width = 0;
+        int height = 0;
+        int tilesX = 0;
+        int tilesY = 0;
+        size_t firstTile = 0;  // index of the level's first tile in the file
+    };
+
+    // split an image into a tile file. levels stop at the first one that fits
+    // in a single tile. returns false (and prints why) on failure
+    static bool build(const std::string& imagePath, const std::string& outputPath,
+                      int tileSize = DEFAULT_TILE_SIZE, int border = DEFAULT_BORDER);
+
+    // map a tile file, nullptr if it is missing or invalid
+    static std::unique_ptr<VirtualTextureFile> open(const std::string& path);
+
+    int width() const { return m_levels[0].width; }
+    int height() const { return m_levels[0].height; }
+    int tileSize() const { return m_tileSize; }
+    int border() const { return m_border; }
+
+    // edge length of a stored tile, including both borders
+    int paddedTileSize() const { return m_tileSize + 2 * m_border; }
+    size_t tileBytes() const { return static_cast<size_t>(paddedTileSize()) * paddedTileSize() * 4; }
+
+    int levelCount() const { return static_cast<int>(m_levels.size()); }
+    const Level& level(int index) const { return m_levels[index]; }
+
+    // points into the mapping, valid for the lifetime of this object
+    const unsigned char* tile(int level, int x, int y) const;
+
+    // level layout of an image of this size
+    static std::vector<Level> layoutLevels(int width, int height, int tileSize);
+
+private:
+    QFile m_file;
+    const unsigned char* m_tiles = nullptr;
+    int m_tileSize = 0;
+    int m_border = 0;
+    std::vector<Level> m_levels;
+};
@@ -0,0 +1,594 @@
+#include "VirtualTextureManager.h"
+#include "RenderStats.h"
+#include "ShaderManager.h"
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+VirtualTextureManager::VirtualTextureManager() {
+    // tile copies are mostly page faults on the mapping, a couple of threads keep up
+    m_loadPool.setMaxThreadCount(std::max(2, QThread::idealThreadCount() / 2));
+}
+
+VirtualTextureManager::~VirtualTextureManager() {
+    m_loadPool.waitForDone();
+}
+
+uint64_t VirtualTextureManager::pageKey(int vt, int level, int x, int y) {
+    return (uint64_t(vt) << 48) | (uint64_t(level) << 40) | (uint64_t(x) << 20) | uint64_t(y);
+}
+
+void VirtualTextureManager::decodePage(uint64_t page, int& vt, int& level, int& x, int& y) {
+    vt = static_cast<int>((page >> 48) & 0xFF);
+    level = static_cast<int>((page >> 40) & 0xFF);
+    x = static_cast<int>((page >> 20) & 0xFFFFF);
+    y = static_cast<int>(page & 0xFFFFF);
+}
+
+void VirtualTextureManager::initialize(const std::string& shaderDir, int cacheTiles) {
+    m_compiler.initialize();
+    m_feedbackProgram = m_compiler.submit(shaderDir + "/default.vert", shaderDir + "/vt_feedback.frag");
+    if (m_feedbackProgram < 0) {
+        std::cerr << "virtual texture feedback shader failed to load" << std::endl;
+    }
+
+    // the cache is allocated for the default tile layout, files with another
+    // layout are rejected by load()
+    m_cacheTiles = std::clamp(cacheTiles, 2, 255);
+    m_paddedTileSize = VirtualTextureFile::DEFAULT_TILE_SIZE + 2 * VirtualTextureFile::DEFAULT_BORDER;
+    m_slots.assign(m_cacheTiles * m_cacheTiles, CacheSlot());
+
+    int cacheSize = m_cacheTiles * m_paddedTileSize;
+    glGenTextures(1, &m_cacheTexture);
+    glBindTexture(GL_TEXTURE_2D, m_cacheTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSize, cacheSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (FeedbackBuffer& buffer : m_feedbackBuffers) {
+        glGenBuffers(1, &buffer.pbo);
+    }
+
+    std::cout << "virtual texture cache: " << m_cacheTiles * m_cacheTiles << " tiles, "
+              << cacheSize << "x" << cacheSize << std::endl;
+}
+
+int VirtualTextureManager::load(const std::string& filepath) {
+    for (size_t i = 0; i < m_textures.size(); i++) {
+        if (m_textures[i].filepath == filepath) {
+            return static_cast<int>(i);
+        }
+    }
+
+    if (m_cacheTexture == 0 || static_cast<int>(m_textures.size()) >= MAX_TEXTURES) {
+        std::cerr << "too many virtual textures, skipping " << filepath << std::endl;
+        return -1;
+    }
+
+    std::unique_ptr<VirtualTextureFile> file = VirtualTextureFile::open(filepath);
+    if (!file) {
+        std::cerr << "could not open virtual texture: " << filepath << std::endl;
+        return -1;
+    }
+    if (file->paddedTileSize() != m_paddedTileSize || file->levelCount() > MAX_LEVELS) {
+        std::cerr << "unsupported virtual texture layout: " << filepath << std::endl;
+        return -1;
+    }
+
+    VirtualTexture texture;
+    texture.filepath = filepath;
+
+    // levels stacked top to bottom, one texel per tile
+    texture.indirectionWidth = file->level(0).tilesX;
+    for (int level = 0; level < file->levelCount(); level++) {
+        texture.levelRows.push_back(texture.indirectionHeight);
+        texture.indirectionHeight += file->level(level).tilesY;
+    }
+
+    glGenTextures(1, &texture.indirection);
+    glBindTexture(GL_TEXTURE_2D, texture.indirection);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, texture.indirectionWidth, texture.indirectionHeight, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    int vt = static_cast<int>(m_textures.size());
+    int coarsest = file->levelCount() - 1;
+    std::cout << "virtual texture " << filepath << ": " << file->width() << "x" << file->height()
+              << ", " << file->levelCount() << " levels" << std::endl;
+
+    texture.file = std::move(file);
+    m_textures.push_back(std::move(texture));
+    updateIndirection(vt);
+
+    // the single coarsest tile is always resident so there is something to fall back to
+    requestPage(pageKey(vt, coarsest, 0, 0));
+    return vt;
+}
+
+void VirtualTextureManager::clear() {
+    // workers read from the mapped files, let them finish before unmapping
+    m_loadPool.waitForDone();
+    {
+        std::lock_guard<std::mutex> lock(m_loadedMutex);
+        m_loaded.clear();
+    }
+
+    for (VirtualTexture& texture : m_textures) {
+        glDeleteTextures(1, &texture.indirection);
+    }
+    m_textures.clear();
+    m_generation++;
+
+    std::fill(m_slots.begin(), m_slots.end(), CacheSlot());
+    m_residentPages.clear();
+    m_requestedPages.clear();
+    m_visiblePages.clear();
+}
+
+void VirtualTextureManager::requestPage(uint64_t page) {
+    if (m_residentPages.count(page) > 0 || !m_requestedPages.insert(page).second) {
+        return;
+    }
+
+    int vt, level, x, y;
+    decodePage(page, vt, level, x, y);
+    const VirtualTextureFile* file = m_textures[vt].file.get();
+    int generation = m_generation;
+
+    m_loadPool.start([this, file, page, level, x, y, generation]() {
+        LoadedTile tile;
+        tile.page = page;
+        tile.generation = generation;
+        const unsigned char* data = file->tile(level, x, y);
+        tile.pixels.assign(data, data + file->tileBytes());
+
+        std::lock_guard<std::mutex> lock(m_loadedMutex);
+        m_loaded.push_back(std::move(tile));
+    });
+}
+
+bool VirtualTextureManager::beginFeedback(const glm::mat4& view, const glm::mat4& projection) {
+    if (m_textures.empty() || m_feedbackProgram < 0) {
+        return false;
+    }
+    m_compiler.poll();
+    GLuint program = m_compiler.getProgram(m_feedbackProgram);
+    if (program == 0) {
+        return false;
+    }
+
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_savedFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, m_savedViewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, m_savedClearColor);
+
+    resizeFeedbackTarget(std::max(1, m_savedViewport[2] / FEEDBACK_DIVISOR),
+                         std::max(1, m_savedViewport[3] / FEEDBACK_DIVISOR));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+    glViewport(0, 0, m_feedbackWidth, m_feedbackHeight);
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glUseProgram(program);
+    glUniformMatrix4fv(feedbackUniform("viewMatrix"), 1, GL_FALSE, &view[0][0]);
+    glUniformMatrix4fv(feedbackUniform("projectionMatrix"), 1, GL_FALSE, &projection[0][0]);
+
+    // derivatives are FEEDBACK_DIVISOR times too large at this resolution
+    glUniform1f(feedbackUniform("mipBias"), -std::log2(float(FEEDBACK_DIVISOR)));
+    return true;
+}
+
+void VirtualTextureManager::drawFeedback(int vt, const glm::mat4& model, const glm::vec2& repeat,
+                                         bool enableScrolling, const glm::vec2& scrollDirection,
+                                         float scrollSpeed, float time,
+                                         GLuint vao, int vertexCount, int instanceCount) {
+    if (vao == 0 || vertexCount == 0) {
+        return;
+    }
+
+    glUniformMatrix4fv(feedbackUniform("modelMatrix"), 1, GL_FALSE, &model[0][0]);
+    glUniform1i(feedbackUniform("useInstancing"), instanceCount > 0);
+    glUniform1i(feedbackUniform("vtIndex"), vt);
+    if (vt >= 0) {
+        const VirtualTextureFile& file = *m_textures[vt].file;
+        glUniform2f(feedbackUniform("vtSize"), float(file.width()), float(file.height()));
+        glUniform1i(feedbackUniform("vtLevelCount"), file.levelCount());
+        glUniform1i(feedbackUniform("vtTileSize"), file.tileSize());
+        glUniform2f(feedbackUniform("repeat"), repeat.x, repeat.y);
+        glUniform1i(feedbackUniform("enableScrolling"), enableScrolling ? 1 : 0);
+        glUniform2f(feedbackUniform("scrollDirection"), scrollDirection.x, scrollDirection.y);
+        glUniform1f(feedbackUniform("scrollSpeed"), scrollSpeed);
+        glUniform1f(feedbackUniform("time"), time);
+    }
+
+    glBindVertexArray(vao);
+    if (instanceCount > 0) {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+    }
+    RenderStats::add(RenderStats::StateChanges);
+    RenderStats::addDraw(vertexCount, instanceCount);
+}
+
+void VirtualTextureManager::endFeedback() {
+    // read into a pixel buffer, update() maps it once the gpu is done
+    FeedbackBuffer& buffer = m_feedbackBuffers[m_nextFeedbackBuffer];
+    m_nextFeedbackBuffer = (m_nextFeedbackBuffer + 1) % FEEDBACK_BUFFER_COUNT;
+
+    if (buffer.fence) {
+        // still unread from two frames ago, the newer one replaces it
+        glDeleteSync(buffer.fence);
+        buffer.fence = nullptr;
+    }
+
+    GLsizeiptr size = GLsizeiptr(m_feedbackWidth) * m_feedbackHeight * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    if (buffer.width != m_feedbackWidth || buffer.height != m_feedbackHeight) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+        buffer.width = m_feedbackWidth;
+        buffer.height = m_feedbackHeight;
+    }
+    glReadPixels(0, 0, m_feedbackWidth, m_feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_savedFramebuffer);
+    glViewport(m_savedViewport[0], m_savedViewport[1], m_savedViewport[2], m_savedViewport[3]);
+    glClearColor(m_savedClearColor[0], m_savedClearColor[1], m_savedClearColor[2], m_savedClearColor[3]);
+}
+
+void VirtualTextureManager::readFeedback(FeedbackBuffer& buffer) {
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    const unsigned char* pixels = static_cast<const unsigned char*>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(buffer.width) * buffer.height * 4, GL_MAP_READ_BIT));
+    if (pixels == nullptr) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return;
+    }
+
+    // neighbouring pixels mostly want the same tile, skip repeats before hashing
+    m_visiblePages.clear();
+    uint32_t previous = 0xFFFFFFFF;
+    size_t count = size_t(buffer.width) * buffer.height;
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* p = pixels + i * 4;
+        uint32_t packed = uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+        if (p[3] == 0xFF || packed == previous) {
+            continue;
+        }
+        previous = packed;
+
+        int vt = p[3] >> 4;
+        int level = p[3] & 0xF;
+        int x = p[0] | (p[2] & 0xF) << 8;
+        int y = p[1] | (p[2] >> 4) << 8;
+        if (vt >= static_cast<int>(m_textures.size())) {
+            continue;
+        }
+
+        // parents are needed too, they are what the shader falls back to
+        const VirtualTextureFile& file = *m_textures[vt].file;
+        for (; level < file.levelCount(); level++) {
+            const VirtualTextureFile::Level& info = file.level(level);
+            x = std::min(x, info.tilesX - 1);
+            y = std::min(y, info.tilesY - 1);
+            if (!m_visiblePages.insert(pageKey(vt, level, x, y)).second) {
+                break;
+            }
+            x >>= 1;
+            y >>= 1;
+        }
+    }
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTextureManager::requestVisiblePages(int limit) {
+    std::vector<uint64_t> missing;
+    for (uint64_t page : m_visiblePages) {
+        auto resident = m_residentPages.find(page);
+        if (resident != m_residentPages.end()) {
+            m_slots[resident->second].lastUsedFrame = m_frame;
+        } else if (m_requestedPages.count(page) == 0) {
+            missing.push_back(page);
+        }
+    }
+
+    // coarse levels first, they cover the most screen and unblock their children
+    std::sort(missing.begin(), missing.end(), [](uint64_t a, uint64_t b) {
+        int va, la, xa, ya, vb, lb, xb, yb;
+        decodePage(a, va, la, xa, ya);
+        decodePage(b, vb, lb, xb, yb);
+        return la != lb ? la > lb : a < b;
+    });
+
+    int started = 0;
+    for (uint64_t page : missing) {
+        if (limit > 0 && started >= limit) {
+            break;
+        }
+        requestPage(page);
+        started++;
+    }
+}
+
+int VirtualTextureManager::findSlot() {
+    // a free slot, otherwise the least recently used one not seen this frame
+    int best = -1;
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        const CacheSlot& slot = m_slots[i];
+        if (!slot.used) {
+            return static_cast<int>(i);
+        }
+        if (slot.pinned || slot.lastUsedFrame >= m_frame) {
+            continue;
+        }
+        if (best < 0 || slot.lastUsedFrame < m_slots[best].lastUsedFrame) {
+            best = static_cast<int>(i);
+        }
+    }
+
+    if (best >= 0) {
+        int vt, level, x, y;
+        decodePage(m_slots[best].page, vt, level, x, y);
+        m_residentPages.erase(m_slots[best].page);
+        m_textures[vt].dirty = true;
+        m_slots[best] = CacheSlot();
+    }
+    return best;
+}
+
+void VirtualTextureManager::uploadTiles(int limit) {
+    std::deque<LoadedTile> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_loadedMutex);
+        size_t count = limit > 0 ? std::min(m_loaded.size(), size_t(limit)) : m_loaded.size();
+        ready.insert(ready.end(), std::make_move_iterator(m_loaded.begin()),
+                     std::make_move_iterator(m_loaded.begin() + count));
+        m_loaded.erase(m_loaded.begin(), m_loaded.begin() + count);
+    }
+    if (ready.empty()) {
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, m_cacheTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (LoadedTile& tile : ready) {
+        if (tile.generation != m_generation) {
+            continue;
+        }
+        m_requestedPages.erase(tile.page);
+
+        int vt, level, x, y;
+        decodePage(tile.page, vt, level, x, y);
+        bool coarsest = level == m_textures[vt].file->levelCount() - 1;
+
+        int index = findSlot();
+        if (index < 0) {
+            // everything is in use this frame, the feedback will ask again
+            continue;
+        }
+
+        CacheSlot& slot = m_slots[index];
+        slot.page = tile.page;
+        slot.used = true;
+        slot.pinned = coarsest;
+        slot.lastUsedFrame = m_frame;
+        m_residentPages[tile.page] = index;
+        m_textures[vt].dirty = true;
+
+        int slotX = index % m_cacheTiles;
+        int slotY = index / m_cacheTiles;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, slotX * m_paddedTileSize, slotY * m_paddedTileSize,
+                        m_paddedTileSize, m_paddedTileSize, GL_RGBA, GL_UNSIGNED_BYTE, tile.pixels.data());
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void VirtualTextureManager::updateIndirection(int vt) {
+    VirtualTexture& texture = m_textures[vt];
+    const VirtualTextureFile& file = *texture.file;
+
+    // r, g = cache slot, b = level actually resident, a = 255 when anything is.
+    // built coarse to fine so a missing tile inherits its parent's entry
+    std::vector<unsigned char> entries(size_t(texture.indirectionWidth) * texture.indirectionHeight * 4, 0);
+    for (int level = file.levelCount() - 1; level >= 0; level--) {
+        const VirtualTextureFile::Level& info = file.level(level);
+        for (int y = 0; y < info.tilesY; y++) {
+            for (int x = 0; x < info.tilesX; x++) {
+                unsigned char* entry = &entries[(size_t(texture.levelRows[level] + y) * texture.indirectionWidth + x) * 4];
+
+                auto resident = m_residentPages.find(pageKey(vt, level, x, y));
+                if (resident != m_residentPages.end()) {
+                    entry[0] = static_cast<unsigned char>(resident->second % m_cacheTiles);
+                    entry[1] = static_cast<unsigned char>(resident->second / m_cacheTiles);
+                    entry[2] = static_cast<unsigned char>(level);
+                    entry[3] = 255;
+                } else if (level + 1 < file.levelCount()) {
+                    const VirtualTextureFile::Level& parent = file.level(level + 1);
+                    int px = std::min(x >> 1, parent.tilesX - 1);
+                    int py = std::min(y >> 1, parent.tilesY - 1);
+                    const unsigned char* inherited =
+                        &entries[(size_t(texture.levelRows[level + 1] + py) * texture.indirectionWidth + px) * 4];
+                    std::copy(inherited, inherited + 4, entry);
+                }
+            }
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture.indirection);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture.indirectionWidth, texture.indirectionHeight,
+                    GL_RGBA, GL_UNSIGNED_BYTE, entries.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    texture.dirty = false;
+}
+
+void VirtualTextureManager::update() {
+    if (m_textures.empty()) {
+        return;
+    }
+    m_frame++;
+
+    // the newest feedback the gpu has finished, without waiting for it
+    for (int i = 1; i <= FEEDBACK_BUFFER_COUNT; i++) {
+        FeedbackBuffer& buffer = m_feedbackBuffers[(m_nextFeedbackBuffer - i + FEEDBACK_BUFFER_COUNT) % FEEDBACK_BUFFER_COUNT];
+        if (buffer.fence && glClientWaitSync(buffer.fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+            readFeedback(buffer);
+            break;
+        }
+    }
+
+    requestVisiblePages(MAX_REQUESTS_PER_UPDATE);
+    uploadTiles(MAX_UPLOADS_PER_UPDATE);
+
+    for (size_t vt = 0; vt < m_textures.size(); vt++) {
+        if (m_textures[vt].dirty) {
+            updateIndirection(static_cast<int>(vt));
+        }
+    }
+}
+
+void VirtualTextureManager::finishPendingTiles() {
+    if (m_textures.empty()) {
+        return;
+    }
+    m_frame++;
+
+    // the most recent feedback pass, waiting for it this time
+    FeedbackBuffer& buffer = m_feedbackBuffers[(m_nextFeedbackBuffer + FEEDBACK_BUFFER_COUNT - 1) % FEEDBACK_BUFFER_COUNT];
+    if (buffer.fence) {
+        glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+        readFeedback(buffer);
+    }
+
+    requestVisiblePages(0);
+    m_loadPool.waitForDone();
+    uploadTiles(0);
+
+    for (size_t vt = 0; vt < m_textures.size(); vt++) {
+        if (m_textures[vt].dirty) {
+            updateIndirection(static_cast<int>(vt));
+        }
+    }
+}
+
+bool VirtualTextureManager::bind(int vt, const ShaderManager& shader, GLenum cacheUnit, GLenum indirectionUnit) {
+    if (vt < 0 || vt >= static_cast<int>(m_textures.size())) {
+        return false;
+    }
+    const VirtualTexture& texture = m_textures[vt];
+    const VirtualTextureFile& file = *texture.file;
+    if (m_residentPages.count(pageKey(vt, file.levelCount() - 1, 0, 0)) == 0) {
+        return false;
+    }
+
+    glActiveTexture(cacheUnit);
+    glBindTexture(GL_TEXTURE_2D, m_cacheTexture);
+    glActiveTexture(indirectionUnit);
+    glBindTexture(GL_TEXTURE_2D, texture.indirection);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setUniformInt("vtCache", static_cast<int>(cacheUnit - GL_TEXTURE0));
+    shader.setUniformInt("vtIndirection", static_cast<int>(indirectionUnit - GL_TEXTURE0));
+    shader.setUniformVec2("vtSize", glm::vec2(file.width(), file.height()));
+    shader.setUniformInt("vtLevelCount", file.levelCount());
+    shader.setUniformInt("vtTileSize", file.tileSize());
+    shader.setUniformInt("vtBorder", file.border());
+    shader.setUniformFloat("vtCacheSize", float(m_cacheTiles * m_paddedTileSize));
+    for (int level = 0; level < file.levelCount(); level++) {
+        shader.setUniformInt("vtLevelRows[" + std::to_string(level) + "]", texture.levelRows[level]);
+    }
+    return true;
+}
+
+VirtualTextureManager::Stats VirtualTextureManager::getStats() const {
+    Stats stats;
+    stats.textures = static_cast<int>(m_textures.size());
+    stats.residentTiles = static_cast<int>(m_residentPages.size());
+    stats.cacheTiles = static_cast<int>(m_slots.size());
+    stats.pendingTiles = static_cast<int>(m_requestedPages.size());
+    return stats;
+}
+
+bool VirtualTextureManager::isResident(int vt, int level, int x, int y) const {
+    return m_residentPages.count(pageKey(vt, level, x, y)) > 0;
+}
+
+void VirtualTextureManager::resizeFeedbackTarget(int width, int height) {
+    if (m_feedbackFramebuffer != 0 && width == m_feedbackWidth && height == m_feedbackHeight) {
+        return;
+    }
+
+    if (m_feedbackFramebuffer == 0) {
+        glGenFramebuffers(1, &m_feedbackFramebuffer);
+        glGenRenderbuffers(1, &m_feedbackColor);
+        glGenRenderbuffers(1, &m_feedbackDepth);
+    }
+
+    glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_feedbackFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_feedbackColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_feedbackDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "virtual texture feedback framebuffer is not complete" << std::endl;
+    }
+
+    m_feedbackWidth = width;
+    m_feedbackHeight = height;
+}
+
+GLint VirtualTextureManager::feedbackUniform(const char* name) const {
+    return glGetUniformLocation(m_compiler.getProgram(m_feedbackProgram), name);
+}
+
+void VirtualTextureManager::cleanup() {
+    clear();
+
+    for (FeedbackBuffer& buffer : m_feedbackBuffers) {
+        if (buffer.fence) {
+            glDeleteSync(buffer.fence);
+        }
+        if (buffer.pbo) {
+            glDeleteBuffers(1, &buffer.pbo);
+        }
+        buffer = FeedbackBuffer();
+    }
+
+    if (m_feedbackFramebuffer) {
+        glDeleteFramebuffers(1, &m_feedbackFramebuffer);
+        glDeleteRenderbuffers(1, &m_feedbackColor);
+        glDeleteRenderbuffers(1, &m_feedbackDepth);
+        m_feedbackFramebuffer = 0;
+        m_feedbackColor = 0;
+        m_feedbackDepth = 0;
+    }
+
+    if (m_cacheTexture) {
+        glDeleteTextures(1, &m_cacheTexture);
+        m_cacheTexture = 0;
+    }
+    m_compiler.cleanup();
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <QThreadPool>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "ShaderCompiler.h"
+#include "VirtualTextureFile.h"
+
+class ShaderManager;
+
+// software virtual texturing for images too big to upload whole. a low
+// resolution feedback pass writes the tile every pixel wants, the tiles are
+// copied out of the mapped tile files on worker threads and uploaded into one
+// physical cache texture. each virtual texture has an indirection texture that
+// maps its tiles to cache slots, falling back to the nearest resident parent.
+// plain gl 3.3, no sparse texture extensions
+class VirtualTextureManager {
+public:
+    struct Stats {
+        int textures = 0;
+        int residentTiles = 0;
+        int cacheTiles = 0;
+        int pendingTiles = 0;
+    };
+
+    VirtualTextureManager();
+    ~VirtualTextureManager();
+
+    // needs a current context. the feedback pass reuses default.vert from shaderDir.
+    // the cache holds cacheTiles x cacheTiles tiles
+    void initialize(const std::string& shaderDir, int cacheTiles);
+
+    // open a .bvt tile file, returns its index or -1 if it can't be read
+    int load(const std::string& filepath);
+    bool hasTextures() const { return !m_textures.empty(); }
+
+    // drop every virtual texture (e.g. when the scene changes)
+    void clear();
+
+    // feedback pass, drawn into its own small framebuffer at 1/8 of the current
+    // viewport. shapes without a virtual texture (vt = -1) are drawn as occluders.
+    // returns false while the feedback program is still compiling.
+    // the scroll arguments match the uniforms default.frag offsets its uvs by
+    bool beginFeedback(const glm::mat4& view, const glm::mat4& projection);
+    void drawFeedback(int vt, const glm::mat4& model, const glm::vec2& repeat,
+                      bool enableScrolling, const glm::vec2& scrollDirection, float scrollSpeed, float time,
+                      GLuint vao, int vertexCount, int instanceCount = 0);
+    void endFeedback();
+
+    // read back the last finished feedback, request missing tiles and upload a
+    // few loaded ones. call once per frame after endFeedback()
+    void update();
+
+    // block until every tile the last feedback pass asked for is resident
+    // (e.g. before saving an image)
+    void finishPendingTiles();
+
+    // bind the cache and indirection textures and set the sampling uniforms.
+    // returns false until the coarsest tile of the texture is resident
+    bool bind(int vt, const ShaderManager& shader, GLenum cacheUnit, GLenum indirectionUnit);
+
+    Stats getStats() const;
+
+    // whether a tile is in the cache (e.g. for tests)
+    bool isResident(int vt, int level, int x, int y) const;
+
+    void cleanup();
+
+private:
+    // the feedback is read back every frame, so its target stays small
+    static constexpr int FEEDBACK_DIVISOR = 8;
+    static constexpr int FEEDBACK_BUFFER_COUNT = 2;
+    static constexpr int MAX_TEXTURES = 15;          // 4 bits in the feedback, 15 = empty
+    static constexpr int MAX_LEVELS = 15;
+    static constexpr int MAX_REQUESTS_PER_UPDATE = 32;
+    static constexpr int MAX_UPLOADS_PER_UPDATE = 16;
+
+    struct VirtualTexture {
+        std::string filepath;
+        std::unique_ptr<VirtualTextureFile> file;
+        GLuint indirection = 0;
+        std::vector<int> levelRows;  // first indirection row of each level
+        int indirectionWidth = 0;
+        int indirectionHeight = 0;
+        bool dirty = true;
+    };
+
+    // one tile position of the cache texture
+    struct CacheSlot {
+        uint64_t page = 0;
+        bool used = false;
+        bool pinned = false;  // coarsest level, never evicted
+        int lastUsedFrame = 0;
+    };
+
+    // a tile copied out of its file, waiting for upload
+    struct LoadedTile {
+        uint64_t page = 0;
+        int generation = 0;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct FeedbackBuffer {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        int width = 0;
+        int height = 0;
+    };
+
+    static uint64_t pageKey(int vt, int level, int x, int y);
+    static void decodePage(uint64_t page, int& vt, int& level, int& x, int& y);
+
+    void requestPage(uint64_t page);
+    void readFeedback(FeedbackBuffer& buffer);
+    void requestVisiblePages(int limit);
+    void uploadTiles(int limit);
+    int findSlot();
+    void updateIndirection(int vt);
+    void resizeFeedbackTarget(int width, int height);
+    GLint feedbackUniform(const char* name) const;
+
+    std::vector<VirtualTexture> m_textures;
+    int m_generation = 0;  // bumped by clear() so stale tiles are dropped
+
+    GLuint m_cacheTexture = 0;
+    int m_cacheTiles = 0;
+    int m_paddedTileSize = 0;
+    std::vector<CacheSlot> m_slots;
+    std::unordered_map<uint64_t, int> m_residentPages;  // page -> slot
+    std::unordered_set<uint64_t> m_requestedPages;      // loading or waiting for upload
+    std::unordered_set<uint64_t> m_visiblePages;        // from the last feedback, parents included
+    int m_frame = 0;
+
+    QThreadPool m_loadPool;
+    std::mutex m_loadedMutex;
+    std::deque<LoadedTile> m_loaded;
+
+    ShaderCompiler m_compiler;
+    int m_feedbackProgram = -1;
+    GLuint m_feedbackFramebuffer = 0;
+    GLuint m_feedbackColor = 0;
+    GLuint m_feedbackDepth = 0;
+    int m_feedbackWidth = 0;
+    int m_feedbackHeight = 0;
+    FeedbackBuffer m_feedbackBuffers[FEEDBACK_BUFFER_COUNT];
+    int m_nextFeedbackBuffer = 0;
+
+    // state restored by endFeedback()
+    GLint m_savedFramebuffer = 0;
+    GLint m_savedViewport[4] = {0, 0, 0, 0};
+    GLfloat m_savedClearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+};
@@ -0,0 +1,111 @@
+#include "Y4mWriter.h"
+#include <algorithm>
+#include <iostream>
+
+bool Y4mWriter::open(const std::string& path, int width, int height, int fps) {
+    m_file.setFileName(QString::fromStdString(path));
+    if (width <= 0 || height <= 0 || !m_file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Failed to save video to " << path << std::endl;
+        return false;
+    }
+
+    std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height) +
+                         " F" + std::to_string(std::max(1, fps)) + ":1 Ip A1:1 C420jpeg\n";
+    m_file.write(header.data(), static_cast<qint64>(header.size()));
+
+    m_path = path;
+    m_width = width;
+    m_height = height;
+    m_nextFrame = 0;
+    m_failed = false;
+    m_open = true;
+    return true;
+}
+
+void Y4mWriter::toYuv420(const unsigned char* pixels, int width, int height, int rowBytes,
+                         std::vector<unsigned char>& frame) {
+    int chromaWidth = (width + 1) / 2;
+    int chromaHeight = (height + 1) / 2;
+    size_t lumaSize = static_cast<size_t>(width) * height;
+    size_t chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+    frame.resize(6 + lumaSize + 2 * chromaSize);
+    std::copy_n("FRAME\n", 6, frame.begin());
+    unsigned char* luma = frame.data() + 6;
+    unsigned char* cb = luma + lumaSize;
+    unsigned char* cr = cb + chromaSize;
+
+    // bt.601 in 8-bit fixed point, limited range (16-235 luma, 16-240 chroma)
+    for (int y = 0; y < height; y++) {
+        const unsigned char* row = pixels + static_cast<size_t>(y) * rowBytes;
+        for (int x = 0; x < width; x++) {
+            int r = row[x * 4];
+            int g = row[x * 4 + 1];
+            int b = row[x * 4 + 2];
+            luma[static_cast<size_t>(y) * width + x] = static_cast<unsigned char>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+
+    // chroma from the average of each 2x2 block, edges repeat the last pixel
+    for (int cy = 0; cy < chromaHeight; cy++) {
+        const unsigned char* row0 = pixels + static_cast<size_t>(cy * 2) * rowBytes;
+        const unsigned char* row1 = pixels + static_cast<size_t>(std::min(cy * 2 + 1, height - 1)) * rowBytes;
+        for (int cx = 0; cx < chromaWidth; cx++) {
+            int x0 = cx * 2 * 4;
+            int x1 = std::min(cx * 2 + 1, width - 1) * 4;
+            int r = (row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2;
+            int g = (row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1] + 2) >> 2;
+            int b = (row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2] + 2) >> 2;
+            size_t i = static_cast<size_t>(cy) * chromaWidth + cx;
+            cb[i] = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            cr[i] = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+}
+
+bool Y4mWriter::writeFrame(int index, const unsigned char* pixels, int rowBytes) {
+    std::vector<unsigned char> frame;
+    toYuv420(pixels, m_width, m_height, rowBytes, frame);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_turn.wait(lock, [&]() { return m_nextFrame >= index; });
+    if (m_nextFrame != index) {
+        return false;
+    }
+    bool written = m_file.write(reinterpret_cast<const char*>(frame.data()), static_cast<qint64>(frame.size())) ==
+                   static_cast<qint64>(frame.size());
+    if (!written && !m_failed) {
+        std::cerr << "Failed to write frame " << index << " to " << m_path << std::endl;
+    }
+    m_failed = m_failed || !written;
+    m_nextFrame++;
+    m_turn.notify_all();
+    return written;
+}
+
+void Y4mWriter::skipFrame(int index) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_turn.wait(lock, [&]() { return m_nextFrame >= index; });
+    if (m_nextFrame == index) {
+        m_failed = true;
+        m_nextFrame++;
+        m_turn.notify_all();
+    }
+}
+
+bool Y4mWriter::close() {
+    if (!m_open) {
+        return false;
+    }
+    m_open = false;
+    if (m_failed) {
+        // a stream with a hole in it isn't kept
+        m_file.cancelWriting();
+        m_file.commit();
+        return false;
+    }
+    if (!m_file.commit()) {
+        std::cerr << "Failed to save video to " << m_path << std::endl;
+        return false;
+    }
+    return true;
+}
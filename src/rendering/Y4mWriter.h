@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QSaveFile>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// writes frames to an uncompressed yuv4mpeg2 stream (4:2:0, bt.601 limited
+// range) that ffmpeg and most players read directly. frames may arrive from
+// several threads in any order: each is converted where it arrives, then
+// waits until every frame before it has been written
+class Y4mWriter {
+public:
+    // false (after printing why) if the file can't be created
+    bool open(const std::string& path, int width, int height, int fps);
+
+    // convert and append frame index (0, 1, 2, ...) from upright rgba8 pixels.
+    // blocks until it is this frame's turn. false if the write failed
+    bool writeFrame(int index, const unsigned char* pixels, int rowBytes);
+
+    // give up on frame index, so the frames after it aren't left waiting
+    void skipFrame(int index);
+
+    // finish the file and move it into place. false if a write failed
+    bool close();
+
+private:
+    static void toYuv420(const unsigned char* pixels, int width, int height, int rowBytes,
+                         std::vector<unsigned char>& frame);
+
+    QSaveFile m_file;
+    std::string m_path;
+    int m_width = 0;
+    int m_height = 0;
+    bool m_open = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_turn;
+    int m_nextFrame = 0;
+    bool m_failed = false;
+};
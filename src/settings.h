@@ -15,6 +15,34 @@ struct Settings {
     float nearPlane = 0.1f;
     float farPlane = 30.0f;
 
+    //shaders (empty = embedded resources, otherwise a directory that is watched for edits)
+    std::string shaderDirectory;
+
+    //texture cache (empty directory = platform cache location)
+    bool enableTextureCache = true;
+    bool compressTextureCache = false;
+    std::string textureCacheDirectory;
+    bool compressNormalMaps = true;  //rgtc2 instead of rg8
+
+    //texture memory budget in MB (0 = unlimited)
+    int textureBudgetMB = 0;
+
+    //virtual texture tile cache, tiles per side
+    int virtualTextureCacheTiles = 16;
+
+    //cpu mip generation (kaiser instead of box, alpha test cutoff to keep coverage, 0 = off)
+    bool kaiserMipFilter = false;
+    float mipAlphaCutoff = 0.0f;
+
+    //captures larger than this (either side) are rendered in tiles of this size
+    int captureTileSize = 2048;
+
+    //gpu and cpu time per render pass, written here on exit (.json or .csv, empty = off)
+    std::string gpuProfilePath;
+
+    //camera flight recorded in the viewport, written here on exit as a camera path (empty = off)
+    std::string cameraRecordPath;
+
 
 
 
@@ -4,6 +4,8 @@
 #include "Cone.h"
 #include "Cylinder.h"
 #include <iostream>
+#include "rendering/RenderStats.h"
+#include "ZoneProfiler.h"
 
 ShapeManager::ShapeManager()
     : m_param1(1)
@@ -62,6 +64,7 @@ GLuint ShapeManager::createVAO(const std::vector<float>& vertexData, GLuint& vbo
 
 
 void ShapeManager::generateShape(PrimitiveType type, int param1, int param2) {
+    PROFILE_ZONE("ShapeManager::generateShape");
     deleteShape(type);
 
     std::vector<float> vertexData;
@@ -116,11 +119,12 @@ void ShapeManager::initialize(int param1, int param2) {
     generateShape(PrimitiveType::PRIMITIVE_SPHERE, param1, param2);
     generateShape(PrimitiveType::PRIMITIVE_CONE, param1, param2);
     generateShape(PrimitiveType::PRIMITIVE_CYLINDER, param1, param2);
+    return true;
 }
 
-void ShapeManager::updateTessellation(int param1, int param2) {
+bool ShapeManager::updateTessellation(int param1, int param2) {
     if (param1 == m_param1 && param2 == m_param2) {
-        return;
+        return false;
     }
 
     m_param1 = param1;
@@ -130,6 +134,7 @@ void ShapeManager::updateTessellation(int param1, int param2) {
     generateShape(PrimitiveType::PRIMITIVE_SPHERE, param1, param2);
     generateShape(PrimitiveType::PRIMITIVE_CONE, param1, param2);
     generateShape(PrimitiveType::PRIMITIVE_CYLINDER, param1, param2);
+    return true;
 }
 
 GLuint ShapeManager::getVAO(PrimitiveType type) const {
@@ -148,6 +153,23 @@ int ShapeManager::getVertexCount(PrimitiveType type) const {
     return 0;
 }
 
+bool ShapeManager::draw(PrimitiveType type, int instanceCount) const {
+    auto it = m_shapes.find(type);
+    if (it == m_shapes.end() || it->second.vao == 0 || it->second.vertexCount == 0) {
+        return false;
+    }
+
+    glBindVertexArray(it->second.vao);
+    if (instanceCount > 0) {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, it->second.vertexCount, instanceCount);
+    } else {
+        glDrawArrays(GL_TRIANGLES, 0, it->second.vertexCount);
+    }
+    RenderStats::add(RenderStats::StateChanges);
+    RenderStats::addDraw(it->second.vertexCount, instanceCount);
+    return true;
+}
+
 void ShapeManager::setupInstanceAttributes(PrimitiveType type, GLuint instanceVBO) {
     GLuint vao = getVAO(type);
     if (vao == 0 || instanceVBO == 0) {
@@ -16,11 +16,16 @@ public:
     ~ShapeManager();
 
     void initialize(int param1, int param2);
-    void updateTessellation(int param1, int param2);
+    // returns true if the shapes were rebuilt (new vertex arrays)
+    bool updateTessellation(int param1, int param2);
 
     GLuint getVAO(PrimitiveType type) const;
     int getVertexCount(PrimitiveType type) const;
 
+    // bind the shape's vertex array and draw it, instanceCount times if nonzero
+    // (the instance attributes have to be set up). false if the shape isn't built
+    bool draw(PrimitiveType type, int instanceCount = 0) const;
+
     // configure instance attributes for a VAO
     void setupInstanceAttributes(PrimitiveType type, GLuint instanceVBO);
 
@@ -0,0 +1,472 @@
+#include "jsonscanner.h"
+#include <QByteArray>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define JSON_SSE2 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace {
+
+// QJsonDocument gives up at 1024 levels, staying well under that keeps the
+// recursion in skipValue() shallow and never accepts what it would reject
+constexpr size_t MAX_DEPTH = 512;
+
+// doubles hold every integer up to 2^53 and every power of ten up to 1e22
+// exactly, so within those limits one multiply or divide is correctly rounded
+constexpr int MAX_FAST_DIGITS = 15;
+constexpr double POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+bool isWhitespace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+#ifdef JSON_SSE2
+int lowestBit(unsigned mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void appendUtf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xc0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xe0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+        out += static_cast<char>(0xf0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+bool isNonCharacter(uint32_t code) {
+    return (code >= 0xfdd0 && code <= 0xfdef) || (code & 0xfffe) == 0xfffe;
+}
+
+// bytes in the utf-8 sequence starting at p, 0 if it is malformed, overlong,
+// a surrogate or a noncharacter. stricter than qt at the edges, which is the
+// safe side: a reader falls back on the dom path for anything rejected here
+int utf8Length(const unsigned char* p, const unsigned char* end) {
+    unsigned char lead = p[0];
+    int length;
+    uint32_t code;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+        code = lead & 0x1f;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        code = lead & 0x0f;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        code = lead & 0x07;
+    } else {
+        return 0;
+    }
+    if (end - p < length) return 0;
+    for (int i = 1; i < length; i++) {
+        if ((p[i] & 0xc0) != 0x80) return 0;
+        code = (code << 6) | (p[i] & 0x3f);
+    }
+    if ((length == 3 && code < 0x800) || (length == 4 && (code < 0x10000 || code > 0x10ffff))) return 0;
+    if ((code >= 0xd800 && code <= 0xdfff) || isNonCharacter(code)) return 0;
+    return length;
+}
+
+} // namespace
+
+JsonScanner::JsonScanner(const char* data, size_t size) : m_data(data), m_size(size) {
+    // QJsonDocument skips a utf-8 byte order mark too
+    if (size >= 3 && std::memcmp(data, "\xef\xbb\xbf", 3) == 0) {
+        m_pos = 3;
+    }
+}
+
+bool JsonScanner::fail() {
+    m_failed = true;
+    return false;
+}
+
+void JsonScanner::skipWhitespace() {
+    // most gaps between tokens are empty or one space
+    if (m_pos + 1 < m_size && !isWhitespace(m_data[m_pos])) return;
+    if (m_pos + 1 < m_size && !isWhitespace(m_data[m_pos + 1])) {
+        m_pos++;
+        return;
+    }
+#ifdef JSON_SSE2
+    // newlines and indentation: 16 bytes at a time to the first that isn't blank
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    while (m_pos + 16 <= m_size) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_data + m_pos));
+        __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, newline)),
+                                     _mm_or_si128(_mm_cmpeq_epi8(chunk, carriageReturn), _mm_cmpeq_epi8(chunk, tab)));
+        unsigned other = ~static_cast<unsigned>(_mm_movemask_epi8(blank)) & 0xffffu;
+        if (other != 0) {
+            m_pos += lowestBit(other);
+            return;
+        }
+        m_pos += 16;
+    }
+#endif
+    while (m_pos < m_size && isWhitespace(m_data[m_pos])) {
+        m_pos++;
+    }
+}
+
+bool JsonScanner::scanString(std::string* decoded) {
+    if (m_failed) return false;
+    const size_t start = ++m_pos;
+    size_t copied = start;  // with escapes: where the text not yet in *decoded begins
+    m_escaped = false;
+
+    for (;;) {
+#ifdef JSON_SSE2
+        // to the next quote, backslash, control character or non-ascii byte.
+        // bytes >= 0x80 are negative as signed chars, so the one compare
+        // against 0x20 finds them along with the control characters
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x20);
+        while (m_pos + 16 <= m_size) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_data + m_pos));
+            __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                           _mm_cmplt_epi8(chunk, control));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+            if (mask != 0) {
+                m_pos += lowestBit(mask);
+                break;
+            }
+            m_pos += 16;
+        }
+#endif
+        while (m_pos < m_size) {
+            unsigned char c = static_cast<unsigned char>(m_data[m_pos]);
+            if (c == '"' || c == '\\' || c < 0x20 || c >= 0x80) break;
+            m_pos++;
+        }
+        if (m_pos >= m_size) return fail();
+
+        unsigned char c = static_cast<unsigned char>(m_data[m_pos]);
+        if (c == '"') {
+            m_raw = std::string_view(m_data + start, m_pos - start);
+            if (m_escaped && decoded) {
+                decoded->append(m_data + copied, m_pos - copied);
+            }
+            m_pos++;
+            return true;
+        }
+        if (c < 0x20) return fail();
+        if (c >= 0x80) {
+            int length = utf8Length(reinterpret_cast<const unsigned char*>(m_data + m_pos),
+                                    reinterpret_cast<const unsigned char*>(m_data + m_size));
+            if (length == 0) return fail();
+            m_pos += length;
+            continue;
+        }
+
+        // an escape, from here on the text is built up in *decoded
+        if (!m_escaped && decoded) {
+            decoded->assign(m_data + start, m_pos - start);
+        } else if (decoded) {
+            decoded->append(m_data + copied, m_pos - copied);
+        }
+        m_escaped = true;
+        if (m_pos + 1 >= m_size) return fail();
+        char escape = m_data[m_pos + 1];
+        m_pos += 2;
+        char plain = 0;
+        switch (escape) {
+            case '"': plain = '"'; break;
+            case '\\': plain = '\\'; break;
+            case '/': plain = '/'; break;
+            case 'b': plain = '\b'; break;
+            case 'f': plain = '\f'; break;
+            case 'n': plain = '\n'; break;
+            case 'r': plain = '\r'; break;
+            case 't': plain = '\t'; break;
+            case 'u': {
+                auto readHex = [this](uint32_t& unit) {
+                    if (m_pos + 4 > m_size) return false;
+                    unit = 0;
+                    for (int i = 0; i < 4; i++) {
+                        int digit = hexValue(m_data[m_pos + i]);
+                        if (digit < 0) return false;
+                        unit = unit * 16 + digit;
+                    }
+                    m_pos += 4;
+                    return true;
+                };
+                uint32_t code;
+                if (!readHex(code)) return fail();
+                if (code >= 0xd800 && code <= 0xdbff) {
+                    uint32_t low;
+                    if (m_pos + 2 > m_size || m_data[m_pos] != '\\' || m_data[m_pos + 1] != 'u') return fail();
+                    m_pos += 2;
+                    if (!readHex(low) || low < 0xdc00 || low > 0xdfff) return fail();
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                } else if (code >= 0xdc00 && code <= 0xdfff) {
+                    // a lone low surrogate, qt keeps it but it has no utf-8 form
+                    return fail();
+                }
+                if (decoded) appendUtf8(*decoded, code);
+                break;
+            }
+            default:
+                return fail();
+        }
+        if (plain != 0 && decoded) {
+            *decoded += plain;
+        }
+        copied = m_pos;
+    }
+}
+
+bool JsonScanner::enter() {
+    if (m_failed) return false;
+    if (m_first.size() >= MAX_DEPTH) return fail();
+    m_first.push_back(true);
+    m_pos++;
+    return true;
+}
+
+JsonScanner::Kind JsonScanner::peek() {
+    if (m_failed) return Kind::Invalid;
+    skipWhitespace();
+    if (m_pos >= m_size) return Kind::Invalid;
+    char c = m_data[m_pos];
+    switch (c) {
+        case '{': return Kind::Object;
+        case '[': return Kind::Array;
+        case '"': return Kind::String;
+        case 't':
+        case 'f': return Kind::Bool;
+        case 'n': return Kind::Null;
+        default: return c == '-' || isDigit(c) ? Kind::Number : Kind::Invalid;
+    }
+}
+
+bool JsonScanner::beginObject() {
+    if (peek() != Kind::Object) return fail();
+    return enter();
+}
+
+bool JsonScanner::nextKey(std::string_view& key) {
+    if (m_failed || m_first.empty()) return false;
+    skipWhitespace();
+    if (m_pos >= m_size) return fail();
+    char c = m_data[m_pos];
+    if (c == '}') {
+        m_pos++;
+        m_first.pop_back();
+        return false;
+    }
+    if (!m_first.back()) {
+        if (c != ',') return fail();
+        m_pos++;
+        skipWhitespace();
+    }
+    m_first.back() = false;
+    if (m_pos >= m_size || m_data[m_pos] != '"') return fail();
+    m_key.clear();
+    if (!scanString(&m_key)) return false;
+    key = m_escaped ? std::string_view(m_key) : m_raw;
+    skipWhitespace();
+    if (m_pos >= m_size || m_data[m_pos] != ':') return fail();
+    m_pos++;
+    return true;
+}
+
+bool JsonScanner::beginArray() {
+    if (peek() != Kind::Array) return fail();
+    return enter();
+}
+
+bool JsonScanner::nextElement() {
+    if (m_failed || m_first.empty()) return false;
+    skipWhitespace();
+    if (m_pos >= m_size) return fail();
+    char c = m_data[m_pos];
+    if (c == ']') {
+        m_pos++;
+        m_first.pop_back();
+        return false;
+    }
+    if (!m_first.back()) {
+        if (c != ',') return fail();
+        m_pos++;
+        // no trailing comma
+        skipWhitespace();
+        if (m_pos >= m_size || m_data[m_pos] == ']') return fail();
+    }
+    m_first.back() = false;
+    return true;
+}
+
+bool JsonScanner::readNumber(double& value) {
+    if (peek() != Kind::Number) return fail();
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?, collecting up to 19
+    // significant digits as an integer on the way
+    const size_t start = m_pos;
+    bool negative = m_data[m_pos] == '-';
+    if (negative) m_pos++;
+    if (m_pos >= m_size || !isDigit(m_data[m_pos])) return fail();
+
+    uint64_t mantissa = 0;
+    int digits = 0;        // significant digits in mantissa
+    bool truncated = false;
+    int exponent = 0;      // power of ten mantissa is scaled by
+    auto takeDigit = [&](char c, bool fraction) {
+        if (digits == 0 && c == '0') {
+            if (fraction) exponent--;
+            return;
+        }
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (c - '0');
+            digits++;
+            if (fraction) exponent--;
+        } else {
+            truncated = true;
+            if (!fraction) exponent++;
+        }
+    };
+
+    if (m_data[m_pos] == '0') {
+        m_pos++;
+    } else {
+        while (m_pos < m_size && isDigit(m_data[m_pos])) {
+            takeDigit(m_data[m_pos++], false);
+        }
+    }
+    bool integer = true;
+    if (m_pos < m_size && m_data[m_pos] == '.') {
+        integer = false;
+        m_pos++;
+        if (m_pos >= m_size || !isDigit(m_data[m_pos])) return fail();
+        while (m_pos < m_size && isDigit(m_data[m_pos])) {
+            takeDigit(m_data[m_pos++], true);
+        }
+    }
+    if (m_pos < m_size && (m_data[m_pos] == 'e' || m_data[m_pos] == 'E')) {
+        integer = false;
+        m_pos++;
+        bool negativeExponent = false;
+        if (m_pos < m_size && (m_data[m_pos] == '+' || m_data[m_pos] == '-')) {
+            negativeExponent = m_data[m_pos] == '-';
+            m_pos++;
+        }
+        if (m_pos >= m_size || !isDigit(m_data[m_pos])) return fail();
+        int written = 0;
+        while (m_pos < m_size && isDigit(m_data[m_pos])) {
+            if (written < 100000) written = written * 10 + (m_data[m_pos] - '0');
+            m_pos++;
+        }
+        exponent += negativeExponent ? -written : written;
+    }
+
+    // qt keeps integer literals as qint64, and converting those is exact
+    // rounding too. "-0" is an integer zero, so it comes out positive
+    if (integer && !truncated && digits <= 18) {
+        value = static_cast<double>(static_cast<int64_t>(mantissa)) * (negative ? -1.0 : 1.0);
+        if (mantissa == 0) value = 0.0;
+        return true;
+    }
+    if (!truncated && digits <= MAX_FAST_DIGITS && exponent >= -22 && exponent <= 22) {
+        double magnitude = static_cast<double>(mantissa);
+        magnitude = exponent < 0 ? magnitude / POWERS_OF_TEN[-exponent] : magnitude * POWERS_OF_TEN[exponent];
+        value = negative ? -magnitude : magnitude;
+        return true;
+    }
+
+    // everything else is rare in scene files, leave it to qt's correctly
+    // rounded conversion
+    bool ok = false;
+    value = QByteArray::fromRawData(m_data + start, static_cast<qsizetype>(m_pos - start)).toDouble(&ok);
+    if (!ok || !std::isfinite(value)) return fail();
+    return true;
+}
+
+bool JsonScanner::readString(std::string& value) {
+    if (peek() != Kind::String) return fail();
+    if (!scanString(&value)) return false;
+    if (!m_escaped) {
+        value.assign(m_raw.data(), m_raw.size());
+    }
+    return true;
+}
+
+bool JsonScanner::skipValue() {
+    auto literal = [this](const char* word, size_t length) {
+        if (m_size - m_pos < length || std::memcmp(m_data + m_pos, word, length) != 0) return fail();
+        m_pos += length;
+        return true;
+    };
+
+    switch (peek()) {
+        case Kind::Object: {
+            beginObject();
+            std::string_view key;
+            while (nextKey(key)) {
+                if (!skipValue()) return false;
+            }
+            return !m_failed;
+        }
+        case Kind::Array:
+            beginArray();
+            while (nextElement()) {
+                if (!skipValue()) return false;
+            }
+            return !m_failed;
+        case Kind::String:
+            return scanString(nullptr);
+        case Kind::Number: {
+            double value;
+            return readNumber(value);
+        }
+        case Kind::Bool:
+            return m_data[m_pos] == 't' ? literal("true", 4) : literal("false", 5);
+        case Kind::Null:
+            return literal("null", 4);
+        default:
+            return fail();
+    }
+}
+
+bool JsonScanner::finish() {
+    if (m_failed || !m_first.empty()) return fail();
+    skipWhitespace();
+    return m_pos == m_size || fail();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// a pull tokenizer over json text in memory, for readers that build their own
+// structures as the tokens come in instead of going through a QJsonDocument.
+// runs of whitespace and string bodies are scanned 16 bytes at a time (sse2
+// where available), the structural characters between them by a switch.
+//
+// it is strict: anything QJsonDocument rejects fails here too. a failure
+// sticks, every call after it returns false, so a reader can check failed()
+// once at the end of a loop instead of after every token
+class JsonScanner {
+public:
+    enum class Kind { Object, Array, String, Number, Bool, Null, Invalid };
+
+    JsonScanner(const char* data, size_t size);
+
+    // what the next value is, without consuming it
+    Kind peek();
+
+    // consume '{', then call nextKey() until it returns false, reading exactly
+    // one value after each key. keys stay valid until the next call
+    bool beginObject();
+    bool nextKey(std::string_view& key);
+
+    // consume '[', then call nextElement() until it returns false, reading
+    // exactly one value after each true
+    bool beginArray();
+    bool nextElement();
+
+    // integers give what QJsonValue::toDouble() gives for them ("-0" is +0)
+    bool readNumber(double& value);
+    bool readString(std::string& value);
+
+    // checks and steps over one value of any kind
+    bool skipValue();
+
+    // true when only whitespace is left after the last value
+    bool finish();
+
+    bool failed() const { return m_failed; }
+
+private:
+    bool fail();
+    void skipWhitespace();
+    // at the opening quote. decoded (may be null) gets the text when it had
+    // escapes, m_raw always points at the text between the quotes
+    bool scanString(std::string* decoded);
+    bool enter();
+
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+    bool m_failed = false;
+    std::vector<bool> m_first;  // per open container: no member read yet
+    std::string_view m_raw;     // the last string between its quotes
+    bool m_escaped = false;     // it had escapes, so m_raw isn't its text
+    std::string m_key;          // the last key, when it had escapes
+};
@@ -120,7 +120,7 @@ struct SceneMaterial {
     float blend;             // Used for texture mapping
 
     SceneColor cEmissive; // Not used
-    SceneFileMap bumpMap; // Not used
+    SceneFileMap bumpMap; // Used for normal mapping
 
     void clear()
     {
@@ -1,5 +1,7 @@
 #include "scenefilereader.h"
 #include "scenedata.h"
+#include "scenestreamreader.h"
+#include "ZoneProfiler.h"
 
 #include "glm/gtc/type_ptr.hpp"
 
@@ -17,6 +19,27 @@
 #define UNSUPPORTED_ELEMENT(e) std::cout << ERROR_AT(e) << "unsupported element <" \
                                          << e.tagName().toStdString() << ">" << std::endl;
 
+// Asset paths are relative to the scene file. Older scenes wrote them relative
+// to the project root (the scene directory's parent), so fall back to that.
+std::string ScenefileReader::resolveAssetPath(const std::string &sceneFile, const std::string &assetPath) {
+    std::filesystem::path relativePath(assetPath);
+    if (relativePath.is_absolute()) {
+        return relativePath.lexically_normal().string();
+    }
+
+    std::filesystem::path sceneDir = std::filesystem::absolute(sceneFile).parent_path();
+    std::filesystem::path resolved = (sceneDir / relativePath).lexically_normal();
+    if (std::filesystem::exists(resolved)) {
+        return resolved.string();
+    }
+
+    std::filesystem::path legacy = (sceneDir.parent_path() / relativePath).lexically_normal();
+    if (std::filesystem::exists(legacy)) {
+        return legacy.string();
+    }
+    return resolved.string();
+}
+
 // Students, please ignore this file.
 ScenefileReader::ScenefileReader(const std::string &name) {
     file_name = name;
@@ -53,6 +76,29 @@ ScenefileReader::~ScenefileReader() {
     m_templates.clear();
 }
 
+void ScenefileReader::clear() {
+    for (SceneNode *node : m_nodes) {
+        for (SceneTransformation *transformation : node->transformations) {
+            delete transformation;
+        }
+        for (ScenePrimitive *primitive : node->primitives) {
+            delete primitive;
+        }
+        for (SceneLight *light : node->lights) {
+            delete light;
+        }
+        delete node;
+    }
+    m_nodes.clear();
+    m_templates.clear();
+
+    memset(&m_cameraData, 0, sizeof(SceneCameraData));
+    memset(&m_globalData, 0, sizeof(SceneGlobalData));
+
+    m_root = new SceneNode;
+    m_nodes.push_back(m_root);
+}
+
 SceneGlobalData ScenefileReader::getGlobalData() const {
     return m_globalData;
 }
@@ -67,6 +113,39 @@ SceneNode *ScenefileReader::getRootNode() const {
 
 // This is where it all goes down...
 bool ScenefileReader::readJSON() {
+    PROFILE_ZONE("ScenefileReader::readJSON");
+    QFile file(file_name.c_str());
+    if (!file.open(QFile::ReadOnly)) {
+        std::cout << "could not open " << file_name << std::endl;
+        return false;
+    }
+
+    // Map the file rather than copying it, the scanner goes over it once
+    QByteArray fileContents;
+    const char *data = reinterpret_cast<const char *>(file.map(0, file.size()));
+    size_t size = file.size();
+    if (!data) {
+        fileContents = file.readAll();
+        data = fileContents.constData();
+        size = fileContents.size();
+    }
+
+    bool streamed = SceneStreamReader(*this, data, size).read();
+    file.close();
+    if (streamed) {
+        std::cout << "Finished reading " << file_name << std::endl;
+        return true;
+    }
+
+    // The streaming reader stops at the first problem without saying what it
+    // was. Start over on the dom path, which prints the usual messages (or,
+    // for the few valid scenes the streaming reader leaves alone, reads them)
+    clear();
+    return readJSONDom();
+}
+
+bool ScenefileReader::readJSONDom() {
+    PROFILE_ZONE("ScenefileReader::readJSONDom");
     // Read the file
     QFile file(file_name.c_str());
     if (!file.open(QFile::ReadOnly)) {
@@ -840,7 +919,6 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
     mat.cDiffuse.r = mat.cDiffuse.g = mat.cDiffuse.b = 1;
     node->primitives.push_back(primitive);
 
-    std::filesystem::path basepath = std::filesystem::path(file_name).parent_path().parent_path();
     if (primType == "sphere")
         primitive->type = PrimitiveType::PRIMITIVE_SPHERE;
     else if (primType == "cube")
@@ -860,8 +938,7 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
             return false;
         }
 
-        std::filesystem::path relativePath(prim["meshFile"].toString().toStdString());
-        primitive->meshfile = (basepath / relativePath).string();
+        primitive->meshfile = resolveAssetPath(file_name, prim["meshFile"].toString().toStdString());
     }
     else {
         std::cout << "unknown primitive type \"" << primType << "\"" << std::endl;
@@ -1005,9 +1082,7 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
             std::cout << "primitive textureFile must be of type string" << std::endl;
             return false;
         }
-        std::filesystem::path fileRelativePath(prim["textureFile"].toString().toStdString());
-
-        mat.textureMap.filename = (basepath / fileRelativePath).string();
+        mat.textureMap.filename = resolveAssetPath(file_name, prim["textureFile"].toString().toStdString());
         mat.textureMap.repeatU = prim.contains("textureU") && prim["textureU"].isDouble() ? prim["textureU"].toDouble() : 1;
         mat.textureMap.repeatV = prim.contains("textureV") && prim["textureV"].isDouble() ? prim["textureV"].toDouble() : 1;
         mat.textureMap.isUsed = true;
@@ -1018,9 +1093,7 @@ bool ScenefileReader::parsePrimitive(const QJsonObject &prim, SceneNode *node) {
             std::cout << "primitive bumpMapFile must be of type string" << std::endl;
             return false;
         }
-        std::filesystem::path fileRelativePath(prim["bumpMapFile"].toString().toStdString());
-
-        mat.bumpMap.filename = (basepath / fileRelativePath).string();
+        mat.bumpMap.filename = resolveAssetPath(file_name, prim["bumpMapFile"].toString().toStdString());
         mat.bumpMap.repeatU = prim.contains("bumpMapU") && prim["bumpMapU"].isDouble() ? prim["bumpMapU"].toDouble() : 1;
         mat.bumpMap.repeatV = prim.contains("bumpMapV") && prim["bumpMapV"].isDouble() ? prim["bumpMapV"].toDouble() : 1;
         mat.bumpMap.isUsed = true;
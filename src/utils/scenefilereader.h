@@ -18,8 +18,14 @@ public:
     ~ScenefileReader();
 
     // Parse the XML scene file. Returns false if scene is invalid.
+    // The file is mapped and streamed through SceneStreamReader; anything it
+    // can't take goes through readJSONDom, which explains what is wrong.
     bool readJSON();
 
+    // The QJsonDocument reader readJSON used to be, kept for its error
+    // messages and to benchmark the streaming reader against.
+    bool readJSONDom();
+
     SceneGlobalData getGlobalData() const;
 
     SceneCameraData getCameraData() const;
@@ -27,6 +33,14 @@ public:
     SceneNode *getRootNode() const;
 
 private:
+    friend class SceneStreamReader;
+
+    // Asset paths in the scene are relative to the scene file.
+    static std::string resolveAssetPath(const std::string &sceneFile, const std::string &assetPath);
+
+    // Back to the state the constructor left, dropping a half read graph.
+    void clear();
+
     bool parseGlobalData(const QJsonObject &globaldata);
     bool parseCameraData(const QJsonObject &cameradata);
     bool parseTemplateGroups(const QJsonValue &templateGroups);
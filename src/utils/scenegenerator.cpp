@@ -0,0 +1,370 @@
+#include "scenegenerator.h"
+#include <QColor>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QSaveFile>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr size_t FLUSH_BYTES = 1 << 20;
+constexpr int TEXTURE_SIZE = 256;
+
+const char* PRIMITIVE_TYPES[] = {"cube", "sphere", "cylinder", "cone"};
+
+// mt19937 is specified bit for bit, the standard distributions aren't. draws
+// are always taken one statement at a time, argument evaluation order isn't fixed
+class Random {
+public:
+    explicit Random(unsigned seed) : m_engine(seed) {}
+
+    // [0, 1)
+    double next() { return (m_engine() >> 8) * (1.0 / 16777216.0); }
+    double range(double low, double high) { return low + (high - low) * next(); }
+    // [0, count)
+    int index(int count) { return std::min(count - 1, static_cast<int>(next() * count)); }
+
+private:
+    std::mt19937 m_engine;
+};
+
+struct Material {
+    glm::vec3 ambient;
+    glm::vec3 diffuse;
+    glm::vec3 specular;
+    float shininess = 20.0f;
+    int texture = -1;
+};
+
+// the json text, handed to the file a megabyte at a time
+class Output {
+public:
+    explicit Output(const QString& path) : m_file(path) {}
+
+    bool open() { return m_file.open(QIODevice::WriteOnly); }
+
+    void append(const char* format, ...) {
+        char line[512];
+        va_list arguments;
+        va_start(arguments, format);
+        int length = std::vsnprintf(line, sizeof(line), format, arguments);
+        va_end(arguments);
+        m_buffer.append(line, static_cast<size_t>(std::clamp(length, 0, static_cast<int>(sizeof(line)) - 1)));
+        if (m_buffer.size() >= FLUSH_BYTES) {
+            flush();
+        }
+    }
+
+    bool commit() {
+        flush();
+        return m_ok && m_file.commit();
+    }
+
+private:
+    void flush() {
+        m_ok = m_ok && m_file.write(m_buffer.data(), static_cast<qint64>(m_buffer.size())) ==
+                           static_cast<qint64>(m_buffer.size());
+        m_buffer.clear();
+    }
+
+    QSaveFile m_file;
+    std::string m_buffer;
+    bool m_ok = true;
+};
+
+class Generator {
+public:
+    Generator(const SceneGeneratorOptions& options, Output& out, const std::string& textureDirectory)
+        : m_options(options), m_out(out), m_random(options.seed), m_textureDirectory(textureDirectory) {}
+
+    void write() {
+        int count = std::max(0, m_options.primitives);
+        placeObjects(count);
+        makeMaterials();
+
+        float e = m_options.extent;
+        glm::vec3 eye(0.0f, e * 0.3f + 2.0f, e * 0.6f + 5.0f);
+        glm::vec3 look = glm::normalize(glm::vec3(0.0f) - eye);
+        m_out.append("{\n  \"name\": \"generated, %d objects, seed %u\",\n", count, m_options.seed);
+        m_out.append("  \"globalData\": {\"ambientCoeff\": 0.5, \"diffuseCoeff\": 0.7, \"specularCoeff\": 0.5, "
+                     "\"transparentCoeff\": 0},\n");
+        m_out.append("  \"cameraData\": {\"position\": [%.3f, %.3f, %.3f], \"up\": [0, 1, 0], "
+                     "\"look\": [%.4f, %.4f, %.4f], \"heightAngle\": 45},\n",
+                     eye.x, eye.y, eye.z, look.x, look.y, look.z);
+
+        if (m_options.templates > 0) {
+            m_out.append("  \"templateGroups\": [\n");
+            for (int t = 0; t < m_options.templates; t++) {
+                writeTemplate(t, t + 1 < m_options.templates);
+            }
+            m_out.append("  ],\n");
+        }
+
+        m_out.append("  \"groups\": [\n");
+        writeLights();
+        if (count > 0) {
+            m_out.append(",\n");
+            int depth = std::max(0, m_options.depth);
+            int branching = std::max(2, static_cast<int>(std::ceil(std::pow(count, 1.0 / (depth + 1)))));
+            writeGroups(0, count, depth, branching, glm::vec3(0.0f), 2);
+        }
+        m_out.append("\n  ]\n}\n");
+    }
+
+private:
+    void placeObjects(int count) {
+        float e = m_options.extent;
+        m_positions.resize(static_cast<size_t>(count));
+        switch (m_options.distribution) {
+        case SceneDistribution::Grid: {
+            int side = std::max(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count)))));
+            float spacing = e / side;
+            for (int i = 0; i < count; i++) {
+                m_positions[i] = glm::vec3((i % side + 0.5f) * spacing - e / 2, 0.0f, (i / side + 0.5f) * spacing - e / 2);
+            }
+            break;
+        }
+        case SceneDistribution::Clustered: {
+            int clusters = std::max(1, m_options.clusters);
+            std::vector<glm::vec3> centers;
+            for (int c = 0; c < clusters; c++) {
+                float x = static_cast<float>(m_random.range(-0.4, 0.4)) * e;
+                float z = static_cast<float>(m_random.range(-0.4, 0.4)) * e;
+                centers.emplace_back(x, 0.0f, z);
+            }
+            // a sum of three uniforms is close enough to a normal spread around the center
+            float radius = e / (2.0f * std::sqrt(static_cast<float>(clusters)));
+            auto spread = [&]() {
+                double sum = m_random.next();
+                sum += m_random.next();
+                sum += m_random.next();
+                return static_cast<float>(sum - 1.5);
+            };
+            for (int i = 0; i < count; i++) {
+                const glm::vec3& center = centers[m_random.index(clusters)];
+                float x = spread() * radius;
+                float y = std::abs(spread()) * radius * 0.2f;
+                float z = spread() * radius;
+                m_positions[i] = center + glm::vec3(x, y, z);
+            }
+            break;
+        }
+        case SceneDistribution::Uniform:
+            for (int i = 0; i < count; i++) {
+                float x = static_cast<float>(m_random.range(-0.5, 0.5)) * e;
+                float y = static_cast<float>(m_random.range(0.0, 0.05)) * e;
+                float z = static_cast<float>(m_random.range(-0.5, 0.5)) * e;
+                m_positions[i] = glm::vec3(x, y, z);
+            }
+            break;
+        }
+        m_objectSize = std::clamp(0.7f * e / std::sqrt(static_cast<float>(std::max(1, count))), 0.05f, 2.0f);
+    }
+
+    void makeMaterials() {
+        int count = std::max(1, m_options.materials);
+        for (int i = 0; i < count; i++) {
+            float hue = static_cast<float>(m_random.next());
+            float saturation = static_cast<float>(m_random.range(0.3, 0.8));
+            float value = static_cast<float>(m_random.range(0.6, 1.0));
+            QColor color = QColor::fromHsvF(hue, saturation, value);
+            Material material;
+            material.diffuse = glm::vec3(color.redF(), color.greenF(), color.blueF());
+            material.ambient = material.diffuse * 0.3f;
+            material.specular = glm::vec3(static_cast<float>(m_random.range(0.1, 0.8)));
+            material.shininess = static_cast<float>(m_random.range(4.0, 64.0));
+            material.texture = m_options.textures > 0 ? i % m_options.textures : -1;
+            m_materials.push_back(material);
+        }
+    }
+
+    void writePrimitive(const char* type, const Material& material) {
+        m_out.append("{\"type\": \"%s\", \"ambient\": [%.3f, %.3f, %.3f], \"diffuse\": [%.3f, %.3f, %.3f], "
+                     "\"specular\": [%.3f, %.3f, %.3f], \"shininess\": %.1f",
+                     type, material.ambient.r, material.ambient.g, material.ambient.b, material.diffuse.r,
+                     material.diffuse.g, material.diffuse.b, material.specular.r, material.specular.g,
+                     material.specular.b, material.shininess);
+        if (material.texture >= 0) {
+            m_out.append(", \"textureFile\": \"%s/tex_%04d.png\"", m_textureDirectory.c_str(), material.texture);
+        }
+        m_out.append("}");
+    }
+
+    const Material& pickMaterial() { return m_materials[m_random.index(static_cast<int>(m_materials.size()))]; }
+
+    // a base slab with two of the other shapes on it
+    void writeTemplate(int index, bool more) {
+        m_out.append("    {\"name\": \"template_%d\", \"groups\": [\n", index);
+        m_out.append("      {\"translate\": [0, -0.4, 0], \"scale\": [1, 0.2, 1], \"primitives\": [");
+        writePrimitive("cube", pickMaterial());
+        m_out.append("]},\n      {\"translate\": [-0.25, 0.1, 0], \"scale\": [0.4, 0.8, 0.4], \"primitives\": [");
+        writePrimitive(PRIMITIVE_TYPES[1 + index % 3], pickMaterial());
+        m_out.append("]},\n      {\"translate\": [0.25, 0.1, 0], \"scale\": [0.4, 0.8, 0.4], \"primitives\": [");
+        writePrimitive(PRIMITIVE_TYPES[1 + (index + 1) % 3], pickMaterial());
+        m_out.append("]}\n    ]}%s\n", more ? "," : "");
+    }
+
+    void writeLights() {
+        float e = m_options.extent;
+        int count = std::max(0, m_options.lights);
+        m_out.append("    {\"groups\": [");
+        for (int i = 0; i < count; i++) {
+            glm::vec3 color;
+            for (int c = 0; c < 3; c++) {
+                color[c] = static_cast<float>(m_random.range(0.6, 1.0));
+            }
+            m_out.append("%s\n      {", i > 0 ? "," : "");
+            if (i == 0) {
+                m_out.append("\"lights\": [{\"type\": \"directional\", \"color\": [%.3f, %.3f, %.3f], "
+                             "\"direction\": [-0.3, -1, -0.2]}]}",
+                             color.r, color.g, color.b);
+                continue;
+            }
+            double x = m_random.range(-0.5, 0.5) * e;
+            double y = 2.0 + m_random.range(0.05, 0.15) * e;
+            double z = m_random.range(-0.5, 0.5) * e;
+            m_out.append("\"translate\": [%.3f, %.3f, %.3f], ", x, y, z);
+            if (i % 3 == 0) {
+                m_out.append("\"lights\": [{\"type\": \"spot\", \"color\": [%.3f, %.3f, %.3f], "
+                             "\"attenuationCoeff\": [1, 0.05, 0.01], \"direction\": [0, -1, 0], "
+                             "\"penumbra\": 10, \"angle\": 35}]}",
+                             color.r, color.g, color.b);
+            } else {
+                m_out.append("\"lights\": [{\"type\": \"point\", \"color\": [%.3f, %.3f, %.3f], "
+                             "\"attenuationCoeff\": [1, 0.05, 0.01]}]}",
+                             color.r, color.g, color.b);
+            }
+        }
+        m_out.append("\n    ]}");
+    }
+
+    glm::vec3 center(int begin, int end) const {
+        glm::dvec3 sum(0.0);
+        for (int i = begin; i < end; i++) {
+            sum += glm::dvec3(m_positions[i]);
+        }
+        return glm::vec3(sum / static_cast<double>(std::max(1, end - begin)));
+    }
+
+    // objects [begin, end) as groups nested levels deep, relative to parent
+    void writeGroups(int begin, int end, int levels, int branching, const glm::vec3& parent, int indent) {
+        if (levels == 0) {
+            for (int i = begin; i < end; i++) {
+                writeObject(i, parent, indent, i + 1 < end);
+            }
+            return;
+        }
+
+        int chunk = std::max(1, (end - begin + branching - 1) / branching);
+        for (int first = begin; first < end; first += chunk) {
+            int last = std::min(end, first + chunk);
+            glm::vec3 middle = center(first, last);
+            glm::vec3 offset = middle - parent;
+            m_out.append("%*s{\"translate\": [%.3f, %.3f, %.3f], \"groups\": [\n", indent * 2, "", offset.x, offset.y,
+                         offset.z);
+            writeGroups(first, last, levels - 1, branching, middle, indent + 1);
+            m_out.append("%*s]}%s\n", indent * 2, "", last < end ? "," : "");
+        }
+    }
+
+    void writeObject(int index, const glm::vec3& parent, int indent, bool more) {
+        glm::vec3 offset = m_positions[index] - parent;
+        float size = m_objectSize;
+        m_out.append("%*s{\"translate\": [%.3f, %.3f, %.3f], ", indent * 2, "", offset.x, offset.y + size / 2, offset.z);
+        if (m_options.distribution != SceneDistribution::Grid) {
+            size *= static_cast<float>(m_random.range(0.6, 1.0));
+            m_out.append("\"rotate\": [0, 1, 0, %.1f], ", m_random.range(0.0, 360.0));
+        }
+        m_out.append("\"scale\": [%.3f, %.3f, %.3f], ", size, size, size);
+
+        if (m_options.templates > 0 && m_random.next() < m_options.templateReuse) {
+            m_out.append("\"groups\": [{\"name\": \"template_%d\"}]}%s\n", m_random.index(m_options.templates),
+                         more ? "," : "");
+            return;
+        }
+        m_out.append("\"primitives\": [");
+        const char* type = PRIMITIVE_TYPES[m_random.index(4)];
+        writePrimitive(type, pickMaterial());
+        m_out.append("]}%s\n", more ? "," : "");
+    }
+
+    const SceneGeneratorOptions& m_options;
+    Output& m_out;
+    Random m_random;
+    std::string m_textureDirectory;
+    std::vector<glm::vec3> m_positions;
+    std::vector<Material> m_materials;
+    float m_objectSize = 1.0f;
+};
+
+// a checkerboard in a hue of its own, so no two textures share content
+bool writeTexture(const QString& path, int index, int count) {
+    QImage image(TEXTURE_SIZE, TEXTURE_SIZE, QImage::Format_RGB888);
+    QColor light = QColor::fromHsvF(static_cast<float>(index) / count, 0.35f, 0.95f);
+    QColor dark = QColor::fromHsvF(static_cast<float>(index) / count, 0.7f, 0.45f);
+    int cell = 8 << (index % 3);
+    for (int y = 0; y < TEXTURE_SIZE; y++) {
+        for (int x = 0; x < TEXTURE_SIZE; x++) {
+            image.setPixelColor(x, y, ((x / cell) + (y / cell)) % 2 == 0 ? light : dark);
+        }
+    }
+    if (!image.save(path)) {
+        std::cerr << "Failed to save texture to " << path.toStdString() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+bool SceneGenerator::write(const std::string& path, const SceneGeneratorOptions& options) {
+    QFileInfo scene(QString::fromStdString(path));
+    QString textureDirectory = scene.completeBaseName() + "_textures";
+
+    if (options.textures > 0) {
+        QDir directory = scene.absoluteDir();
+        if (!directory.mkpath(textureDirectory)) {
+            std::cerr << "Failed to create " << directory.filePath(textureDirectory).toStdString() << std::endl;
+            return false;
+        }
+        for (int i = 0; i < options.textures; i++) {
+            QString name = QString("tex_%1.png").arg(i, 4, 10, QChar('0'));
+            if (!writeTexture(directory.filePath(textureDirectory + "/" + name), i, options.textures)) {
+                return false;
+            }
+        }
+    }
+
+    Output out(QString::fromStdString(path));
+    if (!out.open()) {
+        std::cerr << "Failed to save scene to " << path << std::endl;
+        return false;
+    }
+    Generator(options, out, textureDirectory.toStdString()).write();
+    if (!out.commit()) {
+        std::cerr << "Failed to save scene to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool SceneGenerator::parseDistribution(const std::string& name, SceneDistribution& distribution) {
+    if (name == "grid") {
+        distribution = SceneDistribution::Grid;
+    } else if (name == "clustered") {
+        distribution = SceneDistribution::Clustered;
+    } else if (name == "uniform") {
+        distribution = SceneDistribution::Uniform;
+    } else {
+        return false;
+    }
+    return true;
+}
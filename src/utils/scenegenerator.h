@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+
+// how generated objects are spread over the ground plane
+enum class SceneDistribution {
+    Grid,       // evenly spaced rows and columns
+    Clustered,  // bunched around a few random centers
+    Uniform,    // anywhere, independently
+};
+
+struct SceneGeneratorOptions {
+    int primitives = 1000;        // objects placed, a template reference counts as one
+    int lights = 8;               // the first is directional, then point and spot lights
+    int templates = 0;            // distinct templateGroups, each a few primitives
+    float templateReuse = 0.0f;   // fraction of the objects placed as template references
+    int depth = 2;                // group levels between the root and the objects
+    int materials = 16;           // distinct materials the objects pick from
+    int textures = 0;             // distinct images written next to the scene, 0 = untextured
+    SceneDistribution distribution = SceneDistribution::Grid;
+    int clusters = 16;            // for Clustered
+    float extent = 100.0f;        // objects lie within +-extent/2 on x and z
+    unsigned seed = 1;
+};
+
+// writes synthetic scenes in the scenefile json format for stress tests and
+// benchmarks. the same options and seed give the same bytes on every platform:
+// randomness is a mt19937 turned into floats by hand, not through the standard
+// distributions whose output differs between standard libraries.
+// groups nest depth levels deep, each translated to the center of what it
+// holds, so the scene graph has real transforms to flatten
+class SceneGenerator {
+public:
+    // false (after printing why) if the scene or a texture can't be written.
+    // textures go to <scene name>_textures/ next to the scene
+    static bool write(const std::string& path, const SceneGeneratorOptions& options);
+
+    // "grid", "clustered" or "uniform"
+    static bool parseDistribution(const std::string& name, SceneDistribution& distribution);
+};
@@ -1,5 +1,6 @@
 #include "sceneparser.h"
 #include "scenefilereader.h"
+#include "ZoneProfiler.h"
 #include <glm/gtx/transform.hpp>
 #include <chrono>
 #include <iostream>
@@ -104,6 +105,7 @@ void traverseSceneGraph(SceneNode* node, const glm::mat4& parentCTM, RenderData&
 }
 
 bool SceneParser::parse(std::string filepath, RenderData &renderData) {
+    PROFILE_ZONE("SceneParser::parse");
     ScenefileReader fileReader(filepath);
     bool success = fileReader.readJSON();
     if (!success) {
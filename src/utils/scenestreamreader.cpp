@@ -0,0 +1,594 @@
+#include "scenestreamreader.h"
+#include "scenefilereader.h"
+
+#include "glm/gtc/type_ptr.hpp"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+using Kind = JsonScanner::Kind;
+
+template <size_t N>
+int fieldIndex(std::string_view key, const std::string_view (&names)[N]) {
+    for (size_t i = 0; i < N; i++) {
+        if (names[i] == key) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+}
+
+SceneStreamReader::SceneStreamReader(ScenefileReader &reader, const char *data, size_t size)
+    : m_reader(reader), m_json(data, size) {}
+
+bool SceneStreamReader::read() {
+    enum { GLOBAL_DATA, CAMERA_DATA, NAME, GROUPS, TEMPLATE_GROUPS };
+    static constexpr std::string_view names[] = {"globalData", "cameraData", "name", "groups", "templateGroups"};
+
+    if (!m_json.beginObject()) {
+        return false;
+    }
+    unsigned seen = 0;
+    std::string_view key;
+    while (m_json.nextKey(key)) {
+        int field = fieldIndex(key, names);
+        if (field < 0 || (seen & (1u << field))) {
+            return false;
+        }
+        seen |= 1u << field;
+
+        bool ok = false;
+        switch (field) {
+            case GLOBAL_DATA: ok = readGlobalData(); break;
+            case CAMERA_DATA: ok = readCameraData(); break;
+            case NAME: ok = m_json.skipValue(); break;
+            case GROUPS: ok = readGroups(m_reader.m_root); break;
+            case TEMPLATE_GROUPS: ok = readTemplateGroups(); break;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    if (m_json.failed() || !m_json.finish()) {
+        return false;
+    }
+    if (!(seen & (1u << GLOBAL_DATA)) || !(seen & (1u << CAMERA_DATA))) {
+        return false;
+    }
+
+    // groups read before their templates were all known, the dom path would
+    // have made these references
+    for (const std::string &name : m_unresolvedNames) {
+        if (m_reader.m_templates.contains(name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SceneStreamReader::readField(Field &field) {
+    switch (m_json.peek()) {
+        case Kind::Number:
+            field.kind = Field::Kind::Number;
+            return m_json.readNumber(field.numbers[0]);
+        case Kind::String:
+            field.kind = Field::Kind::String;
+            return m_json.readString(field.text);
+        case Kind::Array:
+            // short arrays of numbers are the only arrays any field takes
+            m_json.beginArray();
+            field.kind = Field::Kind::Numbers;
+            field.count = 0;
+            while (m_json.nextElement()) {
+                if (field.kind == Field::Kind::Numbers && field.count < 4 && m_json.peek() == Kind::Number) {
+                    if (!m_json.readNumber(field.numbers[field.count++])) {
+                        return false;
+                    }
+                } else {
+                    field.kind = Field::Kind::Other;
+                    if (!m_json.skipValue()) {
+                        return false;
+                    }
+                }
+            }
+            return !m_json.failed();
+        default:
+            field.kind = Field::Kind::Other;
+            return m_json.skipValue();
+    }
+}
+
+template <size_t N>
+bool SceneStreamReader::readFields(const std::string_view (&names)[N], Field (&fields)[N]) {
+    for (Field &field : fields) {
+        field.kind = Field::Kind::Missing;
+    }
+    if (!m_json.beginObject()) {
+        return false;
+    }
+    std::string_view key;
+    while (m_json.nextKey(key)) {
+        int index = fieldIndex(key, names);
+        if (index < 0 || fields[index].kind != Field::Kind::Missing || !readField(fields[index])) {
+            return false;
+        }
+    }
+    return !m_json.failed();
+}
+
+bool SceneStreamReader::readGlobalData() {
+    enum { AMBIENT, DIFFUSE, SPECULAR, TRANSPARENT };
+    static constexpr std::string_view names[] = {"ambientCoeff", "diffuseCoeff", "specularCoeff", "transparentCoeff"};
+    Field fields[4];
+    if (!readFields(names, fields)) {
+        return false;
+    }
+    if (!fields[AMBIENT].isNumber() || !fields[DIFFUSE].isNumber() || !fields[SPECULAR].isNumber()) {
+        return false;
+    }
+    if (fields[TRANSPARENT].kind != Field::Kind::Missing && !fields[TRANSPARENT].isNumber()) {
+        return false;
+    }
+
+    SceneGlobalData &global = m_reader.m_globalData;
+    global.ka = fields[AMBIENT].numbers[0];
+    global.kd = fields[DIFFUSE].numbers[0];
+    global.ks = fields[SPECULAR].numbers[0];
+    if (fields[TRANSPARENT].isNumber()) {
+        global.kt = fields[TRANSPARENT].numbers[0];
+    }
+    return true;
+}
+
+bool SceneStreamReader::readCameraData() {
+    enum { POSITION, UP, HEIGHT_ANGLE, APERTURE, FOCAL_LENGTH, LOOK, FOCUS };
+    static constexpr std::string_view names[] = {"position", "up", "heightAngle", "aperture", "focalLength", "look", "focus"};
+    Field fields[7];
+    if (!readFields(names, fields)) {
+        return false;
+    }
+    auto present = [&](int field) { return fields[field].kind != Field::Kind::Missing; };
+    if (!fields[POSITION].isNumbers(3) || !fields[UP].isNumbers(3) || !fields[HEIGHT_ANGLE].isNumber()) {
+        return false;
+    }
+    if ((present(APERTURE) && !fields[APERTURE].isNumber()) || (present(FOCAL_LENGTH) && !fields[FOCAL_LENGTH].isNumber())) {
+        return false;
+    }
+    if ((present(LOOK) && present(FOCUS)) || (present(LOOK) && !fields[LOOK].isNumbers(3)) ||
+        (present(FOCUS) && !fields[FOCUS].isNumbers(3))) {
+        return false;
+    }
+
+    SceneCameraData &camera = m_reader.m_cameraData;
+    const double *position = fields[POSITION].numbers;
+    camera.pos = glm::vec4(position[0], position[1], position[2], 1.f);
+    const double *up = fields[UP].numbers;
+    camera.up = glm::vec4(up[0], up[1], up[2], 0.f);
+    camera.heightAngle = fields[HEIGHT_ANGLE].numbers[0] * M_PI / 180.f;
+    if (present(APERTURE)) {
+        camera.aperture = fields[APERTURE].numbers[0];
+    }
+    if (present(FOCAL_LENGTH)) {
+        camera.focalLength = fields[FOCAL_LENGTH].numbers[0];
+    }
+    if (present(LOOK)) {
+        const double *look = fields[LOOK].numbers;
+        camera.look = glm::vec4(look[0], look[1], look[2], 0.f);
+    } else if (present(FOCUS)) {
+        // a focus point becomes the look vector from the camera to it
+        const double *focus = fields[FOCUS].numbers;
+        camera.look = glm::vec4(focus[0], focus[1], focus[2], 1.f);
+        camera.look -= camera.pos;
+    }
+    return true;
+}
+
+bool SceneStreamReader::readTemplateGroups() {
+    if (!m_json.beginArray()) {
+        return false;
+    }
+    while (m_json.nextElement()) {
+        if (m_json.peek() != Kind::Object) {
+            return false;
+        }
+        SceneNode *node = new SceneNode;
+        m_reader.m_nodes.push_back(node);
+
+        // the dom path registers a template before reading it, so its own
+        // groups can't be told apart until its name has gone by
+        m_templatesKnown = false;
+        if (!readGroupData(node, true, nullptr)) {
+            return false;
+        }
+    }
+    m_templatesKnown = true;
+    return !m_json.failed();
+}
+
+bool SceneStreamReader::readGroups(SceneNode *parent) {
+    if (!m_json.beginArray()) {
+        return false;
+    }
+    while (m_json.nextElement()) {
+        if (m_json.peek() != Kind::Object) {
+            return false;
+        }
+        size_t first = m_reader.m_nodes.size();
+        SceneNode *node = new SceneNode;
+        m_reader.m_nodes.push_back(node);
+        parent->children.push_back(node);
+
+        SceneNode *reference = nullptr;
+        if (!readGroupData(node, false, &reference)) {
+            return false;
+        }
+        if (reference) {
+            deleteNodesFrom(first);
+            parent->children.back() = reference;
+        }
+    }
+    return !m_json.failed();
+}
+
+// a group is read member by member: lights, primitives and groups go straight
+// into the node, the transformations are held back and added in the dom
+// path's order (translate, rotate, scale, matrix) at the end
+bool SceneStreamReader::readGroupData(SceneNode *node, bool isTemplate, SceneNode **reference) {
+    enum { NAME, TRANSLATE, ROTATE, SCALE, MATRIX, LIGHTS, PRIMITIVES, GROUPS };
+    static constexpr std::string_view names[] = {"name", "translate", "rotate", "scale", "matrix", "lights", "primitives", "groups"};
+
+    if (!m_json.beginObject()) {
+        return false;
+    }
+    unsigned seen = 0;
+    Field vector;
+    glm::vec3 translate, rotateAxis, scale;
+    float angle = 0;
+    glm::mat4 matrix;
+
+    std::string_view key;
+    while (m_json.nextKey(key)) {
+        int field = fieldIndex(key, names);
+
+        // a template reference, the dom path ignores everything else in it
+        if (reference && *reference) {
+            if (field == NAME || !m_json.skipValue()) {
+                return false;
+            }
+            continue;
+        }
+
+        if (field < 0 || (seen & (1u << field))) {
+            return false;
+        }
+        seen |= 1u << field;
+
+        switch (field) {
+            case NAME: {
+                std::string name;
+                if (!m_json.readString(name)) {
+                    return false;
+                }
+                if (isTemplate) {
+                    if (m_reader.m_templates.contains(name)) {
+                        return false;
+                    }
+                    m_reader.m_templates[name] = node;
+                    m_templatesKnown = true;
+                } else if (!m_templatesKnown) {
+                    m_unresolvedNames.push_back(std::move(name));
+                } else {
+                    auto found = m_reader.m_templates.find(name);
+                    if (found != m_reader.m_templates.end()) {
+                        *reference = found->second;
+                    }
+                }
+                break;
+            }
+            case TRANSLATE:
+                if (!readField(vector) || !vector.isNumbers(3)) {
+                    return false;
+                }
+                translate = glm::vec3(vector.numbers[0], vector.numbers[1], vector.numbers[2]);
+                break;
+            case ROTATE:
+                if (!readField(vector) || !vector.isNumbers(4)) {
+                    return false;
+                }
+                rotateAxis = glm::vec3(vector.numbers[0], vector.numbers[1], vector.numbers[2]);
+                angle = vector.numbers[3] * M_PI / 180.f;
+                break;
+            case SCALE:
+                if (!readField(vector) || !vector.isNumbers(3)) {
+                    return false;
+                }
+                scale = glm::vec3(vector.numbers[0], vector.numbers[1], vector.numbers[2]);
+                break;
+            case MATRIX:
+                if (!readMatrix(matrix)) {
+                    return false;
+                }
+                break;
+            case LIGHTS:
+            case PRIMITIVES:
+                if (!m_json.beginArray()) {
+                    return false;
+                }
+                while (m_json.nextElement()) {
+                    if (m_json.peek() != Kind::Object) {
+                        return false;
+                    }
+                    if (!(field == LIGHTS ? readLight(node) : readPrimitive(node))) {
+                        return false;
+                    }
+                }
+                if (m_json.failed()) {
+                    return false;
+                }
+                break;
+            case GROUPS:
+                if (!readGroups(node)) {
+                    return false;
+                }
+                break;
+        }
+    }
+    if (m_json.failed()) {
+        return false;
+    }
+    if (isTemplate && !(seen & (1u << NAME))) {
+        return false;
+    }
+    if (reference && *reference) {
+        return true;
+    }
+
+    if (seen & (1u << TRANSLATE)) {
+        SceneTransformation *translation = new SceneTransformation();
+        translation->type = TransformationType::TRANSFORMATION_TRANSLATE;
+        translation->translate = translate;
+        node->transformations.push_back(translation);
+    }
+    if (seen & (1u << ROTATE)) {
+        SceneTransformation *rotation = new SceneTransformation();
+        rotation->type = TransformationType::TRANSFORMATION_ROTATE;
+        rotation->rotate = rotateAxis;
+        rotation->angle = angle;
+        node->transformations.push_back(rotation);
+    }
+    if (seen & (1u << SCALE)) {
+        SceneTransformation *scaling = new SceneTransformation();
+        scaling->type = TransformationType::TRANSFORMATION_SCALE;
+        scaling->scale = scale;
+        node->transformations.push_back(scaling);
+    }
+    if (seen & (1u << MATRIX)) {
+        SceneTransformation *matrixTransformation = new SceneTransformation();
+        matrixTransformation->type = TransformationType::TRANSFORMATION_MATRIX;
+        matrixTransformation->matrix = matrix;
+        node->transformations.push_back(matrixTransformation);
+    }
+    return true;
+}
+
+// four rows of four numbers, stored column-wise
+bool SceneStreamReader::readMatrix(glm::mat4 &matrix) {
+    float *matrixPtr = glm::value_ptr(matrix);
+    if (!m_json.beginArray()) {
+        return false;
+    }
+    int rowIndex = 0;
+    while (m_json.nextElement()) {
+        if (rowIndex == 4 || !m_json.beginArray()) {
+            return false;
+        }
+        int colIndex = 0;
+        while (m_json.nextElement()) {
+            double value;
+            if (colIndex == 4 || m_json.peek() != Kind::Number || !m_json.readNumber(value)) {
+                return false;
+            }
+            matrixPtr[colIndex * 4 + rowIndex] = (float)value;
+            colIndex++;
+        }
+        if (m_json.failed() || colIndex != 4) {
+            return false;
+        }
+        rowIndex++;
+    }
+    return !m_json.failed() && rowIndex == 4;
+}
+
+bool SceneStreamReader::readLight(SceneNode *node) {
+    enum { TYPE, COLOR, NAME, ATTENUATION, DIRECTION, PENUMBRA, ANGLE };
+    static constexpr std::string_view names[] = {"type", "color", "name", "attenuationCoeff", "direction", "penumbra", "angle"};
+    Field (&fields)[7] = m_lightFields;
+    if (!readFields(names, fields)) {
+        return false;
+    }
+    if (!fields[TYPE].isString() || !fields[COLOR].isNumbers(3)) {
+        return false;
+    }
+
+    // fields a light type doesn't use aren't checked
+    const std::string &type = fields[TYPE].text;
+    LightType lightType;
+    if (type == "directional") {
+        lightType = LightType::LIGHT_DIRECTIONAL;
+        if (!fields[DIRECTION].isNumbers(3)) {
+            return false;
+        }
+    } else if (type == "point") {
+        lightType = LightType::LIGHT_POINT;
+        if (!fields[ATTENUATION].isNumbers(3)) {
+            return false;
+        }
+    } else if (type == "spot") {
+        lightType = LightType::LIGHT_SPOT;
+        if (!fields[DIRECTION].isNumbers(3) || !fields[ATTENUATION].isNumbers(3) || !fields[PENUMBRA].isNumber() ||
+            !fields[ANGLE].isNumber()) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    SceneLight *light = new SceneLight();
+    memset(light, 0, sizeof(SceneLight));
+    node->lights.push_back(light);
+
+    light->type = lightType;
+    light->dir = glm::vec4(0.f, 0.f, 0.f, 0.f);
+    light->function = glm::vec3(1, 0, 0);
+
+    const double *color = fields[COLOR].numbers;
+    light->color.r = color[0];
+    light->color.g = color[1];
+    light->color.b = color[2];
+    if (lightType != LightType::LIGHT_POINT) {
+        const double *direction = fields[DIRECTION].numbers;
+        light->dir.x = direction[0];
+        light->dir.y = direction[1];
+        light->dir.z = direction[2];
+    }
+    if (lightType != LightType::LIGHT_DIRECTIONAL) {
+        const double *attenuation = fields[ATTENUATION].numbers;
+        light->function.x = attenuation[0];
+        light->function.y = attenuation[1];
+        light->function.z = attenuation[2];
+    }
+    if (lightType == LightType::LIGHT_SPOT) {
+        light->penumbra = fields[PENUMBRA].numbers[0] * M_PI / 180.f;
+        light->angle = fields[ANGLE].numbers[0] * M_PI / 180.f;
+    }
+    return true;
+}
+
+bool SceneStreamReader::readPrimitive(SceneNode *node) {
+    enum {
+        TYPE, MESH_FILE, AMBIENT, DIFFUSE, SPECULAR, REFLECTIVE, TRANSPARENT, SHININESS, IOR,
+        BLEND, TEXTURE_FILE, TEXTURE_U, TEXTURE_V, BUMP_MAP_FILE, BUMP_MAP_U, BUMP_MAP_V
+    };
+    static constexpr std::string_view names[] = {
+        "type", "meshFile", "ambient", "diffuse", "specular", "reflective", "transparent", "shininess", "ior",
+        "blend", "textureFile", "textureU", "textureV", "bumpMapFile", "bumpMapU", "bumpMapV"};
+    Field (&fields)[16] = m_primitiveFields;
+    if (!readFields(names, fields)) {
+        return false;
+    }
+    auto present = [&](int field) { return fields[field].kind != Field::Kind::Missing; };
+
+    if (!fields[TYPE].isString()) {
+        return false;
+    }
+    const std::string &type = fields[TYPE].text;
+    PrimitiveType primitiveType;
+    if (type == "sphere") {
+        primitiveType = PrimitiveType::PRIMITIVE_SPHERE;
+    } else if (type == "cube") {
+        primitiveType = PrimitiveType::PRIMITIVE_CUBE;
+    } else if (type == "cylinder") {
+        primitiveType = PrimitiveType::PRIMITIVE_CYLINDER;
+    } else if (type == "cone") {
+        primitiveType = PrimitiveType::PRIMITIVE_CONE;
+    } else if (type == "mesh") {
+        primitiveType = PrimitiveType::PRIMITIVE_MESH;
+        if (!fields[MESH_FILE].isString()) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    for (int color : {AMBIENT, DIFFUSE, SPECULAR, REFLECTIVE, TRANSPARENT}) {
+        if (present(color) && !fields[color].isNumbers(3)) {
+            return false;
+        }
+    }
+    for (int value : {SHININESS, IOR, BLEND}) {
+        if (present(value) && !fields[value].isNumber()) {
+            return false;
+        }
+    }
+    if ((present(TEXTURE_FILE) && !fields[TEXTURE_FILE].isString()) ||
+        (present(BUMP_MAP_FILE) && !fields[BUMP_MAP_FILE].isString())) {
+        return false;
+    }
+
+    ScenePrimitive *primitive = new ScenePrimitive();
+    SceneMaterial &mat = primitive->material;
+    mat.clear();
+    primitive->type = primitiveType;
+    mat.textureMap.isUsed = false;
+    mat.bumpMap.isUsed = false;
+    mat.cDiffuse.r = mat.cDiffuse.g = mat.cDiffuse.b = 1;
+    node->primitives.push_back(primitive);
+
+    if (primitiveType == PrimitiveType::PRIMITIVE_MESH) {
+        primitive->meshfile = resolveAssetPath(fields[MESH_FILE].text);
+    }
+
+    auto setColor = [&](int field, SceneColor &color) {
+        if (present(field)) {
+            for (int i = 0; i < 3; i++) {
+                color[i] = fields[field].numbers[i];
+            }
+        }
+    };
+    setColor(AMBIENT, mat.cAmbient);
+    setColor(DIFFUSE, mat.cDiffuse);
+    setColor(SPECULAR, mat.cSpecular);
+    setColor(REFLECTIVE, mat.cReflective);
+    setColor(TRANSPARENT, mat.cTransparent);
+
+    if (present(SHININESS)) {
+        mat.shininess = (float)fields[SHININESS].numbers[0];
+    }
+    if (present(IOR)) {
+        mat.ior = (float)fields[IOR].numbers[0];
+    }
+    if (present(BLEND)) {
+        mat.blend = (float)fields[BLEND].numbers[0];
+    }
+
+    // repeats that aren't numbers quietly default to 1
+    auto setMap = [&](int file, int u, int v, SceneFileMap &map) {
+        if (present(file)) {
+            map.filename = resolveAssetPath(fields[file].text);
+            map.repeatU = fields[u].isNumber() ? fields[u].numbers[0] : 1;
+            map.repeatV = fields[v].isNumber() ? fields[v].numbers[0] : 1;
+            map.isUsed = true;
+        }
+    };
+    setMap(TEXTURE_FILE, TEXTURE_U, TEXTURE_V, mat.textureMap);
+    setMap(BUMP_MAP_FILE, BUMP_MAP_U, BUMP_MAP_V, mat.bumpMap);
+    return true;
+}
+
+void SceneStreamReader::deleteNodesFrom(size_t first) {
+    std::vector<SceneNode *> &nodes = m_reader.m_nodes;
+    for (size_t i = first; i < nodes.size(); i++) {
+        for (SceneTransformation *transformation : nodes[i]->transformations) {
+            delete transformation;
+        }
+        for (ScenePrimitive *primitive : nodes[i]->primitives) {
+            delete primitive;
+        }
+        for (SceneLight *light : nodes[i]->lights) {
+            delete light;
+        }
+        delete nodes[i];
+    }
+    nodes.resize(first);
+}
+
+const std::string &SceneStreamReader::resolveAssetPath(const std::string &path) {
+    auto found = m_resolvedPaths.find(path);
+    if (found == m_resolvedPaths.end()) {
+        found = m_resolvedPaths.emplace(path, ScenefileReader::resolveAssetPath(m_reader.file_name, path)).first;
+    }
+    return found->second;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "jsonscanner.h"
+#include "scenedata.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class ScenefileReader;
+
+// reads a scenefile in one pass over its bytes, building the nodes,
+// transformations, primitives and lights as their json goes by, where
+// readJSONDom() builds a QJsonDocument and then walks it again.
+//
+// it accepts exactly the scenes readJSONDom() accepts and builds the same
+// graph from them, but it doesn't explain anything: the first problem makes
+// read() return false, and ScenefileReader goes back to the dom path, which
+// prints the usual messages. things that are valid but awkward to handle in a
+// single pass (a group named after a template that comes later in the file)
+// also just return false and take the slow path
+class SceneStreamReader {
+public:
+    SceneStreamReader(ScenefileReader &reader, const char *data, size_t size);
+
+    // fills in the reader's global data, camera and nodes. on false the reader
+    // holds a half built graph and has to be cleared
+    bool read();
+
+private:
+    // a captured member value, for objects whose fields are checked in a
+    // fixed order after the whole object has been seen
+    struct Field {
+        enum class Kind { Missing, Number, String, Numbers, Other };
+
+        Kind kind = Kind::Missing;
+        double numbers[4];  // Number holds one, Numbers up to four
+        int count = 0;
+        std::string text;
+
+        bool isNumber() const { return kind == Kind::Number; }
+        bool isString() const { return kind == Kind::String; }
+        bool isNumbers(int size) const { return kind == Kind::Numbers && count == size; }
+    };
+
+    bool readField(Field &field);
+    template <size_t N>
+    bool readFields(const std::string_view (&names)[N], Field (&fields)[N]);
+
+    bool readGlobalData();
+    bool readCameraData();
+    bool readTemplateGroups();
+    bool readGroups(SceneNode *parent);
+    bool readGroupData(SceneNode *node, bool isTemplate, SceneNode **reference);
+    bool readMatrix(glm::mat4 &matrix);
+    bool readLight(SceneNode *node);
+    bool readPrimitive(SceneNode *node);
+
+    // drops nodes speculatively built for what turned out to be a template reference
+    void deleteNodesFrom(size_t first);
+    const std::string &resolveAssetPath(const std::string &path);
+
+    ScenefileReader &m_reader;
+    JsonScanner m_json;
+
+    // false while m_templates may still be missing templates the dom path
+    // would already know about, names seen then are checked at the end
+    bool m_templatesKnown = false;
+    std::vector<std::string> m_unresolvedNames;
+
+    // reused between objects so their strings keep their capacity
+    Field m_lightFields[7];
+    Field m_primitiveFields[16];
+
+    // each distinct texture or mesh path is looked up on disk once
+    std::unordered_map<std::string, std::string> m_resolvedPaths;
+};
@@ -12,9 +12,24 @@
 class ShaderLoader{
 public:
     static GLuint createShaderProgram(const char * vertex_file_path, const char * fragment_file_path){
+        GLuint programID = beginShaderProgram(vertex_file_path, fragment_file_path);
+        finishShaderProgram(programID);
+        return programID;
+    }
+
+    // Compile and link a program without querying any status, so a driver that
+    // compiles on its own threads can keep working while we do something else.
+    // The returned program must be passed to finishShaderProgram before use.
+    static GLuint beginShaderProgram(const char * vertex_file_path, const char * fragment_file_path){
+        std::string vertexCode = readShaderSource(vertex_file_path);
+        std::string fragmentCode = readShaderSource(fragment_file_path);
+        return beginShaderProgramFromSource(vertexCode, fragmentCode);
+    }
+
+    static GLuint beginShaderProgramFromSource(const std::string &vertexCode, const std::string &fragmentCode){
         // Create and compile the shaders.
-        GLuint vertexShaderID = createShader(GL_VERTEX_SHADER, vertex_file_path);
-        GLuint fragmentShaderID = createShader(GL_FRAGMENT_SHADER, fragment_file_path);
+        GLuint vertexShaderID = compileShader(GL_VERTEX_SHADER, vertexCode);
+        GLuint fragmentShaderID = compileShader(GL_FRAGMENT_SHADER, fragmentCode);
 
         // Link the shader program.
         GLuint programID = glCreateProgram();
@@ -22,6 +37,37 @@ public:
         glAttachShader(programID, fragmentShaderID);
         glLinkProgram(programID);
 
+        // Flag the shaders for deletion; they are freed once detached from the program.
+        glDeleteShader(vertexShaderID);
+        glDeleteShader(fragmentShaderID);
+
+        return programID;
+    }
+
+    // Check the compile and link status of a program started with beginShaderProgram.
+    // This blocks until the driver is done. On failure the program is deleted and
+    // the info log is thrown.
+    static void finishShaderProgram(GLuint programID){
+        // Print the info log of any attached shader that failed to compile
+        GLuint shaders[2];
+        GLsizei shaderCount = 0;
+        glGetAttachedShaders(programID, 2, &shaderCount, shaders);
+        for (GLsizei i = 0; i < shaderCount; i++) {
+            GLint status;
+            glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &status);
+
+            if (status == GL_FALSE) {
+                GLint length;
+                glGetShaderiv(shaders[i], GL_INFO_LOG_LENGTH, &length);
+
+                std::string log(length, '\0');
+                glGetShaderInfoLog(shaders[i], length, nullptr, &log[0]);
+
+                glDeleteProgram(programID);
+                throw std::runtime_error(log);
+            }
+        }
+
         // Print the info log if error
         GLint status;
         glGetProgramiv(programID, GL_LINK_STATUS, &status);
@@ -38,16 +84,12 @@ public:
         }
 
         // Shaders no longer necessary, stored in program
-        glDeleteShader(vertexShaderID);
-        glDeleteShader(fragmentShaderID);
-
-        return programID;
+        for (GLsizei i = 0; i < shaderCount; i++) {
+            glDetachShader(programID, shaders[i]);
+        }
     }
 
-private:
-    static GLuint createShader(GLenum shaderType, const char *filepath){
-        GLuint shaderID = glCreateShader(shaderType);
-
+    static std::string readShaderSource(const char *filepath){
         // Read shader file.
         std::string code;
         QString filepathStr = QString(filepath);
@@ -58,27 +100,18 @@ private:
         }else{
             throw std::runtime_error(std::string("Failed to open shader: ")+filepath);
         }
+        return code;
+    }
+
+private:
+    static GLuint compileShader(GLenum shaderType, const std::string &code){
+        GLuint shaderID = glCreateShader(shaderType);
 
         // Compile shader code.
         const char *codePtr = code.c_str();
         glShaderSource(shaderID, 1, &codePtr, nullptr); // Assumes code is null terminated
         glCompileShader(shaderID);
 
-        // Print info log if shader fails to compile.
-        GLint status;
-        glGetShaderiv(shaderID, GL_COMPILE_STATUS, &status);
-
-        if (status == GL_FALSE) {
-            GLint length;
-            glGetShaderiv(shaderID, GL_INFO_LOG_LENGTH, &length);
-
-            std::string log(length, '\0');
-            glGetShaderInfoLog(shaderID, length, nullptr, &log[0]);
-
-            glDeleteShader(shaderID);
-            throw std::runtime_error(log);
-        }
-
         return shaderID;
     }
 };
@@ -0,0 +1,179 @@
+#pragma once
+
+// a small benchmark harness: each case runs a few untimed warmup calls, then
+// a fixed number of timed repetitions summarized by the median and the median
+// absolute deviation, which one slow repetition (a page fault, the scheduler)
+// barely moves. a case says how many items one call processes so a throughput
+// in its unit (nodes/s, vertices/s, bytes/s) is reported next to the time
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QString>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+struct Result {
+    std::string name;
+    std::string unit;     // what items counts, e.g. "nodes"
+    double items = 0.0;   // per call
+    int repetitions = 0;
+    double medianMs = 0.0;
+    double madMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+
+    // items per second at the median time
+    double throughput() const { return medianMs > 0.0 ? items / (medianMs / 1000.0) : 0.0; }
+};
+
+inline double median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double upper = values[middle];
+    if (values.size() % 2 == 1) {
+        return upper;
+    }
+    return (upper + *std::max_element(values.begin(), values.begin() + middle)) / 2.0;
+}
+
+// median absolute deviation from the median
+inline double mad(const std::vector<double>& values) {
+    double center = median(values);
+    std::vector<double> deviations;
+    deviations.reserve(values.size());
+    for (double value : values) {
+        deviations.push_back(std::abs(value - center));
+    }
+    return median(deviations);
+}
+
+// swallows std::cout while alive, the code under test logs as it goes
+class QuietStdout {
+public:
+    QuietStdout() : m_previous(std::cout.rdbuf(&m_null)) {}
+    ~QuietStdout() { std::cout.rdbuf(m_previous); }
+
+private:
+    struct NullBuffer : std::streambuf {
+        int overflow(int c) override { return c; }
+    };
+    NullBuffer m_null;
+    std::streambuf* m_previous;
+};
+
+class Harness {
+public:
+    struct Options {
+        int warmup = 1;
+        int repetitions = 7;
+        std::string filter;  // only cases whose name contains this, empty = all
+    };
+
+    explicit Harness(const Options& options) : m_options(options) {}
+
+    bool selected(const std::string& name) const {
+        return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+    }
+
+    // times call. setup runs before every call, untimed, for cases that need
+    // fresh state each time (an empty cache, a new manager)
+    void run(const std::string& name, double items, const std::string& unit, const std::function<void()>& call,
+             const std::function<void()>& setup = {}) {
+        if (!selected(name)) {
+            return;
+        }
+
+        std::vector<double> times;
+        {
+            QuietStdout quiet;
+            for (int i = 0; i < m_options.warmup; i++) {
+                if (setup) {
+                    setup();
+                }
+                call();
+            }
+            for (int i = 0; i < std::max(1, m_options.repetitions); i++) {
+                if (setup) {
+                    setup();
+                }
+                QElapsedTimer timer;
+                timer.start();
+                call();
+                times.push_back(timer.nsecsElapsed() / 1e6);
+            }
+        }
+
+        Result result;
+        result.name = name;
+        result.unit = unit;
+        result.items = items;
+        result.repetitions = static_cast<int>(times.size());
+        result.medianMs = median(times);
+        result.madMs = mad(times);
+        result.minMs = *std::min_element(times.begin(), times.end());
+        result.maxMs = *std::max_element(times.begin(), times.end());
+        m_results.push_back(result);
+
+        std::cout << std::fixed << std::setprecision(3) << std::left << std::setw(40) << name << std::right
+                  << std::setw(12) << result.medianMs << " ms  +- " << std::setw(9) << result.madMs << "  "
+                  << std::setprecision(0) << std::setw(14) << result.throughput() << " " << unit << "/s" << std::endl;
+    }
+
+    const std::vector<Result>& results() const { return m_results; }
+
+    // {"warmup": 1, "repetitions": 7, "context": {...},
+    //  "benchmarks": [{"name", "unit", "items", "repetitions", "median-ms", "mad-ms",
+    //                  "min-ms", "max-ms", "throughput-per-s"}]}
+    QJsonObject toJson(const QJsonObject& context = {}) const {
+        QJsonArray benchmarks;
+        for (const Result& result : m_results) {
+            QJsonObject object;
+            object["name"] = QString::fromStdString(result.name);
+            object["unit"] = QString::fromStdString(result.unit);
+            object["items"] = result.items;
+            object["repetitions"] = result.repetitions;
+            object["median-ms"] = result.medianMs;
+            object["mad-ms"] = result.madMs;
+            object["min-ms"] = result.minMs;
+            object["max-ms"] = result.maxMs;
+            object["throughput-per-s"] = result.throughput();
+            benchmarks.append(object);
+        }
+        QJsonObject root;
+        root["warmup"] = m_options.warmup;
+        root["repetitions"] = m_options.repetitions;
+        root["context"] = context;
+        root["benchmarks"] = benchmarks;
+        return root;
+    }
+
+    bool writeJson(const std::string& path, const QJsonObject& context = {}) const {
+        QByteArray text = QJsonDocument(toJson(context)).toJson();
+        QSaveFile file(QString::fromStdString(path));
+        if (!file.open(QIODevice::WriteOnly) || file.write(text) != text.size() || !file.commit()) {
+            std::cerr << "Failed to save benchmark results to " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    Options m_options;
+    std::vector<Result> m_results;
+};
+
+}
@@ -0,0 +1,121 @@
+// mip chain generation benchmark
+// compares the cpu mip generator against glGenerateMipmap at 4k and 8k
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include "../src/rendering/MipGenerator.h"
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+
+namespace {
+
+constexpr int RUNS = 3;
+
+// best of a few runs in milliseconds
+double bestOf(const std::function<void()>& run) {
+    double best = 0.0;
+    for (int i = 0; i < RUNS; i++) {
+        QElapsedTimer timer;
+        timer.start();
+        run();
+        double ms = timer.nsecsElapsed() / 1e6;
+        best = i == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+void benchmark(int size) {
+    std::vector<unsigned char> pixels(static_cast<size_t>(size) * size * 4);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        pixels[i] = static_cast<unsigned char>((i * 2654435761u) >> 13);
+    }
+
+    MipOptions serial;
+    serial.parallel = false;
+    MipOptions kaiser;
+    kaiser.filter = MipFilter::Kaiser;
+
+    double serialMs = bestOf([&]() { MipGenerator::generateRGBA8(pixels.data(), size, size, size * 4, serial); });
+    double parallelMs = bestOf([&]() { MipGenerator::generateRGBA8(pixels.data(), size, size, size * 4); });
+    double kaiserMs = bestOf([&]() { MipGenerator::generateRGBA8(pixels.data(), size, size, size * 4, kaiser); });
+
+    std::vector<MipLevel> mips = MipGenerator::generateRGBA8(pixels.data(), size, size, size * 4);
+    int levels = MipGenerator::levelCount(size, size);
+
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (int i = 0; i < levels; i++) {
+        glTexImage2D(GL_TEXTURE_2D, i, GL_SRGB8_ALPHA8, std::max(1, size >> i), std::max(1, size >> i), 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    // glFinish so the driver's work is inside the measurement
+    double gpuMs = bestOf([&]() {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+    });
+    double uploadMs = bestOf([&]() {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        for (int i = 1; i < levels; i++) {
+            const MipLevel& mip = mips[i - 1];
+            glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, mip.width, mip.height, GL_RGBA, GL_UNSIGNED_BYTE, mip.pixels.data());
+        }
+        glFinish();
+    });
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &texture);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << size << "x" << size << ":\n"
+              << "  cpu box, 1 thread       " << serialMs << " ms\n"
+              << "  cpu box, thread pool    " << parallelMs << " ms\n"
+              << "  cpu kaiser, thread pool " << kaiserMs << " ms\n"
+              << "  upload + glGenerateMipmap " << gpuMs << " ms\n"
+              << "  upload of the cpu chain   " << uploadMs << " ms" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QApplication app(argc, argv);
+
+    QSurfaceFormat format;
+    format.setVersion(4, 1);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    if (!context.create() || !surface.isValid() || !context.makeCurrent(&surface)) {
+        std::cerr << "failed to create an opengl context" << std::endl;
+        return 1;
+    }
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "glew initialization failed" << std::endl;
+        return 1;
+    }
+
+    for (int size : {4096, 8192}) {
+        benchmark(size);
+    }
+
+    context.doneCurrent();
+    return 0;
+}
@@ -0,0 +1,283 @@
+// microbenchmarks for scene loading, tessellation, uv mapping, texture loading
+// and instancing. prints one line per case and writes every result as json:
+//   ./bread_bench [--json results.json] [--filter scene/] [--repetitions 7]
+//                 [--warmup 1] [--max-nodes 100000]
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QImage>
+#include <QJsonObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QTemporaryDir>
+#include <QThread>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench_harness.h"
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include "../src/rendering/InstanceManager.h"
+#include "../src/rendering/TextureManager.h"
+#include "../src/shapes/Cone.h"
+#include "../src/shapes/Cube.h"
+#include "../src/shapes/Cylinder.h"
+#include "../src/shapes/Sphere.h"
+#include "../src/utils/scenefilereader.h"
+#include "../src/utils/scenegenerator.h"
+#include "../src/utils/sceneparser.h"
+#include "../src/utils/uvmapper.h"
+
+#ifndef BREAD_RESOURCE_DIR
+#define BREAD_RESOURCE_DIR "resources"
+#endif
+
+namespace {
+
+constexpr int FLOATS_PER_VERTEX = 14;
+
+volatile float g_sink = 0.0f;  // keeps results the optimizer would otherwise drop
+
+void benchScenes(bench::Harness& harness, const QTemporaryDir& dir, int maxNodes) {
+    for (int nodes = 1000; nodes <= maxNodes; nodes *= 10) {
+        std::string suffix = "/" + std::to_string(nodes);
+        if (!harness.selected("scene/readJSON" + suffix) && !harness.selected("scene/readJSON-dom" + suffix) &&
+            !harness.selected("scene/parse" + suffix)) {
+            continue;
+        }
+
+        // a few lights, some template reuse and two levels of groups, like a hand made scene
+        SceneGeneratorOptions scene;
+        scene.primitives = nodes;
+        scene.lights = 1 + nodes / 1000;
+        scene.templates = 8;
+        scene.templateReuse = 0.1f;
+        scene.materials = 32;
+        std::string path = QDir(dir.path()).filePath(QString("scene_%1.json").arg(nodes)).toStdString();
+        if (!SceneGenerator::write(path, scene)) {
+            continue;
+        }
+
+        harness.run("scene/readJSON" + suffix, nodes, "nodes", [&]() {
+            ScenefileReader reader(path);
+            g_sink = reader.readJSON() ? 1.0f : 0.0f;
+        });
+        // the QJsonDocument reader the streaming one replaced, for comparison
+        harness.run("scene/readJSON-dom" + suffix, nodes, "nodes", [&]() {
+            ScenefileReader reader(path);
+            g_sink = reader.readJSONDom() ? 1.0f : 0.0f;
+        });
+        harness.run("scene/parse" + suffix, nodes, "nodes", [&]() {
+            RenderData data;
+            SceneParser::parse(path, data);
+            g_sink = static_cast<float>(data.shapes.size());
+        });
+        QFile::remove(QString::fromStdString(path));
+    }
+}
+
+template <typename Shape, typename Update>
+void benchShape(bench::Harness& harness, const std::string& name, int param, Update update) {
+    Shape shape;
+    update(shape);
+    double vertices = static_cast<double>(shape.generateShape().size()) / FLOATS_PER_VERTEX;
+    harness.run("shape/" + name + "/" + std::to_string(param), vertices, "vertices", [&]() {
+        update(shape);
+        g_sink = shape.generateShape().back();
+    });
+}
+
+void benchShapes(bench::Harness& harness) {
+    for (int param : {5, 25, 100}) {
+        benchShape<Cube>(harness, "cube", param, [=](Cube& shape) { shape.updateParams(param); });
+        benchShape<Sphere>(harness, "sphere", param, [=](Sphere& shape) { shape.updateParams(param, param); });
+        benchShape<Cylinder>(harness, "cylinder", param, [=](Cylinder& shape) { shape.updateParams(param, param); });
+        benchShape<Cone>(harness, "cone", param, [=](Cone& shape) { shape.updateParams(param, param); });
+    }
+}
+
+// uv lookups on the object space vertices of each shape, so every branch of
+// getUVCoords (caps, sides, poles, seams) is taken in the proportion a mesh hits it
+void benchUVs(bench::Harness& harness) {
+    struct Case {
+        const char* name;
+        PrimitiveType type;
+        std::vector<float> vertexData;
+    };
+    Cube cube;
+    cube.updateParams(50);
+    Sphere sphere;
+    sphere.updateParams(50, 50);
+    Cylinder cylinder;
+    cylinder.updateParams(50, 50);
+    Cone cone;
+    cone.updateParams(50, 50);
+    Case cases[] = {
+        {"cube", PrimitiveType::PRIMITIVE_CUBE, cube.generateShape()},
+        {"sphere", PrimitiveType::PRIMITIVE_SPHERE, sphere.generateShape()},
+        {"cylinder", PrimitiveType::PRIMITIVE_CYLINDER, cylinder.generateShape()},
+        {"cone", PrimitiveType::PRIMITIVE_CONE, cone.generateShape()},
+    };
+
+    for (const Case& c : cases) {
+        std::vector<glm::vec3> points;
+        for (size_t i = 0; i + 2 < c.vertexData.size(); i += FLOATS_PER_VERTEX) {
+            points.emplace_back(c.vertexData[i], c.vertexData[i + 1], c.vertexData[i + 2]);
+        }
+        harness.run(std::string("uv/") + c.name, static_cast<double>(points.size()), "lookups", [&]() {
+            glm::vec2 sum(0.0f);
+            for (const glm::vec3& point : points) {
+                sum += getUVCoords(c.type, point);
+            }
+            g_sink = sum.x + sum.y;
+        });
+    }
+}
+
+// decode and upload through a fresh manager every time (no cache, then a warm
+// preprocessed cache), and the bundled jpeg next to a generated 2048x2048 png
+void benchTextures(bench::Harness& harness, const QTemporaryDir& dir) {
+    std::string generated = QDir(dir.path()).filePath("noise_2048.png").toStdString();
+    if (harness.selected("texture/load/noise-2048-png/decode") ||
+        harness.selected("texture/load/noise-2048-png/cache-hit")) {
+        QImage image(2048, 2048, QImage::Format_RGBA8888);
+        std::mt19937 random(1);
+        for (int y = 0; y < image.height(); y++) {
+            uchar* row = image.scanLine(y);
+            for (int x = 0; x < image.width() * 4; x++) {
+                row[x] = static_cast<uchar>(((x / 64) * 31 + (y / 64) * 17 + (random() & 15)) & 255);
+            }
+        }
+        if (!image.save(QString::fromStdString(generated))) {
+            std::cerr << "Failed to save benchmark texture to " << generated << std::endl;
+            return;
+        }
+    }
+
+    struct Case {
+        std::string name;
+        std::string path;
+    };
+    std::vector<Case> cases = {
+        {"bread-jpg", std::string(BREAD_RESOURCE_DIR) + "/textures/bread.jpg"},
+        {"noise-2048-png", generated},
+    };
+    std::string cacheDirectory = QDir(dir.path()).filePath("texture_cache").toStdString();
+
+    for (const Case& c : cases) {
+        QImage image(QString::fromStdString(c.path));
+        double pixels = static_cast<double>(image.width()) * image.height();
+
+        for (bool cached : {false, true}) {
+            std::unique_ptr<TextureManager> manager;
+            auto setup = [&]() {
+                if (manager) {
+                    manager->cleanup();
+                }
+                manager = std::make_unique<TextureManager>();
+                if (cached) {
+                    manager->setCacheDirectory(cacheDirectory);
+                }
+            };
+            harness.run("texture/load/" + c.name + (cached ? "/cache-hit" : "/decode"), pixels, "pixels", [&]() {
+                g_sink = static_cast<float>(manager->loadTexture(c.path));
+                manager->finishPendingLoads();
+                glFinish();
+            }, setup);
+            if (manager) {
+                manager->cleanup();
+            }
+        }
+    }
+}
+
+void benchInstances(bench::Harness& harness) {
+    for (int count : {1000, 100000}) {
+        std::string suffix = "/" + std::to_string(count);
+        InstanceManager instances;
+        harness.run("instances/generate" + suffix, count, "instances", [&]() {
+            instances.generateInstances(count, 50.0f, 1);
+        });
+        harness.run("instances/upload" + suffix, count, "instances", [&]() {
+            instances.uploadToGPU();
+            glFinish();
+        }, [&]() {
+            instances.cleanup();
+            instances.generateInstances(count, 50.0f, 1);
+        });
+        instances.cleanup();
+    }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"json", "write the results as json to <file>", "file"});
+    parser.addOption({"filter", "only run cases whose name contains <text>", "text"});
+    parser.addOption({"repetitions", "timed runs per case (default 7)", "count", "7"});
+    parser.addOption({"warmup", "untimed runs per case (default 1)", "count", "1"});
+    parser.addOption({"max-nodes", "largest generated scene, 1000 to 1000000 (default 100000)", "count", "100000"});
+    parser.process(app);
+
+    bench::Harness::Options options;
+    options.repetitions = std::max(1, parser.value("repetitions").toInt());
+    options.warmup = std::max(0, parser.value("warmup").toInt());
+    options.filter = parser.value("filter").toStdString();
+    bench::Harness harness(options);
+    int maxNodes = std::clamp(parser.value("max-nodes").toInt(), 1000, 1000000);
+
+    QSurfaceFormat format;
+    format.setVersion(4, 1);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+
+    QOpenGLContext context;
+    context.setFormat(format);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    if (!context.create() || !surface.isValid() || !context.makeCurrent(&surface)) {
+        std::cerr << "failed to create an opengl context" << std::endl;
+        return 1;
+    }
+
+    glewExperimental = GL_TRUE;
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "glew initialization failed" << std::endl;
+        return 1;
+    }
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::cerr << "failed to create a temporary directory" << std::endl;
+        return 1;
+    }
+
+    benchScenes(harness, dir, maxNodes);
+    benchShapes(harness);
+    benchUVs(harness);
+    benchTextures(harness, dir);
+    benchInstances(harness);
+
+    bool ok = true;
+    if (parser.isSet("json")) {
+        QJsonObject info;
+        info["threads"] = QThread::idealThreadCount();
+        info["gl-renderer"] = QString(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+        info["max-nodes"] = maxNodes;
+        ok = harness.writeJson(parser.value("json").toStdString(), info);
+    }
+
+    context.doneCurrent();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+// performance regression check, run by ctest. runs bread_bench or the
+// BreadFinal flythrough several times, reduces every metric to a mean and a
+// 95% confidence interval, and compares that with the committed baseline:
+//   perf_check --suite bench --bench ./bread_bench --baseline perf_baseline.json
+//   perf_check --suite flythrough --app ./BreadFinal --scene a.json --scene b.json ...
+// arguments after -- are passed on to the program being measured. --bless
+// writes the measured values as the suite's new baseline instead of comparing
+//
+// a metric regresses when the slowdown is larger than its tolerance even at
+// the favourable end of the confidence interval of the difference, so noise
+// alone doesn't fail the check and a real slowdown isn't hidden by one lucky run.
+// every metric is lower-is-better (times, draw calls, triangles)
+//
+// the baseline file:
+//   {"tolerance": 0.1,
+//    "metrics": {"bench/scene/parse/10000/median-ms": {"mean": 41.2, "stddev": 0.8, "runs": 5},
+//                "flythrough/test_instancing/cpu-ms-p95": {..., "tolerance": 0.25}}}
+// a metric's own tolerance wins over --tolerance, which wins over the file's
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSaveFile>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int EXIT_REGRESSED = 1;
+constexpr int EXIT_ERROR = 2;
+
+struct Stats {
+    double mean = 0.0;
+    double stddev = 0.0;  // sample standard deviation
+    int runs = 0;
+};
+
+Stats summarize(const std::vector<double>& samples) {
+    Stats stats;
+    stats.runs = static_cast<int>(samples.size());
+    if (samples.empty()) {
+        return stats;
+    }
+    for (double sample : samples) {
+        stats.mean += sample;
+    }
+    stats.mean /= samples.size();
+    if (samples.size() > 1) {
+        double squares = 0.0;
+        for (double sample : samples) {
+            squares += (sample - stats.mean) * (sample - stats.mean);
+        }
+        stats.stddev = std::sqrt(squares / (samples.size() - 1));
+    }
+    return stats;
+}
+
+// two sided 95% quantile of student's t
+double tQuantile(double degreesOfFreedom) {
+    static const double TABLE[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    int df = static_cast<int>(std::floor(degreesOfFreedom));
+    if (df < 1) {
+        return TABLE[0];
+    }
+    if (df <= 30) {
+        return TABLE[df - 1];
+    }
+    return df <= 60 ? 2.000 : 1.960;
+}
+
+// half width of the 95% confidence interval of the mean
+double confidence(const Stats& stats) {
+    if (stats.runs < 2) {
+        return 0.0;
+    }
+    return tQuantile(stats.runs - 1) * stats.stddev / std::sqrt(static_cast<double>(stats.runs));
+}
+
+// half width of the 95% confidence interval of current.mean - baseline.mean (welch)
+double differenceConfidence(const Stats& baseline, const Stats& current) {
+    double a = baseline.runs > 1 ? baseline.stddev * baseline.stddev / baseline.runs : 0.0;
+    double b = current.runs > 1 ? current.stddev * current.stddev / current.runs : 0.0;
+    if (a + b <= 0.0) {
+        return 0.0;
+    }
+    double df = (a + b) * (a + b) /
+                ((baseline.runs > 1 ? a * a / (baseline.runs - 1) : 0.0) + (current.runs > 1 ? b * b / (current.runs - 1) : 0.0));
+    return tQuantile(df) * std::sqrt(a + b);
+}
+
+using Samples = std::map<std::string, std::vector<double>>;
+
+// runs program, false (after printing its output) if it doesn't exit cleanly
+bool runProgram(const QString& program, const QStringList& arguments) {
+    QProcess process;
+    process.setProcessChannelMode(QProcess::MergedChannels);
+    process.start(program, arguments);
+    if (!process.waitForStarted()) {
+        std::cerr << "perf check: failed to start " << program.toStdString() << std::endl;
+        return false;
+    }
+    process.waitForFinished(-1);
+    if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        std::cerr << "perf check: " << program.toStdString() << " " << arguments.join(' ').toStdString()
+                  << " failed, its output:\n" << process.readAll().toStdString() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool readJson(const QString& path, QJsonObject& object) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "perf check: could not open " << path.toStdString() << std::endl;
+        return false;
+    }
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!document.isObject()) {
+        std::cerr << "perf check: " << path.toStdString() << " is not a json object: "
+                  << error.errorString().toStdString() << std::endl;
+        return false;
+    }
+    object = document.object();
+    return true;
+}
+
+// one bread_bench run: the median time of every case
+bool collectBench(const QString& program, const QStringList& extra, const QDir& dir, Samples& samples) {
+    QString report = dir.filePath("bench.json");
+    if (!runProgram(program, QStringList{"--json", report} + extra)) {
+        return false;
+    }
+    QJsonObject root;
+    if (!readJson(report, root)) {
+        return false;
+    }
+    for (const QJsonValue& value : root["benchmarks"].toArray()) {
+        QJsonObject benchmark = value.toObject();
+        samples["bench/" + benchmark["name"].toString().toStdString() + "/median-ms"].push_back(
+            benchmark["median-ms"].toDouble());
+    }
+    return true;
+}
+
+// one flythrough of a scene: frame time percentiles and what each frame drew
+bool collectFlythrough(const QString& program, const QString& scene, int frames, const QString& size,
+                       const QStringList& extra, const QDir& dir, Samples& samples) {
+    QString report = dir.filePath("flythrough.json");
+    QStringList arguments{scene, "--benchmark", QString::number(frames), "--size", size, "-o", report};
+    if (!runProgram(program, arguments + extra)) {
+        return false;
+    }
+    QJsonObject root;
+    if (!readJson(report, root)) {
+        return false;
+    }
+
+    std::string prefix = "flythrough/" + QFileInfo(scene).completeBaseName().toStdString() + "/";
+    QJsonObject cpu = root["cpu-ms"].toObject();
+    samples[prefix + "cpu-ms-p50"].push_back(cpu["p50"].toDouble());
+    samples[prefix + "cpu-ms-p95"].push_back(cpu["p95"].toDouble());
+    if (root.contains("gpu-ms")) {
+        QJsonObject gpu = root["gpu-ms"].toObject();
+        samples[prefix + "gpu-ms-p50"].push_back(gpu["p50"].toDouble());
+        samples[prefix + "gpu-ms-p95"].push_back(gpu["p95"].toDouble());
+    }
+    QJsonObject perFrame = root["per-frame"].toObject();
+    samples[prefix + "draw-calls"].push_back(perFrame["draw-calls"].toObject()["mean"].toDouble());
+    samples[prefix + "triangles"].push_back(perFrame["triangles"].toObject()["mean"].toDouble());
+    return true;
+}
+
+std::string formatStats(const Stats& stats) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(stats.mean >= 100.0 ? 1 : 3) << stats.mean << " +- " << confidence(stats);
+    return text.str();
+}
+
+bool startsWith(const std::string& text, const std::string& prefix) {
+    return text.compare(0, prefix.size(), prefix) == 0;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"suite", "what to measure: bench or flythrough", "suite"});
+    parser.addOption({"baseline", "baseline json to compare with (or write with --bless)", "file"});
+    parser.addOption({"bench", "bread_bench executable", "file"});
+    parser.addOption({"app", "BreadFinal executable", "file"});
+    parser.addOption({"scene", "scene for the flythrough, repeatable", "file"});
+    parser.addOption({"frames", "flythrough frames (default 240)", "count", "240"});
+    parser.addOption({"size", "flythrough size (default 640x360)", "WxH", "640x360"});
+    parser.addOption({"runs", "runs to take the statistics over (default 5)", "count", "5"});
+    parser.addOption({"tolerance", "allowed slowdown as a fraction, e.g. 0.1 (default from the baseline)", "fraction"});
+    parser.addOption({"bless", "write the measured values as the new baseline"});
+    parser.addPositionalArgument("arguments", "passed on to the program being measured", "[-- arguments...]");
+    parser.process(app);
+
+    QString suite = parser.value("suite");
+    QString baselinePath = parser.value("baseline");
+    if ((suite != "bench" && suite != "flythrough") || baselinePath.isEmpty()) {
+        std::cerr << "perf check needs --suite bench|flythrough and --baseline" << std::endl;
+        return EXIT_ERROR;
+    }
+    if ((suite == "bench" && !parser.isSet("bench")) ||
+        (suite == "flythrough" && (!parser.isSet("app") || parser.values("scene").isEmpty()))) {
+        std::cerr << "perf check: the bench suite needs --bench, the flythrough suite --app and --scene" << std::endl;
+        return EXIT_ERROR;
+    }
+    int runs = std::max(1, parser.value("runs").toInt());
+    QStringList extra = parser.positionalArguments();
+
+    // read before measuring, an unblessed suite has nothing to compare with
+    QJsonObject baseline;
+    if (QFileInfo::exists(baselinePath) && !readJson(baselinePath, baseline)) {
+        return EXIT_ERROR;
+    }
+    QJsonObject metrics = baseline["metrics"].toObject();
+    std::string prefix = suite.toStdString() + "/";
+
+    bool anyBaseline = false;
+    for (const QString& key : metrics.keys()) {
+        anyBaseline = anyBaseline || startsWith(key.toStdString(), prefix);
+    }
+    if (!anyBaseline && !parser.isSet("bless")) {
+        std::cout << "perf check: " << baselinePath.toStdString() << " has no " << suite.toStdString()
+                  << " metrics yet, nothing to compare. bless this machine's numbers with the perf_bless target"
+                  << std::endl;
+        return 0;
+    }
+
+    QTemporaryDir temporary;
+    if (!temporary.isValid()) {
+        std::cerr << "perf check: failed to create a temporary directory" << std::endl;
+        return EXIT_ERROR;
+    }
+    QDir dir(temporary.path());
+
+    Samples samples;
+    for (int run = 0; run < runs; run++) {
+        std::cout << "perf check: " << suite.toStdString() << " run " << run + 1 << " of " << runs << std::endl;
+        if (suite == "bench") {
+            if (!collectBench(parser.value("bench"), extra, dir, samples)) {
+                return EXIT_ERROR;
+            }
+            continue;
+        }
+        for (const QString& scene : parser.values("scene")) {
+            if (!collectFlythrough(parser.value("app"), scene, std::max(1, parser.value("frames").toInt()),
+                                   parser.value("size"), extra, dir, samples)) {
+                return EXIT_ERROR;
+            }
+        }
+    }
+
+    std::map<std::string, Stats> current;
+    for (const auto& [name, values] : samples) {
+        current[name] = summarize(values);
+    }
+
+    if (parser.isSet("bless")) {
+        // replace this suite's metrics, keeping the other suite and any tolerances set by hand
+        for (const QString& key : metrics.keys()) {
+            if (startsWith(key.toStdString(), prefix) && !current.count(key.toStdString())) {
+                metrics.remove(key);
+            }
+        }
+        for (const auto& [name, stats] : current) {
+            QString key = QString::fromStdString(name);
+            QJsonObject metric = metrics[key].toObject();
+            metric["mean"] = stats.mean;
+            metric["stddev"] = stats.stddev;
+            metric["runs"] = stats.runs;
+            metrics[key] = metric;
+        }
+        baseline["metrics"] = metrics;
+        if (!baseline.contains("tolerance")) {
+            baseline["tolerance"] = 0.1;
+        }
+
+        QByteArray text = QJsonDocument(baseline).toJson();
+        QSaveFile file(baselinePath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(text) != text.size() || !file.commit()) {
+            std::cerr << "Failed to save perf baseline to " << baselinePath.toStdString() << std::endl;
+            return EXIT_ERROR;
+        }
+        std::cout << "perf check: blessed " << current.size() << " " << suite.toStdString() << " metrics into "
+                  << baselinePath.toStdString() << std::endl;
+        return 0;
+    }
+
+    double defaultTolerance = parser.isSet("tolerance") ? parser.value("tolerance").toDouble()
+                                                         : baseline["tolerance"].toDouble(0.1);
+
+    std::vector<std::string> regressions;
+    std::cout << "perf check: " << current.size() << " metrics against " << baselinePath.toStdString() << " ("
+              << runs << " runs, 95% confidence intervals)\n"
+              << std::left << std::setw(52) << "  metric" << std::setw(22) << "baseline" << std::setw(22) << "current"
+              << "change" << std::endl;
+    for (const auto& [name, stats] : current) {
+        QString key = QString::fromStdString(name);
+        std::cout << "  " << std::left << std::setw(50) << name;
+        if (!metrics.contains(key)) {
+            std::cout << std::setw(22) << "-" << std::setw(22) << formatStats(stats) << "new" << std::endl;
+            continue;
+        }
+
+        QJsonObject metric = metrics[key].toObject();
+        Stats base;
+        base.mean = metric["mean"].toDouble();
+        base.stddev = metric["stddev"].toDouble();
+        base.runs = metric["runs"].toInt(1);
+        double tolerance = metric["tolerance"].toDouble(defaultTolerance);
+
+        double difference = stats.mean - base.mean;
+        double noise = differenceConfidence(base, stats);
+        double allowed = tolerance * std::abs(base.mean);
+        double change = base.mean != 0.0 ? 100.0 * difference / base.mean : 0.0;
+
+        std::ostringstream verdict;
+        verdict << std::showpos << std::fixed << std::setprecision(1) << change << "%" << std::noshowpos;
+        if (difference - noise > allowed) {
+            verdict << "  REGRESSED";
+            std::ostringstream why;
+            why << std::fixed << std::setprecision(1) << name << ": " << formatStats(base) << " -> "
+                << formatStats(stats) << " (" << std::showpos << change << "%" << std::noshowpos << ", allowed "
+                << 100.0 * tolerance << "% plus " << (base.mean != 0.0 ? 100.0 * noise / std::abs(base.mean) : 0.0)
+                << "% noise)";
+            regressions.push_back(why.str());
+        } else if (difference + noise < -allowed) {
+            verdict << "  improved";
+        }
+        std::cout << std::setw(22) << formatStats(base) << std::setw(22) << formatStats(stats) << verdict.str()
+                  << std::endl;
+    }
+    for (const QString& key : metrics.keys()) {
+        if (startsWith(key.toStdString(), prefix) && !current.count(key.toStdString())) {
+            std::cout << "  " << std::left << std::setw(50) << key.toStdString() << "not measured" << std::endl;
+        }
+    }
+
+    if (regressions.empty()) {
+        std::cout << "perf check: no regressions" << std::endl;
+        return 0;
+    }
+    std::cout << "perf check: " << regressions.size() << " metrics regressed:" << std::endl;
+    for (const std::string& regression : regressions) {
+        std::cout << "  " << regression << std::endl;
+    }
+    std::cout << "if the slowdown is intended, re-bless the baseline with the perf_bless target" << std::endl;
+    return EXIT_REGRESSED;
+}
@@ -0,0 +1,98 @@
+// automated tests for camera paths
+// verifies keyframes are hit, orbits loop and paths survive json
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../src/camera/CameraPath.h"
+
+#include <QTemporaryDir>
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+// test that a camera path passes through its keyframes, loops back onto its
+// start and survives a save and load
+void testCameraPath() {
+    CameraPath path;
+    for (int i = 0; i < 4; i++) {
+        CameraPath::Keyframe keyframe;
+        keyframe.time = static_cast<float>(i);
+        keyframe.position = glm::vec3(i * 2.0f, 1.0f, -static_cast<float>(i));
+        keyframe.look = glm::normalize(glm::vec3(1.0f, 0.0f, -1.0f - i));
+        path.addKeyframe(keyframe);
+    }
+
+    SceneCameraData base{};
+    base.heightAngle = 0.8f;
+    auto near = [](const glm::vec3& a, const glm::vec3& b) { return glm::length(a - b) < 1e-4f; };
+
+    bool throughKeys = true;
+    for (const CameraPath::Keyframe& keyframe : path.keyframes()) {
+        SceneCameraData camera = path.sample(keyframe.time, base);
+        throughKeys = throughKeys && near(glm::vec3(camera.pos), keyframe.position) &&
+                      near(glm::vec3(camera.look), keyframe.look) && camera.heightAngle == 0.8f;
+    }
+    // clamped past the end, and halfway between two keys on a straight run
+    bool clamped = near(glm::vec3(path.sample(10.0f, base).pos), path.keyframes().back().position) &&
+                   near(glm::vec3(path.sample(1.5f, base).pos), glm::vec3(3.0f, 1.0f, -1.5f));
+
+    // looking at the origin from 5 units away, so the orbit goes around it
+    base.pos = glm::vec4(0.0f, 0.0f, 5.0f, 1.0f);
+    base.look = glm::vec4(0.0f, 0.0f, -1.0f, 0.0f);
+    base.up = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+    CameraPath orbit = CameraPath::orbit(base, 8.0f);
+    glm::vec3 start = glm::vec3(orbit.sample(0.0f, base).pos);
+    glm::vec3 half = glm::vec3(orbit.sample(4.0f, base).pos);
+    bool loops = near(glm::vec3(orbit.sample(8.0f, base).pos), start) &&
+                 near(glm::vec3(orbit.sample(9.0f, base).pos), glm::vec3(orbit.sample(1.0f, base).pos)) &&
+                 near(half, glm::vec3(0.0f, 0.0f, -5.0f)) && near(start, glm::vec3(base.pos));
+
+    QTemporaryDir dir;
+    std::string file = dir.filePath("path.json").toStdString();
+    CameraPath loaded;
+    bool saved = path.save(file) && loaded.load(file) && loaded.keyframes().size() == path.keyframes().size() &&
+                 near(glm::vec3(loaded.sample(2.5f, base).pos), glm::vec3(path.sample(2.5f, base).pos));
+
+    bool passed = throughKeys && clamped && loops && saved;
+    results.push_back({
+        "CameraPath sampling",
+        passed,
+        !throughKeys ? "keyframes not hit" : !clamped ? "wrong position between or past the keys" :
+        !loops ? "orbit doesn't come back around" : !saved ? "path not saved and loaded" :
+        "4 keyframes hit, orbit loops, json round trip"
+    });
+}
+
+int main() {
+    std::cout << "=== running camera path automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    testCameraPath();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    return failCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+// automated tests for the gpu profiler
+// verifies scopes nest, samples are collected and summaries are ordered
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/rendering/GpuProfiler.h"
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <QFile>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QTemporaryDir>
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+// helper to initialize opengl context for testing
+bool initializeGLContext(QOpenGLContext*& context, QOffscreenSurface*& surface) {
+    context = new QOpenGLContext();
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    context->setFormat(format);
+
+    if (!context->create()) {
+        std::cerr << "failed to create opengl context" << std::endl;
+        return false;
+    }
+
+    surface = new QOffscreenSurface();
+    surface->setFormat(format);
+    surface->create();
+
+    if (!surface->isValid()) {
+        std::cerr << "failed to create offscreen surface" << std::endl;
+        return false;
+    }
+
+    context->makeCurrent(surface);
+
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        std::cerr << "glew initialization failed: " << glewGetErrorString(err) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// test that profiled scopes are collected, nest, and summarize in order
+void testGpuProfiler() {
+    GpuProfiler profiler;
+    profiler.setEnabled(true);
+    for (int i = 0; i < 20; i++) {
+        GpuProfiler::Scope outer(profiler, "outer");
+        {
+            GpuProfiler::Scope inner(profiler, "clear");
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        profiler.collect();
+    }
+    profiler.collect(true);
+
+    std::vector<GpuProfiler::ScopeStats> stats = profiler.stats();
+    bool counted = stats.size() == 2 && stats[0].name == "outer" && stats[1].name == "clear";
+    bool ordered = counted;
+    for (size_t i = 0; counted && i < stats.size(); i++) {
+        const GpuProfiler::ScopeStats& s = stats[i];
+        // gpu samples are missing altogether on drivers without timer queries
+        counted = s.cpuSamples == 20 && (s.gpuSamples == 20 || s.gpuSamples == 0);
+        ordered = ordered && s.cpu.minMs <= s.cpu.avgMs && s.cpu.avgMs <= s.cpu.p99Ms &&
+                  s.gpu.minMs <= s.gpu.avgMs && s.gpu.avgMs <= s.gpu.p99Ms;
+    }
+
+    QTemporaryDir dir;
+    std::string path = dir.filePath("profile.csv").toStdString();
+    QFile file(QString::fromStdString(path));
+    bool written = profiler.write(path) && file.open(QIODevice::ReadOnly) &&
+                   file.readLine().startsWith("scope,gpu_samples") && file.readLine().startsWith("outer,");
+    profiler.cleanup();
+
+    bool passed = counted && ordered && written;
+    results.push_back({
+        "GpuProfiler scopes",
+        passed,
+        !counted ? "wrong scopes or sample counts" : !ordered ? "min/avg/p99 out of order" :
+        !written ? "csv not written" : "2 nested scopes x 20 collected and written"
+    });
+}
+
+int main(int argc, char *argv[]) {
+    QGuiApplication app(argc, argv);
+
+    std::cout << "=== running gpu profiler automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    QOpenGLContext* context = nullptr;
+    QOffscreenSurface* surface = nullptr;
+
+    if (!initializeGLContext(context, surface)) {
+        std::cerr << "failed to initialize opengl context for testing" << std::endl;
+        return 1;
+    }
+
+    testGpuProfiler();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    context->doneCurrent();
+    delete surface;
+    delete context;
+
+    return failCount > 0 ? 1 : 0;
+}
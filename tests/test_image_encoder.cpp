@@ -0,0 +1,191 @@
+// automated tests for image encoding
+// verifies every output format decodes back to the frame it was given
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/rendering/ImageEncoder.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QTemporaryDir>
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+// test that every output format round-trips the rgb of a frame
+void testImageEncoder() {
+    // large enough for several deflate chunks, with flat areas and noise
+    int width = 701;
+    int height = 500;
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char* pixel = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+            bool flat = x > width / 2 && y > height / 2;
+            pixel[0] = flat ? 40 : static_cast<unsigned char>(x * 255 / width);
+            pixel[1] = flat ? 40 : static_cast<unsigned char>(y * 255 / height);
+            pixel[2] = flat ? 40 : static_cast<unsigned char>(((x * 2654435761u) ^ (y * 40503u)) >> 7);
+            pixel[3] = static_cast<unsigned char>(x + y);  // ignored
+        }
+    }
+    auto matches = [&](const QImage& decoded) {
+        if (decoded.width() != width || decoded.height() != height) {
+            return false;
+        }
+        QImage rgb = decoded.convertToFormat(QImage::Format_RGB888);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const unsigned char* expected = &pixels[(static_cast<size_t>(y) * width + x) * 4];
+                if (std::memcmp(rgb.constScanLine(y) + x * 3, expected, 3) != 0) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<unsigned char> png;
+    bool pngEncoded = ImageEncoder::encode(pixels.data(), width, height, width * 4, ImageFormat::Png, png);
+    double pngMs = timer.nsecsElapsed() / 1e6;
+    bool pngOk = pngEncoded && matches(QImage::fromData(png.data(), static_cast<int>(png.size()), "PNG"));
+
+    timer.restart();
+    QByteArray qtPng;
+    QBuffer buffer(&qtPng);
+    buffer.open(QIODevice::WriteOnly);
+    QImage(pixels.data(), width, height, width * 4, QImage::Format_RGBX8888).save(&buffer, "PNG");
+    double qtMs = timer.nsecsElapsed() / 1e6;
+
+    std::vector<unsigned char> ppm;
+    bool ppmOk = ImageEncoder::encode(pixels.data(), width, height, width * 4, ImageFormat::Ppm, ppm) &&
+                 matches(QImage::fromData(ppm.data(), static_cast<int>(ppm.size()), "PPM"));
+
+    // qt has no qoi reader, decode it here
+    std::vector<unsigned char> qoi;
+    bool qoiOk = ImageEncoder::encode(pixels.data(), width, height, width * 4, ImageFormat::Qoi, qoi) &&
+                 qoi.size() > 22 && std::memcmp(qoi.data(), "qoif", 4) == 0;
+    if (qoiOk) {
+        QImage decoded(width, height, QImage::Format_RGB888);
+        unsigned char index[64][4] = {};
+        unsigned char pixel[4] = {0, 0, 0, 255};
+        size_t position = 14;
+        int run = 0;
+        for (int i = 0; i < width * height && position < qoi.size(); i++) {
+            if (run > 0) {
+                run--;
+            } else {
+                unsigned char op = qoi[position++];
+                if (op == 0xfe) {
+                    std::memcpy(pixel, &qoi[position], 3);
+                    position += 3;
+                } else if (op >> 6 == 0) {
+                    std::memcpy(pixel, index[op], 4);
+                } else if (op >> 6 == 1) {
+                    pixel[0] += ((op >> 4) & 3) - 2;
+                    pixel[1] += ((op >> 2) & 3) - 2;
+                    pixel[2] += (op & 3) - 2;
+                } else if (op >> 6 == 2) {
+                    int dg = (op & 63) - 32;
+                    unsigned char next = qoi[position++];
+                    pixel[0] += dg - 8 + (next >> 4);
+                    pixel[1] += dg;
+                    pixel[2] += dg - 8 + (next & 15);
+                } else if (op != 0xff) {
+                    run = op & 63;
+                }
+                std::memcpy(index[(pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64], pixel, 4);
+            }
+            std::memcpy(decoded.scanLine(i / width) + (i % width) * 3, pixel, 3);
+        }
+        qoiOk = matches(decoded);
+    }
+
+    std::vector<unsigned char> raw;
+    bool rawOk = ImageEncoder::encode(pixels.data(), width, height, width * 4, ImageFormat::Raw, raw) &&
+                 raw.size() == static_cast<size_t>(width) * height * 3 && std::memcmp(raw.data(), ppm.data() + ppm.size() - raw.size(), raw.size()) == 0;
+
+    // the tiled capture path: the same image streamed in uneven bands of rows
+    QTemporaryDir dir;
+    bool streamOk = true;
+    for (const char* name : {"stream.png", "stream.ppm"}) {
+        std::string path = dir.filePath(name).toStdString();
+        ImageStreamWriter writer;
+        bool written = writer.open(path, width, height);
+        int row = 0;
+        for (int rows : {1, 37, 128, 300}) {
+            rows = std::min(rows, height - row);
+            written = written && writer.writeRows(pixels.data() + static_cast<size_t>(row) * width * 4, rows, width * 4);
+            row += rows;
+        }
+        written = written && writer.writeRows(pixels.data() + static_cast<size_t>(row) * width * 4, height - row, width * 4);
+        streamOk = streamOk && written && writer.close() && matches(QImage(QString::fromStdString(path)));
+    }
+    ImageStreamWriter incomplete;
+    incomplete.open(dir.filePath("incomplete.png").toStdString(), width, height);
+    incomplete.writeRows(pixels.data(), 10, width * 4);
+    streamOk = streamOk && !incomplete.close() && !QFile::exists(dir.filePath("incomplete.png"));
+
+    bool extensions = ImageEncoder::formatForPath("out/frame.PNG") == ImageFormat::Png &&
+                      ImageEncoder::formatForPath("frame.qoi") == ImageFormat::Qoi &&
+                      ImageEncoder::formatForPath("frame.ppm") == ImageFormat::Ppm &&
+                      ImageEncoder::formatForPath("frames.v2/frame") == ImageFormat::Other &&
+                      ImageEncoder::formatForPath("frame.jpg") == ImageFormat::Other;
+
+    bool passed = pngOk && ppmOk && qoiOk && rawOk && streamOk && extensions;
+    std::ostringstream message;
+    message << std::fixed << std::setprecision(1) << "png " << png.size() / 1024 << " KB in " << pngMs
+            << " ms (QImage " << qtPng.size() / 1024 << " KB in " << qtMs << " ms), qoi " << qoi.size() / 1024 << " KB";
+    results.push_back({
+        "ImageEncoder formats",
+        passed,
+        !pngOk ? "png doesn't decode to the input" : !ppmOk ? "ppm doesn't decode to the input" :
+        !qoiOk ? "qoi doesn't decode to the input" : !rawOk ? "raw isn't the plain rgb rows" :
+        !streamOk ? "streamed image differs or an incomplete one was kept" :
+        !extensions ? "wrong format for an extension" : message.str()
+    });
+}
+
+int main(int argc, char *argv[]) {
+    // qt's image plugins are found through the application
+    QCoreApplication app(argc, argv);
+
+    std::cout << "=== running image encoder automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    testImageEncoder();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    return failCount > 0 ? 1 : 0;
+}
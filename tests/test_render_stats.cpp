@@ -0,0 +1,84 @@
+// automated tests for the renderer's frame counters
+// verifies counters are published per frame and frame time percentiles
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/rendering/RenderStats.h"
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+// test that counters are published per frame and that frame time percentiles
+// follow the nearest rank over the kept window
+void testRenderStats() {
+    RenderStats::reset();
+    RenderStats::addDraw(36);
+    RenderStats::addDraw(36, 100);
+    RenderStats::add(RenderStats::StateChanges);
+    RenderStats::set(RenderStats::Lights, 3);
+
+    bool pending = RenderStats::lastFrame(RenderStats::DrawCalls) == 0;
+    RenderStats::endFrame();
+    bool counted = RenderStats::lastFrame(RenderStats::DrawCalls) == 2 &&
+                   RenderStats::lastFrame(RenderStats::Triangles) == 12 + 1200 &&
+                   RenderStats::lastFrame(RenderStats::Instances) == 100 &&
+                   RenderStats::lastFrame(RenderStats::StateChanges) == 1;
+    RenderStats::endFrame();
+    bool cleared = RenderStats::lastFrame(RenderStats::DrawCalls) == 0 && RenderStats::get(RenderStats::Lights) == 3;
+    RenderStats::reset();
+
+    // 1..100 ms, then 400 more frames so only the last 240 are kept
+    FrameTimes times;
+    for (int i = 1; i <= 100; i++) {
+        times.add(static_cast<float>(i));
+    }
+    bool percentiles = times.percentile(50.0f) == 50.0f && times.percentile(95.0f) == 95.0f &&
+                       times.percentile(99.0f) == 99.0f && times.latest() == 100.0f;
+    for (int i = 101; i <= 500; i++) {
+        times.add(static_cast<float>(i));
+    }
+    bool window = times.size() == FrameTimes::DEFAULT_CAPACITY && times.at(0) == 261.0f && times.latest() == 500.0f &&
+                  times.max() == 500.0f && times.percentile(50.0f) == 380.0f;
+
+    bool passed = pending && counted && cleared && percentiles && window;
+    results.push_back({
+        "RenderStats counters",
+        passed,
+        !pending ? "counters published before the frame ended" : !counted ? "wrong frame counters" :
+        !cleared ? "counters not reset for the next frame" : !percentiles ? "wrong percentiles" :
+        !window ? "frame time window not kept" : "2 draws counted, p50/p95/p99 over the last 240 frames"
+    });
+}
+
+int main() {
+    std::cout << "=== running render stats automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    testRenderStats();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    return failCount > 0 ? 1 : 0;
+}
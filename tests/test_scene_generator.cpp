@@ -0,0 +1,153 @@
+// automated tests for the scene generator
+// verifies a seed always gives the same scene and that the scene reads back
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../src/utils/scenefilereader.h"
+#include "../src/utils/scenegenerator.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+QByteArray readBytes(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// the scene and each of its textures, empty if the scene wasn't written
+std::vector<QByteArray> readScene(const QString& dir) {
+    std::vector<QByteArray> files;
+    QByteArray scene = readBytes(dir + "/scene.json");
+    if (scene.isEmpty()) {
+        return files;
+    }
+    files.push_back(scene);
+    for (const QString& texture : QDir(dir + "/scene_textures").entryList({"*.png"}, QDir::Files, QDir::Name)) {
+        files.push_back(readBytes(dir + "/scene_textures/" + texture));
+    }
+    return files;
+}
+
+void countNodes(SceneNode* node, int& primitives, int& lights) {
+    primitives += static_cast<int>(node->primitives.size());
+    lights += static_cast<int>(node->lights.size());
+    for (SceneNode* child : node->children) {
+        countNodes(child, primitives, lights);
+    }
+}
+
+// test that the same options and seed write the same bytes, that another seed
+// writes a different scene, and that what's written reads back as a scene
+void testSceneGenerator() {
+    QTemporaryDir dir;
+    for (const char* name : {"first", "second", "reseeded"}) {
+        QDir(dir.path()).mkdir(name);
+    }
+
+    // templates, spot lights, textures and a clustered layout, so every
+    // random choice the generator makes shows up in the output
+    SceneGeneratorOptions options;
+    options.primitives = 500;
+    options.lights = 6;
+    options.templates = 3;
+    options.templateReuse = 0.3f;
+    options.depth = 2;
+    options.textures = 2;
+    options.distribution = SceneDistribution::Clustered;
+    options.clusters = 4;
+    options.seed = 7;
+
+    bool written = SceneGenerator::write(dir.filePath("first/scene.json").toStdString(), options) &&
+                   SceneGenerator::write(dir.filePath("second/scene.json").toStdString(), options);
+    SceneGeneratorOptions reseeded = options;
+    reseeded.seed = 8;
+    written = written && SceneGenerator::write(dir.filePath("reseeded/scene.json").toStdString(), reseeded);
+
+    std::vector<QByteArray> first = readScene(dir.filePath("first"));
+    std::vector<QByteArray> second = readScene(dir.filePath("second"));
+    std::vector<QByteArray> other = readScene(dir.filePath("reseeded"));
+
+    bool complete = written && first.size() == 1 + static_cast<size_t>(options.textures);
+    results.push_back({
+        "SceneGenerator same seed",
+        complete && first == second,
+        !complete ? "could not write the scene and its textures" :
+        first != second ? "the same options and seed wrote different bytes" :
+                          std::to_string(first[0].size()) + " scene bytes and " +
+                          std::to_string(options.textures) + " textures identical"
+    });
+
+    results.push_back({
+        "SceneGenerator different seed",
+        complete && !other.empty() && other[0] != first[0],
+        !complete || other.empty() ? "could not write the scene" :
+        other[0] == first[0] ? "seeds 7 and 8 wrote the same scene" : "seeds 7 and 8 wrote different scenes"
+    });
+
+    ScenefileReader reader(dir.filePath("first/scene.json").toStdString());
+    bool read = written && reader.readJSON() && reader.getRootNode() != nullptr;
+    int primitives = 0;
+    int lights = 0;
+    if (read) {
+        countNodes(reader.getRootNode(), primitives, lights);
+    }
+
+    // templates expand to several primitives each, so there are at least as
+    // many as were asked for
+    bool passed = read && lights == options.lights && primitives >= options.primitives;
+    results.push_back({
+        "SceneGenerator output reads back",
+        passed,
+        !read ? "ScenefileReader could not read the generated scene" :
+        lights != options.lights ? "expected " + std::to_string(options.lights) + " lights, got " +
+                                   std::to_string(lights) :
+        primitives < options.primitives ? "expected at least " + std::to_string(options.primitives) +
+                                          " primitives, got " + std::to_string(primitives) :
+                                          std::to_string(primitives) + " primitives, " + std::to_string(lights) +
+                                          " lights"
+    });
+}
+
+int main(int argc, char *argv[]) {
+    // generated scenes write their textures through qt's image plugins
+    QCoreApplication app(argc, argv);
+
+    std::cout << "=== running scene generator automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    testSceneGenerator();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    return failCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+// automated tests for the streaming scene reader
+// verifies it builds the same graph as the QJsonDocument reader
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../src/utils/scenefilereader.h"
+#include "../src/utils/scenegenerator.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+// everything a scene reader builds, as text, with shared template nodes
+// written as references to where they first appeared
+void describeNode(std::ostream& out, SceneNode* node, std::map<SceneNode*, int>& ids) {
+    auto found = ids.find(node);
+    if (found != ids.end()) {
+        out << "ref " << found->second << "\n";
+        return;
+    }
+    int id = static_cast<int>(ids.size());
+    ids[node] = id;
+    out << "node " << id << "\n";
+    for (SceneTransformation* t : node->transformations) {
+        out << " transform " << static_cast<int>(t->type);
+        switch (t->type) {
+            case TransformationType::TRANSFORMATION_TRANSLATE:
+                out << " " << t->translate.x << " " << t->translate.y << " " << t->translate.z;
+                break;
+            case TransformationType::TRANSFORMATION_SCALE:
+                out << " " << t->scale.x << " " << t->scale.y << " " << t->scale.z;
+                break;
+            case TransformationType::TRANSFORMATION_ROTATE:
+                out << " " << t->rotate.x << " " << t->rotate.y << " " << t->rotate.z << " " << t->angle;
+                break;
+            case TransformationType::TRANSFORMATION_MATRIX:
+                for (int i = 0; i < 16; i++) {
+                    out << " " << t->matrix[i / 4][i % 4];
+                }
+                break;
+        }
+        out << "\n";
+    }
+    for (SceneLight* l : node->lights) {
+        out << " light " << static_cast<int>(l->type);
+        for (int i = 0; i < 4; i++) {
+            out << " " << l->color[i] << " " << l->dir[i];
+        }
+        out << " " << l->function.x << " " << l->function.y << " " << l->function.z << " " << l->penumbra << " "
+            << l->angle << "\n";
+    }
+    for (ScenePrimitive* p : node->primitives) {
+        const SceneMaterial& m = p->material;
+        out << " primitive " << static_cast<int>(p->type) << " " << p->meshfile;
+        for (const SceneColor* color : {&m.cAmbient, &m.cDiffuse, &m.cSpecular, &m.cReflective, &m.cTransparent}) {
+            for (int i = 0; i < 4; i++) {
+                out << " " << (*color)[i];
+            }
+        }
+        out << " " << m.shininess << " " << m.ior << " " << m.blend;
+        for (const SceneFileMap* map : {&m.textureMap, &m.bumpMap}) {
+            out << " [" << map->isUsed << " " << map->filename << " " << map->repeatU << " " << map->repeatV << "]";
+        }
+        out << "\n";
+    }
+    for (SceneNode* child : node->children) {
+        describeNode(out, child, ids);
+    }
+}
+
+// reads a scene with readJSON or readJSONDom, giving what it printed, whether
+// it succeeded and what it built
+std::string readScene(const std::string& path, bool dom) {
+    std::ostringstream printed;
+    std::streambuf* previous = std::cout.rdbuf(printed.rdbuf());
+    ScenefileReader reader(path);
+    bool ok = dom ? reader.readJSONDom() : reader.readJSON();
+    std::cout.rdbuf(previous);
+
+    std::ostringstream out;
+    out << std::setprecision(9) << printed.str() << "ok " << ok << "\n";
+    if (ok) {
+        SceneGlobalData global = reader.getGlobalData();
+        SceneCameraData camera = reader.getCameraData();
+        out << global.ka << " " << global.kd << " " << global.ks << " " << global.kt << "\n";
+        for (int i = 0; i < 4; i++) {
+            out << camera.pos[i] << " " << camera.look[i] << " " << camera.up[i] << " ";
+        }
+        out << camera.heightAngle << " " << camera.aperture << " " << camera.focalLength << "\n";
+        std::map<SceneNode*, int> ids;
+        describeNode(out, reader.getRootNode(), ids);
+    }
+    return out.str();
+}
+
+// test that the streaming scene reader builds what the QJsonDocument reader
+// builds, and that scenes it gives up on still get the dom reader's messages
+void testSceneStreaming() {
+    QTemporaryDir dir;
+    std::vector<std::string> scenes;
+    for (const QFileInfo& file : QDir(QString(BREAD_RESOURCE_DIR) + "/../scenefiles").entryInfoList({"*.json"})) {
+        scenes.push_back(file.absoluteFilePath().toStdString());
+    }
+
+    // templates, spot lights, textures and nested groups
+    SceneGeneratorOptions options;
+    options.primitives = 2000;
+    options.lights = 6;
+    options.templates = 4;
+    options.templateReuse = 0.2f;
+    options.depth = 3;
+    options.textures = 2;
+    options.seed = 5;
+    std::string generated = dir.filePath("generated.json").toStdString();
+    bool written = SceneGenerator::write(generated, options);
+    scenes.push_back(generated);
+
+    const char* header = "{\"globalData\": {\"ambientCoeff\": 0.5, \"diffuseCoeff\": 0.5, \"specularCoeff\": 0.5},\n"
+                         " \"cameraData\": {\"position\": [0, 0, 5], \"up\": [0, 1, 0], \"heightAngle\": 45, "
+                         "\"focus\": [0, 0, 0]},\n";
+    const char* templateGroups = " \"templateGroups\": [{\"name\": \"t\", \"primitives\": [{\"type\": \"cone\"}]}]";
+    std::vector<std::pair<std::string, std::string>> handWritten = {
+        // valid, but only the dom reader knows what to do with them: a
+        // template reference before the templates, a duplicate template
+        {"late_template", std::string(header) + " \"groups\": [{\"name\": \"t\"}],\n" + templateGroups + "}"},
+        {"duplicate_template", std::string(header) + " \"templateGroups\": [{\"name\": \"t\"}, {\"name\": \"t\"}]}"},
+        // a template reference ignores everything else in the group
+        {"reference", std::string(header) + templateGroups +
+                          ",\n \"groups\": [{\"name\": \"t\", \"junk\": [1, {}], \"translate\": \"x\"}]}"},
+        // and a point light doesn't look at its direction
+        {"point_light", std::string(header) + " \"groups\": [{\"lights\": [{\"type\": \"point\", \"color\": [1, 1, 1], "
+                            "\"attenuationCoeff\": [1, 0, 0], \"direction\": null}], \"matrix\": [[1, 2, 3, 4], "
+                            "[5, 6, 7, 8], [9, 10, 11, 12], [13, 14, 15, 16]]}]}"},
+        // invalid
+        {"trailing_comma", std::string(header) + " \"groups\": [],}"},
+        {"unknown_field", std::string(header) + " \"groups\": [{\"primitives\": [{\"type\": \"cube\", \"size\": 2}]}]}"},
+        {"light_color", std::string(header) + " \"groups\": [{\"lights\": [{\"type\": \"point\", \"color\": [1, 1]}]}]}"},
+        {"missing_camera", "{\"globalData\": {\"ambientCoeff\": 0.5, \"diffuseCoeff\": 0.5, \"specularCoeff\": 0.5}}"},
+        {"truncated", std::string(header) + " \"groups\": [{\"name\": \"a"},
+    };
+    for (const auto& [name, text] : handWritten) {
+        std::string path = dir.filePath(QString::fromStdString(name + ".json")).toStdString();
+        QFile file(QString::fromStdString(path));
+        written = written && file.open(QFile::WriteOnly) && file.write(text.c_str()) == qint64(text.size());
+        scenes.push_back(path);
+    }
+
+    int valid = 0;
+    std::string mismatch;
+    for (const std::string& scene : scenes) {
+        std::string streamed = readScene(scene, false);
+        if (streamed != readScene(scene, true) && mismatch.empty()) {
+            mismatch = QFileInfo(QString::fromStdString(scene)).fileName().toStdString();
+        }
+        valid += streamed.find("ok 1\n") != std::string::npos ? 1 : 0;
+    }
+
+    // the generated scene, the 4 valid hand written ones and most scenefiles
+    bool passed = written && mismatch.empty() && valid >= 5;
+    results.push_back({
+        "Scene streaming",
+        passed,
+        !written ? "could not write the test scenes" : !mismatch.empty() ? "readJSON and readJSONDom differ on " + mismatch :
+        valid < 5 ? "valid scenes not read" :
+        std::to_string(scenes.size()) + " scenes, " + std::to_string(valid) + " valid, same graphs and messages"
+    });
+}
+
+int main(int argc, char *argv[]) {
+    // generated scenes write their textures through qt's image plugins
+    QCoreApplication app(argc, argv);
+
+    std::cout << "=== running scene streaming automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    testSceneStreaming();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    return failCount > 0 ? 1 : 0;
+}
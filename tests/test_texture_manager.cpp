@@ -1,8 +1,16 @@
 // automated tests for texture manager
 // verifies texture loading and caching work correctly
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <vector>
+#include <glm/glm.hpp>
+#include "../src/rendering/MipGenerator.h"
+#include "../src/rendering/TextureCache.h"
 #include "../src/rendering/TextureManager.h"
 
 #ifdef __APPLE__
@@ -10,8 +18,13 @@
 #endif
 #include <GL/glew.h>
 #include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
+#include <QTemporaryDir>
 
 struct TestResult {
     std::string testName;
@@ -61,7 +74,7 @@ bool initializeGLContext(QOpenGLContext*& context, QOffscreenSurface*& surface)
 
 // test that texture manager can load a valid texture
 void testTextureLoading(TextureManager& manager) {
-    std::string texturePath = "/Users/fluffy/projects/cs1230/bread-final/resources/textures/test_normal.png";
+    std::string texturePath = std::string(BREAD_RESOURCE_DIR) + "/textures/test_normal.png";
 
     GLuint textureId = manager.loadTexture(texturePath);
 
@@ -89,7 +102,7 @@ void testInvalidTexture(TextureManager& manager) {
 
 // test that texture manager caches textures
 void testTextureCaching(TextureManager& manager) {
-    std::string texturePath = "/Users/fluffy/projects/cs1230/bread-final/resources/textures/test_normal.png";
+    std::string texturePath = std::string(BREAD_RESOURCE_DIR) + "/textures/test_normal.png";
 
     GLuint firstId = manager.loadTexture(texturePath);
     GLuint secondId = manager.loadTexture(texturePath);
@@ -103,9 +116,537 @@ void testTextureCaching(TextureManager& manager) {
     });
 }
 
+// test that an async load returns before decoding with a 1x1 white
+// placeholder, and has full size once uploaded. a manager of its own so the
+// image isn't already loaded by the tests before
+void testAsyncUpload() {
+    TextureManager manager;
+    std::string texturePath = std::string(BREAD_RESOURCE_DIR) + "/textures/bread.jpg";
+
+    GLuint textureId = manager.loadTexture(texturePath);
+    bool pending = manager.hasPendingLoads();
+
+    GLint width = 0;
+    GLint height = 0;
+    unsigned char texel[4] = {0, 0, 0, 0};
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    if (width == 1 && height == 1) {
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, texel);
+    }
+    bool placeholder = pending && width == 1 && height == 1 && texel[0] == 255 && texel[1] == 255 &&
+                       texel[2] == 255 && texel[3] == 255;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    manager.finishPendingLoads();
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    bool uploaded = textureId != 0 && width > 1 && height > 1 && !manager.hasPendingLoads();
+    manager.cleanup();
+
+    bool passed = placeholder && uploaded;
+    results.push_back({
+        "TextureManager async upload",
+        passed,
+        !placeholder ? "loadTexture didn't return a pending 1x1 white placeholder" :
+        !uploaded ? "texture still a placeholder (" + std::to_string(width) + "x" + std::to_string(height) + ")" :
+        "1x1 white while decoding, uploaded " + std::to_string(width) + "x" + std::to_string(height)
+    });
+}
+
+// read back level 0 of a texture as rgba
+std::vector<unsigned char> readTexture(GLuint textureId, int& width, int& height) {
+    glBindTexture(GL_TEXTURE_2D, textureId);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    std::vector<unsigned char> pixels(width * height * 4);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return pixels;
+}
+
+// test that a second load comes from the preprocessed cache with identical texels and mips
+void testPreprocessedCache() {
+    QTemporaryDir dir;
+    std::string imagePath = dir.filePath("gradient.png").toStdString();
+    std::string cacheDir = dir.filePath("cache").toStdString();
+
+    // npot size so the odd-size mip path is exercised
+    QImage source(1000, 600, QImage::Format_RGBA8888);
+    for (int y = 0; y < source.height(); y++) {
+        for (int x = 0; x < source.width(); x++) {
+            source.setPixelColor(x, y, QColor(x % 256, y % 256, (x ^ y) % 256));
+        }
+    }
+    source.save(QString::fromStdString(imagePath));
+
+    QElapsedTimer timer;
+    int width = 0, height = 0;
+
+    TextureManager decodeManager;
+    decodeManager.setCacheDirectory(cacheDir);
+    timer.start();
+    GLuint decodedId = decodeManager.loadTexture(imagePath);
+    decodeManager.finishPendingLoads();
+    qint64 decodeNs = timer.nsecsElapsed();
+    std::vector<unsigned char> decodedPixels = readTexture(decodedId, width, height);
+
+    TextureManager cacheManager;
+    cacheManager.setCacheDirectory(cacheDir);
+    timer.restart();
+    GLuint cachedId = cacheManager.loadTexture(imagePath);
+    cacheManager.finishPendingLoads();
+    qint64 cacheNs = timer.nsecsElapsed();
+    std::vector<unsigned char> cachedPixels = readTexture(cachedId, width, height);
+
+    GLint maxLevel = 0;
+    glBindTexture(GL_TEXTURE_2D, cachedId);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    bool passed = (width == 1000 && height == 600 && decodedPixels == cachedPixels &&
+                   maxLevel == MipGenerator::levelCount(1000, 600) - 1);
+    results.push_back({
+        "TextureManager preprocessed cache",
+        passed,
+        passed ? "decode " + std::to_string(decodeNs / 1000) + " us, cache " + std::to_string(cacheNs / 1000) + " us" :
+                 "cached texture differs from decoded texture"
+    });
+
+    decodeManager.cleanup();
+    cacheManager.cleanup();
+}
+
+// test that cache files whose level table doesn't fit the file or the format
+// are rejected instead of handing the upload a pointer past the mapping
+void testCorruptCache() {
+    QTemporaryDir dir;
+    QString sourcePath = dir.filePath("source.png");
+    QImage(8, 4, QImage::Format_RGBA8888).save(sourcePath);
+    std::string source = sourcePath.toStdString();
+
+    // 8x4, 4x2, 2x1 and 1x1 rgba8
+    std::vector<std::vector<unsigned char>> pixels;
+    std::vector<TextureCache::Level> levels;
+    for (int i = 0; i < 4; i++) {
+        TextureCache::Level level;
+        level.width = std::max(1, 8 >> i);
+        level.height = std::max(1, 4 >> i);
+        pixels.emplace_back(level.width * level.height * 4, static_cast<unsigned char>(i));
+        level.data = pixels.back().data();
+        level.size = pixels.back().size();
+        levels.push_back(level);
+    }
+
+    auto writeCache = [&](const QString& name, const std::vector<TextureCache::Level>& written) {
+        std::string path = dir.filePath(name).toStdString();
+        TextureCache::write(path, source, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, written);
+        return path;
+    };
+
+    std::string valid = writeCache("valid.btex", levels);
+    bool validOpens = TextureCache::open(valid, source) != nullptr;
+
+    // the last level cut short
+    std::string truncated = writeCache("truncated.btex", levels);
+    QFile truncatedFile(QString::fromStdString(truncated));
+    truncatedFile.resize(truncatedFile.size() - 2);
+    bool truncatedRejected = TextureCache::open(truncated, source) == nullptr;
+
+    // a level holding fewer bytes than its size and format need
+    std::vector<TextureCache::Level> shortLevels = levels;
+    shortLevels[1].size -= 4;
+    std::string shortLevel = writeCache("short.btex", shortLevels);
+    bool shortRejected = TextureCache::open(shortLevel, source) == nullptr;
+
+    // a level that isn't half the one before it
+    std::vector<TextureCache::Level> wrongSize = levels;
+    wrongSize[2].width = 4;
+    wrongSize[2].size = 4 * 1 * 4;
+    std::string resized = writeCache("resized.btex", wrongSize);
+    bool resizedRejected = TextureCache::open(resized, source) == nullptr;
+
+    bool passed = validOpens && truncatedRejected && shortRejected && resizedRejected;
+    results.push_back({
+        "TextureCache corrupt files",
+        passed,
+        !validOpens ? "a valid cache file was rejected" :
+        !truncatedRejected ? "a truncated cache file was opened" :
+        !shortRejected ? "a level with too few bytes was opened" :
+        !resizedRejected ? "a level with the wrong dimensions was opened" :
+                           "truncated, short and resized levels rejected"
+    });
+}
+
+// test that same-sized textures share an array and each layer keeps its own texels
+void testTextureArrays() {
+    QTemporaryDir dir;
+    std::vector<std::string> paths;
+    for (int i = 0; i < 3; i++) {
+        // the third image has a different size and needs its own array
+        int size = i < 2 ? 64 : 32;
+        QImage image(size, size, QImage::Format_RGBA8888);
+        image.fill(QColor(80 * i, 255 - 80 * i, 0));
+        paths.push_back(dir.filePath(QString("layer%1.png").arg(i)).toStdString());
+        image.save(QString::fromStdString(paths.back()));
+    }
+
+    TextureManager manager;
+    TextureSlot first = manager.loadArrayTexture(paths[0]);
+    TextureSlot second = manager.loadArrayTexture(paths[1]);
+    TextureSlot third = manager.loadArrayTexture(paths[2]);
+    TextureSlot again = manager.loadArrayTexture(paths[0]);
+    TextureSlot missing = manager.loadArrayTexture(dir.filePath("missing.png").toStdString());
+    manager.allocateArrays();
+    manager.finishPendingLoads();
+
+    // read back level 0 of both layers of the first array
+    std::vector<unsigned char> pixels(64 * 64 * 4 * 2);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, manager.getArrayTexture(first.array));
+    glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    const unsigned char* secondLayer = pixels.data() + 64 * 64 * 4;
+
+    bool grouped = first.array == second.array && first.layer != second.layer && third.array != first.array &&
+                   again.array == first.array && again.layer == first.layer && !missing.isValid();
+    bool loaded = manager.isLayerReady(first) && manager.isLayerReady(second) && manager.isLayerReady(third);
+    bool texels = pixels[0] == 0 && pixels[1] == 255 && secondLayer[0] == 80 && secondLayer[1] == 175;
+
+    bool passed = grouped && loaded && texels;
+    results.push_back({
+        "TextureManager texture arrays",
+        passed,
+        passed ? "3 textures in 2 arrays" :
+                 !grouped ? "textures grouped into wrong arrays" :
+                 !loaded ? "layers not ready after loading" : "layer texels differ from source"
+    });
+
+    manager.cleanup();
+}
+
+// test that the least recently used textures lose their top mips first when over budget
+void testResidencyBudget() {
+    // three textures of 85 bytes each, the budget only fits about one and a half
+    std::vector<size_t> levelBytes = {64, 16, 4, 1};
+    TextureResidency residency;
+    residency.setBudget(120);
+    for (int key = 1; key <= 3; key++) {
+        residency.add(key, levelBytes, 4);
+    }
+    for (const TextureResidency::Change& change : residency.update()) {
+        residency.setResident(change.key, change.firstLevel);
+    }
+    bool fitsAfterLoad = residency.getStats().residentBytes <= 120;
+
+    // texture 1 is drawn, so 2 and 3 are the ones that shrink
+    residency.request(1, 0);
+    std::map<int, int> levels;
+    for (const TextureResidency::Change& change : residency.update()) {
+        levels[change.key] = change.firstLevel;
+        residency.setResident(change.key, change.firstLevel);
+    }
+    TextureResidency::Stats stats = residency.getStats();
+
+    bool passed = fitsAfterLoad && levels[1] == 0 && levels[2] == 3 && levels[3] == 1 &&
+                  stats.residentBytes == 85 + 1 + 21 && stats.reduced == 2 && stats.streaming == 0;
+    results.push_back({
+        "TextureManager residency budget",
+        passed,
+        passed ? "resident " + std::to_string(stats.residentBytes) + " of 120 bytes" :
+                 "unexpected levels after eviction (resident " + std::to_string(stats.residentBytes) + " bytes)"
+    });
+
+    // a budget too small for anything leaves arrays at their coarsest level, still usable
+    QTemporaryDir dir;
+    std::string imagePath = dir.filePath("small.png").toStdString();
+    QImage image(64, 64, QImage::Format_RGBA8888);
+    image.fill(Qt::red);
+    image.save(QString::fromStdString(imagePath));
+
+    TextureManager manager;
+    manager.setMemoryBudget(1);
+    TextureSlot slot = manager.loadArrayTexture(imagePath);
+    manager.allocateArrays();
+    manager.finishPendingLoads();
+
+    GLint width = 0;
+    glBindTexture(GL_TEXTURE_2D_ARRAY, manager.getArrayTexture(slot.array));
+    glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_WIDTH, &width);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    bool coarse = manager.isLayerReady(slot) && width == 1;
+    results.push_back({
+        "TextureManager budget streaming",
+        coarse,
+        coarse ? "array loaded at 1x1" : "array loaded at " + std::to_string(width) + " wide"
+    });
+
+    manager.cleanup();
+}
+
+// angle in degrees between a reference normal and one rebuilt from x, y like the shader does
+double normalError(const QColor& reference, unsigned char x, unsigned char y) {
+    glm::vec3 a = glm::normalize(glm::vec3(reference.red(), reference.green(), reference.blue()) / 127.5f - 1.0f);
+    glm::vec2 xy = glm::vec2(x, y) / 127.5f - 1.0f;
+    glm::vec3 b = glm::normalize(glm::vec3(xy, std::sqrt(std::max(0.0f, 1.0f - glm::dot(xy, xy)))));
+    return glm::degrees(std::acos(std::clamp(glm::dot(a, b), -1.0f, 1.0f)));
+}
+
+// test that two-channel normal maps rebuild the same normals as the decoded rgb source
+void testNormalMapQuality() {
+    std::string texturePath = std::string(BREAD_RESOURCE_DIR) + "/textures/test_normal.png";
+    QImage reference(QString::fromStdString(texturePath));
+
+    for (bool compressed : {false, true}) {
+        TextureManager manager;
+        manager.setNormalMapCompression(compressed);
+        TextureSlot slot = manager.loadArrayTexture(texturePath, TextureUsage::NormalMap);
+        manager.allocateArrays();
+        manager.finishPendingLoads();
+
+        int width = reference.width();
+        int height = reference.height();
+        std::vector<unsigned char> rg(static_cast<size_t>(width) * height * 2);
+        GLint storedBytes = 0;
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, manager.getArrayTexture(slot.array));
+        glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RG, GL_UNSIGNED_BYTE, rg.data());
+        if (compressed) {
+            glGetTexLevelParameteriv(GL_TEXTURE_2D_ARRAY, 0, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &storedBytes);
+        } else {
+            storedBytes = width * height * 2;
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+        // the texture is flipped for opengl, the reference is not
+        double sum = 0.0;
+        double worst = 0.0;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const unsigned char* texel = rg.data() + (static_cast<size_t>(height - 1 - y) * width + x) * 2;
+                double error = normalError(reference.pixelColor(x, y), texel[0], texel[1]);
+                sum += error;
+                worst = std::max(worst, error);
+            }
+        }
+        double mean = sum / (static_cast<double>(width) * height);
+        double ratio = static_cast<double>(width) * height * 4 / std::max(storedBytes, 1);
+
+        // rg8 only loses rounding, bc5 may be a couple of degrees off at sharp edges
+        bool passed = manager.isLayerReady(slot) &&
+                      (compressed ? mean < 2.0 && worst < 10.0 : mean < 0.5 && worst < 2.0);
+        std::ostringstream message;
+        message << std::fixed << std::setprecision(2) << "mean " << mean << " deg, max " << worst
+                << " deg, " << ratio << "x smaller than rgba8";
+        results.push_back({
+            compressed ? "TextureManager rgtc2 normal maps" : "TextureManager rg8 normal maps",
+            passed,
+            message.str()
+        });
+
+        manager.cleanup();
+    }
+}
+
+// test that the same image reached through a copy, a symlink or a relative path
+// shares one texture (and one array layer), and is freed with its last reference
+void testTextureDedup() {
+    QTemporaryDir dir;
+    QDir root(dir.path());
+    root.mkpath("copy");
+    root.mkpath("other");
+
+    QImage source(256, 128, QImage::Format_RGBA8888);
+    source.fill(QColor(200, 100, 50));
+    source.save(root.filePath("crust.png"));
+    QFile::copy(root.filePath("crust.png"), root.filePath("copy/crust.png"));
+    QFile::link(root.filePath("crust.png"), root.filePath("linked.png"));
+    source.fill(QColor(10, 20, 30));
+    source.save(root.filePath("other/crumb.png"));
+
+    std::vector<std::string> paths = {
+        root.filePath("crust.png").toStdString(),
+        root.filePath("copy/crust.png").toStdString(),
+        root.filePath("linked.png").toStdString(),
+        root.filePath("other/../crust.png").toStdString(),
+    };
+    std::string different = root.filePath("other/crumb.png").toStdString();
+
+    // an image with no other file of its size to match is never read whole
+    TextureManager lone;
+    lone.loadTexture(different);
+    bool unread = lone.getDedupStats().hashedFiles == 0;
+    lone.finishPendingLoads();
+    lone.cleanup();
+
+    TextureManager manager;
+    std::vector<GLuint> ids;
+    for (const std::string& path : paths) {
+        ids.push_back(manager.loadTexture(path));
+    }
+    GLuint differentId = manager.loadTexture(different);
+
+    // the copy is hashed by its decode job, never while it is requested
+    bool deferred = manager.getDedupStats().hashedFiles == 0;
+    manager.finishPendingLoads();
+
+    // the copy's handle (and maybe the first one) stands for the shared texture
+    GLuint texture = manager.resolveTexture(ids[0]);
+    bool shared = std::all_of(ids.begin(), ids.end(),
+                              [&](GLuint id) { return manager.resolveTexture(id) == texture; }) &&
+                  texture != 0 && manager.resolveTexture(differentId) != texture &&
+                  manager.getDedupStats().hashedFiles >= 2;
+
+    // 3 duplicate paths of a 256x128 rgba8 chain
+    TextureManager::DedupStats stats = manager.getDedupStats();
+    size_t chain = 0;
+    for (int level = 0; level < MipGenerator::levelCount(256, 128); level++) {
+        chain += static_cast<size_t>(std::max(1, 256 >> level)) * std::max(1, 128 >> level) * 4;
+    }
+    bool counted = stats.paths == 5 && stats.textures == 2 && stats.dedupedBytes == 3 * chain;
+
+    // one reference per load, the last release deletes it
+    for (size_t i = 0; i + 1 < ids.size(); i++) {
+        manager.releaseTexture(ids[i]);
+    }
+    bool kept = glIsTexture(texture) == GL_TRUE;
+    manager.releaseTexture(ids.back());
+    bool freed = glIsTexture(texture) == GL_FALSE && glIsTexture(ids[0]) == GL_FALSE && glIsTexture(ids[1]) == GL_FALSE;
+
+    TextureSlot first = manager.loadArrayTexture(paths[0]);
+    TextureSlot copy = manager.loadArrayTexture(paths[1]);
+    TextureSlot other = manager.loadArrayTexture(different);
+    bool sharedLayer = first.isValid() && first.array == copy.array && first.layer == copy.layer &&
+                       !(other.array == first.array && other.layer == first.layer);
+
+    bool passed = unread && deferred && shared && counted && kept && freed && sharedLayer;
+    results.push_back({
+        "TextureManager content dedup",
+        passed,
+        !unread ? "a file of a size nothing else has was hashed" :
+        !deferred ? "files were hashed while they were requested" :
+        !shared ? "duplicate paths got separate textures" :
+        !counted ? "dedup stats are off (" + std::to_string(stats.paths) + " paths, " +
+                   std::to_string(stats.textures) + " textures, " + std::to_string(stats.dedupedBytes) + " bytes)" :
+        !kept || !freed ? "reference counting freed the texture at the wrong time" :
+        !sharedLayer ? "duplicate paths got separate array layers" :
+                       std::to_string(stats.paths) + " paths -> " + std::to_string(stats.textures) + " textures, " +
+                       std::to_string(stats.dedupedBytes) + " bytes deduplicated"
+    });
+
+    manager.cleanup();
+}
+
+// test cpu mip generation: box levels within one step of a double precision
+// reference (odd sizes included), the same output on one thread and on the pool,
+// alpha coverage kept at a cutoff, and a kaiser filter that keeps flat color flat
+void testMipGenerator() {
+    auto toLinear = [](int c) {
+        double v = c / 255.0;
+        return v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+    };
+    auto toSrgb = [](double l) {
+        double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+        return static_cast<int>(std::lround(std::clamp(c, 0.0, 1.0) * 255.0));
+    };
+
+    bool accurate = true;
+    bool deterministic = true;
+    int worst = 0;
+    for (auto [width, height] : {std::pair<int, int>(512, 256), std::pair<int, int>(333, 197)}) {
+        std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+        for (size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = static_cast<unsigned char>((i * 2654435761u) >> 13);
+        }
+
+        MipOptions serial;
+        serial.parallel = false;
+        std::vector<MipLevel> levels = MipGenerator::generateRGBA8(pixels.data(), width, height, width * 4, serial);
+        std::vector<MipLevel> pooled = MipGenerator::generateRGBA8(pixels.data(), width, height, width * 4);
+
+        accurate = accurate && static_cast<int>(levels.size()) == MipGenerator::levelCount(width, height) - 1 &&
+                   levels.back().width == 1 && levels.back().height == 1;
+        for (size_t i = 0; i < levels.size() && i < pooled.size(); i++) {
+            deterministic = deterministic && levels[i].pixels == pooled[i].pixels;
+        }
+
+        // level 1 against the footprint average in linear light (alpha is linear)
+        const MipLevel& level = levels[0];
+        for (int y = 0; y < level.height; y++) {
+            int y0 = y * height / level.height;
+            int y1 = std::max(y0 + 1, ((y + 1) * height + level.height - 1) / level.height);
+            for (int x = 0; x < level.width; x++) {
+                int x0 = x * width / level.width;
+                int x1 = std::max(x0 + 1, ((x + 1) * width + level.width - 1) / level.width);
+                for (int c = 0; c < 4; c++) {
+                    double sum = 0.0;
+                    for (int sy = y0; sy < y1; sy++) {
+                        for (int sx = x0; sx < x1; sx++) {
+                            int value = pixels[(static_cast<size_t>(sy) * width + sx) * 4 + c];
+                            sum += c < 3 ? toLinear(value) : value / 255.0;
+                        }
+                    }
+                    double mean = sum / ((x1 - x0) * (y1 - y0));
+                    int expected = c < 3 ? toSrgb(mean) : static_cast<int>(std::lround(mean * 255.0));
+                    worst = std::max(worst, std::abs(expected - level.pixels[(static_cast<size_t>(y) * level.width + x) * 4 + c]));
+                }
+            }
+        }
+    }
+    accurate = accurate && worst <= 1;
+
+    // cutout leaves: without help the alpha test pass rate sinks as the edges blur
+    int size = 256;
+    std::vector<unsigned char> leaves(static_cast<size_t>(size) * size * 4, 128);
+    for (int i = 0; i < size * size; i++) {
+        leaves[i * 4 + 3] = std::sin(i % size * 0.3) * std::sin(i / size * 0.2) > 0.5 ? 255 : 0;
+    }
+    MipOptions cutout;
+    cutout.alphaCutoff = 0.5f;
+    float target = MipGenerator::alphaCoverage(leaves.data(), size, size, size * 4, cutout.alphaCutoff);
+    std::vector<MipLevel> covered = MipGenerator::generateRGBA8(leaves.data(), size, size, size * 4, cutout);
+    float coverageError = 0.0f;
+    for (const MipLevel& level : covered) {
+        if (level.width >= 16) {
+            float coverage = MipGenerator::alphaCoverage(level.pixels.data(), level.width, level.height, level.width * 4, cutout.alphaCutoff);
+            coverageError = std::max(coverageError, std::abs(coverage - target));
+        }
+    }
+
+    std::vector<unsigned char> flat(static_cast<size_t>(size) * size * 4);
+    for (int i = 0; i < size * size; i++) {
+        flat[i * 4] = 100;
+        flat[i * 4 + 1] = 50;
+        flat[i * 4 + 2] = 200;
+        flat[i * 4 + 3] = 255;
+    }
+    MipOptions kaiser;
+    kaiser.filter = MipFilter::Kaiser;
+    bool kaiserFlat = true;
+    for (const MipLevel& level : MipGenerator::generateRGBA8(flat.data(), size, size, size * 4, kaiser)) {
+        for (size_t i = 0; i < level.pixels.size(); i++) {
+            kaiserFlat = kaiserFlat && level.pixels[i] == flat[i % 4];
+        }
+    }
+
+    bool passed = accurate && deterministic && coverageError < 0.03f && kaiserFlat;
+    std::ostringstream message;
+    message << std::fixed << std::setprecision(3) << "max error " << worst << ", coverage off by " << coverageError;
+    results.push_back({
+        "MipGenerator filtering",
+        passed,
+        !deterministic ? "pooled output differs from single threaded" : !kaiserFlat ? "kaiser changed a flat image" : message.str()
+    });
+}
+
 // test that binding texture doesn't crash
 void testTextureBinding(TextureManager& manager) {
-    std::string texturePath = "/Users/fluffy/projects/cs1230/bread-final/resources/textures/test_normal.png";
+    std::string texturePath = std::string(BREAD_RESOURCE_DIR) + "/textures/test_normal.png";
 
     GLuint textureId = manager.loadTexture(texturePath);
 
@@ -158,6 +699,14 @@ int main(int argc, char *argv[]) {
     testInvalidTexture(manager);
     testTextureCaching(manager);
     testTextureBinding(manager);
+    testAsyncUpload();
+    testPreprocessedCache();
+    testCorruptCache();
+    testTextureArrays();
+    testResidencyBudget();
+    testNormalMapQuality();
+    testTextureDedup();
+    testMipGenerator();
 
     // cleanup
     manager.cleanup();
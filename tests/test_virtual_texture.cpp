@@ -0,0 +1,246 @@
+// automated tests for virtual texturing
+// verifies tile files and that the feedback pass asks for the tiles the main pass samples
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "../src/rendering/VirtualTextureFile.h"
+#include "../src/rendering/VirtualTextureManager.h"
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QTemporaryDir>
+#include <QThread>
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+// helper to initialize opengl context for testing
+bool initializeGLContext(QOpenGLContext*& context, QOffscreenSurface*& surface) {
+    context = new QOpenGLContext();
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    context->setFormat(format);
+
+    if (!context->create()) {
+        std::cerr << "failed to create opengl context" << std::endl;
+        return false;
+    }
+
+    surface = new QOffscreenSurface();
+    surface->setFormat(format);
+    surface->create();
+
+    if (!surface->isValid()) {
+        std::cerr << "failed to create offscreen surface" << std::endl;
+        return false;
+    }
+
+    context->makeCurrent(surface);
+
+    glewExperimental = GL_TRUE;
+    GLenum err = glewInit();
+    if (err != GLEW_OK) {
+        std::cerr << "glew initialization failed: " << glewGetErrorString(err) << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// a quad covering the viewport, positions already in clip space with uvs 0..1
+GLuint createQuad(GLuint& vbo) {
+    const float vertices[] = {
+        -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+         1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+         1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+        -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+         1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+        -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+    };
+
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), reinterpret_cast<void*>(3 * sizeof(float)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return vao;
+}
+
+// test that a virtual texture is cut into the expected levels and tiles, with
+// borders copied from the neighbouring tiles and clamped at the image edge
+void testVirtualTextureFile() {
+    QTemporaryDir dir;
+    std::string imagePath = dir.filePath("terrain.png").toStdString();
+    std::string tilePath = dir.filePath("terrain.bvt").toStdString();
+
+    QImage source(300, 200, QImage::Format_RGBA8888);
+    for (int y = 0; y < source.height(); y++) {
+        for (int x = 0; x < source.width(); x++) {
+            source.setPixelColor(x, y, QColor(x % 256, y, x / 256 * 100));
+        }
+    }
+    source.save(QString::fromStdString(imagePath));
+
+    bool built = VirtualTextureFile::build(imagePath, tilePath);
+    std::unique_ptr<VirtualTextureFile> file = VirtualTextureFile::open(tilePath);
+
+    // texel of a padded tile against the source pixel it should hold (tiles are flipped)
+    auto matches = [&](int level, int tileX, int tileY, int x, int y, int sourceX, int sourceY) {
+        const unsigned char* texel = file->tile(level, tileX, tileY) + (static_cast<size_t>(y) * file->paddedTileSize() + x) * 4;
+        QColor expected = source.pixelColor(sourceX, source.height() - 1 - sourceY);
+        return texel[0] == expected.red() && texel[1] == expected.green() && texel[2] == expected.blue();
+    };
+
+    // 300x200 -> 150x100 -> 75x50, the last one fits one 128 tile
+    bool layout = file && file->levelCount() == 3 &&
+                  file->level(0).tilesX == 3 && file->level(0).tilesY == 2 &&
+                  file->level(1).tilesX == 2 && file->level(1).tilesY == 1 &&
+                  file->level(2).tilesX == 1 && file->level(2).tilesY == 1;
+
+    int border = VirtualTextureFile::DEFAULT_BORDER;
+    bool texels = layout &&
+                  matches(0, 1, 0, border, border, 128, 0) &&             // first texel of a tile
+                  matches(0, 1, 0, 0, border, 128 - border, 0) &&         // left border from the previous tile
+                  matches(0, 1, 0, border, 0, 128, 0) &&                  // bottom border clamped
+                  matches(0, 2, 1, border + 43, border + 71, 299, 199) && // last texel of the image
+                  matches(0, 2, 1, border + 50, border + 80, 299, 199);   // past the edge, clamped
+
+    bool passed = built && layout && texels;
+    results.push_back({
+        "VirtualTextureFile tiles",
+        passed,
+        !layout ? "unexpected level layout" : !texels ? "tile texels don't match the source" :
+                  std::to_string(file->levelCount()) + " levels, " + std::to_string(file->tileBytes()) + " bytes per tile"
+    });
+}
+
+// test that the feedback pass offsets its uvs like default.frag when scrolling
+// is on, so the tiles streamed in are the ones the scrolled material samples
+void testScrolledFeedback() {
+    QTemporaryDir dir;
+    std::string imagePath = dir.filePath("scroll.png").toStdString();
+    std::string tilePath = dir.filePath("scroll.bvt").toStdString();
+
+    // 1024x1024 is 8x8 level 0 tiles
+    QImage source(1024, 1024, QImage::Format_RGBA8888);
+    source.fill(QColor(200, 120, 40));
+    source.save(QString::fromStdString(imagePath));
+    bool built = VirtualTextureFile::build(imagePath, tilePath);
+
+    VirtualTextureManager manager;
+    manager.initialize(std::string(BREAD_RESOURCE_DIR) + "/shaders", 16);
+    int vt = built ? manager.load(tilePath) : -1;
+
+    GLuint vbo = 0;
+    GLuint vao = createQuad(vbo);
+
+    // a 1024 viewport gives a 128 pixel feedback target. with a repeat of 1/8 the
+    // quad shows 128 texels, one per feedback pixel, so it wants level 0 tile
+    // (0, 0), or (3, 0) once the uvs are scrolled 0.375 to the right
+    glViewport(0, 0, 1024, 1024);
+    glm::vec2 repeat(0.125f);
+    glm::vec2 scrollDirection(1.0f, 0.0f);
+    float scrollSpeed = 0.25f;
+    float time = 1.5f;
+
+    auto feedback = [&](bool enableScrolling) {
+        QElapsedTimer timer;
+        timer.start();
+        while (!manager.beginFeedback(glm::mat4(1.0f), glm::mat4(1.0f))) {
+            // the feedback program compiles in the background
+            if (timer.elapsed() > 10000) {
+                return false;
+            }
+            QThread::msleep(5);
+        }
+        manager.drawFeedback(vt, glm::mat4(1.0f), repeat, enableScrolling, scrollDirection, scrollSpeed, time, vao, 6);
+        manager.endFeedback();
+        manager.finishPendingTiles();
+        return true;
+    };
+
+    bool unscrolled = vt >= 0 && feedback(false) &&
+                      manager.isResident(vt, 0, 0, 0) && !manager.isResident(vt, 0, 3, 0);
+    bool scrolled = unscrolled && feedback(true) &&
+                    manager.isResident(vt, 0, 3, 0) && !manager.isResident(vt, 0, 4, 0);
+
+    bool passed = built && unscrolled && scrolled;
+    results.push_back({
+        "VirtualTextureManager scrolled feedback",
+        passed,
+        vt < 0 ? "failed to load the virtual texture" :
+        !unscrolled ? "the unscrolled quad didn't request tile (0, 0) alone" :
+        !scrolled ? "the scrolled quad didn't request tile (3, 0)" :
+                    std::to_string(manager.getStats().residentTiles) + " tiles resident"
+    });
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+    manager.cleanup();
+}
+
+int main(int argc, char *argv[]) {
+    // need qapplication for qt image loading
+    QApplication app(argc, argv);
+
+    std::cout << "=== running virtual texture automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    QOpenGLContext* context = nullptr;
+    QOffscreenSurface* surface = nullptr;
+
+    if (!initializeGLContext(context, surface)) {
+        std::cerr << "failed to initialize opengl context for testing" << std::endl;
+        return 1;
+    }
+
+    testVirtualTextureFile();
+    testScrolledFeedback();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    context->doneCurrent();
+    delete surface;
+    delete context;
+
+    return failCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+// automated tests for the y4m video writer
+// verifies frame order and yuv levels
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/rendering/Y4mWriter.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QTemporaryDir>
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+// test that video frames handed in out of order from several threads come out
+// in order, with the expected bt.601 levels
+void testY4mWriter() {
+    int width = 5;
+    int height = 3;
+    const unsigned char colors[4][3] = {{255, 255, 255}, {0, 0, 0}, {128, 128, 128}, {128, 0, 0}};
+    std::vector<std::vector<unsigned char>> frames(4, std::vector<unsigned char>(static_cast<size_t>(width) * height * 4));
+    for (int f = 0; f < 4; f++) {
+        for (int i = 0; i < width * height; i++) {
+            std::memcpy(&frames[f][i * 4], colors[f], 3);
+        }
+    }
+
+    QTemporaryDir dir;
+    std::string path = dir.filePath("frames.y4m").toStdString();
+    Y4mWriter writer;
+    bool written = writer.open(path, width, height, 24);
+    std::vector<std::thread> threads;
+    bool frameWritten[4] = {};
+    for (int f = 3; f >= 0; f--) {
+        threads.emplace_back([&, f]() { frameWritten[f] = writer.writeFrame(f, frames[f].data(), width * 4); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    written = written && frameWritten[0] && frameWritten[1] && frameWritten[2] && frameWritten[3] && writer.close();
+
+    // luma, cb, cr of each frame: white, black, mid gray, dark red
+    const int expected[4][3] = {{235, 128, 128}, {16, 128, 128}, {126, 128, 128}, {49, 109, 184}};
+    QFile file(QString::fromStdString(path));
+    QByteArray data = file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    std::string header = "YUV4MPEG2 W5 H3 F24:1 Ip A1:1 C420jpeg\n";
+    int lumaSize = width * height;
+    int chromaSize = 3 * 2;
+    int frameSize = 6 + lumaSize + 2 * chromaSize;
+    bool ordered = data.size() == static_cast<int>(header.size()) + 4 * frameSize && data.startsWith(header.c_str());
+    for (int f = 0; ordered && f < 4; f++) {
+        const char* frame = data.constData() + header.size() + f * frameSize;
+        ordered = std::memcmp(frame, "FRAME\n", 6) == 0 &&
+                  static_cast<unsigned char>(frame[6 + lumaSize - 1]) == expected[f][0] &&
+                  static_cast<unsigned char>(frame[6 + lumaSize]) == expected[f][1] &&
+                  static_cast<unsigned char>(frame[6 + lumaSize + chromaSize]) == expected[f][2];
+    }
+
+    bool passed = written && ordered;
+    results.push_back({
+        "Y4mWriter frame order",
+        passed,
+        !written ? "a frame failed to write" : !ordered ? "frames out of order or wrong levels" : "4 frames written in order from 4 threads"
+    });
+}
+
+int main() {
+    std::cout << "=== running y4m writer automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    testY4mWriter();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    return failCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+// automated tests for the cpu zone profiler
+// verifies zones nest and land on their thread's track in the chrome trace
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../src/ZoneProfiler.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+struct TestResult {
+    std::string testName;
+    bool passed;
+    std::string message;
+};
+
+std::vector<TestResult> results;
+
+// test that zones from two threads come out of the chrome trace nested and on
+// their own tracks
+void testZoneProfiler() {
+    auto work = [](int count) {
+        for (int i = 0; i < count; i++) {
+            PROFILE_ZONE("test outer");
+            PROFILE_ZONE("test inner");
+        }
+    };
+    std::thread worker([&]() {
+        ZoneProfiler::setThreadName("test worker");
+        work(100);
+    });
+    worker.join();
+    work(10);
+
+    QTemporaryDir dir;
+    std::string path = dir.filePath("trace.json").toStdString();
+    bool written = ZoneProfiler::writeChromeTrace(path);
+    QFile file(QString::fromStdString(path));
+    QJsonArray events = file.open(QIODevice::ReadOnly) ? QJsonDocument::fromJson(file.readAll()).object()["traceEvents"].toArray()
+                                                       : QJsonArray();
+
+    // per track: outer and inner zones seen, nesting depth, and the worker's name
+    std::map<int, int> outer;
+    std::map<int, int> depth;
+    int workerTrack = -1;
+    bool nested = true;
+    for (const QJsonValue& value : events) {
+        QJsonObject event = value.toObject();
+        int track = event["tid"].toInt();
+        QString phase = event["ph"].toString();
+        if (phase == "M" && event["args"].toObject()["name"].toString() == "test worker") {
+            workerTrack = track;
+        } else if (phase == "B") {
+            depth[track]++;
+            if (event["name"].toString() == "test outer") {
+                outer[track]++;
+                nested = nested && depth[track] == 1;
+            } else if (event["name"].toString() == "test inner") {
+                nested = nested && depth[track] == 2;
+            }
+        } else if (phase == "E") {
+            depth[track]--;
+        }
+    }
+    for (const auto& [track, open] : depth) {
+        nested = nested && open == 0;
+    }
+    bool tracks = workerTrack >= 0 && outer[workerTrack] == 100;
+    int mainZones = 0;
+    for (const auto& [track, count] : outer) {
+        mainZones += track != workerTrack ? count : 0;
+    }
+    tracks = tracks && mainZones == 10;
+
+    bool passed = written && nested && tracks;
+    results.push_back({
+        "ZoneProfiler chrome trace",
+        passed,
+        !written ? "trace not written" : !nested ? "zones not nested or unbalanced" :
+        !tracks ? "zones on the wrong tracks" : "110 nested zones on 2 named tracks"
+    });
+}
+
+int main() {
+    std::cout << "=== running zone profiler automated tests ===" << std::endl;
+    std::cout << std::endl;
+
+    testZoneProfiler();
+
+    int passCount = 0;
+    int failCount = 0;
+
+    for (const auto& result : results) {
+        if (result.passed) {
+            std::cout << "[PASS] " << result.testName << ": " << result.message << std::endl;
+            passCount++;
+        } else {
+            std::cout << "[FAIL] " << result.testName << ": " << result.message << std::endl;
+            failCount++;
+        }
+    }
+
+    std::cout << std::endl;
+    std::cout << "=== test summary ===" << std::endl;
+    std::cout << "passed: " << passCount << std::endl;
+    std::cout << "failed: " << failCount << std::endl;
+
+    return failCount > 0 ? 1 : 0;
+}
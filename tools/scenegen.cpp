@@ -0,0 +1,74 @@
+// stress scene generator: writes a scene json in the scenefile format
+//   ./scenegen out.json --primitives 100000 --lights 32 --templates 8 --template-reuse 0.25
+//              --depth 3 --materials 64 --textures 16 --distribution clustered --seed 7
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "../src/utils/scenegenerator.h"
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    SceneGeneratorOptions defaults;
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Writes a synthetic scene for stress tests and benchmarks");
+    parser.addHelpOption();
+    parser.addPositionalArgument("output", "Scene json to write");
+    parser.addOption({"primitives", "Objects to place (default 1000)", "count", QString::number(defaults.primitives)});
+    parser.addOption({"lights", "Lights, the first directional (default 8)", "count", QString::number(defaults.lights)});
+    parser.addOption({"templates", "Distinct templateGroups (default 0)", "count", QString::number(defaults.templates)});
+    parser.addOption({"template-reuse", "Fraction of the objects placed as template references, 0 to 1", "fraction",
+                      QString::number(defaults.templateReuse)});
+    parser.addOption({"depth", "Group levels between the root and the objects (default 2)", "levels",
+                      QString::number(defaults.depth)});
+    parser.addOption({"materials", "Distinct materials (default 16)", "count", QString::number(defaults.materials)});
+    parser.addOption({"textures", "Distinct textures written next to the scene (default 0)", "count",
+                      QString::number(defaults.textures)});
+    parser.addOption({"distribution", "grid, clustered or uniform (default grid)", "name", "grid"});
+    parser.addOption({"clusters", "Cluster count for the clustered distribution (default 16)", "count",
+                      QString::number(defaults.clusters)});
+    parser.addOption({"extent", "Width of the square the objects are spread over (default 100)", "units",
+                      QString::number(defaults.extent)});
+    parser.addOption({"seed", "Random seed, the same seed writes the same scene (default 1)", "seed",
+                      QString::number(defaults.seed)});
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        std::cerr << "scenegen needs one output file" << std::endl;
+        parser.showHelp(1);
+    }
+
+    SceneGeneratorOptions options;
+    options.primitives = std::max(0, parser.value("primitives").toInt());
+    options.lights = std::max(0, parser.value("lights").toInt());
+    options.templates = std::max(0, parser.value("templates").toInt());
+    options.templateReuse = std::clamp(parser.value("template-reuse").toFloat(), 0.0f, 1.0f);
+    options.depth = std::clamp(parser.value("depth").toInt(), 0, 16);
+    options.materials = std::max(1, parser.value("materials").toInt());
+    options.textures = std::max(0, parser.value("textures").toInt());
+    options.clusters = std::max(1, parser.value("clusters").toInt());
+    options.extent = std::max(1.0f, parser.value("extent").toFloat());
+    options.seed = parser.value("seed").toUInt();
+    if (!SceneGenerator::parseDistribution(parser.value("distribution").toStdString(), options.distribution)) {
+        std::cerr << "unknown distribution \"" << parser.value("distribution").toStdString()
+                  << "\", expected grid, clustered or uniform" << std::endl;
+        return 1;
+    }
+
+    std::string path = parser.positionalArguments().first().toStdString();
+    QElapsedTimer timer;
+    timer.start();
+    if (!SceneGenerator::write(path, options)) {
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(1) << "wrote " << path << ": " << options.primitives << " objects, "
+              << options.lights << " lights, " << options.templates << " templates, "
+              << QFileInfo(QString::fromStdString(path)).size() / (1024.0 * 1024.0) << " MB in "
+              << timer.elapsed() / 1000.0 << " s" << std::endl;
+    return 0;
+}